@@ -0,0 +1,558 @@
+'''
+Measures the overhead of binutils in ns/op and writes the results as JSON.
+
+The benchmarks run against a synthetic library (target/bench_target.cpp) that
+is compiled on the fly. Build binutils first (build.sh or build.cmd), then run:
+
+    python benchmarks/bench.py -o before.json
+    python benchmarks/bench.py -o after.json
+    python benchmarks/compare.py before.json after.json
+'''
+
+# =============================================================================
+# >> IMPORTS
+# =============================================================================
+# Python
+import os
+import sys
+import json
+import time
+import struct
+import timeit
+import platform
+import optparse
+
+from distutils import ccompiler
+from distutils import sysconfig
+
+# Make the binutils package of the repository importable
+ROOT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, ROOT_DIR)
+
+# binutils
+from binutils import *
+
+
+# =============================================================================
+# >> CONSTANTS
+# =============================================================================
+# Increase this number if the structure of the result file changes
+RESULT_VERSION = 1
+
+BENCH_DIR     = os.path.dirname(os.path.abspath(__file__))
+TARGET_SOURCE = os.path.join(BENCH_DIR, 'target', 'bench_target.cpp')
+TARGET_NAME   = 'bench_target'
+
+# Field indexes of bench_entity_offset()
+FIELD_HEALTH = 0
+FIELD_SPEED  = 1
+FIELD_NAME   = 2
+FIELD_OWNER  = 3
+
+# Virtual function indexes of CBenchEntity
+VFUNC_GET_HEALTH = 0
+VFUNC_SET_HEALTH = 1
+VFUNC_ADD        = 2
+
+# Positions of the planted signatures relative to the blob size
+SIGNATURE_POSITIONS = (
+    ('early', 0.01),
+    ('middle', 0.5),
+    ('late', 0.99),
+)
+
+# Number of distinct signatures per position. Found signatures are cached by
+# BinaryFile objects, so every uncached scan needs a new signature.
+SIGNATURE_VARIANTS = 8
+
+IS_X86 = struct.calcsize('P') == 4
+
+
+# =============================================================================
+# >> CLASSES
+# =============================================================================
+class BenchRunner(object):
+    '''
+    Runs benchmarks and collects their results.
+    '''
+
+    def __init__(self, min_time=0.2, repeat=5, filters=None):
+        '''
+        Each benchmark is repeated <repeat> times and runs at least <min_time>
+        seconds per repetition. The fastest repetition is reported.
+        '''
+
+        self.min_time = min_time
+        self.repeat   = repeat
+        self.filters  = filters or []
+        self.results  = {}
+
+    def is_enabled(self, name):
+        '''
+        Returns True if the benchmark matches at least one filter.
+        '''
+
+        return not self.filters or any(f in name for f in self.filters)
+
+    def run(self, name, func, *args):
+        '''
+        Calls <func> with <args> repeatedly and records the time per call.
+        '''
+
+        self.run_batch(name, 1, func, *args)
+
+    def run_batch(self, name, ops_per_call, func, *args):
+        '''
+        Works like run(), but a single call of <func> performs <ops_per_call>
+        operations.
+        '''
+
+        if not self.is_enabled(name):
+            return
+
+        # Find a number of calls that takes at least <min_time> seconds
+        number = 1
+        while True:
+            elapsed = self.__measure(number, func, args)
+            if elapsed >= self.min_time or number >= 1 << 30:
+                break
+
+            number *= 10 if elapsed < self.min_time / 10.0 else 2
+
+        timings = [elapsed] + [self.__measure(number, func, args)
+            for x in xrange(self.repeat - 1)]
+
+        self.add(name, min(timings) / number, number, ops_per_call)
+
+    def run_once(self, name, funcs):
+        '''
+        Calls each function of <funcs> a single time and records the average
+        time per call. Used for operations that can't be repeated, like
+        uncached signature scans.
+        '''
+
+        if not self.is_enabled(name):
+            return
+
+        start = timeit.default_timer()
+        for func in funcs:
+            func()
+
+        self.add(name, (timeit.default_timer() - start) / len(funcs),
+            len(funcs))
+
+    def add(self, name, seconds, number, ops_per_call=1):
+        '''
+        Adds a result. <seconds> is the time of a single call.
+        '''
+
+        ns_per_op = seconds * 1e9 / ops_per_call
+        self.results[name] = {
+            'ns_per_op': ns_per_op,
+            'calls': number,
+            'ops_per_call': ops_per_call
+        }
+
+        print('%-40s %14.1f ns/op'% (name, ns_per_op))
+
+    @staticmethod
+    def __measure(number, func, args):
+        start = timeit.default_timer()
+        for x in xrange(number):
+            func(*args)
+
+        return timeit.default_timer() - start
+
+
+# =============================================================================
+# >> TARGET
+# =============================================================================
+def build_target(build_dir):
+    '''
+    Compiles the synthetic target library into <build_dir> and returns the
+    path that has to be passed to find_binary().
+    '''
+
+    compiler = ccompiler.new_compiler(
+        compiler='mingw32' if os.name == 'nt' else None)
+
+    sysconfig.customize_compiler(compiler)
+
+    if os.name == 'nt':
+        extra_compile = ['-O2']
+
+        # Don't decorate stdcall functions, so they can be found by name
+        extra_link = ['-Wl,--kill-at', '-static-libgcc', '-static-libstdc++']
+        file_name = TARGET_NAME + '.dll'
+    else:
+        extra_compile = ['-O2', '-fPIC', '-pthread']
+        extra_link = ['-pthread']
+        file_name = TARGET_NAME + '.so'
+
+    objects = compiler.compile([TARGET_SOURCE], output_dir=build_dir,
+        extra_postargs=extra_compile)
+
+    compiler.link_shared_object(objects, os.path.join(build_dir, file_name),
+        extra_postargs=extra_link, target_lang='c++')
+
+    return os.path.join(build_dir, TARGET_NAME)
+
+def make_signature(index, variant):
+    '''
+    Returns a signature that doesn't contain null bytes (the signature cache
+    compares C strings) or the wildcard byte.
+    '''
+
+    data = [0x55, 0x8B, 0xEC, 0x83, 0xE4, 0xF0, 0x81, 0xEC,
+        0x10 + index, 0x40 + variant, 0xA1, 0xB2, 0xC3, 0xD4, 0xE5, 0xF6]
+
+    return ''.join(chr(x) for x in data)
+
+def make_wildcard(signature):
+    '''
+    Replaces some bytes of the signature with the wildcard byte.
+    '''
+
+    return signature[:2] + '\x2A\x2A' + signature[4:6] + '\x2A' + \
+        signature[7:]
+
+def plant_signatures(blob, blob_size):
+    '''
+    Writes all signatures into the blob. Returns a dictionary that maps the
+    position names to the list of their signatures.
+    '''
+
+    planted = {}
+    for index, (name, position) in enumerate(SIGNATURE_POSITIONS):
+        offset = int(blob_size * position)
+        signatures = planted[name] = []
+        for variant in xrange(SIGNATURE_VARIANTS):
+            signature = make_signature(index, variant)
+            for i, byte in enumerate(signature):
+                blob.set_uchar(ord(byte), offset + i)
+
+            signatures.append(signature)
+            offset += len(signature)
+
+    return planted
+
+
+# =============================================================================
+# >> BENCHMARKS
+# =============================================================================
+def bench_calls(runner, binary):
+    '''
+    Function.__call__ by signature shape.
+    '''
+
+    noargs = binary['bench_noargs'].make_function(Convention.CDECL, ')i')
+    add_ii = binary['bench_add_ii'].make_function(Convention.CDECL, 'ii)i')
+    add_dd = binary['bench_add_dd'].make_function(Convention.CDECL, 'dd)d')
+    add_ll = binary['bench_add_ll'].make_function(Convention.CDECL, 'll)l')
+    mixed  = binary['bench_mixed'].make_function(Convention.CDECL, 'idZp)i')
+    string = binary['bench_string'].make_function(Convention.CDECL, ')Z')
+    ptr    = binary['bench_get_entity'].make_function(Convention.CDECL, ')p')
+
+    entity = ptr()
+    runner.run('call.cdecl.noargs', noargs)
+    runner.run('call.cdecl.ii', add_ii, 1, 2)
+    runner.run('call.cdecl.dd', add_dd, 1.0, 2.0)
+    runner.run('call.cdecl.ll', add_ll, 1, 2)
+    runner.run('call.cdecl.mixed', mixed, 1, 2.0, 'abc', entity)
+    runner.run('call.cdecl.ret_string', string)
+    runner.run('call.cdecl.ret_ptr', ptr)
+
+    # Only x86 has several calling conventions
+    if IS_X86:
+        add_std = binary['bench_stdcall_ii'].make_function(
+            Convention.STDCALL, 'ii)i')
+
+        runner.run('call.stdcall.ii', add_std, 1, 2)
+
+    get_health = entity.make_virtual_function(VFUNC_GET_HEALTH,
+        Convention.THISCALL, 'p)i')
+
+    add = entity.make_virtual_function(VFUNC_ADD, Convention.THISCALL,
+        'pii)i')
+
+    runner.run('call.thiscall.virtual_p', get_health, entity)
+    runner.run('call.thiscall.virtual_pii', add, entity, 1, 2)
+    runner.run('call.make_virtual_function', entity.make_virtual_function,
+        VFUNC_GET_HEALTH, Convention.THISCALL, 'p)i')
+
+def bench_memory(runner, binary):
+    '''
+    Pointer.get_*() and Pointer.set_*().
+    '''
+
+    get_offset = binary['bench_entity_offset'].make_function(
+        Convention.CDECL, 'i)i')
+
+    entity = binary['bench_get_entity'].make_function(Convention.CDECL, ')p')()
+    health = get_offset(FIELD_HEALTH)
+    speed  = get_offset(FIELD_SPEED)
+    name   = get_offset(FIELD_NAME)
+    owner  = get_offset(FIELD_OWNER)
+
+    runner.run('memory.get_int', entity.get_int, health)
+    runner.run('memory.set_int', entity.set_int, 100, health)
+    runner.run('memory.get_float', entity.get_float, speed)
+    runner.run('memory.set_float', entity.set_float, 1.5, speed)
+    runner.run('memory.get_ptr', entity.get_ptr, owner)
+    runner.run('memory.get_string_array', entity.get_string_array, name)
+    runner.run('memory.set_string_array', entity.set_string_array,
+        'bench_entity', name)
+
+    runner.run('memory.pointer_add', entity.__add__, health)
+    runner.run('memory.get_virtual_table', entity.get_ptr)
+
+    block = alloc(65536)
+    runner.run('memory.hash_xxh3_64k', block.hash, 65536)
+    runner.run('memory.hash_xxh64_64k', block.hash, 65536, 'xxh64')
+
+def bench_type_manager(runner, binary):
+    '''
+    Attribute and function access of types created by a TypeManager.
+    '''
+
+    get_offset = binary['bench_entity_offset'].make_function(
+        Convention.CDECL, 'i)i')
+
+    size = binary['bench_entity_size'].make_function(Convention.CDECL, ')i')
+
+    manager = TypeManager()
+    Entity = manager.create_type('Entity', {
+        'size': size(),
+        'health': manager.attribute('int', get_offset(FIELD_HEALTH)),
+        'speed': manager.attribute('float', get_offset(FIELD_SPEED)),
+        'name': manager.attribute('string_array', get_offset(FIELD_NAME)),
+        'owner': manager.attribute('Entity', get_offset(FIELD_OWNER)),
+        'get_health': manager.virtual_function(VFUNC_GET_HEALTH, 'p)i'),
+        'add': manager.virtual_function(VFUNC_ADD, 'pii)i'),
+    })
+
+    entity = Entity(binary['bench_get_entity'].make_function(
+        Convention.CDECL, ')p')())
+
+    runner.run('type_manager.get_int', getattr, entity, 'health')
+    runner.run('type_manager.set_int', setattr, entity, 'health', 100)
+    runner.run('type_manager.get_float', getattr, entity, 'speed')
+    runner.run('type_manager.get_string_array', getattr, entity, 'name')
+    runner.run('type_manager.get_custom_type', getattr, entity, 'owner')
+    runner.run('type_manager.virtual_function', lambda: entity.get_health())
+    runner.run('type_manager.virtual_function_args',
+        lambda: entity.add(1, 2))
+
+    runner.run('type_manager.wrap_pointer', Entity, entity)
+
+    layout = manager.get_layout('Entity')
+    blob = serialize(entity, layout, 1)
+    runner.run('type_manager.serialize', serialize, entity, layout, 1)
+    runner.run('type_manager.deserialize_into', deserialize_into, entity,
+        blob, layout)
+
+def bench_symbols(runner, binary):
+    '''
+    BinaryFile.find_symbol() and BinaryFile.find_symbols().
+    '''
+
+    symbols = ['bench_noargs', 'bench_add_ii', 'bench_hook_target',
+        'bench_fill_blob']
+
+    runner.run('scan.find_symbol', binary.find_symbol, 'bench_fill_blob')
+    runner.run('scan.find_symbol_missing', binary.find_symbol, 'missing')
+    runner.run_batch('scan.find_symbols', len(symbols), binary.find_symbols,
+        symbols)
+
+def bench_signatures(runner, binary, planted):
+    '''
+    BinaryFile.find_signature() and BinaryFile.find_signatures() for planted
+    signatures at several positions.
+    '''
+
+    for name, signatures in sorted(planted.iteritems()):
+        # Every variant is searched only once, because found signatures are
+        # cached
+        runner.run_once('scan.find_signature.%s'% name,
+            [lambda sig=sig: binary.find_signature(sig)
+                for sig in signatures[:SIGNATURE_VARIANTS / 2]])
+
+        runner.run_once('scan.find_signature_wildcard.%s'% name,
+            [lambda sig=sig: binary.find_signature(make_wildcard(sig))
+                for sig in signatures[SIGNATURE_VARIANTS / 2:]])
+
+    # Signatures that can't be found aren't cached, so this is repeatable
+    runner.run('scan.find_signature.missing', binary.find_signature,
+        make_signature(0xE0, 0x80))
+
+    runner.run('scan.find_signature.cached', binary.find_signature,
+        planted['early'][0])
+
+    # The batch scan finds all signatures in a single pass. Missing
+    # signatures are used, so the results aren't cached.
+    missing = [make_signature(0xE0, 0x80 + x) for x in xrange(8)]
+    runner.run_batch('scan.find_signatures', len(missing),
+        binary.find_signatures, missing)
+
+def bench_hooks(runner, binary):
+    '''
+    Pre- and post-hook dispatch. The unhooked call is measured as well, so
+    the overhead can be calculated.
+    '''
+
+    target = binary['bench_hook_target'].make_function(Convention.CDECL,
+        'ii)i')
+
+    runner.run('hook.unhooked', target, 1, 2)
+
+    def pre_hook(args):
+        pass
+
+    def post_hook(args, retval):
+        pass
+
+    def override_hook(args):
+        return 5
+
+    target.add_pre_hook(pre_hook)
+    runner.run('hook.pre', target, 1, 2)
+
+    target.add_post_hook(post_hook)
+    runner.run('hook.pre_post', target, 1, 2)
+    target.remove_pre_hook(pre_hook)
+    target.remove_post_hook(post_hook)
+
+    target.add_pre_hook(override_hook)
+    runner.run('hook.pre_override', target, 1, 2)
+    target.remove_pre_hook(override_hook)
+
+    # The hook is still installed, but no callback is registered anymore
+    runner.run('hook.empty', target, 1, 2)
+
+    def read_args(args):
+        args[0]
+        args[1]
+
+    target.add_pre_hook(read_args)
+    runner.run('hook.pre_read_args', target, 1, 2)
+    target.remove_pre_hook(read_args)
+
+    # Cached calls don't call the original function
+    target.enable_cache(16)
+    runner.run('hook.cache_hit', target, 1, 2)
+    target.disable_cache()
+
+    # Rules are applied by the hook itself, so Python is never called
+    target.add_clamp_rule(0, 0, 100)
+    runner.run('hook.rule_clamp', target, 1, 2)
+    target.clear_rules()
+
+    target.add_supersede_rule(5)
+    runner.run('hook.rule_supersede', target, 1, 2)
+    target.clear_rules()
+
+    # Timeline spans write two events per call into a per-thread buffer
+    enable_timeline(True)
+    target.add_timeline_span('bench_hook_target')
+    runner.run('hook.timeline_span', target, 1, 2)
+    target.remove_timeline_span()
+    enable_timeline(False)
+    clear_timeline()
+
+def bench_callbacks(runner, binary):
+    '''
+    Callback invocation from native code and from Python.
+    '''
+
+    def add(x, y, ebp):
+        return x + y
+
+    callback = Callback(add, Convention.CDECL, 'ii)i')
+    driver = binary['bench_call_callback'].make_function(Convention.CDECL,
+        'pi)i')
+
+    count = 1000
+    try:
+        runner.run_batch('callback.native', count, driver, callback, count)
+
+        runner.run('callback.python', callback, 1, 2)
+    finally:
+        callback.free()
+
+
+# =============================================================================
+# >> MAIN
+# =============================================================================
+def main():
+    parser = optparse.OptionParser(usage='%prog [options] [filter ...]',
+        description='Runs the binutils benchmarks. Only benchmarks that co' \
+            'ntain one of the filters are run.')
+
+    parser.add_option('-o', '--output', help='write the results to this ' \
+        'JSON file')
+
+    parser.add_option('-b', '--build-dir', default=os.path.join(BENCH_DIR,
+        'build'), help='directory of the target library')
+
+    parser.add_option('-t', '--min-time', type='float', default=0.2,
+        help='minimum time per repetition in seconds')
+
+    parser.add_option('-r', '--repeat', type='int', default=5,
+        help='number of repetitions')
+
+    options, filters = parser.parse_args()
+
+    print('Building the target library...')
+    target_path = build_target(options.build_dir)
+
+    runner = BenchRunner(options.min_time, options.repeat, filters)
+    binary = find_binary(target_path, False)
+
+    # Prepare the blob before any signature is searched, because binaries of
+    # memory backends copy the image once
+    blob = binary['bench_blob_address'].make_function(Convention.CDECL, ')p')()
+    blob_size = binary['bench_blob_size'].make_function(Convention.CDECL,
+        ')i')()
+
+    binary['bench_fill_blob'].make_function(Convention.CDECL, 'I)v')(1)
+    planted = plant_signatures(blob, blob_size)
+
+    # Binaries that have been loaded with dlopen() can't be scanned directly,
+    # so signatures are searched in the memory of this process instead
+    scan_binary = binary
+    if os.name != 'nt':
+        scan_binary = RemoteProcess(os.getpid()).find_binary(target_path,
+            False)
+
+    print('Running benchmarks...')
+    bench_calls(runner, binary)
+    bench_memory(runner, binary)
+    bench_type_manager(runner, binary)
+    bench_symbols(runner, binary)
+    bench_signatures(runner, scan_binary, planted)
+    bench_hooks(runner, binary)
+    bench_callbacks(runner, binary)
+
+    result = {
+        'version': RESULT_VERSION,
+        'info': {
+            'time': time.strftime('%Y-%m-%d %H:%M:%S'),
+            'platform': platform.platform(),
+            'machine': platform.machine(),
+            'python': platform.python_version(),
+            'pointer_size': struct.calcsize('P'),
+            'min_time': options.min_time,
+            'repeat': options.repeat,
+            'blob_size': blob_size,
+        },
+        'results': runner.results
+    }
+
+    if options.output:
+        with open(options.output, 'w') as f:
+            json.dump(result, f, indent=4, sort_keys=True)
+
+        print('Results written to %s.'% options.output)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,410 @@
+'''
+Measures the latency of hook dispatch while a hooked function of the target
+library is called by several threads at once. The latency of every call is
+recorded in an HDR-style histogram and reported as p50, p99 and p99.9.
+
+    python benchmarks/bench_threads.py -n 8 -o threads.json
+    python benchmarks/bench_threads.py python_pre python_post
+
+Configurations:
+    direct            the function isn't hooked yet (baseline)
+    bridge            the function is hooked, but no callback is registered
+                      (the hook jumps straight to the trampoline)
+    native            a native pre-hook callback that does nothing
+    call_trampoline   Function.call_trampoline() called by Python threads
+    python_pre        a Python pre-hook that does nothing
+    python_post       a Python post-hook that does nothing
+
+All configurations except call_trampoline call the function from native
+threads. Python callbacks have to acquire the GIL for every call in that case,
+so their percentiles show the GIL contention.
+'''
+
+# =============================================================================
+# >> IMPORTS
+# =============================================================================
+# Python
+import os
+import sys
+import json
+import time
+import ctypes
+import struct
+import platform
+import optparse
+import threading
+import multiprocessing
+
+# Make the binutils package of the repository importable
+ROOT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, ROOT_DIR)
+
+# binutils
+from binutils import *
+from _binutils import get_trace_time
+
+# Benchmarks
+from bench import BENCH_DIR
+from bench import build_target
+
+
+# =============================================================================
+# >> CONSTANTS
+# =============================================================================
+# Increase this number if the structure of the result file changes
+RESULT_VERSION = 1
+
+# Configurations in the order they are run. Hooks can't be removed, so the
+# unhooked configuration has to be the first one.
+CONFIGURATIONS = (
+    'direct',
+    'bridge',
+    'native',
+    'call_trampoline',
+    'python_pre',
+    'python_post',
+)
+
+# Number of calls per thread before call_trampoline starts measuring. Must
+# match BENCH_WARMUP_CALLS of the target library.
+WARMUP_CALLS = 1000
+
+PERCENTILES = (50.0, 99.0, 99.9)
+
+
+# =============================================================================
+# >> CLASSES
+# =============================================================================
+class Histogram(object):
+    '''
+    HDR-style histogram of latencies in nanoseconds. Values below
+    2 ** <sub_bucket_bits> are recorded exactly. Larger values are grouped
+    into buckets, so the relative error is at most 2 ** (1 - sub_bucket_bits)
+    regardless of the magnitude.
+    '''
+
+    def __init__(self, sub_bucket_bits=10):
+        self.sub_bucket_bits = sub_bucket_bits
+        self.counts = {}
+        self.total  = 0
+        self.sum    = 0
+        self.max    = 0
+
+    def get_index(self, value):
+        '''
+        Returns the bucket index of a value. Indexes grow with the values.
+        '''
+
+        bits = self.sub_bucket_bits
+        if value < 1 << bits:
+            return value
+
+        shift = value.bit_length() - bits
+        return (shift << (bits - 1)) + (value >> shift)
+
+    def get_highest_value(self, index):
+        '''
+        Returns the largest value that falls into the given bucket.
+        '''
+
+        bits = self.sub_bucket_bits
+        if index < 1 << bits:
+            return index
+
+        shift = (index >> (bits - 1)) - 1
+        top = index - (shift << (bits - 1))
+        return ((top + 1) << shift) - 1
+
+    def record(self, values):
+        '''
+        Records all values of the given iterable.
+        '''
+
+        counts = self.counts
+        get_index = self.get_index
+        for value in values:
+            index = get_index(value)
+            counts[index] = counts.get(index, 0) + 1
+
+        self.total += len(values)
+        self.sum += sum(values)
+        self.max = max(self.max, max(values))
+
+    def merge(self, other):
+        '''
+        Adds the values of another histogram with the same precision.
+        '''
+
+        for index, count in other.counts.iteritems():
+            self.counts[index] = self.counts.get(index, 0) + count
+
+        self.total += other.total
+        self.sum += other.sum
+        self.max = max(self.max, other.max)
+
+    def get_percentile(self, percentile):
+        '''
+        Returns the value that <percentile> percent of all values are less
+        than or equal to.
+        '''
+
+        if not self.total:
+            return 0
+
+        # Round up, so the 100th percentile is the largest value
+        target = max(1, -(-self.total * percentile // 100))
+        seen = 0
+        for index in sorted(self.counts):
+            seen += self.counts[index]
+            if seen >= target:
+                return min(self.get_highest_value(index), self.max)
+
+        return self.max
+
+    def get_mean(self):
+        return float(self.sum) / self.total if self.total else 0.0
+
+
+class ThreadDriver(object):
+    '''
+    Calls functions from native threads with bench_run_threads() of the
+    target library.
+    '''
+
+    def __init__(self, library_path):
+        # ctypes releases the GIL while the threads are running, so Python
+        # callbacks of the threads can acquire it
+        self.library = ctypes.CDLL(library_path)
+        self.run_threads = self.library.bench_run_threads
+        self.run_threads.restype = ctypes.c_longlong
+        self.run_threads.argtypes = [ctypes.c_void_p, ctypes.c_int,
+            ctypes.c_int, ctypes.POINTER(ctypes.c_uint)]
+
+    def run(self, address, thread_count, calls):
+        '''
+        Calls the function at <address> <calls> times per thread. Returns a
+        histogram for every thread and the elapsed time in nanoseconds.
+        '''
+
+        samples = (ctypes.c_uint * (thread_count * calls))()
+        elapsed = self.run_threads(address, thread_count, calls, samples)
+        if elapsed < 0:
+            raise RuntimeError('Unable to create %d threads.'% thread_count)
+
+        histograms = []
+        for thread in xrange(thread_count):
+            histogram = Histogram()
+            histogram.record(samples[thread * calls:(thread + 1) * calls])
+            histograms.append(histogram)
+
+        return histograms, elapsed
+
+
+# =============================================================================
+# >> FUNCTIONS
+# =============================================================================
+def run_python_threads(func, thread_count, calls):
+    '''
+    Works like ThreadDriver.run(), but calls <func> from Python threads.
+    '''
+
+    ready = threading.Semaphore(0)
+    start_event = threading.Event()
+    results = []
+
+    def worker():
+        for x in xrange(WARMUP_CALLS):
+            func(x, 1)
+
+        ready.release()
+        start_event.wait()
+
+        # Trace times are microseconds
+        samples = []
+        start = get_trace_time()
+        for x in xrange(calls):
+            call_start = get_trace_time()
+            func(x, 1)
+            samples.append(int((get_trace_time() - call_start) * 1000))
+
+        results.append((start, get_trace_time(), samples))
+
+    threads = [threading.Thread(target=worker) for x in xrange(thread_count)]
+    for thread in threads:
+        thread.start()
+
+    for thread in threads:
+        ready.acquire()
+
+    start_event.set()
+    for thread in threads:
+        thread.join()
+
+    histograms = []
+    for start, end, samples in results:
+        histogram = Histogram()
+        histogram.record(samples)
+        histograms.append(histogram)
+
+    elapsed = max(r[1] for r in results) - min(r[0] for r in results)
+    return histograms, int(elapsed * 1000)
+
+def get_thread_counts(max_threads):
+    '''
+    Returns 1, 2, 4, ... up to and including <max_threads>.
+    '''
+
+    counts = []
+    count = 1
+    while count < max_threads:
+        counts.append(count)
+        count *= 2
+
+    counts.append(max_threads)
+    return counts
+
+def setup_configuration(name, target, native_hook, callbacks):
+    '''
+    Registers the callbacks of the configuration <name>.
+    '''
+
+    if name == 'bridge':
+        # Install the hook without leaving a callback behind
+        target.add_native_pre_hook(native_hook)
+        target.remove_native_pre_hook(native_hook)
+    elif name == 'native':
+        target.add_native_pre_hook(native_hook)
+    elif name == 'python_pre':
+        target.add_pre_hook(callbacks['pre'])
+    elif name == 'python_post':
+        target.add_post_hook(callbacks['post'])
+
+def teardown_configuration(name, target, native_hook, callbacks):
+    '''
+    Removes the callbacks of the configuration <name>. The function stays
+    hooked.
+    '''
+
+    if name == 'native':
+        target.remove_native_pre_hook(native_hook)
+    elif name == 'python_pre':
+        target.remove_pre_hook(callbacks['pre'])
+    elif name == 'python_post':
+        target.remove_post_hook(callbacks['post'])
+
+def main():
+    parser = optparse.OptionParser(usage='%prog [options] [configuration ...]',
+        description='Measures hook dispatch latency with several threads. ' \
+            'Configurations: %s.'% ', '.join(CONFIGURATIONS))
+
+    parser.add_option('-o', '--output', help='write the results to this ' \
+        'JSON file')
+
+    parser.add_option('-b', '--build-dir', default=os.path.join(BENCH_DIR,
+        'build'), help='directory of the target library')
+
+    parser.add_option('-n', '--max-threads', type='int',
+        default=multiprocessing.cpu_count(),
+        help='largest number of threads (default: number of CPUs)')
+
+    parser.add_option('-c', '--calls', type='int', default=20000,
+        help='measured calls per thread')
+
+    options, names = parser.parse_args()
+    for name in names:
+        if name not in CONFIGURATIONS:
+            parser.error('Unknown configuration: %s'% name)
+
+    if options.max_threads < 1 or options.calls < 1:
+        parser.error('At least one thread and one call are required.')
+
+    print('Building the target library...')
+    target_path = build_target(options.build_dir)
+    library_path = target_path + ('.dll' if os.name == 'nt' else '.so')
+
+    binary = find_binary(target_path, False)
+    target = binary['bench_hook_target'].make_function(Convention.CDECL,
+        'ii)i')
+
+    native_hook = binary['bench_native_hook']
+    driver = ThreadDriver(library_path)
+
+    def pre_hook(args):
+        pass
+
+    def post_hook(args, retval):
+        pass
+
+    callbacks = {'pre': pre_hook, 'post': post_hook}
+    thread_counts = get_thread_counts(options.max_threads)
+    results = {}
+
+    print('%-16s %7s %10s %10s %10s %10s %12s'% ('Configuration', 'Threads',
+        'p50 (ns)', 'p99 (ns)', 'p99.9 (ns)', 'max (ns)', 'Mcalls/s'))
+
+    for name in CONFIGURATIONS:
+        # Hooks can't be removed, so all previous configurations have to be
+        # set up even if they aren't measured
+        setup_configuration(name, target, native_hook, callbacks)
+        if names and name not in names:
+            teardown_configuration(name, target, native_hook, callbacks)
+            continue
+
+        for thread_count in thread_counts:
+            if name == 'call_trampoline':
+                histograms, elapsed = run_python_threads(
+                    target.call_trampoline, thread_count, options.calls)
+            else:
+                histograms, elapsed = driver.run(int(target), thread_count,
+                    options.calls)
+
+            histogram = Histogram()
+            for thread_histogram in histograms:
+                histogram.merge(thread_histogram)
+
+            percentiles = [histogram.get_percentile(p) for p in PERCENTILES]
+            throughput = histogram.total * 1e3 / elapsed if elapsed else 0.0
+
+            print('%-16s %7d %10d %10d %10d %10d %12.2f'% ((name,
+                thread_count) + tuple(percentiles) + (histogram.max,
+                throughput)))
+
+            results['%s.%d'% (name, thread_count)] = {
+                'threads': thread_count,
+                'calls': histogram.total,
+                'p50': percentiles[0],
+                'p99': percentiles[1],
+                'p99.9': percentiles[2],
+                'max': histogram.max,
+                'mean': histogram.get_mean(),
+                'mcalls_per_second': throughput,
+
+                # Worst p99 of a single thread
+                'thread_p99_max': max(h.get_percentile(99.0)
+                    for h in histograms),
+            }
+
+        teardown_configuration(name, target, native_hook, callbacks)
+
+    result = {
+        'version': RESULT_VERSION,
+        'info': {
+            'time': time.strftime('%Y-%m-%d %H:%M:%S'),
+            'platform': platform.platform(),
+            'machine': platform.machine(),
+            'python': platform.python_version(),
+            'pointer_size': struct.calcsize('P'),
+            'cpu_count': multiprocessing.cpu_count(),
+            'calls_per_thread': options.calls,
+        },
+        'results': results
+    }
+
+    if options.output:
+        with open(options.output, 'w') as f:
+            json.dump(result, f, indent=4, sort_keys=True)
+
+        print('Results written to %s.'% options.output)
+
+if __name__ == '__main__':
+    main()
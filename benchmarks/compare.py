@@ -0,0 +1,110 @@
+'''
+Compares two result files of bench.py and prints the change of every
+benchmark. Exits with status 1 if at least one benchmark got slower than the
+threshold.
+
+    python benchmarks/compare.py before.json after.json --threshold 10
+'''
+
+# =============================================================================
+# >> IMPORTS
+# =============================================================================
+# Python
+import sys
+import json
+import optparse
+
+
+# =============================================================================
+# >> CONSTANTS
+# =============================================================================
+# Must match bench.RESULT_VERSION
+RESULT_VERSION = 1
+
+# Info fields that should be equal in both files
+INFO_FIELDS = (
+    'platform',
+    'machine',
+    'python',
+    'pointer_size',
+)
+
+
+# =============================================================================
+# >> FUNCTIONS
+# =============================================================================
+def load_results(path):
+    '''
+    Loads a result file and checks its version.
+    '''
+
+    with open(path) as f:
+        data = json.load(f)
+
+    if data.get('version') != RESULT_VERSION:
+        raise ValueError('%s has version %s, expected %s.'% (path,
+            data.get('version'), RESULT_VERSION))
+
+    return data
+
+def compare(old, new, threshold):
+    '''
+    Returns a list of (name, old ns/op, new ns/op, change in percent,
+    regression) tuples. Missing benchmarks have None as their value.
+    '''
+
+    rows = []
+    old_results = old['results']
+    new_results = new['results']
+    for name in sorted(set(old_results) | set(new_results)):
+        old_value = old_results.get(name, {}).get('ns_per_op')
+        new_value = new_results.get(name, {}).get('ns_per_op')
+        change = None
+        if old_value and new_value is not None:
+            change = (new_value - old_value) / float(old_value) * 100.0
+
+        rows.append((name, old_value, new_value, change,
+            change is not None and change > threshold))
+
+    return rows
+
+def format_value(value, format_string):
+    return '-' if value is None else format_string % value
+
+def main():
+    parser = optparse.OptionParser(usage='%prog [options] old.json new.json')
+    parser.add_option('-t', '--threshold', type='float', default=10.0,
+        help='slowdown in percent that is reported as a regression')
+
+    options, args = parser.parse_args()
+    if len(args) != 2:
+        parser.error('Two result files are required.')
+
+    old = load_results(args[0])
+    new = load_results(args[1])
+
+    for field in INFO_FIELDS:
+        if old['info'].get(field) != new['info'].get(field):
+            print('Warning: %s differs (%s vs. %s)'% (field,
+                old['info'].get(field), new['info'].get(field)))
+
+    print('%-40s %14s %14s %9s'% ('Benchmark', 'Old (ns/op)', 'New (ns/op)',
+        'Change'))
+
+    rows = compare(old, new, options.threshold)
+    for name, old_value, new_value, change, regression in rows:
+        print('%-40s %14s %14s %9s%s'% (name,
+            format_value(old_value, '%.1f'),
+            format_value(new_value, '%.1f'),
+            format_value(change, '%+.1f%%'),
+            '  <-- regression' if regression else ''))
+
+    regressions = sum(1 for row in rows if row[4])
+    if regressions:
+        print('%d benchmark(s) got slower by more than %.1f%%.'% (regressions,
+            options.threshold))
+
+    return 1 if regressions else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,738 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+/*
+    Standalone benchmarks for the parts of binutils that don't depend on
+    Python: signature scanning, symbol lookup, the instruction decoder and
+    bridge generation. Build it with benchmarks/native/build.py.
+
+    Usage: bench_native [-s <scan size in MB>] [-t <threads>] [-e <ELF file>]
+*/
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <link.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    #include <cpuid.h>
+    #define HAVE_CPUID
+#endif
+
+#include "binutils_elf.h"
+#include "binutils_search.h"
+#include "binutils_thread.h"
+#include "binutils_trace.h"
+
+#include "asm.h"
+#include "asm_x64.h"
+#include "utilities.h"
+#include "DynamicHooks.h"
+using namespace DynamicHooks;
+
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+#define BENCH_NOINLINE __attribute__((noinline))
+
+// Minimum time of each measurement in seconds
+#define MIN_TIME 0.2
+
+// Number of hook targets for the bridge benchmark
+#define HOOK_TARGETS 4
+
+
+// ============================================================================
+// >> HELPER FUNCTIONS
+// ============================================================================
+// Returns the time in seconds
+inline double Now()
+{
+    return GetTracer()->Now() / 1000000.0;
+}
+
+void PrintResult(const char* szName, double dValue, const char* szUnit)
+{
+    printf("  %-36s %12.3f %s\n", szName, dValue, szUnit);
+}
+
+void PrintSection(const char* szName)
+{
+    printf("\n%s\n", szName);
+}
+
+unsigned int XorShift(unsigned int& x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+
+// ============================================================================
+// >> CPU FEATURES
+// ============================================================================
+void PrintCpuFeatures()
+{
+    PrintSection("System");
+    printf("  %-36s %d bit\n", "Build", (int) sizeof(void *) * 8);
+    printf("  %-36s %d\n", "Processors", GetProcessorCount());
+
+#ifdef HAVE_CPUID
+    unsigned int eax, ebx, ecx, edx;
+    char szBrand[49] = {0};
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) && eax >= 0x80000004)
+    {
+        for (unsigned int i=0; i < 3; i++)
+            __get_cpuid(0x80000002 + i, (unsigned int *) &szBrand[i * 16], (unsigned int *) &szBrand[i * 16 + 4],
+                (unsigned int *) &szBrand[i * 16 + 8], (unsigned int *) &szBrand[i * 16 + 12]);
+    }
+    printf("  %-36s %s\n", "CPU", szBrand[0] ? szBrand : "unknown");
+
+    std::string szFeatures;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        if (edx & (1 << 26)) szFeatures += " sse2";
+        if (ecx & (1 << 0))  szFeatures += " sse3";
+        if (ecx & (1 << 9))  szFeatures += " ssse3";
+        if (ecx & (1 << 19)) szFeatures += " sse4.1";
+        if (ecx & (1 << 20)) szFeatures += " sse4.2";
+        if (ecx & (1 << 23)) szFeatures += " popcnt";
+        if (ecx & (1 << 28)) szFeatures += " avx";
+    }
+
+    if (__get_cpuid_max(0, NULL) >= 7)
+    {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if (ebx & (1 << 3))  szFeatures += " bmi1";
+        if (ebx & (1 << 5))  szFeatures += " avx2";
+        if (ebx & (1 << 8))  szFeatures += " bmi2";
+        if (ebx & (1 << 16)) szFeatures += " avx512f";
+        if (ebx & (1 << 30)) szFeatures += " avx512bw";
+    }
+    printf("  %-36s%s\n", "Features", szFeatures.c_str());
+#else
+    printf("  %-36s %s\n", "Features", "unknown");
+#endif
+}
+
+
+// ============================================================================
+// >> SCANNER
+// ============================================================================
+struct PatternShape_t
+{
+    const char*   m_szName;
+    int           m_iLength;
+    unsigned char m_Bytes[32];
+    bool          m_bPlanted;
+};
+
+static const PatternShape_t s_Shapes[] = {
+    {"exact_8", 8, {0x55, 0x8B, 0xEC, 0x83, 0xE4, 0xF0, 0x81, 0xEC}, true},
+    {"exact_32", 32, {0x55, 0x89, 0xE5, 0x57, 0x56, 0x53, 0x83, 0xEC, 0x3C, 0x8B, 0x45, 0x08, 0x8B, 0x5D, 0x0C, 0x89,
+        0x45, 0xD4, 0x65, 0xA1, 0x14, 0x00, 0x00, 0x00, 0x89, 0x45, 0xE4, 0x31, 0xC0, 0x8B, 0x03, 0x85}, true},
+    {"frequent_anchor", 12, {0x00, 0x00, 0x8B, 0x48, 0x00, 0xFF, 0x89, 0x00, 0x00, 0xE8, 0x11, 0x22}, true},
+    {"wildcard_head", 12, {0x2A, 0x2A, 0x2A, 0x2A, 0x8B, 0x0D, 0x9C, 0x3F, 0x51, 0x66, 0x77, 0x88}, true},
+    {"sparse_wildcards", 16, {0xA1, 0x2A, 0xB2, 0x2A, 0xC3, 0x2A, 0xD4, 0x2A, 0xE5, 0x2A, 0xF6, 0x2A, 0x17, 0x2A, 0x28, 0x39}, true},
+    {"missing", 16, {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10}, false},
+};
+
+#define SHAPE_COUNT (int) (sizeof(s_Shapes) / sizeof(s_Shapes[0]))
+
+/*
+    The scan loop that has been used before FindPattern(). It's used as a
+    reference for the results and the speed of FindPattern().
+*/
+unsigned char* NaiveFindPattern(unsigned char* pBase, unsigned long ulSize, const unsigned char* pPattern, int iLength)
+{
+    unsigned char* end = pBase + ulSize - iLength;
+    for (unsigned char* base = pBase; base <= end; base++)
+    {
+        int i = 0;
+        for (; i < iLength; i++)
+        {
+            if (pPattern[i] != SIGNATURE_WILDCARD && pPattern[i] != base[i])
+                break;
+        }
+
+        if (i == iLength)
+            return base;
+    }
+    return NULL;
+}
+
+/*
+    Fills the buffer with bytes that have a distribution similar to machine
+    code: a few bytes like 0x00, 0xFF and 0x8B are much more frequent than
+    others. Planted patterns are placed at the end of the buffer, so they
+    are found after a (nearly) full scan.
+*/
+void CreateScanBuffer(std::vector<unsigned char>& buffer, std::vector<unsigned long>& ulOffsets)
+{
+    static const unsigned char s_Frequent[] = {0x00, 0x00, 0x00, 0xFF, 0x8B, 0x48, 0x89, 0xE8, 0x0F, 0xCC};
+
+    unsigned int x = 0x12345678;
+    for (size_t i=0; i < buffer.size(); i++)
+    {
+        unsigned int r = XorShift(x);
+        if ((r & 0xFF) < 96)
+            buffer[i] = s_Frequent[(r >> 8) % sizeof(s_Frequent)];
+        else
+            buffer[i] = (unsigned char) (r >> 16);
+    }
+
+    ulOffsets.assign(SHAPE_COUNT, 0);
+    unsigned long ulOffset = buffer.size() - 64;
+    for (int i=0; i < SHAPE_COUNT; i++)
+    {
+        const PatternShape_t& shape = s_Shapes[i];
+        if (!shape.m_bPlanted)
+            continue;
+
+        // Planted patterns must not overlap and wildcards need a value
+        ulOffset -= 64;
+        for (int j=0; j < shape.m_iLength; j++)
+            buffer[ulOffset + j] = shape.m_Bytes[j] == SIGNATURE_WILDCARD ? 0x5A : shape.m_Bytes[j];
+
+        ulOffsets[i] = ulOffset;
+    }
+}
+
+typedef unsigned char* (*FindPatternFn)(unsigned char* pBase, unsigned long ulSize, const unsigned char* pPattern, int iLength);
+
+/*
+    Calls the search function until MIN_TIME has elapsed. Returns the number
+    of scanned bytes per second and stores the result in ppResult.
+*/
+double MeasureScan(FindPatternFn pFunc, std::vector<unsigned char>& buffer, const PatternShape_t& shape, unsigned char** ppResult)
+{
+    unsigned char* pResult = NULL;
+    int iRuns = 0;
+    double dStart = Now();
+    double dElapsed;
+    do
+    {
+        pResult = pFunc(&buffer[0], buffer.size(), shape.m_Bytes, shape.m_iLength);
+        iRuns++;
+    } while ((dElapsed = Now() - dStart) < MIN_TIME);
+
+    *ppResult = pResult;
+    double dScanned = pResult ? (double) (pResult - &buffer[0] + shape.m_iLength) : (double) buffer.size();
+    return dScanned * iRuns / dElapsed;
+}
+
+bool BenchScanner(unsigned long ulSize, int iThreads)
+{
+    char szTitle[64];
+    sprintf(szTitle, "Scanner (%lu MB buffer)", ulSize / (1024 * 1024));
+    PrintSection(szTitle);
+
+    std::vector<unsigned char> buffer(ulSize);
+    std::vector<unsigned long> ulOffsets;
+    CreateScanBuffer(buffer, ulOffsets);
+
+    bool bValid = true;
+    char szName[64];
+    for (int i=0; i < SHAPE_COUNT; i++)
+    {
+        const PatternShape_t& shape = s_Shapes[i];
+        unsigned char* pExpected = shape.m_bPlanted ? &buffer[ulOffsets[i]] : NULL;
+
+        unsigned char* pNaive;
+        unsigned char* pResult;
+        double dNaive = MeasureScan(&NaiveFindPattern, buffer, shape, &pNaive);
+        double dFast = MeasureScan(&FindPattern, buffer, shape, &pResult);
+
+        // Random data might contain an earlier match, but both functions must
+        // agree on it
+        if (pResult != pNaive || (pExpected && pResult > pExpected) || (!pExpected && pResult))
+        {
+            printf("  %-36s FAILED (expected %p, got %p)\n", shape.m_szName, pExpected, pResult);
+            bValid = false;
+            continue;
+        }
+
+        sprintf(szName, "%s (naive)", shape.m_szName);
+        PrintResult(szName, dNaive / 1e9, "GB/s");
+        sprintf(szName, "%s (FindPattern)", shape.m_szName);
+        PrintResult(szName, dFast / 1e9, "GB/s");
+    }
+
+    // Scan for all shapes at once
+    std::vector<Pattern_t> patterns;
+    for (int i=0; i < SHAPE_COUNT; i++)
+    {
+        Pattern_t pattern = {s_Shapes[i].m_Bytes, s_Shapes[i].m_iLength};
+        patterns.push_back(pattern);
+    }
+
+    int threads[2] = {1, iThreads > 0 ? iThreads : GetProcessorCount()};
+    for (int i=0; i < 2; i++)
+    {
+        std::vector<unsigned long> ulResults;
+        int iRuns = 0;
+        double dStart = Now();
+        double dElapsed;
+        do
+        {
+            FindPatterns(&buffer[0], buffer.size(), patterns, ulResults, threads[i]);
+            iRuns++;
+        } while ((dElapsed = Now() - dStart) < MIN_TIME);
+
+        for (int j=0; j < SHAPE_COUNT; j++)
+        {
+            unsigned char* pNaive = NaiveFindPattern(&buffer[0], buffer.size(), s_Shapes[j].m_Bytes, s_Shapes[j].m_iLength);
+            if (ulResults[j] != (unsigned long) pNaive)
+            {
+                printf("  FindPatterns: %s FAILED (expected %p, got %p)\n", s_Shapes[j].m_szName, pNaive, (void *) ulResults[j]);
+                bValid = false;
+            }
+        }
+
+        sprintf(szName, "FindPatterns (%d patterns, %d threads)", SHAPE_COUNT, threads[i]);
+        PrintResult(szName, (double) buffer.size() * iRuns / dElapsed / 1e9, "GB/s");
+    }
+    return bValid;
+}
+
+
+// ============================================================================
+// >> SYMBOLS
+// ============================================================================
+bool CollectSymbolCallback(const char* szName, unsigned long ulValue, unsigned long ulSize, void* pData)
+{
+    std::vector<std::string>* names = (std::vector<std::string> *) pData;
+    names->push_back(szName);
+    return true;
+}
+
+bool CountSymbolCallback(const char* szName, unsigned long ulValue, unsigned long ulSize, void* pData)
+{
+    (*(unsigned long *) pData)++;
+    return true;
+}
+
+// The same lookup that CBinaryFile::LookupSymbols() uses
+struct SymbolLookup_t
+{
+    std::map<std::string, std::vector<size_t> > m_Wanted;
+    std::vector<unsigned long>                  m_Results;
+};
+
+bool LookupSymbolCallback(const char* szName, unsigned long ulValue, unsigned long ulSize, void* pData)
+{
+    SymbolLookup_t* lookup = (SymbolLookup_t *) pData;
+    std::map<std::string, std::vector<size_t> >::iterator iter = lookup->m_Wanted.find(szName);
+    if (iter == lookup->m_Wanted.end())
+        return true;
+
+    for (size_t j = 0; j < iter->second.size(); j++)
+        lookup->m_Results[iter->second[j]] = ulValue;
+
+    lookup->m_Wanted.erase(iter);
+    return !lookup->m_Wanted.empty();
+}
+
+#ifdef __linux__
+struct LargestModule_t
+{
+    std::string   m_szPath;
+    unsigned long m_ulSize;
+};
+
+int FindLargestModule(struct dl_phdr_info* info, size_t size, void* pData)
+{
+    LargestModule_t* module = (LargestModule_t *) pData;
+    if (!info->dlpi_name || !info->dlpi_name[0])
+        return 0;
+
+    unsigned long ulSize = 0;
+    for (int i=0; i < info->dlpi_phnum; i++)
+    {
+        if (info->dlpi_phdr[i].p_type == PT_LOAD)
+            ulSize += info->dlpi_phdr[i].p_memsz;
+    }
+
+    if (ulSize > module->m_ulSize)
+    {
+        module->m_szPath = info->dlpi_name;
+        module->m_ulSize = ulSize;
+    }
+    return 0;
+}
+#endif
+
+bool BenchSymbols(const char* szPath)
+{
+    std::string szFile;
+    if (szPath)
+        szFile = szPath;
+#ifdef __linux__
+    else
+    {
+        LargestModule_t module;
+        module.m_ulSize = 0;
+        dl_iterate_phdr(&FindLargestModule, &module);
+        szFile = module.m_szPath;
+    }
+#endif
+
+    PrintSection(("Symbols (" + szFile + ")").c_str());
+    if (szFile.empty())
+    {
+        printf("  No ELF file given. Use -e <path>.\n");
+        return true;
+    }
+
+    CElfFile elf;
+    if (!elf.Open(szFile.c_str()))
+    {
+        printf("  Unable to open the ELF file.\n");
+        return false;
+    }
+
+    std::vector<std::string> names;
+    if (!elf.ForEachSymbol(&CollectSymbolCallback, &names) || names.empty())
+    {
+        printf("  The file doesn't have a symbol table.\n");
+        return true;
+    }
+
+    PrintResult("Symbols", (double) names.size(), "");
+    PrintResult("ELF class", elf.GetClass() == 2 ? 64 : 32, "bit");
+
+    // Opening includes mapping the file and parsing the program headers
+    int iRuns = 0;
+    double dStart = Now();
+    double dElapsed;
+    do
+    {
+        CElfFile temp;
+        temp.Open(szFile.c_str());
+        iRuns++;
+    } while ((dElapsed = Now() - dStart) < MIN_TIME);
+    PrintResult("Open", dElapsed / iRuns * 1e6, "us");
+
+    unsigned long ulCount = 0;
+    iRuns = 0;
+    dStart = Now();
+    do
+    {
+        elf.ForEachSymbol(&CountSymbolCallback, &ulCount);
+        iRuns++;
+    } while ((dElapsed = Now() - dStart) < MIN_TIME);
+    PrintResult("Iteration", ulCount / dElapsed / 1e6, "M symbols/s");
+
+    // Look up batches of symbols that are spread over the whole table. The
+    // last symbol is always included, so every batch needs a full pass.
+    static const size_t s_BatchSizes[] = {1, 16, 256, 4096};
+    bool bValid = true;
+    for (size_t i=0; i < sizeof(s_BatchSizes) / sizeof(s_BatchSizes[0]); i++)
+    {
+        size_t iBatch = s_BatchSizes[i] < names.size() ? s_BatchSizes[i] : names.size();
+        std::vector<size_t> indexes;
+        for (size_t j=0; j < iBatch; j++)
+            indexes.push_back(names.size() - 1 - j * (names.size() / iBatch));
+
+        iRuns = 0;
+        dStart = Now();
+        SymbolLookup_t lookup;
+        do
+        {
+            lookup.m_Wanted.clear();
+            lookup.m_Results.assign(iBatch, 0);
+            for (size_t j=0; j < iBatch; j++)
+                lookup.m_Wanted[names[indexes[j]]].push_back(j);
+
+            elf.ForEachSymbol(&LookupSymbolCallback, &lookup);
+            iRuns++;
+        } while ((dElapsed = Now() - dStart) < MIN_TIME);
+
+        if (!lookup.m_Wanted.empty())
+        {
+            printf("  Lookup: %d symbol(s) not found\n", (int) lookup.m_Wanted.size());
+            bValid = false;
+        }
+
+        char szName[64];
+        sprintf(szName, "Lookup (batches of %d)", (int) iBatch);
+        PrintResult(szName, iBatch * iRuns / dElapsed, "lookups/s");
+    }
+    return bValid;
+}
+
+
+// ============================================================================
+// >> DECODER
+// ============================================================================
+#ifdef __linux__
+struct CodeRegion_t
+{
+    unsigned char* m_pStart;
+    unsigned long  m_ulSize;
+};
+
+int FindCodeRegion(struct dl_phdr_info* info, size_t size, void* pData)
+{
+    // Use the largest executable segment of all loaded modules
+    CodeRegion_t* region = (CodeRegion_t *) pData;
+    for (int i=0; i < info->dlpi_phnum; i++)
+    {
+        const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+        if (phdr.p_type == PT_LOAD && (phdr.p_flags & PF_X) && phdr.p_memsz > region->m_ulSize)
+        {
+            region->m_pStart = (unsigned char *) (info->dlpi_addr + phdr.p_vaddr);
+            region->m_ulSize = phdr.p_filesz;
+        }
+    }
+    return 0;
+}
+#endif
+
+bool GetCodeRegion(CodeRegion_t& region)
+{
+    region.m_pStart = NULL;
+    region.m_ulSize = 0;
+#ifdef _WIN32
+    IMAGE_DOS_HEADER* dos = (IMAGE_DOS_HEADER *) GetModuleHandle(NULL);
+    IMAGE_NT_HEADERS* nt  = (IMAGE_NT_HEADERS *) ((BYTE *) dos + dos->e_lfanew);
+    region.m_pStart = (unsigned char *) dos + nt->OptionalHeader.BaseOfCode;
+    region.m_ulSize = nt->OptionalHeader.SizeOfCode;
+#else
+    dl_iterate_phdr(&FindCodeRegion, &region);
+#endif
+    return region.m_pStart != NULL;
+}
+
+// Returns the length of the instruction at pCode or 0 if it's unknown
+inline int DecodeInstruction(unsigned char* pCode)
+{
+#ifdef __x86_64__
+    int iRelOffset, iRelSize, iIsRip;
+    return insn_length_x64(pCode, &iRelOffset, &iRelSize, &iIsRip);
+#else
+    return copy_bytes(pCode, NULL, 1);
+#endif
+}
+
+// Returns the number of relocated bytes or -1 if the code can't be relocated
+inline int RelocateCode(unsigned char* pCode, unsigned char* pDest)
+{
+#ifdef __x86_64__
+    int iDestLen;
+    return copy_bytes_x64(pCode, pDest, 5, &iDestLen);
+#else
+    return copy_bytes(pCode, pDest, 5);
+#endif
+}
+
+bool BenchDecoder()
+{
+    CodeRegion_t region;
+    if (!GetCodeRegion(region))
+    {
+        PrintSection("Decoder");
+        printf("  Unable to find a code region.\n");
+        return false;
+    }
+
+    char szTitle[64];
+    sprintf(szTitle, "Decoder (%lu KB of code)", region.m_ulSize / 1024);
+    PrintSection(szTitle);
+
+    // Collect the instruction starts during the first pass. Unknown bytes
+    // (e.g. padding or data in the code segment) are skipped.
+    std::vector<unsigned char*> starts;
+    unsigned long ulUnknown = 0;
+    unsigned char* pEnd = region.m_pStart + region.m_ulSize - 16;
+    for (unsigned char* pPos = region.m_pStart; pPos < pEnd; )
+    {
+        int iLength = DecodeInstruction(pPos);
+        if (iLength <= 0)
+        {
+            ulUnknown++;
+            pPos++;
+            continue;
+        }
+
+        starts.push_back(pPos);
+        pPos += iLength;
+    }
+
+    PrintResult("Instructions", (double) starts.size(), "");
+    PrintResult("Unknown bytes", (double) ulUnknown, "");
+
+    int iRuns = 0;
+    double dStart = Now();
+    double dElapsed;
+    volatile unsigned long ulBytes = 0;
+    do
+    {
+        for (size_t i=0; i < starts.size(); i++)
+            ulBytes += DecodeInstruction(starts[i]);
+
+        iRuns++;
+    } while ((dElapsed = Now() - dStart) < MIN_TIME);
+
+    PrintResult("Length decoding", starts.size() * (double) iRuns / dElapsed / 1e6, "M instructions/s");
+    PrintResult("Length decoding", ulBytes / dElapsed / 1e6, "MB/s");
+
+    // Relocate the first bytes of every instruction like a hook would do. On
+    // x64 the destination has to be within +-2 GB of the code.
+    unsigned char* dest = (unsigned char *) AllocateNear(region.m_pStart, 4096);
+    if (!dest)
+    {
+        printf("  Unable to allocate memory near the code.\n");
+        return false;
+    }
+
+    unsigned long ulRelocated = 0;
+    unsigned long ulFailed = 0;
+    iRuns = 0;
+    dStart = Now();
+    do
+    {
+        for (size_t i=0; i < starts.size(); i++)
+        {
+            if (RelocateCode(starts[i], dest) > 0)
+                ulRelocated++;
+            else
+                ulFailed++;
+        }
+        iRuns++;
+    } while ((dElapsed = Now() - dStart) < MIN_TIME);
+
+    PrintResult("Relocation", (ulRelocated + ulFailed) / dElapsed / 1e6, "M relocations/s");
+    PrintResult("Relocation failures", ulFailed * 100.0 / (ulRelocated + ulFailed), "%");
+
+    FreeNear(dest, 4096);
+    return true;
+}
+
+
+// ============================================================================
+// >> BRIDGE GENERATION
+// ============================================================================
+volatile int g_iSink = 0;
+
+#define DEFINE_HOOK_TARGET(index) \
+    BENCH_NOINLINE int HookTarget##index(int a, int b) \
+    { \
+        g_iSink = a + index; \
+        g_iSink += b; \
+        return a * 3 + b + index; \
+    }
+
+DEFINE_HOOK_TARGET(0)
+DEFINE_HOOK_TARGET(1)
+DEFINE_HOOK_TARGET(2)
+DEFINE_HOOK_TARGET(3)
+
+bool BenchBridges()
+{
+    PrintSection("Bridge generation");
+
+    typedef int (*HookTarget)(int, int);
+    HookTarget targets[HOOK_TARGETS] = {&HookTarget0, &HookTarget1, &HookTarget2, &HookTarget3};
+
+    CHookManager* pManager = GetHookManager();
+    char szParams[] = "ii)i";
+    int iRuns = 0;
+    double dStart = Now();
+    double dElapsed;
+    do
+    {
+        for (int i=0; i < HOOK_TARGETS; i++)
+        {
+            if (!pManager->HookFunction((void *) targets[i], CONV_CDECL, szParams))
+            {
+                printf("  Unable to hook a function.\n");
+                return false;
+            }
+        }
+
+        for (int i=0; i < HOOK_TARGETS; i++)
+            pManager->UnhookFunction((void *) targets[i]);
+
+        iRuns++;
+    } while ((dElapsed = Now() - dStart) < MIN_TIME);
+
+    PrintResult("Hook + unhook", dElapsed / (iRuns * HOOK_TARGETS) * 1e6, "us");
+
+    // Make sure the original functions still work
+    for (int i=0; i < HOOK_TARGETS; i++)
+    {
+        if (targets[i](1, 2) != 5 + i)
+        {
+            printf("  Function %d is broken after unhooking.\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// ============================================================================
+// >> MAIN
+// ============================================================================
+int main(int argc, char* argv[])
+{
+    unsigned long ulSize = 64;
+    int iThreads = 0;
+    const char* szElfPath = NULL;
+    for (int i=1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            ulSize = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            iThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+            szElfPath = argv[++i];
+        else
+        {
+            printf("Usage: %s [-s <scan size in MB>] [-t <threads>] [-e <ELF file>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    PrintCpuFeatures();
+
+    bool bValid = BenchScanner(ulSize * 1024 * 1024, iThreads);
+    bValid &= BenchSymbols(szElfPath);
+    bValid &= BenchDecoder();
+    bValid &= BenchBridges();
+
+    printf("\n%s\n", bValid ? "All results are valid." : "Some results are INVALID.");
+    return bValid ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+'''
+Builds the native benchmarks (bench_native.cpp) with the same compiler,
+include directories and flags as the extension. Python is only used to run
+the build; the resulting executable doesn't depend on it.
+
+    python benchmarks/native/build.py
+    benchmarks/native/bench_native -s 64
+'''
+
+# =============================================================================
+# >> IMPORTS
+# =============================================================================
+# Python
+import os
+import time
+
+from distutils import ccompiler
+from distutils import sysconfig
+
+
+# =============================================================================
+# >> CONSTANTS
+# =============================================================================
+ROOT_DIR   = os.path.dirname(os.path.dirname(os.path.dirname(
+    os.path.abspath(__file__))))
+
+BUILD_DIR  = 'build/bench_native'
+OUTPUT     = 'benchmarks/native/bench_native'
+
+# All sources have to be independent of Python
+SOURCES = [
+    'benchmarks/native/bench_native.cpp',
+
+    # binutils
+    'src/binutils_search.cpp',
+    'src/binutils_thread.cpp',
+    'src/binutils_trace.cpp',
+    'src/binutils_elf.cpp',
+
+    # DynamicHooks
+    'src/thirdparty/DynamicHooks/DynamicHooks.cpp',
+    'src/thirdparty/DynamicHooks/utilities.cpp',
+    'src/thirdparty/DynamicHooks/asm.cpp',
+    'src/thirdparty/DynamicHooks/asm_x64.cpp',
+]
+
+INCLUDE_DIRS = [
+    'src',
+    'src/thirdparty/AsmJit/include',
+    'src/thirdparty/DynamicHooks',
+]
+
+LIBRARY_DIRS = [
+    'src/thirdparty/AsmJit/lib',
+]
+
+if os.name == 'nt':
+    LIBRARIES = [
+        'libAsmJit',
+    ]
+
+    LINKER_FLAGS = [
+        '-static-libgcc',
+        '-static-libstdc++',
+    ]
+else:
+    LIBRARIES = [
+        'AsmJit',
+        'pthread',
+    ]
+
+    LINKER_FLAGS = [
+    ]
+
+COMPILER_FLAGS = [
+    '-O2',
+
+    # Same warnings as the extension
+    '-Wno-attributes',
+    '-Wno-parentheses',
+    '-Wno-write-strings',
+    '-Wno-sign-compare',
+]
+
+
+# =============================================================================
+# >> MAIN
+# =============================================================================
+def main():
+    os.chdir(ROOT_DIR)
+
+    compiler = ccompiler.new_compiler(
+        compiler='mingw32' if os.name == 'nt' else None)
+
+    sysconfig.customize_compiler(compiler)
+
+    print('Compiling the native benchmarks...')
+    objects = compiler.compile(SOURCES, output_dir=BUILD_DIR,
+        include_dirs=INCLUDE_DIRS, extra_postargs=COMPILER_FLAGS)
+
+    print('Linking %s...'% OUTPUT)
+    compiler.link_executable(objects, OUTPUT, libraries=LIBRARIES,
+        library_dirs=LIBRARY_DIRS, extra_postargs=LINKER_FLAGS,
+        target_lang='c++')
+
+now = time.time()
+main()
+print('Time elapsed: %.02f seconds.'% (time.time() - now))
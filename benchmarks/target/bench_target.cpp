@@ -0,0 +1,419 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+/*
+    Synthetic shared library for the benchmark suite. It provides functions of
+    all calling conventions, a class with a virtual table and a large blob of
+    pseudo random data that the benchmarks plant signatures into.
+
+    Everything is exported with C linkage, so the symbols have the same names
+    on all platforms.
+*/
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <time.h>
+#endif
+
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+#ifdef _WIN32
+    #define BENCH_EXPORT extern "C" __declspec(dllexport)
+#else
+    #define BENCH_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+#if defined(__i386__) || defined(_M_IX86)
+    #define BENCH_STDCALL __attribute__((stdcall))
+#else
+    #define BENCH_STDCALL
+#endif
+
+#define BENCH_NOINLINE __attribute__((noinline))
+
+// The blob lives in .bss, so it's part of the loaded image, but doesn't
+// bloat the file
+#define BENCH_BLOB_SIZE (16 * 1024 * 1024)
+
+// Field indexes for bench_entity_offset()
+#define FIELD_HEALTH 0
+#define FIELD_SPEED  1
+#define FIELD_NAME   2
+#define FIELD_OWNER  3
+
+// Number of calls per thread before bench_run_threads() starts measuring
+#define BENCH_WARMUP_CALLS 1000
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+class CBenchEntity
+{
+public:
+    CBenchEntity()
+    {
+        m_iHealth = 100;
+        m_flSpeed = 1.5f;
+        strcpy(m_szName, "bench_entity");
+        m_pOwner = NULL;
+    }
+
+    // No virtual destructor, because it occupies a different number of slots
+    // depending on the compiler
+    virtual int  GetHealth() { return m_iHealth; }
+    virtual void SetHealth(int iHealth) { m_iHealth = iHealth; }
+    virtual int  Add(int a, int b) { return m_iHealth + a + b; }
+
+public:
+    int           m_iHealth;
+    float         m_flSpeed;
+    char          m_szName[32];
+    CBenchEntity* m_pOwner;
+};
+
+
+// ============================================================================
+// >> GLOBAL VARIABLES
+// ============================================================================
+CBenchEntity  g_Entity;
+CBenchEntity  g_Owner;
+unsigned char g_Blob[BENCH_BLOB_SIZE];
+
+// Prevents the compiler from optimizing away the hook target
+volatile int  g_iSink = 0;
+
+
+// ============================================================================
+// >> CALL TARGETS
+// ============================================================================
+BENCH_EXPORT int bench_noargs()
+{
+    return 1;
+}
+
+BENCH_EXPORT int bench_add_ii(int a, int b)
+{
+    return a + b;
+}
+
+BENCH_EXPORT double bench_add_dd(double a, double b)
+{
+    return a + b;
+}
+
+BENCH_EXPORT long long bench_add_ll(long long a, long long b)
+{
+    return a + b;
+}
+
+BENCH_EXPORT int bench_mixed(int a, double b, const char* c, void* d)
+{
+    return a + (int) b + (int) strlen(c) + (d != NULL);
+}
+
+BENCH_EXPORT int BENCH_STDCALL bench_stdcall_ii(int a, int b)
+{
+    return a + b;
+}
+
+BENCH_EXPORT const char* bench_string()
+{
+    return "binutils";
+}
+
+
+// ============================================================================
+// >> HOOK TARGETS
+// ============================================================================
+/*
+    Used for pre- and post-hooks. It's larger than the jump that is written to
+    hook it and doesn't contain any branches.
+*/
+BENCH_EXPORT BENCH_NOINLINE int bench_hook_target(int a, int b)
+{
+    g_iSink = a;
+    g_iSink += b;
+    return a * 3 + b;
+}
+
+/*
+    Same as bench_hook_target(). It's used by tests/checks.py, which needs a
+    function that isn't hooked by anything else.
+*/
+BENCH_EXPORT BENCH_NOINLINE int bench_record_target(int a, int b)
+{
+    g_iSink = a;
+    g_iSink += b;
+    return a * 3 + b;
+}
+
+/*
+    Recorded by tests/checks.py. Only the low bytes of the char and short
+    arguments are defined.
+*/
+BENCH_EXPORT BENCH_NOINLINE int bench_record_small_target(char c, short s, int i)
+{
+    g_iSink = c;
+    g_iSink += s;
+    return c + s + i;
+}
+
+
+// ============================================================================
+// >> CALLBACK DRIVERS
+// ============================================================================
+typedef int (*BenchCallback)(int, int);
+
+/*
+    Calls the given callback <iCount> times. This measures the cost of
+    calling from native code into Python.
+*/
+BENCH_EXPORT int bench_call_callback(BenchCallback callback, int iCount)
+{
+    int iResult = 0;
+    for (int i=0; i < iCount; i++)
+        iResult += callback(i, iResult);
+
+    return iResult;
+}
+
+
+// ============================================================================
+// >> THREAD DRIVER
+// ============================================================================
+/*
+    Native hook callback (see DynamicHooks' HookFn) that does nothing. It's
+    registered with Function.add_native_pre_hook() to measure the dispatch
+    without Python.
+*/
+BENCH_EXPORT bool bench_native_hook(int iHookType, void* pHook)
+{
+    return false;
+}
+
+struct BenchThread_t
+{
+    BenchCallback  m_pFunc;
+    int            m_iCalls;
+    unsigned int*  m_pSamples;
+
+    // Time of the first and the end of the last measured call
+    long long      m_llStart;
+    long long      m_llEnd;
+};
+
+static volatile int g_iStartedThreads = 0;
+static volatile int g_iThreadCount = 0;
+
+// Returns a monotonic timestamp in nanoseconds
+static long long GetNanoseconds()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER s_Frequency;
+    if (!s_Frequency.QuadPart)
+        QueryPerformanceFrequency(&s_Frequency);
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (long long) ((double) now.QuadPart * 1e9 / s_Frequency.QuadPart);
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+static void RunThread(BenchThread_t* pThread)
+{
+    for (int i=0; i < BENCH_WARMUP_CALLS; i++)
+        pThread->m_pFunc(i, 1);
+
+    // Wait until all threads are ready, so they really call at the same time
+    __sync_fetch_and_add(&g_iStartedThreads, 1);
+    while (g_iStartedThreads < g_iThreadCount)
+        ;
+
+    pThread->m_llStart = GetNanoseconds();
+    for (int i=0; i < pThread->m_iCalls; i++)
+    {
+        long long start = GetNanoseconds();
+        pThread->m_pFunc(i, 1);
+        long long elapsed = GetNanoseconds() - start;
+
+        pThread->m_pSamples[i] = elapsed > 0xFFFFFFFFLL ? 0xFFFFFFFF : (unsigned int) elapsed;
+    }
+    pThread->m_llEnd = GetNanoseconds();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI ThreadProc(LPVOID pParam)
+{
+    RunThread((BenchThread_t *) pParam);
+    return 0;
+}
+#else
+static void* ThreadProc(void* pParam)
+{
+    RunThread((BenchThread_t *) pParam);
+    return NULL;
+}
+#endif
+
+/*
+    Calls <func> <iCalls> times from each of <iThreads> threads at once and
+    stores the latency of every call in nanoseconds. <pSamples> must have room
+    for iThreads * iCalls values; the samples of thread n start at
+    n * iCalls.
+
+    Returns the time between the first and the last measured call in
+    nanoseconds or -1 if a thread couldn't be created. This function has to
+    be called with ctypes, because the GIL must be released while the threads
+    are running.
+*/
+BENCH_EXPORT long long bench_run_threads(BenchCallback func, int iThreads, int iCalls, unsigned int* pSamples)
+{
+    if (iThreads < 1 || iThreads > 256)
+        return -1;
+
+    BenchThread_t threads[256];
+#ifdef _WIN32
+    HANDLE handles[256];
+#else
+    pthread_t handles[256];
+#endif
+
+    g_iStartedThreads = 0;
+    g_iThreadCount = iThreads;
+
+    int iCreated = 0;
+    bool bFailed = false;
+    for (; iCreated < iThreads; iCreated++)
+    {
+        threads[iCreated].m_pFunc = func;
+        threads[iCreated].m_iCalls = iCalls;
+        threads[iCreated].m_pSamples = pSamples + iCreated * iCalls;
+
+#ifdef _WIN32
+        handles[iCreated] = CreateThread(NULL, 0, ThreadProc, &threads[iCreated], 0, NULL);
+        bFailed = handles[iCreated] == NULL;
+#else
+        bFailed = pthread_create(&handles[iCreated], NULL, ThreadProc, &threads[iCreated]) != 0;
+#endif
+        if (bFailed)
+        {
+            // Release the threads that are already waiting
+            g_iThreadCount = iCreated;
+            break;
+        }
+    }
+
+    for (int i=0; i < iCreated; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(handles[i], INFINITE);
+        CloseHandle(handles[i]);
+#else
+        pthread_join(handles[i], NULL);
+#endif
+    }
+
+    if (bFailed)
+        return -1;
+
+    long long start = threads[0].m_llStart;
+    long long end = threads[0].m_llEnd;
+    for (int i=1; i < iThreads; i++)
+    {
+        if (threads[i].m_llStart < start)
+            start = threads[i].m_llStart;
+
+        if (threads[i].m_llEnd > end)
+            end = threads[i].m_llEnd;
+    }
+    return end - start;
+}
+
+
+// ============================================================================
+// >> ENTITIES
+// ============================================================================
+BENCH_EXPORT CBenchEntity* bench_get_entity()
+{
+    g_Entity.m_pOwner = &g_Owner;
+    return &g_Entity;
+}
+
+BENCH_EXPORT int bench_entity_size()
+{
+    return sizeof(CBenchEntity);
+}
+
+// Returns the offset of a field, so the benchmarks don't need to guess the
+// layout of the class
+BENCH_EXPORT int bench_entity_offset(int iField)
+{
+    const char* base = (const char *) &g_Entity;
+    switch (iField)
+    {
+        case FIELD_HEALTH: return (const char *) &g_Entity.m_iHealth - base;
+        case FIELD_SPEED:  return (const char *) &g_Entity.m_flSpeed - base;
+        case FIELD_NAME:   return (const char *) &g_Entity.m_szName - base;
+        case FIELD_OWNER:  return (const char *) &g_Entity.m_pOwner - base;
+    }
+    return -1;
+}
+
+
+// ============================================================================
+// >> BLOB
+// ============================================================================
+BENCH_EXPORT unsigned char* bench_blob_address()
+{
+    return g_Blob;
+}
+
+BENCH_EXPORT int bench_blob_size()
+{
+    return BENCH_BLOB_SIZE;
+}
+
+// Fills the blob with pseudo random bytes (xorshift32)
+BENCH_EXPORT void bench_fill_blob(unsigned int uiSeed)
+{
+    unsigned int x = uiSeed ? uiSeed : 1;
+    for (int i=0; i < BENCH_BLOB_SIZE; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+
+        g_Blob[i] = (unsigned char) x;
+    }
+}
@@ -21,11 +21,28 @@ SOURCES = [
     'src/binutils_hooks.cpp',
     'src/binutils_scanner.cpp',
     'src/binutils_callback.cpp',
+    'src/binutils_search.cpp',
+    'src/binutils_thread.cpp',
+    'src/binutils_trace.cpp',
+    'src/binutils_memory.cpp',
+    'src/binutils_remote.cpp',
+    'src/binutils_core.cpp',
+    'src/binutils_elf.cpp',
+    'src/binutils_memo.cpp',
+    'src/binutils_timeline.cpp',
+    'src/binutils_layout.cpp',
+    'src/binutils_record.cpp',
+    'src/binutils_watch.cpp',
+    'src/binutils_hash.cpp',
+    'src/binutils_integrity.cpp',
+    'src/binutils_executor.cpp',
+    'src/binutils_query.cpp',
 
     # DynamicHooks
     'src/thirdparty/DynamicHooks/DynamicHooks.cpp',
     'src/thirdparty/DynamicHooks/utilities.cpp',
     'src/thirdparty/DynamicHooks/asm.cpp',
+    'src/thirdparty/DynamicHooks/asm_x64.cpp',
 ]
 
 
@@ -71,6 +88,7 @@ else:
         'dyncallback_s',
         'dynload_s',
         'AsmJit',
+        'pthread',
     ]
 
 
@@ -89,6 +107,10 @@ COMPILER_FLAGS = [
     
     # Disable sign compare warnings
     '-Wno-sign-compare',
+
+    # Queries compare columns with SSE2. This is the default on x86-64, but
+    # not on i686.
+    '-msse2',
 ]
 
 
@@ -3,10 +3,12 @@
 # =============================================================================
 # Python
 import os
-import binascii
+import atexit
 
 # binutils
+import cache
 import helpers
+import trace
 
 from _binutils import *
 
@@ -117,11 +119,36 @@ class TypeManager(dict):
     information.
     '''
 
-    def __init__(self):
+    def __init__(self, cache_file=None, eager=False, resolution_file=None):
         '''
         Initializes the manager by setting the default converter.
+
+        If <cache_file> is not None, parsed data files are stored in that file
+        and only parsed again if they have been changed.
+
+        If <eager> is False, addresses of functions are resolved when they are
+        called for the first time. Use resolve_all() to validate all of them.
+
+        If <resolution_file> is not None, addresses are taken from that file
+        if it contains the binary. Create it offline with binutils.resolve.
         '''
 
+        self.eager = eager
+        self.lazy_functions = []
+
+        self.resolutions = None
+        if resolution_file is not None:
+            self.resolutions = cache.ResolutionCache(resolution_file)
+
+        # Compiled Layout objects by type name and the information of all
+        # attributes that have been created by this manager
+        self.layouts = {}
+        self.attribute_info = {}
+
+        self.data_cache = None
+        if cache_file is not None:
+            self.data_cache = cache.DataCache(cache_file)
+
         # Default converter -- do nothing
         self.set_default_converter(lambda x: x)
 
@@ -144,6 +171,7 @@ class TypeManager(dict):
                 'tomType".'% name)
 
         self[name] = cls
+        self.layouts.pop(name, None)
         return cls
 
     def set_default_converter(self, converter):
@@ -157,6 +185,24 @@ class TypeManager(dict):
 
         self[None] = converter
 
+    def read_files(self, *files):
+        '''
+        Reads all passed data files. Uses the data cache if it's available.
+        '''
+
+        if self.data_cache is None:
+            return helpers.read_files(*files)
+
+        return self.data_cache.read_files(*files)
+
+    def save_cache(self):
+        '''
+        Writes the data cache to its file if it has been changed.
+        '''
+
+        if self.data_cache is not None:
+            self.data_cache.save()
+
     def create_converter(self, name):
         '''
         Creates a callable converter by name. That means the type is evaluated
@@ -193,8 +239,12 @@ class TypeManager(dict):
         documentation = <default: ''>
         '''
 
+        with trace.traced('create_pipe_from_file', ', '.join(
+                f for f in files if isinstance(f, basestring))):
+            raw_data = self.read_files(*files)
+
         data = helpers.parse_data(
-            helpers.read_files(*files),
+            raw_data,
             (
                 (KEY_BINARY, str, None),
                 (KEY_IDENTIFIER, str, None),
@@ -277,7 +327,9 @@ class TypeManager(dict):
         All sections (attributes, functions, virtual_functions) are optional.
         '''
 
-        raw_data = helpers.read_files(*files)
+        with trace.traced('create_type_from_file', type_name):
+            raw_data = self.read_files(*files)
+
         size     = raw_data.get(KEY_SIZE)
         cls_dict = { 'size':  size and int(size)}
 
@@ -348,13 +400,24 @@ class TypeManager(dict):
 
     def pipe_function(self, binary, identifier, parameters,
             converter_name=None, srv_check=True, convention=Convention.CDECL,
-            doc=None):
+            doc=None, eager=None):
         '''
-        Returns a new Function object.
+        Returns a new Function object. If <eager> is None, the manager's
+        default is used.
         '''
 
-        return make_function(binary, identifier, convention, parameters,
-            self.create_converter(converter_name), srv_check, doc)
+        if self.eager if eager is None else eager:
+            return make_function(binary, identifier, convention, parameters,
+                self.create_converter(converter_name), srv_check, doc,
+                self.resolutions)
+
+        func = helpers._LazyFunction(binary, identifier, convention,
+            parameters, self.create_converter(converter_name), srv_check,
+            self.resolutions)
+
+        func.__doc__ = doc
+        self.lazy_functions.append(func)
+        return func
 
     def attribute(self, str_type, offset=0, length=-1, is_array=False,
             aligned=False, flags=AttrFlags.READ_WRITE, doc=None):
@@ -445,35 +508,230 @@ class TypeManager(dict):
 
         # Return the proper property object depending on the flags
         if flags & AttrFlags.READ_WRITE:
-            return property(fget, fset, doc=doc)
+            attr = property(fget, fset, doc=doc)
         elif flags & AttrFlags.READ:
-            return property(fget, doc=doc)
+            attr = property(fget, doc=doc)
         elif flags & AttrFlags.WRITE:
-            return property(fset=fset, doc=doc)
+            attr = property(fset=fset, doc=doc)
+        else:
+            # Raise an error as we cannot read or write the attribute
+            raise AttributeError('Attribute is not readable or writeable.')
+
+        # Required to compile the layout of the type
+        self.attribute_info[attr] = (str_type, converter_name, offset, length,
+            is_array, aligned)
+
+        return attr
+
+    def get_layout(self, name):
+        '''
+        Returns a Layout object of the given type that contains all attributes
+        of the type and its base classes. Pass it to serialize(). Layouts are
+        compiled once and then cached.
+        '''
+
+        layout = self.layouts.get(name)
+        if layout is not None:
+            return layout
+
+        cls = self[name]
+
+        # Subclasses override the attributes of their base classes
+        attributes = {}
+        for base in reversed(cls.__mro__):
+            for attr_name, value in base.__dict__.iteritems():
+                if isinstance(value, property) and value in self.attribute_info:
+                    attributes[attr_name] = self.attribute_info[value]
+
+        # Cache the layout before its fields are added, so types can point to
+        # themselves
+        layout = self.layouts[name] = Layout(cls.size or 0)
+        for attr_name, info in sorted(attributes.iteritems(),
+                key=lambda item: item[1][2]):
+            self._add_layout_field(layout, attr_name, *info)
+
+        return layout
+
+    def _add_layout_field(self, layout, name, str_type, converter_name,
+            offset, length, is_array, aligned):
+        '''
+        Adds an attribute to the given layout. Attributes with an unknown size
+        are skipped and pointers to them are not followed.
+        '''
+
+        if str_type == 'string_array':
+            if length > 0:
+                layout.add_field(name, offset, 'char', length)
 
-        # Raise an error as we cannot read or write the attribute
-        raise AttributeError('Attribute is not readable or writeable.')
+            return
+
+        # Get the layout of the elements
+        if converter_name is None:
+            element = None
+        else:
+            cls = self.get(converter_name)
+            if not isinstance(cls, type) or not issubclass(cls, CustomType):
+                if not aligned:
+                    layout.add_pointer(name, offset)
+
+                return
+
+            element = self.get_layout(converter_name)
+
+        if not is_array:
+            if element is None:
+                layout.add_field(name, offset, str_type)
+            elif aligned:
+                layout.add_layout(name, offset, element)
+            else:
+                layout.add_pointer(name, offset, element)
+
+            return
+
+        if length <= 0:
+            if not aligned:
+                layout.add_pointer(name, offset)
+
+            return
+
+        # Unaligned arrays are pointers to the array
+        array = layout if aligned else Layout()
+        array_offset = offset if aligned else 0
+        if element is None:
+            array.add_field(name, array_offset, str_type, length)
+        else:
+            array.add_layout(name, array_offset, element, length)
+
+        if not aligned:
+            layout.add_pointer(name, offset, array)
 
     def function(self, binary, identifier, parameters, converter_name=None,
-            srv_check=True, convention=Convention.THISCALL, doc=None):
+            srv_check=True, convention=Convention.THISCALL, doc=None,
+            eager=None):
         '''
-        Adds a function to a class.
+        Adds a function to a class. If <eager> is None, the manager's default
+        is used.
         '''
 
-        func = helpers._EvalFunction(
-            make_function(
-                binary,
-                identifier,
-                convention,
-                parameters,
-                self.create_converter(converter_name),
-                srv_check
+        if self.eager if eager is None else eager:
+            func = helpers._EvalFunction(
+                make_function(
+                    binary,
+                    identifier,
+                    convention,
+                    parameters,
+                    self.create_converter(converter_name),
+                    srv_check,
+                    resolutions=self.resolutions
+                )
             )
-        )
+        else:
+            func = helpers._LazyMemberFunction(binary, identifier, convention,
+                parameters, self.create_converter(converter_name), srv_check,
+                self.resolutions)
+
+            self.lazy_functions.append(func)
 
         func.__doc__ = doc
         return func
 
+    def resolve_all(self, parallel=False, threads=0):
+        '''
+        Resolves the addresses of all lazy functions that have been created by
+        this manager. Raises a ValueError that contains all failures if at
+        least one function couldn't be resolved. A failing function doesn't
+        stop the others from being resolved.
+
+        If <parallel> is True, the functions are grouped by their binary. Then
+        all symbols of a binary are looked up in a single pass and all
+        signatures are searched with a multi-threaded scan. <threads> is the
+        number of threads per scan (0 = number of processors).
+        '''
+
+        pending = [func for func in self.lazy_functions if not func.is_resolved]
+        if parallel:
+            errors = self.__resolve_parallel(pending, threads)
+        else:
+            errors = []
+            for func in pending:
+                try:
+                    func.resolve()
+                except Exception, e:
+                    errors.append(format_resolve_error(func, func.binary, e))
+
+        if errors:
+            raise ValueError('Could not resolve %d function(s):\n%s'% (
+                len(errors), '\n'.join(errors)))
+
+    def __resolve_parallel(self, functions, threads):
+        '''
+        Resolves the given lazy functions grouped by their binary. Returns a
+        list of error messages.
+        '''
+
+        groups = {}
+        for func in functions:
+            groups.setdefault((func.binary, func.srv_check), []).append(func)
+
+        errors = []
+        for (path, srv_check), funcs in groups.iteritems():
+            try:
+                binary = find_binary(path, srv_check)
+            except Exception, e:
+                errors.extend(format_resolve_error(func, path, e)
+                    for func in funcs)
+                continue
+
+            signatures = []
+            symbols    = []
+            for func in funcs:
+                # A broken entry must not abort the whole batch
+                try:
+                    # Use the offline resolutions if the binary hasn't changed
+                    if self.resolutions is not None:
+                        func_ptr = self.resolutions.get(binary, func.identifier)
+                        if func_ptr is not None:
+                            func.resolve(func_ptr)
+                            continue
+
+                    if helpers.is_signature(func.identifier):
+                        signatures.append((func,
+                            helpers.parse_signature(func.identifier)))
+                    else:
+                        symbols.append((func, func.identifier))
+                except Exception, e:
+                    errors.append(format_resolve_error(func, path, e))
+
+            searches = (
+                ('signature', signatures, lambda identifiers:
+                    binary.find_signatures(identifiers, threads)),
+                ('symbol', symbols, binary.find_symbols)
+            )
+
+            for kind, entries, search in searches:
+                if not entries:
+                    continue
+
+                funcs = [entry[0] for entry in entries]
+                try:
+                    pointers = search([entry[1] for entry in entries])
+                except Exception, e:
+                    errors.extend(format_resolve_error(func, path, e)
+                        for func in funcs)
+                    continue
+
+                for func, func_ptr in zip(funcs, pointers):
+                    try:
+                        if func_ptr:
+                            func.resolve(func_ptr)
+                        else:
+                            errors.append('%s (%s): Could not find %s.'% (
+                                func.identifier, path, kind))
+                    except Exception, e:
+                        errors.append(format_resolve_error(func, path, e))
+
+        return errors
+
     def virtual_function(self, index, parameters,
             converter_name=None, convention=Convention.THISCALL, doc=None):
         '''
@@ -494,34 +752,31 @@ type_manager = TypeManager()
 # >> FUNCTIONS
 # =============================================================================
 def make_function(binary, identifier, convention, parameters,
-        converter=lambda x: x, srv_check=True, doc=None):
+        converter=lambda x: x, srv_check=True, doc=None, resolutions=None):
     '''
-    Creates a new function. Signatures have to be passed with spaces.
+    Creates a new function. Signatures have to be passed with spaces. If
+    <resolutions> is a ResolutionCache, its addresses are used if possible.
     '''
 
-    binary = find_binary(binary, srv_check)
-
-    # Is it a signature?
-    if os.name == 'nt' and ' ' in identifier:
-        sig = binascii.unhexlify(identifier.replace(' ', ''))
-        func_ptr = binary.find_signature(sig)
-
-        # Raise an error here. Maybe the user wanted to use a symbol, but
-        # accidentally added a space
-        if not func_ptr:
-            raise ValueError('Could not find signature "%s".'% repr(sig))
-    else:
-        func_ptr = binary[identifier]
-
-        # Same here. Maybe the user wanted to use a signature, but forgot
-        # to add spaces
-        if not func_ptr:
-            raise ValueError('Could not find symbol "%s".'% identifier)
-
+    func_ptr = helpers.find_address(binary, identifier, srv_check,
+        resolutions)
     func = func_ptr.make_function(convention, parameters, converter)
     func.__doc__ = doc
     return func
 
+def format_resolve_error(func, binary, error):
+    '''
+    Returns the message of an error that occurred while resolving a lazy
+    function. Unexpected errors contain their type, so they can be told
+    apart from functions that simply couldn't be found.
+    '''
+
+    if isinstance(error, (ValueError, IOError)):
+        return '%s (%s): %s'% (func.identifier, binary, error)
+
+    return '%s (%s): %s: %s'% (func.identifier, binary,
+        type(error).__name__, error)
+
 def create_string(text, size=None):
     '''
     Creates a new string. If <size> is None len(<text>) + 1 bytes are allocated.
@@ -555,4 +810,11 @@ def callback(convention, params):
     def wait_for_py_func(py_func):
         return Callback(py_func, convention, params)
 
-    return wait_for_py_func
\ No newline at end of file
+    return wait_for_py_func
+
+# =============================================================================
+# >> INITIALIZATION
+# =============================================================================
+# Release the Python callbacks while the interpreter is still alive. Hooked
+# functions that are called by other threads after that don't call Python.
+atexit.register(clear_python_hooks)
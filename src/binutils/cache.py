@@ -0,0 +1,331 @@
+# =============================================================================
+# >> IMPORTS
+# =============================================================================
+# Python
+import os
+import atexit
+import hashlib
+import marshal
+
+from configobj import ConfigObj
+
+# binutils
+from _binutils import Pointer
+from _binutils import get_build_id
+from _binutils import is_trace_enabled
+from _binutils import get_trace_time
+from _binutils import add_trace_event
+
+
+# =============================================================================
+# >> CONSTANTS
+# =============================================================================
+# Increase this number if the structure of the cache file changes. Old cache
+# files will be discarded automatically.
+CACHE_VERSION = 1
+
+# Same for resolution cache files
+RESOLUTION_VERSION = 1
+
+
+# =============================================================================
+# >> CLASSES
+# =============================================================================
+class DataCache(object):
+    '''
+    Stores the parsed content of data files in a marshal file. A file is only
+    parsed again if its modification time or size has changed and its hash
+    doesn't match the cached hash anymore.
+    '''
+
+    def __init__(self, path):
+        '''
+        Loads the cache file at <path> (if it exists) and registers a function
+        that saves the cache when the interpreter exits.
+        '''
+
+        self.path    = path
+        self.entries = {}
+        self.hits    = 0
+        self.misses  = 0
+        self.dirty   = False
+
+        self.load()
+        atexit.register(self.save)
+
+    def load(self):
+        '''
+        Loads the cache file. A missing, outdated or broken cache file results
+        in an empty cache.
+        '''
+
+        self.entries = {}
+        try:
+            with open(self.path, 'rb') as f:
+                version, entries = marshal.load(f)
+        except (IOError, OSError, EOFError, ValueError, TypeError):
+            return
+
+        if version == CACHE_VERSION:
+            self.entries = entries
+
+    def save(self):
+        '''
+        Writes the cache file if any entry has been changed since the last
+        call. The file is replaced atomically, so a crash while writing won't
+        leave a broken cache file behind.
+        '''
+
+        if not self.dirty:
+            return
+
+        temp_path = self.path + '.tmp'
+        with open(temp_path, 'wb') as f:
+            marshal.dump((CACHE_VERSION, self.entries), f)
+
+        # os.rename() doesn't replace existing files on Windows
+        if os.name == 'nt' and os.path.exists(self.path):
+            os.remove(self.path)
+
+        os.rename(temp_path, self.path)
+        self.dirty = False
+
+    def get(self, path):
+        '''
+        Returns the parsed content of the given data file as a dictionary. A
+        missing file results in an empty dictionary like ConfigObj does, but
+        isn't cached.
+        '''
+
+        path  = os.path.abspath(path)
+        start = get_trace_time() if is_trace_enabled() else None
+        try:
+            stat = os.stat(path)
+        except OSError:
+            if not os.path.exists(path):
+                return {}
+
+            raise
+
+        entry = self.entries.get(path)
+
+        # Fast path. The file hasn't been touched since it was cached
+        if entry is not None and entry[0] == stat.st_mtime and \
+                entry[1] == stat.st_size:
+            self.hits += 1
+            if start is not None:
+                add_trace_event('data_cache', path, start,
+                    get_trace_time() - start, 0, 1)
+
+            return entry[3]
+
+        with open(path, 'rb') as f:
+            content = f.read()
+
+        digest = hashlib.md5(content).hexdigest()
+
+        # The file has been touched, but its content is still the same
+        hit = entry is not None and entry[2] == digest
+        if hit:
+            data = entry[3]
+            self.hits += 1
+        else:
+            data = section_to_dict(ConfigObj(content.splitlines()))
+            self.misses += 1
+
+        if start is not None:
+            add_trace_event('data_cache', path, start,
+                get_trace_time() - start, len(content), int(hit))
+
+        self.entries[path] = (stat.st_mtime, stat.st_size, digest, data)
+        self.dirty = True
+        return data
+
+    def read_files(self, *files):
+        '''
+        Works like helpers.read_files(), but uses the cache for all given
+        paths. File objects are parsed as usual.
+        '''
+
+        data = {}
+        for f in files:
+            if isinstance(f, basestring):
+                data.update(self.get(f))
+                continue
+
+            data.update(section_to_dict(ConfigObj(f)))
+            try:
+                f.close()
+            except AttributeError:
+                pass
+
+        return data
+
+    def compile(self, *files):
+        '''
+        Parses all given files, removes entries of files that don't exist
+        anymore and saves the cache.
+        '''
+
+        for f in files:
+            self.get(f)
+
+        for path in self.entries.keys():
+            if not os.path.isfile(path):
+                del self.entries[path]
+                self.dirty = True
+
+        self.save()
+
+
+class ResolutionCache(object):
+    '''
+    Stores the addresses of identifiers (signatures and symbols) per binary,
+    so they don't have to be searched at runtime. The file is written by
+    the offline resolver (see binutils.resolve). Binaries are identified by
+    their content, so the addresses of a binary that has been updated are
+    never used.
+    '''
+
+    def __init__(self, path=None):
+        '''
+        Loads the cache file at <path> if it's not None.
+        '''
+
+        self.path     = path
+        self.binaries = {}
+        self.ids      = {}
+        self.hits     = 0
+        self.misses   = 0
+
+        if path is not None:
+            self.load()
+
+    def load(self):
+        '''
+        Loads the cache file. A missing, outdated or broken cache file results
+        in an empty cache.
+        '''
+
+        self.binaries = {}
+        try:
+            with open(self.path, 'rb') as f:
+                version, binaries = marshal.load(f)
+        except (IOError, OSError, EOFError, ValueError, TypeError):
+            return
+
+        if version == RESOLUTION_VERSION:
+            self.binaries = binaries
+
+    def save(self, path=None):
+        '''
+        Writes the cache file atomically. If <path> is None, the path that
+        has been passed to the constructor is used.
+        '''
+
+        path = self.path if path is None else path
+        temp_path = path + '.tmp'
+        with open(temp_path, 'wb') as f:
+            marshal.dump((RESOLUTION_VERSION, self.binaries), f)
+
+        # os.rename() doesn't replace existing files on Windows
+        if os.name == 'nt' and os.path.exists(path):
+            os.remove(path)
+
+        os.rename(temp_path, path)
+
+    def get_binary_id(self, path):
+        '''
+        Returns the identifier of the binary file at <path>. Results are
+        cached per path.
+        '''
+
+        binary_id = self.ids.get(path)
+        if binary_id is None:
+            binary_id = self.ids[path] = get_binary_id(path)
+
+        return binary_id
+
+    def update(self, binary_id, addresses):
+        '''
+        Adds virtual addresses of a binary: {identifier: address}
+        '''
+
+        self.binaries.setdefault(binary_id, {}).update(addresses)
+
+    def get(self, binary, identifier):
+        '''
+        Returns a Pointer to the cached address of <identifier> in the given
+        BinaryFile object or None if it hasn't been cached.
+        '''
+
+        if not self.binaries:
+            return None
+
+        start = get_trace_time() if is_trace_enabled() else None
+        addresses = self.binaries.get(self.get_binary_id(binary.path), {})
+        address = addresses.get(identifier)
+        if address is None:
+            self.misses += 1
+        else:
+            self.hits += 1
+            address = Pointer(binary.load_bias + address)
+
+        if start is not None:
+            add_trace_event('resolution_cache', identifier, start,
+                get_trace_time() - start, 0, int(address is not None))
+
+        return address
+
+
+# =============================================================================
+# >> FUNCTIONS
+# =============================================================================
+def get_binary_id(path):
+    '''
+    Returns a string that identifies the content of a binary file. That's the
+    GNU build ID if the binary has one. Otherwise the MD5 hash of the file is
+    used.
+    '''
+
+    try:
+        build_id = get_build_id(path)
+    except IOError:
+        build_id = None
+
+    if build_id is not None:
+        return 'build-id:' + build_id
+
+    digest = hashlib.md5()
+    with open(path, 'rb') as f:
+        for chunk in iter(lambda: f.read(1 << 20), ''):
+            digest.update(chunk)
+
+    return 'md5:' + digest.hexdigest()
+
+def section_to_dict(section):
+    '''
+    Converts a ConfigObj section recursively into a plain dictionary, so it
+    can be marshalled.
+    '''
+
+    result = {}
+    for key, value in section.iteritems():
+        if isinstance(value, dict):
+            value = section_to_dict(value)
+        elif isinstance(value, list):
+            value = list(value)
+
+        result[key] = value
+
+    return result
+
+def compile_data_files(cache_file, *files):
+    '''
+    Compiles the given type and pipe files into the cache file <cache_file>.
+    Pass the same path to TypeManager() to load the cache directly.
+    '''
+
+    data_cache = DataCache(cache_file)
+    data_cache.compile(*files)
+    return data_cache
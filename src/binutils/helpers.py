@@ -3,6 +3,7 @@
 # =============================================================================
 # Python
 import os
+import binascii
 
 from configobj import ConfigObj
 
@@ -33,6 +34,99 @@ class _EvalFunction(Function):
         return func
 
 
+class _LazyFunction(object):
+    '''
+    Stores all information that is required to create a Function object, but
+    doesn't resolve the address until the function is called for the first
+    time or an attribute of the Function class is accessed.
+    '''
+
+    def __init__(self, binary, identifier, convention, parameters,
+            converter, srv_check, resolutions=None):
+        self.binary      = binary
+        self.identifier  = identifier
+        self.convention  = convention
+        self.parameters  = parameters
+        self.converter   = converter
+        self.srv_check   = srv_check
+        self.resolutions = resolutions
+        self.function    = None
+        self.is_virtual  = False
+
+    def resolve(self, func_ptr=None):
+        '''
+        Resolves the address and creates the Function object. If <func_ptr> is
+        not None, it will be used instead of searching the address.
+        '''
+
+        if self.function is not None:
+            return self.function
+
+        if func_ptr is None:
+            func_ptr = find_address(self.binary, self.identifier,
+                self.srv_check, self.resolutions)
+
+        self.function = func_ptr.make_function(self.convention,
+            self.parameters, self.converter)
+
+        self.function.__doc__ = self.__doc__
+        return self.function
+
+    @property
+    def is_resolved(self):
+        '''
+        Returns True if the address has already been resolved.
+        '''
+
+        return self.function is not None
+
+    def __call__(self, *args):
+        '''
+        Resolves the function (if necessary) and calls it.
+        '''
+
+        return self.resolve()(*args)
+
+    def __get__(self, this, cls):
+        '''
+        Pipe functions don't require a this-pointer, so we always return
+        <self>.
+        '''
+
+        return self
+
+    def __getattr__(self, attr):
+        '''
+        Redirects all other attributes (e.g. address or add_pre_hook) to the
+        resolved Function object.
+        '''
+
+        if attr in dir(Function):
+            return getattr(self.resolve(), attr)
+
+        raise AttributeError('"%s" has no attribute "%s"'% (
+            self.__class__.__name__, attr))
+
+
+class _LazyMemberFunction(_LazyFunction):
+    '''
+    Emulates a bound method of a lazily resolved function.
+    '''
+
+    def __get__(self, this, cls):
+        '''
+        Returns <self> if <this> is None. Otherwise it resolves the function
+        and returns a new Thiscall object.
+        '''
+
+        if this is None:
+            return self
+
+        func = Thiscall(self.resolve(), this, False)
+        func.__doc__ = self.__doc__
+        return func
+
+
 class _EvalVirtualFunction(object):
     '''
     Emulates a bound method. We can only evaluate the function's address if a
@@ -132,6 +226,54 @@ class Thiscall(Function):
 # =============================================================================
 # >> FUNCTIONS
 # =============================================================================
+def find_address(binary, identifier, srv_check=True, resolutions=None):
+    '''
+    Searches the given binary for a signature or symbol and returns its
+    address. Signatures have to be passed with spaces. If <resolutions> is a
+    ResolutionCache, cached addresses are used instead of searching them.
+    '''
+
+    binary = find_binary(binary, srv_check)
+    if resolutions is not None:
+        func_ptr = resolutions.get(binary, identifier)
+        if func_ptr is not None:
+            return func_ptr
+
+    # Is it a signature?
+    if is_signature(identifier):
+        sig = parse_signature(identifier)
+        func_ptr = binary.find_signature(sig)
+
+        # Raise an error here. Maybe the user wanted to use a symbol, but
+        # accidentally added a space
+        if not func_ptr:
+            raise ValueError('Could not find signature "%s".'% repr(sig))
+    else:
+        func_ptr = binary[identifier]
+
+        # Same here. Maybe the user wanted to use a signature, but forgot
+        # to add spaces
+        if not func_ptr:
+            raise ValueError('Could not find symbol "%s".'% identifier)
+
+    return func_ptr
+
+def is_signature(identifier, os_name=None):
+    '''
+    Returns True if the given identifier is a signature and not a symbol.
+    <os_name> is the os.name of the system the identifier is used on and
+    defaults to the current one.
+    '''
+
+    return (os_name or os.name) == 'nt' and ' ' in identifier
+
+def parse_signature(identifier):
+    '''
+    Converts a signature with spaces into a byte string.
+    '''
+
+    return binascii.unhexlify(identifier.replace(' ', ''))
+
 def read_files(*files):
     '''
     Reads all passed data files and converts them to a dictionary. If the
@@ -0,0 +1,182 @@
+'''
+Resolves the identifiers (signatures and symbols) of all functions in the
+given type and pipe files offline and writes a resolution cache file. Pass
+that file to TypeManager(resolution_file=...), so servers don't have to
+search any address at boot.
+
+    python -m binutils.resolve -d /srv/game/bin resolutions.dat data/*.ini
+
+The binaries are mapped from disk and their file offsets are translated to
+virtual addresses with the program headers. They are never loaded, so the
+game's Python interpreter isn't required. Identifiers are classified by
+helpers.is_signature() like on a Linux server, so a resolution matches
+the address the server would search.
+
+Exits with status 1 if an identifier couldn't be resolved, so a deployment
+can be stopped before any server starts.
+'''
+
+# =============================================================================
+# >> IMPORTS
+# =============================================================================
+# Python
+import os
+import sys
+import optparse
+
+# binutils
+import cache
+import helpers
+
+from binutils import KEY_BINARY
+from binutils import KEY_IDENTIFIER
+from binutils import KEY_SRV_CHECK
+from binutils import KEY_ATTRIBUTES
+from binutils import KEY_FUNCTIONS
+from binutils import KEY_VIRTUAL_FUNCTIONS
+
+from _binutils import BinaryImage
+
+
+# =============================================================================
+# >> FUNCTIONS
+# =============================================================================
+def collect_identifiers(raw_data):
+    '''
+    Returns a list of (binary, identifier, srv_check) tuples of all functions
+    in the parsed content of a type or pipe file.
+    '''
+
+    keys = (
+        (KEY_BINARY, str, None),
+        (KEY_IDENTIFIER, str, None),
+        (KEY_SRV_CHECK, helpers.as_bool, 'True')
+    )
+
+    # Pipe files contain the functions at the top level
+    pipes = dict((name, value) for name, value in raw_data.iteritems()
+        if isinstance(value, dict) and name not in (KEY_ATTRIBUTES,
+            KEY_FUNCTIONS, KEY_VIRTUAL_FUNCTIONS))
+
+    result = []
+    for section in (raw_data.get(KEY_FUNCTIONS, {}), pipes):
+        for name, data in helpers.parse_data(section, keys):
+            result.append(tuple(data))
+
+    return result
+
+def find_binary_file(binary, srv_check, binary_dirs):
+    '''
+    Returns the path of the file find_binary() would load for the given
+    binary or None if it doesn't exist in one of the given directories.
+    '''
+
+    # Same naming rules as find_binary() on Linux
+    name = binary
+    if srv_check and not name.endswith('_srv'):
+        name += '_srv.so'
+    elif not name.endswith('.so'):
+        name += '.so'
+
+    candidates = [name]
+    if not os.path.isabs(name):
+        candidates = [os.path.join(d, name) for d in binary_dirs] + candidates
+
+    for path in candidates:
+        if os.path.isfile(path):
+            return os.path.abspath(path)
+
+    return None
+
+def resolve_binary(path, identifiers, threads=0):
+    '''
+    Searches all given identifiers in the binary file at <path>. Returns a
+    dictionary that maps the identifiers that have been found to their
+    virtual addresses.
+    '''
+
+    image  = BinaryImage(path)
+    binary = image.find_binary(path, False)
+    bias   = binary.load_bias
+
+    # The binaries are always shared libraries of Linux
+    signatures = [x for x in identifiers if helpers.is_signature(x, 'posix')]
+    symbols    = [x for x in identifiers
+        if not helpers.is_signature(x, 'posix')]
+
+    results = zip(signatures, binary.find_signatures(
+        [helpers.parse_signature(x) for x in signatures], threads))
+
+    results.extend(zip(symbols, binary.find_symbols(symbols)))
+    return dict((identifier, int(ptr) - bias)
+        for identifier, ptr in results if ptr)
+
+def main():
+    parser = optparse.OptionParser(
+        usage='%prog [options] output_file data_file ...',
+        description='Resolves all signatures and symbols of the given type ' \
+            'and pipe files and writes them to a resolution cache file.')
+
+    parser.add_option('-d', '--binary-dir', action='append', default=[],
+        help='directory that contains the binaries (can be used several ' \
+            'times)')
+
+    parser.add_option('-t', '--threads', type='int', default=0,
+        help='threads per signature scan (default: number of CPUs)')
+
+    options, args = parser.parse_args()
+    if len(args) < 2:
+        parser.error('An output file and at least one data file are ' \
+            'required.')
+
+    output_file = args[0]
+    errors = []
+
+    # Group the identifiers by their binary
+    groups = {}
+    for data_file in args[1:]:
+        try:
+            raw_data = helpers.read_files(data_file)
+            identifiers = collect_identifiers(raw_data)
+        except (IOError, SyntaxError, KeyError, ValueError), e:
+            errors.append('%s: %s'% (data_file, e))
+            continue
+
+        for binary, identifier, srv_check in identifiers:
+            groups.setdefault((binary, srv_check), set()).add(identifier)
+
+    resolutions = cache.ResolutionCache()
+    for (binary, srv_check), identifiers in sorted(groups.iteritems()):
+        identifiers = sorted(identifiers)
+        path = find_binary_file(binary, srv_check, options.binary_dir)
+        if path is None:
+            errors.extend('%s (%s): Unable to find the binary.'% (
+                identifier, binary) for identifier in identifiers)
+            continue
+
+        try:
+            addresses = resolve_binary(path, identifiers, options.threads)
+        except (IOError, TypeError, ValueError), e:
+            errors.extend('%s (%s): %s'% (identifier, binary, e)
+                for identifier in identifiers)
+            continue
+
+        resolutions.update(cache.get_binary_id(path), addresses)
+        print('%s: %d of %d identifiers resolved'% (path, len(addresses),
+            len(identifiers)))
+
+        errors.extend('%s (%s): Could not find %s.'% (identifier, binary,
+            'signature' if ' ' in identifier else 'symbol')
+            for identifier in identifiers if identifier not in addresses)
+
+    resolutions.save(output_file)
+    print('Resolution cache written to %s.'% output_file)
+
+    if errors:
+        sys.stderr.write('Could not resolve %d identifier(s):\n%s\n'% (
+            len(errors), '\n'.join(errors)))
+
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,343 @@
+# =============================================================================
+# >> IMPORTS
+# =============================================================================
+# Python
+import os
+import gc
+import sys
+import json
+
+# binutils
+from _binutils import *
+
+
+# =============================================================================
+# >> CONSTANTS
+# =============================================================================
+# Fields of the tuples returned by get_trace_events()
+EVENT_FIELDS = (
+    'category',
+    'name',
+    'thread',
+    'start',
+    'duration',
+    'bytes',
+    'cache_hit'
+)
+
+# Fields of the tuples returned by get_timeline_spans()
+SPAN_FIELDS = (
+    'name',
+    'thread',
+    'start',
+    'duration',
+    'depth',
+    'tick'
+)
+
+# Largest tick number
+MAX_TICK = 0xFFFFFFFF
+
+
+# =============================================================================
+# >> CLASSES
+# =============================================================================
+class traced(object):
+    '''
+    Context manager that adds a trace event for the time spent in its block.
+    Does nothing if tracing is disabled.
+
+    with traced('create_type_from_file', 'CBaseEntity'):
+        ...
+    '''
+
+    def __init__(self, category, name=''):
+        self.category = category
+        self.name     = name
+        self.start    = None
+
+    def __enter__(self):
+        if is_trace_enabled():
+            self.start = get_trace_time()
+
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        if self.start is not None:
+            add_trace_event(self.category, self.name, self.start,
+                get_trace_time() - self.start)
+
+
+# =============================================================================
+# >> FUNCTIONS
+# =============================================================================
+def get_events(category=None):
+    '''
+    Returns all recorded events as dictionaries. If <category> is not None,
+    only events of that category are returned.
+    '''
+
+    events = (dict(zip(EVENT_FIELDS, event)) for event in get_trace_events())
+    if category is None:
+        return list(events)
+
+    return [event for event in events if event['category'] == category]
+
+def report(sort_by='duration', category=None, limit=None):
+    '''
+    Returns the recorded events sorted by the given field (most expensive
+    first).
+    '''
+
+    events = sorted(get_events(category), key=lambda x: x[sort_by],
+        reverse=True)
+
+    return events if limit is None else events[:limit]
+
+def summary():
+    '''
+    Returns a dictionary that contains the number of events, the total
+    duration, the scanned bytes and the cache hits/misses per category.
+    '''
+
+    result = {}
+    for event in get_events():
+        data = result.setdefault(event['category'], {
+            'count': 0,
+            'duration': 0.0,
+            'bytes': 0,
+            'hits': 0,
+            'misses': 0
+        })
+
+        data['count'] += 1
+        data['duration'] += event['duration']
+        data['bytes'] += event['bytes']
+        if event['cache_hit'] == 1:
+            data['hits'] += 1
+        elif event['cache_hit'] == 0:
+            data['misses'] += 1
+
+    return result
+
+def format_report(limit=20):
+    '''
+    Returns a human readable report of the most expensive events and a
+    summary per category.
+    '''
+
+    lines = ['%-24s %12s %8s %12s  %s'% ('Category', 'Total (ms)', 'Count',
+        'Bytes', 'Hits/Misses')]
+
+    for category, data in sorted(summary().iteritems(),
+            key=lambda x: x[1]['duration'], reverse=True):
+        lines.append('%-24s %12.3f %8d %12d  %d/%d'% (category,
+            data['duration'] / 1000.0, data['count'], data['bytes'],
+            data['hits'], data['misses']))
+
+    lines.append('')
+    lines.append('%-12s %-24s %s'% ('Time (ms)', 'Category', 'Name'))
+    for event in report(limit=limit):
+        lines.append('%-12.3f %-24s %s'% (event['duration'] / 1000.0,
+            event['category'], event['name']))
+
+    return '\n'.join(lines)
+
+def export_chrome_trace(path):
+    '''
+    Writes all recorded events to <path> in the Chrome trace-event format. The
+    file can be opened with chrome://tracing or Perfetto.
+    '''
+
+    pid = os.getpid()
+    trace_events = []
+    for event in get_events():
+        args = {'bytes': event['bytes']}
+        if event['cache_hit'] != -1:
+            args['cache_hit'] = bool(event['cache_hit'])
+
+        trace_events.append({
+            'name': event['name'] or event['category'],
+            'cat': event['category'],
+            'ph': 'X',
+            'ts': event['start'],
+            'dur': event['duration'],
+            'pid': pid,
+            'tid': event['thread'],
+            'args': args
+        })
+
+    with open(path, 'w') as f:
+        json.dump({'traceEvents': trace_events, 'displayTimeUnit': 'ms'}, f)
+
+def get_spans(first_tick=0, last_tick=MAX_TICK):
+    '''
+    Returns all recorded timeline spans that begin in the given range of ticks
+    as dictionaries.
+    '''
+
+    return [dict(zip(SPAN_FIELDS, span)) for span in get_timeline_spans(
+        first_tick, last_tick)]
+
+def export_timeline(path, first_tick=0, last_tick=MAX_TICK,
+        include_events=False):
+    '''
+    Writes the timeline spans of the given range of ticks to <path> in the
+    Chrome trace-event format, so every tick can be viewed as a flame chart
+    with chrome://tracing or Perfetto. If <include_events> is True, the events
+    of the tracer are added as well. Both use the same time line.
+
+    Disable the timeline first to get consistent results. Threads that are
+    recording while exporting might overwrite the oldest events.
+    '''
+
+    pid = os.getpid()
+    trace_events = []
+    for span in get_spans(first_tick, last_tick):
+        trace_events.append({
+            'name': span['name'],
+            'cat': 'timeline',
+            'ph': 'X',
+            'ts': span['start'],
+            'dur': span['duration'],
+            'pid': pid,
+            'tid': span['thread'],
+            'args': {'tick': span['tick'], 'depth': span['depth']}
+        })
+
+    if include_events:
+        for event in get_events():
+            trace_events.append({
+                'name': event['name'] or event['category'],
+                'cat': event['category'],
+                'ph': 'X',
+                'ts': event['start'],
+                'dur': event['duration'],
+                'pid': pid,
+                'tid': event['thread'],
+                'args': {'bytes': event['bytes']}
+            })
+
+    with open(path, 'w') as f:
+        json.dump({'traceEvents': trace_events, 'displayTimeUnit': 'ms'}, f)
+
+def replay(path, callbacks, repeat=1):
+    '''
+    Feeds the calls of a recording (see Function.save_recording()) into the
+    given callbacks like a pre-hook and returns the results per callback as
+    dictionaries. <callbacks> can be a list of callables or a Function object,
+    in which case its registered pre-hooks are used.
+
+    The garbage collector is disabled while a callback is replayed, so
+    'gc_allocations' is the number of container objects a callback has
+    allocated and not freed. 'allocated_blocks' is the number of memory
+    blocks it has left behind if the interpreter can count them (None
+    otherwise).
+    '''
+
+    if isinstance(callbacks, Function):
+        callbacks = callbacks.pre_hooks
+
+    recording = Recording(path)
+    get_blocks = getattr(sys, 'getallocatedblocks', None)
+
+    results = []
+    for callback in callbacks:
+        gc_enabled = gc.isenabled()
+        gc.collect()
+        gc.disable()
+        try:
+            objects = gc.get_count()[0]
+            blocks = get_blocks() if get_blocks is not None else None
+            calls, seconds, errors = recording.replay(callback, repeat)
+            objects = gc.get_count()[0] - objects
+            if blocks is not None:
+                blocks = get_blocks() - blocks
+        finally:
+            if gc_enabled:
+                gc.enable()
+
+        results.append({
+            'callback': getattr(callback, '__name__', repr(callback)),
+            'calls': calls,
+            'seconds': seconds,
+            'calls_per_second': calls / seconds if seconds else 0.0,
+            'errors': errors,
+            'gc_allocations': objects,
+            'allocated_blocks': blocks
+        })
+
+    return results
+
+def format_replay(results):
+    '''
+    Returns a human readable table of the results of replay().
+    '''
+
+    lines = ['%-32s %10s %14s %8s %12s'% ('Callback', 'Calls', 'Calls/s',
+        'Errors', 'GC allocs')]
+
+    for result in results:
+        lines.append('%-32s %10d %14.0f %8d %12d'% (result['callback'],
+            result['calls'], result['calls_per_second'], result['errors'],
+            result['gc_allocations']))
+
+    return '\n'.join(lines)
+
+def drain_watch(watch, backend=None):
+    '''
+    Drains the samples of a HardwareWatch (see hw_watch()) and groups them by
+    program counter. Every program counter is symbolized with <backend> or
+    the memory of this process. Returns a list of dictionaries, most hits
+    first.
+    '''
+
+    pcs = {}
+    for pc, thread, time in watch.drain():
+        data = pcs.get(pc)
+        if data is None:
+            data = pcs[pc] = {
+                'pc': pc,
+                'hits': 0,
+                'threads': set(),
+                'first': time,
+                'last': time
+            }
+
+        data['hits'] += 1
+        data['threads'].add(thread)
+        data['first'] = min(data['first'], time)
+        data['last'] = max(data['last'], time)
+
+    lookup = symbolize if backend is None else backend.symbolize
+    for data in pcs.itervalues():
+        symbol = lookup(data['pc'])
+        data['module'], data['symbol'], data['offset'] = symbol or (None,
+            None, None)
+
+        data['threads'] = sorted(data['threads'])
+
+    return sorted(pcs.itervalues(), key=lambda x: x['hits'], reverse=True)
+
+def check_integrity(monitor, budget, backend=None):
+    '''
+    Verifies the next <budget> blocks of an IntegrityMonitor and returns the
+    newly modified ranges as dictionaries. The start of every range is
+    symbolized with <backend> or the memory of this process.
+    '''
+
+    ranges = []
+    modified = monitor.step(budget)
+    lookup = symbolize if backend is None else backend.symbolize
+    for addr, size in modified:
+        module, symbol, offset = lookup(addr) or (None, None, None)
+
+        ranges.append({
+            'addr': addr,
+            'size': size,
+            'module': module,
+            'symbol': symbol,
+            'offset': offset
+        })
+
+    return ranges
@@ -70,6 +70,37 @@ CCallback::CCallback(object oCallback, Convention_t eConv, char* szParams)
     // Generate the function
     Assembler a;
 
+#ifdef __x86_64__
+    // Epilog
+    a.push(rbp);
+    a.mov(rbp, rsp);
+
+    // Spill the argument registers in the order of Registers_t. The stack
+    // stays aligned to 16 bytes.
+    a.sub(rsp, imm(112));
+    a.mov(qword_ptr(rsp, 0), rdi);
+    a.mov(qword_ptr(rsp, 8), rsi);
+    a.mov(qword_ptr(rsp, 16), rdx);
+    a.mov(qword_ptr(rsp, 24), rcx);
+    a.mov(qword_ptr(rsp, 32), r8);
+    a.mov(qword_ptr(rsp, 40), r9);
+    for (int i=0; i < 8; i++)
+        a.movq(qword_ptr(rsp, 48 + i * 8), xmm(i));
+
+    // Call callback caller
+    a.mov(rdi, imm((sysint_t) this));
+    a.mov(rsi, rbp);
+    a.mov(rdx, rsp);
+    a.mov(rax, imm((sysint_t) pCallCallbackFunc));
+    a.call(rax);
+
+    // Prolog
+    a.mov(rsp, rbp);
+    a.pop(rbp);
+
+    // Return
+    a.ret();
+#else
     // Epilog
     a.push(ebp);
     a.mov(ebp, esp);
@@ -87,6 +118,7 @@ CCallback::CCallback(object oCallback, Convention_t eConv, char* szParams)
 
     // Return
     a.ret(imm(GetPopSize()));
+#endif
 
     m_ulAddr = (unsigned long) a.make();
 }
@@ -146,12 +178,21 @@ void CCallback::Free()
 template<class T>
 T GetArgument(CCallback* pCallback, unsigned long ulEBP, unsigned long ulECX, int iIndex)
 {
+#ifdef __x86_64__
+    // On x64 ulECX points to the spilled argument registers
+    Param_t* pParam = pCallback->GetArgument(iIndex);
+    if (pParam->m_iRegister != ARG_REG_NONE)
+        return *(T *) (ulECX + pParam->m_iRegister * 8);
+
+    return *(T *) (ulEBP + pParam->m_iOffset + 16);
+#else
 #ifdef _WIN32
     if (pCallback->m_eConv == CONV_THISCALL && iIndex == 0)
         return *(T *) &ulECX;
 #endif
 
     return *(T *) (ulEBP + pCallback->GetArgument(iIndex)->m_iOffset + 8);
+#endif
 }
 
 object CallCallback(CCallback* pCallback, unsigned long ulEBP, unsigned long ulECX)
@@ -24,6 +24,7 @@
 // >> INCLUDES
 // ============================================================================
 #include "binutils_tools.h"
+#include "binutils_macros.h"
 
 
 // ============================================================================
@@ -34,21 +35,26 @@ class CCallback;
 
 object CallCallback(CCallback* pCallback, unsigned long ulEBP, unsigned long ulECX);
 
+// The callback might be called by any thread, so the GIL has to be acquired
+// before the Python objects are created
 template<class T>
 T CallbackCaller(CCallback* pCallback, unsigned long ulEBP, unsigned long ulECX)
 {
+    CAcquireGIL gil;
     return extract<T>(CallCallback(pCallback, ulEBP, ulECX));
 }
 
 template<>
 inline void CallbackCaller(CCallback* pCallback, unsigned long ulEBP, unsigned long ulECX)
 {
+    CAcquireGIL gil;
     CallCallback(pCallback, ulEBP, ulECX);
 }
 
 template<>
 inline void* CallbackCaller(CCallback* pCallback, unsigned long ulEBP, unsigned long ulECX)
 {
+    CAcquireGIL gil;
     return (void *) ExtractPyPtr(CallCallback(pCallback, ulEBP, ulECX));
 }
 
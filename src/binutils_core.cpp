@@ -0,0 +1,666 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+// Core files might be larger than 2 GB
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#ifndef _WIN32
+    #include <elf.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include "binutils_core.h"
+#include "binutils_elf.h"
+
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+#ifndef NT_FILE
+    #define NT_FILE 0x46494c45
+#endif
+
+// Notes are aligned to 4 bytes in both ELF classes
+#define NOTE_ALIGN(size) (((size) + 3) & ~3)
+
+
+// ============================================================================
+// >> HELPER FUNCTIONS
+// ============================================================================
+bool SortSegments(const CoreSegment_t& a, const CoreSegment_t& b)
+{
+    return a.m_ulAddr < b.m_ulAddr;
+}
+
+#ifndef _WIN32
+unsigned long GetPageDelta(unsigned long long ullOffset)
+{
+    return (unsigned long) (ullOffset & (sysconf(_SC_PAGESIZE) - 1));
+}
+
+unsigned char* MapFile(int iFile, unsigned long long ullOffset, unsigned long ulSize)
+{
+    // The offset of mmap() needs to be aligned to the page size
+    unsigned long ulDelta = GetPageDelta(ullOffset);
+    void* pData = mmap(NULL, ulSize + ulDelta, PROT_READ, MAP_PRIVATE, iFile, (off_t) (ullOffset - ulDelta));
+    if (pData == MAP_FAILED)
+        return NULL;
+
+    return (unsigned char *) pData + ulDelta;
+}
+
+void UnmapFile(unsigned char* pData, unsigned long long ullOffset, unsigned long ulSize)
+{
+    unsigned long ulDelta = GetPageDelta(ullOffset);
+    munmap(pData - ulDelta, ulSize + ulDelta);
+}
+#endif
+
+
+// ============================================================================
+// >> CCoreFile
+// ============================================================================
+CCoreFile::CCoreFile()
+{
+    m_iFile = -1;
+}
+
+CCoreFile::~CCoreFile()
+{
+#ifndef _WIN32
+    for (size_t i=0; i < m_Segments.size(); i++)
+    {
+        CoreSegment_t& segment = m_Segments[i];
+        if (segment.m_pData)
+            UnmapFile(segment.m_pData, segment.m_ullOffset, segment.m_ulFileSize);
+    }
+
+    for (size_t i=0; i < m_Files.size(); i++)
+    {
+        FileMapping_t& file = m_Files[i];
+        if (file.m_pData)
+            UnmapFile(file.m_pData, file.m_ullOffset, file.m_ulDataSize);
+    }
+
+    if (m_iFile != -1)
+        close(m_iFile);
+#endif
+}
+
+bool CCoreFile::ReadFile(unsigned long long ullOffset, void* pBuffer, unsigned long ulSize)
+{
+#ifndef _WIN32
+    return pread(m_iFile, pBuffer, ulSize, (off_t) ullOffset) == (ssize_t) ulSize;
+#else
+    return false;
+#endif
+}
+
+bool CCoreFile::Open(const char* szPath, std::string& szError)
+{
+#ifdef _WIN32
+    szError = "Core files are not supported on Windows.";
+    return false;
+#else
+    m_szPath = szPath;
+    m_iFile = open(szPath, O_RDONLY);
+    if (m_iFile == -1)
+    {
+        szError = "Unable to open " + m_szPath;
+        return false;
+    }
+
+    unsigned char ident[EI_NIDENT];
+    if (!ReadFile(0, ident, sizeof(ident)))
+    {
+        szError = "File is too small.";
+        return false;
+    }
+
+    bool bResult;
+    if (memcmp(ident, SNAPSHOT_MAGIC, 8) == 0)
+        bResult = ParseSnapshot(szError);
+
+    else if (memcmp(ident, ELFMAG, SELFMAG) == 0 && ident[EI_CLASS] == ELFCLASS32)
+        bResult = ParseElf<Elf32_Ehdr, Elf32_Phdr, Elf32_Nhdr, Elf32_Word>(szError);
+
+    else if (memcmp(ident, ELFMAG, SELFMAG) == 0 && ident[EI_CLASS] == ELFCLASS64)
+        bResult = ParseElf<Elf64_Ehdr, Elf64_Phdr, Elf64_Nhdr, Elf64_Xword>(szError);
+
+    else
+    {
+        szError = "Neither an ELF core file nor a snapshot file.";
+        return false;
+    }
+
+    std::sort(m_Segments.begin(), m_Segments.end(), SortSegments);
+    return bResult;
+#endif
+}
+
+bool CCoreFile::ParseSnapshot(std::string& szError)
+{
+    SnapshotHeader_t header;
+    if (!ReadFile(0, &header, sizeof(header)))
+    {
+        szError = "Invalid snapshot header.";
+        return false;
+    }
+
+    unsigned long long ullOffset = sizeof(header);
+    std::vector<SnapshotRange_t> ranges(header.m_uiRanges);
+    if (header.m_uiRanges && !ReadFile(ullOffset, &ranges[0], header.m_uiRanges * sizeof(SnapshotRange_t)))
+    {
+        szError = "Invalid snapshot ranges.";
+        return false;
+    }
+    ullOffset += header.m_uiRanges * sizeof(SnapshotRange_t);
+
+    for (unsigned int i=0; i < header.m_uiModules; i++)
+    {
+        SnapshotModule_t module;
+        if (!ReadFile(ullOffset, &module, sizeof(module)))
+        {
+            szError = "Invalid snapshot modules.";
+            return false;
+        }
+        ullOffset += sizeof(module);
+
+        std::string szModulePath(module.m_uiPathLength, '\0');
+        if (module.m_uiPathLength && !ReadFile(ullOffset, &szModulePath[0], module.m_uiPathLength))
+        {
+            szError = "Invalid snapshot modules.";
+            return false;
+        }
+        ullOffset += module.m_uiPathLength;
+
+        Module_t entry = {szModulePath, (unsigned long) module.m_ullBase, (unsigned long) module.m_ullSize};
+        m_Modules.push_back(entry);
+    }
+
+    for (unsigned int i=0; i < header.m_uiRanges; i++)
+    {
+        SnapshotRange_t& range = ranges[i];
+        CoreSegment_t segment = {(unsigned long) range.m_ullAddr, (unsigned long) range.m_ullSize,
+            (unsigned long) range.m_ullSize, range.m_ullOffset, NULL};
+
+        m_Segments.push_back(segment);
+    }
+    return true;
+}
+
+template<class Ehdr, class Phdr, class Nhdr, class Word>
+bool CCoreFile::ParseElf(std::string& szError)
+{
+    Ehdr header;
+    if (!ReadFile(0, &header, sizeof(header)))
+    {
+        szError = "Invalid ELF header.";
+        return false;
+    }
+
+    if (header.e_type != ET_CORE)
+    {
+        szError = "ELF file is not a core file.";
+        return false;
+    }
+
+    if (sizeof(Word) > sizeof(unsigned long))
+    {
+        szError = "64 bit core files require a 64 bit build of binutils.";
+        return false;
+    }
+
+    std::vector<Phdr> phdrs(header.e_phnum);
+    if (header.e_phnum && !ReadFile(header.e_phoff, &phdrs[0], header.e_phnum * sizeof(Phdr)))
+    {
+        szError = "Invalid program headers.";
+        return false;
+    }
+
+    for (size_t i=0; i < phdrs.size(); i++)
+    {
+        Phdr& phdr = phdrs[i];
+        if (phdr.p_type == PT_LOAD && phdr.p_memsz)
+        {
+            CoreSegment_t segment = {(unsigned long) phdr.p_vaddr, (unsigned long) phdr.p_memsz,
+                (unsigned long) std::min(phdr.p_filesz, phdr.p_memsz), phdr.p_offset, NULL};
+
+            m_Segments.push_back(segment);
+        }
+        else if (phdr.p_type == PT_NOTE && phdr.p_filesz)
+        {
+            std::vector<unsigned char> notes(phdr.p_filesz);
+            if (!ReadFile(phdr.p_offset, &notes[0], notes.size()))
+                continue;
+
+            unsigned long ulOffset = 0;
+            while (ulOffset + sizeof(Nhdr) <= notes.size())
+            {
+                Nhdr* note = (Nhdr *) &notes[ulOffset];
+                unsigned long ulDesc = ulOffset + sizeof(Nhdr) + NOTE_ALIGN(note->n_namesz);
+                if (ulDesc + note->n_descsz > notes.size())
+                    break;
+
+                if (note->n_type == NT_FILE)
+                    ParseFileNote<Word>(&notes[ulDesc], note->n_descsz);
+
+                ulOffset = ulDesc + NOTE_ALIGN(note->n_descsz);
+            }
+        }
+    }
+    return true;
+}
+
+template<class Word>
+void CCoreFile::ParseFileNote(const unsigned char* pDesc, unsigned long ulSize)
+{
+    // Layout: count, page size, count * (start, end, page offset), count * path
+    const Word* words = (const Word *) pDesc;
+    if (ulSize < 2 * sizeof(Word))
+        return;
+
+    Word count = words[0];
+    Word page_size = words[1];
+    if ((2 + 3 * count) * sizeof(Word) > ulSize)
+        return;
+
+    const char* names = (const char *) (words + 2 + 3 * count);
+    const char* end = (const char *) pDesc + ulSize;
+    for (Word i=0; i < count && names < end; i++)
+    {
+        const Word* entry = words + 2 + 3 * i;
+        std::string szPath(names, strnlen(names, end - names));
+        names += szPath.size() + 1;
+
+        FileMapping_t file = {(unsigned long) entry[0], (unsigned long) entry[1],
+            (unsigned long long) entry[2] * page_size, szPath, NULL, 0, false};
+
+        m_Files.push_back(file);
+
+        // Mappings of the same file are contiguous
+        if (!m_Modules.empty() && m_Modules.back().m_szPath == szPath)
+        {
+            m_Modules.back().m_ulSize = file.m_ulEnd - m_Modules.back().m_ulBase;
+            continue;
+        }
+
+        Module_t module = {szPath, file.m_ulStart, file.m_ulEnd - file.m_ulStart};
+        m_Modules.push_back(module);
+    }
+}
+
+const unsigned char* CCoreFile::GetData(unsigned long ulAddr, unsigned long& ulAvailable)
+{
+    ulAvailable = 0;
+
+#ifndef _WIN32
+    // Find the last segment that starts at or before the address
+    size_t lo = 0;
+    size_t hi = m_Segments.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (m_Segments[mid].m_ulAddr <= ulAddr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    CoreSegment_t* pSegment = NULL;
+    if (lo > 0 && ulAddr - m_Segments[lo - 1].m_ulAddr < m_Segments[lo - 1].m_ulSize)
+        pSegment = &m_Segments[lo - 1];
+
+    if (pSegment)
+    {
+        unsigned long ulOffset = ulAddr - pSegment->m_ulAddr;
+        if (ulOffset < pSegment->m_ulFileSize)
+        {
+            if (!pSegment->m_pData)
+                pSegment->m_pData = MapFile(m_iFile, pSegment->m_ullOffset, pSegment->m_ulFileSize);
+
+            if (pSegment->m_pData)
+            {
+                ulAvailable = pSegment->m_ulFileSize - ulOffset;
+                return pSegment->m_pData + ulOffset;
+            }
+        }
+    }
+
+    // The page hasn't been dumped. Try the file it has been mapped from.
+    for (size_t i=0; i < m_Files.size(); i++)
+    {
+        FileMapping_t& file = m_Files[i];
+        if (ulAddr < file.m_ulStart || ulAddr >= file.m_ulEnd)
+            continue;
+
+        if (!file.m_bMapped)
+        {
+            file.m_bMapped = true;
+
+            struct stat buf;
+            int iFile = open(file.m_szPath.c_str(), O_RDONLY);
+            if (iFile != -1 && fstat(iFile, &buf) == 0 && file.m_ullOffset < (unsigned long long) buf.st_size)
+            {
+                // Never map beyond the end of the file
+                file.m_ulDataSize = (unsigned long) std::min(
+                    (unsigned long long) (file.m_ulEnd - file.m_ulStart),
+                    (unsigned long long) buf.st_size - file.m_ullOffset);
+
+                file.m_pData = MapFile(iFile, file.m_ullOffset, file.m_ulDataSize);
+            }
+
+            if (iFile != -1)
+                close(iFile);
+        }
+
+        unsigned long ulOffset = ulAddr - file.m_ulStart;
+        if (file.m_pData && ulOffset < file.m_ulDataSize)
+        {
+            ulAvailable = file.m_ulDataSize - ulOffset;
+            return file.m_pData + ulOffset;
+        }
+        break;
+    }
+
+    // The memory exists, but only contains zeros
+    if (pSegment)
+        ulAvailable = pSegment->m_ulSize - (ulAddr - pSegment->m_ulAddr);
+#endif
+
+    return NULL;
+}
+
+bool CCoreFile::Read(unsigned long ulAddr, void* pBuffer, unsigned long ulSize)
+{
+    unsigned char* pDest = (unsigned char *) pBuffer;
+    while (ulSize)
+    {
+        unsigned long ulAvailable;
+        const unsigned char* pData = GetData(ulAddr, ulAvailable);
+        if (!ulAvailable)
+            return false;
+
+        unsigned long ulChunk = std::min(ulAvailable, ulSize);
+        if (pData)
+            memcpy(pDest, pData, ulChunk);
+        else
+            memset(pDest, 0, ulChunk);
+
+        pDest += ulChunk;
+        ulAddr += ulChunk;
+        ulSize -= ulChunk;
+    }
+    return true;
+}
+
+const void* CCoreFile::GetDirect(unsigned long ulAddr, unsigned long ulSize)
+{
+    unsigned long ulAvailable;
+    const unsigned char* pData = GetData(ulAddr, ulAvailable);
+    return ulAvailable >= ulSize ? pData : NULL;
+}
+
+
+// ============================================================================
+// >> CBinaryImage
+// ============================================================================
+CBinaryImage::CBinaryImage()
+{
+    m_pImage = NULL;
+    m_ulSize = 0;
+}
+
+CBinaryImage::~CBinaryImage()
+{
+#ifndef _WIN32
+    if (m_pImage)
+        munmap(m_pImage, m_ulSize);
+#endif
+}
+
+bool CBinaryImage::Open(const char* szPath, std::string& szError)
+{
+#ifdef _WIN32
+    szError = "Binary images are not supported on Windows.";
+    return false;
+#else
+    m_szPath = szPath;
+
+    CElfFile elf;
+    if (!elf.Open(szPath))
+    {
+        szError = "Unable to open " + m_szPath + " as an ELF file.";
+        return false;
+    }
+
+    int iFile = open(szPath, O_RDONLY);
+    if (iFile == -1)
+    {
+        szError = "Unable to open " + m_szPath;
+        return false;
+    }
+
+    // Reserve the whole image first. Gaps between the segments and the
+    // zero-initialized parts (.bss) are anonymous pages that read as zero.
+    unsigned long ulSize = elf.GetImageSize();
+    void* pImage = mmap(NULL, ulSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (!ulSize || pImage == MAP_FAILED)
+    {
+        close(iFile);
+        szError = "Unable to reserve the image of " + m_szPath;
+        return false;
+    }
+
+    m_pImage = (unsigned char *) pImage;
+    m_ulSize = ulSize;
+
+    // Translate the file offsets of the loadable segments to their virtual
+    // addresses
+    const std::vector<ElfSegment_t>& segments = elf.GetSegments();
+    for (size_t i=0; i < segments.size(); i++)
+    {
+        const ElfSegment_t& segment = segments[i];
+        if (segment.m_uiType != PT_LOAD || !segment.m_ullFileSize)
+            continue;
+
+        unsigned long long ullStart = segment.m_ullAddr - elf.GetLoadBase();
+        unsigned long ulDelta = GetPageDelta(ullStart);
+        if (segment.m_ullFileSize > segment.m_ullMemSize || ullStart + segment.m_ullMemSize > ulSize
+                || !elf.IsValidRange(segment.m_ullOffset, segment.m_ullFileSize) || GetPageDelta(segment.m_ullOffset) != ulDelta)
+        {
+            close(iFile);
+            szError = "Invalid program headers in " + m_szPath;
+            return false;
+        }
+
+        unsigned char* pStart = m_pImage + ullStart;
+        unsigned long ulMapSize = segment.m_ullFileSize + ulDelta;
+        if (mmap(pStart - ulDelta, ulMapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, iFile,
+                (off_t) (segment.m_ullOffset - ulDelta)) == MAP_FAILED)
+        {
+            close(iFile);
+            szError = "Unable to map a segment of " + m_szPath;
+            return false;
+        }
+
+        // The rest of the last page belongs to the zero-initialized part
+        unsigned long ulTail = GetPageDelta(ulMapSize);
+        if (ulTail)
+            memset(pStart + segment.m_ullFileSize, 0, sysconf(_SC_PAGESIZE) - ulTail);
+
+        mprotect(pStart - ulDelta, ulMapSize, PROT_READ);
+    }
+
+    close(iFile);
+    m_szBuildId = elf.GetBuildId();
+    return true;
+#endif
+}
+
+bool CBinaryImage::Read(unsigned long ulAddr, void* pBuffer, unsigned long ulSize)
+{
+    const void* pData = GetDirect(ulAddr, ulSize);
+    if (!pData)
+        return false;
+
+    memcpy(pBuffer, pData, ulSize);
+    return true;
+}
+
+const void* CBinaryImage::GetDirect(unsigned long ulAddr, unsigned long ulSize)
+{
+    // The image is mapped at the same address in this process
+    unsigned long ulStart = (unsigned long) m_pImage;
+    if (ulAddr < ulStart || ulSize > m_ulSize || ulAddr - ulStart > m_ulSize - ulSize)
+        return NULL;
+
+    return (const void *) ulAddr;
+}
+
+void CBinaryImage::GetModules(std::vector<Module_t>& modules)
+{
+    modules.clear();
+    if (!m_pImage)
+        return;
+
+    Module_t module = {m_szPath, (unsigned long) m_pImage, m_ulSize};
+    modules.push_back(module);
+}
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+struct SnapshotRun_t
+{
+    unsigned long              m_ulAddr;
+    std::vector<unsigned char> m_Data;
+};
+
+long long WriteSnapshot(IMemoryBackend* pBackend, const char* szPath,
+    const std::vector<std::pair<unsigned long, unsigned long> >& ranges)
+{
+    // Split the ranges into runs of readable pages
+    std::vector<SnapshotRun_t> runs;
+    for (size_t i=0; i < ranges.size(); i++)
+    {
+        unsigned long ulAddr = ranges[i].first;
+        unsigned long ulSize = ranges[i].second;
+        if (!ulSize)
+            continue;
+
+        SnapshotRun_t run;
+        run.m_ulAddr = ulAddr;
+        run.m_Data.resize(ulSize);
+        if (pBackend->Read(ulAddr, &run.m_Data[0], ulSize))
+        {
+            runs.push_back(run);
+            continue;
+        }
+
+        run.m_Data.clear();
+        unsigned long ulEnd = ulAddr + ulSize;
+        while (ulAddr < ulEnd)
+        {
+            unsigned long ulChunk = std::min(4096 - (ulAddr & 4095), ulEnd - ulAddr);
+            unsigned char page[4096];
+            if (pBackend->Read(ulAddr, page, ulChunk))
+            {
+                if (run.m_Data.empty())
+                    run.m_ulAddr = ulAddr;
+
+                run.m_Data.insert(run.m_Data.end(), page, page + ulChunk);
+            }
+            else if (!run.m_Data.empty())
+            {
+                runs.push_back(run);
+                run.m_Data.clear();
+            }
+            ulAddr += ulChunk;
+        }
+
+        if (!run.m_Data.empty())
+            runs.push_back(run);
+    }
+
+    std::vector<Module_t> modules;
+    pBackend->GetModules(modules);
+
+    FILE* pFile = fopen(szPath, "wb");
+    if (!pFile)
+        return -1;
+
+    SnapshotHeader_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_szMagic, SNAPSHOT_MAGIC, 8);
+    header.m_uiRanges = runs.size();
+    header.m_uiModules = modules.size();
+
+    // Calculate where the data of the first run starts
+    unsigned long long ullOffset = sizeof(header) + runs.size() * sizeof(SnapshotRange_t);
+    for (size_t i=0; i < modules.size(); i++)
+        ullOffset += sizeof(SnapshotModule_t) + modules[i].m_szPath.size();
+
+    bool bResult = fwrite(&header, sizeof(header), 1, pFile) == 1;
+    for (size_t i=0; bResult && i < runs.size(); i++)
+    {
+        SnapshotRange_t range;
+        memset(&range, 0, sizeof(range));
+        range.m_ullAddr = runs[i].m_ulAddr;
+        range.m_ullSize = runs[i].m_Data.size();
+        range.m_ullOffset = ullOffset;
+        bResult = fwrite(&range, sizeof(range), 1, pFile) == 1;
+        ullOffset += runs[i].m_Data.size();
+    }
+
+    for (size_t i=0; bResult && i < modules.size(); i++)
+    {
+        SnapshotModule_t module;
+        memset(&module, 0, sizeof(module));
+        module.m_ullBase = modules[i].m_ulBase;
+        module.m_ullSize = modules[i].m_ulSize;
+        module.m_uiPathLength = modules[i].m_szPath.size();
+        bResult = fwrite(&module, sizeof(module), 1, pFile) == 1 &&
+            fwrite(modules[i].m_szPath.data(), 1, module.m_uiPathLength, pFile) == module.m_uiPathLength;
+    }
+
+    long long llBytes = 0;
+    for (size_t i=0; bResult && i < runs.size(); i++)
+    {
+        bResult = fwrite(&runs[i].m_Data[0], 1, runs[i].m_Data.size(), pFile) == runs[i].m_Data.size();
+        llBytes += runs[i].m_Data.size();
+    }
+
+    if (fclose(pFile) != 0 || !bResult)
+        return -1;
+
+    return llBytes;
+}
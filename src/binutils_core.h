@@ -0,0 +1,198 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+#ifndef _BINUTILS_CORE_H
+#define _BINUTILS_CORE_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "binutils_memory.h"
+
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+// First 8 bytes of every snapshot file
+#define SNAPSHOT_MAGIC "BUSNAP01"
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+/*
+    Layout of a snapshot file:
+
+    SnapshotHeader_t
+    SnapshotRange_t[m_uiRanges]
+    m_uiModules times: SnapshotModule_t followed by the path (not terminated)
+    Raw data of all ranges
+*/
+// All fields have fixed sizes and there is no implicit padding, so 32 and 64
+// bit builds read and write the same format. Zero the structs before writing
+// them.
+struct SnapshotHeader_t
+{
+    char               m_szMagic[8];
+    uint32_t           m_uiRanges;
+    uint32_t           m_uiModules;
+};
+
+struct SnapshotRange_t
+{
+    uint64_t           m_ullAddr;
+    uint64_t           m_ullSize;
+    uint64_t           m_ullOffset;
+};
+
+struct SnapshotModule_t
+{
+    uint64_t           m_ullBase;
+    uint64_t           m_ullSize;
+    uint32_t           m_uiPathLength;
+    uint32_t           m_uiReserved;
+};
+
+
+// A range of memory that is stored in the core or snapshot file
+struct CoreSegment_t
+{
+    unsigned long      m_ulAddr;
+    unsigned long      m_ulSize;
+    unsigned long      m_ulFileSize;
+    unsigned long long m_ullOffset;
+    unsigned char*     m_pData;
+};
+
+// A range of memory that has been mapped from a file (NT_FILE note). Core
+// files usually don't contain unmodified pages of binaries, so they are read
+// from the binary instead.
+struct FileMapping_t
+{
+    unsigned long      m_ulStart;
+    unsigned long      m_ulEnd;
+    unsigned long long m_ullOffset;
+    std::string        m_szPath;
+    unsigned char*     m_pData;
+    unsigned long      m_ulDataSize;
+    bool               m_bMapped;
+};
+
+
+/*
+    Read-only backend for ELF core files and snapshot files. Segments are
+    mapped into memory when they are accessed for the first time, so huge
+    core files can be opened instantly.
+*/
+class CCoreFile: public IMemoryBackend
+{
+public:
+    CCoreFile();
+    virtual ~CCoreFile();
+
+    /*
+        Opens a core or snapshot file. Returns false and sets szError if the
+        file couldn't be opened.
+    */
+    bool Open(const char* szPath, std::string& szError);
+
+    virtual bool Read(unsigned long ulAddr, void* pBuffer, unsigned long ulSize);
+    virtual bool Write(unsigned long /* ulAddr */, const void* /* pBuffer */, unsigned long /* ulSize */) { return false; }
+    virtual const void* GetDirect(unsigned long ulAddr, unsigned long ulSize);
+    virtual void GetModules(std::vector<Module_t>& modules) { modules = m_Modules; }
+
+    const std::string& GetPath() { return m_szPath; }
+
+private:
+    bool ReadFile(unsigned long long ullOffset, void* pBuffer, unsigned long ulSize);
+    bool ParseSnapshot(std::string& szError);
+
+    template<class Ehdr, class Phdr, class Nhdr, class Word>
+    bool ParseElf(std::string& szError);
+
+    template<class Word>
+    void ParseFileNote(const unsigned char* pDesc, unsigned long ulSize);
+
+    /*
+        Returns a pointer to the data at the given address and the number of
+        contiguous bytes that are available. Returns NULL and a size greater
+        than 0 if the memory exists, but contains only zeros.
+    */
+    const unsigned char* GetData(unsigned long ulAddr, unsigned long& ulAvailable);
+
+private:
+    std::string                m_szPath;
+    int                        m_iFile;
+    std::vector<CoreSegment_t> m_Segments;
+    std::vector<FileMapping_t> m_Files;
+    std::vector<Module_t>      m_Modules;
+};
+
+
+/*
+    Read-only backend that maps a binary from disk the way the dynamic loader
+    does: every loadable segment is mapped at the offset of its virtual
+    address within the image, so signatures and symbols can be resolved
+    without loading the binary. The image is the only module of the backend.
+*/
+class CBinaryImage: public IMemoryBackend
+{
+public:
+    CBinaryImage();
+    virtual ~CBinaryImage();
+
+    /*
+        Maps the given ELF binary. Returns false and sets szError if the file
+        couldn't be mapped.
+    */
+    bool Open(const char* szPath, std::string& szError);
+
+    virtual bool Read(unsigned long ulAddr, void* pBuffer, unsigned long ulSize);
+    virtual bool Write(unsigned long /* ulAddr */, const void* /* pBuffer */, unsigned long /* ulSize */) { return false; }
+    virtual const void* GetDirect(unsigned long ulAddr, unsigned long ulSize);
+    virtual void GetModules(std::vector<Module_t>& modules);
+
+    const std::string& GetPath() { return m_szPath; }
+    const std::string& GetBuildId() { return m_szBuildId; }
+
+private:
+    std::string    m_szPath;
+    std::string    m_szBuildId;
+    unsigned char* m_pImage;
+    unsigned long  m_ulSize;
+};
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    Writes the given (address, size) ranges of a backend and its modules to a
+    snapshot file. Pages that can't be read are skipped. Returns the number of
+    bytes that have been written or -1 if the file couldn't be written.
+*/
+long long WriteSnapshot(IMemoryBackend* pBackend, const char* szPath,
+    const std::vector<std::pair<unsigned long, unsigned long> >& ranges);
+
+#endif // _BINUTILS_CORE_H
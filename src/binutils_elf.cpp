@@ -0,0 +1,284 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <string.h>
+
+#ifndef _WIN32
+    #include <elf.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#else
+    #define ELFCLASSNONE 0
+#endif
+
+#include "binutils_elf.h"
+
+
+// ============================================================================
+// >> CElfFile class
+// ============================================================================
+CElfFile::CElfFile()
+{
+    m_pData = NULL;
+    m_iSize = 0;
+    m_iClass = ELFCLASSNONE;
+    m_ulLoadBase = 0;
+    m_ulImageSize = 0;
+}
+
+CElfFile::~CElfFile()
+{
+    Close();
+}
+
+bool CElfFile::Open(const char* szPath)
+{
+    Close();
+
+#ifdef _WIN32
+    return false;
+#else
+    // -----------------------------------------
+    // We need to use mmap now that VALVe has
+    // made them all private!
+    // Thank you to DamagedSoul from AlliedMods
+    // for the following code.
+    // It can be found at:
+    // http://hg.alliedmods.net/sourcemod-central/file/dc361050274d/core/logic/MemoryUtils.cpp
+    // -----------------------------------------
+    struct stat dlstat;
+    int dlfile = open(szPath, O_RDONLY);
+    if (dlfile == -1)
+        return false;
+
+    if (fstat(dlfile, &dlstat) == -1 || dlstat.st_size < EI_NIDENT)
+    {
+        close(dlfile);
+        return false;
+    }
+
+    /* Map library file into memory */
+    void* map_base = mmap(NULL, dlstat.st_size, PROT_READ, MAP_PRIVATE, dlfile, 0);
+    close(dlfile);
+    if (map_base == MAP_FAILED)
+        return false;
+
+    m_pData = (unsigned char *) map_base;
+    m_iSize = dlstat.st_size;
+
+    bool bResult = false;
+    if (memcmp(m_pData, ELFMAG, SELFMAG) == 0)
+    {
+        m_iClass = m_pData[EI_CLASS];
+        if (m_iClass == ELFCLASS32)
+            bResult = ParseSegments<Elf32_Ehdr, Elf32_Phdr>();
+
+        else if (m_iClass == ELFCLASS64)
+            bResult = ParseSegments<Elf64_Ehdr, Elf64_Phdr>();
+    }
+
+    if (!bResult)
+        Close();
+
+    return bResult;
+#endif
+}
+
+void CElfFile::Close()
+{
+#ifndef _WIN32
+    if (m_pData)
+        munmap(m_pData, m_iSize);
+#endif
+
+    m_pData = NULL;
+    m_iSize = 0;
+    m_iClass = ELFCLASSNONE;
+    m_ulLoadBase = 0;
+    m_ulImageSize = 0;
+    m_Segments.clear();
+}
+
+bool CElfFile::ForEachSymbol(SymbolCallback callback, void* pData)
+{
+#ifndef _WIN32
+    if (m_iClass == ELFCLASS32)
+        return ParseSymbols<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym>(callback, pData);
+
+    if (m_iClass == ELFCLASS64)
+        return ParseSymbols<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>(callback, pData);
+#endif
+    return false;
+}
+
+bool CElfFile::IsValidRange(unsigned long long ullOffset, unsigned long long ullSize)
+{
+    return ullOffset <= m_iSize && ullSize <= m_iSize - ullOffset;
+}
+
+std::string CElfFile::GetBuildId()
+{
+#ifndef _WIN32
+    // The note header has the same layout in both ELF classes
+    for (size_t i=0; i < m_Segments.size(); i++)
+    {
+        ElfSegment_t& segment = m_Segments[i];
+        if (segment.m_uiType != PT_NOTE || !IsValidRange(segment.m_ullOffset, segment.m_ullFileSize))
+            continue;
+
+        unsigned long long ullAlign = segment.m_ullAlign == 8 ? 8 : 4;
+        unsigned long long ullPos = 0;
+        while (ullPos + sizeof(Elf32_Nhdr) <= segment.m_ullFileSize)
+        {
+            Elf32_Nhdr* note = (Elf32_Nhdr *) (m_pData + segment.m_ullOffset + ullPos);
+            unsigned long long ullName = ullPos + sizeof(Elf32_Nhdr);
+            unsigned long long ullDesc = ullName + ((note->n_namesz + ullAlign - 1) & ~(ullAlign - 1));
+            if (ullDesc + note->n_descsz > segment.m_ullFileSize)
+                break;
+
+            const unsigned char* pName = m_pData + segment.m_ullOffset + ullName;
+            if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 && memcmp(pName, "GNU", 4) == 0)
+            {
+                static const char* s_szDigits = "0123456789abcdef";
+                const unsigned char* pDesc = m_pData + segment.m_ullOffset + ullDesc;
+                std::string szBuildId;
+                for (unsigned int j=0; j < note->n_descsz; j++)
+                {
+                    szBuildId += s_szDigits[pDesc[j] >> 4];
+                    szBuildId += s_szDigits[pDesc[j] & 0xF];
+                }
+                return szBuildId;
+            }
+
+            ullPos = ullDesc + ((note->n_descsz + ullAlign - 1) & ~(ullAlign - 1));
+        }
+    }
+#endif
+    return std::string();
+}
+
+#ifndef _WIN32
+template<class Ehdr, class Phdr>
+bool CElfFile::ParseSegments()
+{
+    if (!IsValidRange(0, sizeof(Ehdr)))
+        return false;
+
+    Ehdr* file_hdr = (Ehdr *) m_pData;
+    if (file_hdr->e_phentsize != sizeof(Phdr) || !IsValidRange(file_hdr->e_phoff, (unsigned long long) file_hdr->e_phnum * sizeof(Phdr)))
+        return false;
+
+    Phdr* phdrs = (Phdr *) (m_pData + file_hdr->e_phoff);
+    unsigned long long ullStart = 0;
+    unsigned long long ullEnd = 0;
+    bool bFound = false;
+    for (unsigned int i=0; i < file_hdr->e_phnum; i++)
+    {
+        Phdr& phdr = phdrs[i];
+        if (phdr.p_type != PT_LOAD && phdr.p_type != PT_NOTE)
+            continue;
+
+        ElfSegment_t segment = {phdr.p_type, phdr.p_vaddr, phdr.p_memsz, phdr.p_offset, phdr.p_filesz, phdr.p_align};
+        m_Segments.push_back(segment);
+        if (phdr.p_type != PT_LOAD)
+            continue;
+
+        /* Find the first loadable segment */
+        if (!bFound)
+        {
+            ullStart = phdr.p_vaddr & ~0xFFFULL;
+            bFound = true;
+        }
+
+        if (phdr.p_vaddr + phdr.p_memsz > ullEnd)
+            ullEnd = phdr.p_vaddr + phdr.p_memsz;
+    }
+
+    // Addresses of 64 bit binaries might not fit into a 32 bit build
+    if (ullEnd > (unsigned long) -1)
+        return false;
+
+    m_ulLoadBase = (unsigned long) ullStart;
+    m_ulImageSize = (unsigned long) (ullEnd - ullStart);
+    return true;
+}
+
+template<class Ehdr, class Shdr, class Sym>
+bool CElfFile::ParseSymbols(SymbolCallback callback, void* pData)
+{
+    Ehdr* file_hdr = (Ehdr *) m_pData;
+    if (file_hdr->e_shoff == 0 || file_hdr->e_shentsize != sizeof(Shdr)
+            || !IsValidRange(file_hdr->e_shoff, (unsigned long long) file_hdr->e_shnum * sizeof(Shdr)))
+        return false;
+
+    Shdr* sections = (Shdr *) (m_pData + file_hdr->e_shoff);
+    unsigned int section_count = file_hdr->e_shnum;
+
+    /* Look for the static symbol table. Stripped binaries only have a dynamic one. */
+    Shdr* symtab_hdr = NULL;
+    for (unsigned int i=0; i < section_count; i++)
+    {
+        if (sections[i].sh_type == SHT_SYMTAB)
+        {
+            symtab_hdr = &sections[i];
+            break;
+        }
+
+        if (sections[i].sh_type == SHT_DYNSYM && symtab_hdr == NULL)
+            symtab_hdr = &sections[i];
+    }
+
+    /* Uh oh, we don't have a symbol table or a string table */
+    if (symtab_hdr == NULL || symtab_hdr->sh_link >= section_count || symtab_hdr->sh_entsize != sizeof(Sym))
+        return false;
+
+    Shdr* strtab_hdr = &sections[symtab_hdr->sh_link];
+    if (!IsValidRange(symtab_hdr->sh_offset, symtab_hdr->sh_size) || !IsValidRange(strtab_hdr->sh_offset, strtab_hdr->sh_size))
+        return false;
+
+    Sym* symtab = (Sym *) (m_pData + symtab_hdr->sh_offset);
+    const char* strtab = (const char *) (m_pData + strtab_hdr->sh_offset);
+    unsigned long long symbol_count = symtab_hdr->sh_size / sizeof(Sym);
+
+    for (unsigned long long i=0; i < symbol_count; i++)
+    {
+        Sym& sym = symtab[i];
+
+        // The type is stored in the same bits in both ELF classes
+        unsigned char sym_type = ELF32_ST_TYPE(sym.st_info);
+
+        /* Skip symbols that are undefined or do not refer to functions or objects */
+        if (sym.st_shndx == SHN_UNDEF || (sym_type != STT_FUNC && sym_type != STT_OBJECT))
+            continue;
+
+        if (sym.st_name >= strtab_hdr->sh_size || sym.st_value > (unsigned long) -1)
+            continue;
+
+        if (!callback(strtab + sym.st_name, (unsigned long) sym.st_value, (unsigned long) sym.st_size, pData))
+            break;
+    }
+    return true;
+}
+#endif
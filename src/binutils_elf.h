@@ -0,0 +1,115 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+
+#ifndef _BINUTILS_ELF_H
+#define _BINUTILS_ELF_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+/*
+    Called for every defined function or object symbol. Return false to stop
+    the iteration.
+*/
+typedef bool (*SymbolCallback)(const char* szName, unsigned long ulValue, unsigned long ulSize, void* pData);
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+// A loadable segment or a note segment (program header)
+struct ElfSegment_t
+{
+    unsigned int       m_uiType;
+    unsigned long long m_ullAddr;
+    unsigned long long m_ullMemSize;
+    unsigned long long m_ullOffset;
+    unsigned long long m_ullFileSize;
+    unsigned long long m_ullAlign;
+};
+
+/*
+    Read-only view of a 32 or 64 bit ELF file. The ELF class is taken from
+    e_ident[EI_CLASS], so one build can handle both kinds of binaries.
+*/
+class CElfFile
+{
+public:
+    CElfFile();
+    ~CElfFile();
+
+    // Maps the given file. Returns false if it's not a valid ELF file.
+    bool Open(const char* szPath);
+    void Close();
+
+    // Returns ELFCLASS32, ELFCLASS64 or ELFCLASSNONE if no file is open
+    int  GetClass() { return m_iClass; }
+
+    // Page of the first loadable segment
+    unsigned long GetLoadBase() { return m_ulLoadBase; }
+
+    // Number of bytes from the load base to the end of the last segment
+    unsigned long GetImageSize() { return m_ulImageSize; }
+
+    /*
+        Calls the callback for every defined function or object symbol. The
+        static symbol table is preferred over the dynamic one. Returns false
+        if the file doesn't have a symbol table.
+    */
+    bool ForEachSymbol(SymbolCallback callback, void* pData);
+
+    // Loadable and note segments in the order of the program headers
+    const std::vector<ElfSegment_t>& GetSegments() { return m_Segments; }
+
+    // Returns true if the given range lies within the mapped file
+    bool IsValidRange(unsigned long long ullOffset, unsigned long long ullSize);
+
+    /*
+        Returns the GNU build ID as a hex string or an empty string if the
+        binary doesn't have one.
+    */
+    std::string GetBuildId();
+
+private:
+    template<class Ehdr, class Phdr>
+    bool ParseSegments();
+
+    template<class Ehdr, class Shdr, class Sym>
+    bool ParseSymbols(SymbolCallback callback, void* pData);
+
+private:
+    unsigned char* m_pData;
+    size_t         m_iSize;
+    int            m_iClass;
+    unsigned long  m_ulLoadBase;
+    unsigned long  m_ulImageSize;
+    std::vector<ElfSegment_t> m_Segments;
+};
+
+#endif // _BINUTILS_ELF_H
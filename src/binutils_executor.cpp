@@ -0,0 +1,222 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include "binutils_executor.h"
+#include "binutils_thread.h"
+#include "binutils_trace.h"
+
+using namespace DynamicHooks;
+
+
+// ============================================================================
+// >> CTaskQueue
+// ============================================================================
+CTaskQueue::CTaskQueue()
+{
+    m_Stub.m_pNext = NULL;
+    m_pHead = &m_Stub;
+    m_pTail = &m_Stub;
+}
+
+void CTaskQueue::Push(Task_t* pTask)
+{
+    __atomic_store_n(&pTask->m_pNext, (Task_t *) NULL, __ATOMIC_RELAXED);
+
+    // The task becomes the new head. Until it's linked to its predecessor,
+    // Pop() can't get past the predecessor.
+    Task_t* pPrev = __atomic_exchange_n(&m_pHead, pTask, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&pPrev->m_pNext, pTask, __ATOMIC_RELEASE);
+}
+
+Task_t* CTaskQueue::Pop()
+{
+    Task_t* pTail = m_pTail;
+    Task_t* pNext = __atomic_load_n(&pTail->m_pNext, __ATOMIC_ACQUIRE);
+
+    // Skip the stub
+    if (pTail == &m_Stub)
+    {
+        if (!pNext)
+            return NULL;
+
+        m_pTail = pNext;
+        pTail = pNext;
+        pNext = __atomic_load_n(&pNext->m_pNext, __ATOMIC_ACQUIRE);
+    }
+
+    if (pNext)
+    {
+        m_pTail = pNext;
+        return pTail;
+    }
+
+    // A producer is about to link its task
+    if (pTail != __atomic_load_n(&m_pHead, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    // pTail is the last task. Push the stub, so it can be removed.
+    Push(&m_Stub);
+    pNext = __atomic_load_n(&pTail->m_pNext, __ATOMIC_ACQUIRE);
+    if (pNext)
+    {
+        m_pTail = pNext;
+        return pTail;
+    }
+
+    return NULL;
+}
+
+
+// ============================================================================
+// >> CExecutor
+// ============================================================================
+CExecutor::CExecutor()
+{
+    m_bDraining = false;
+    m_ulOwner = 0;
+    m_bCoalesce = false;
+    m_dBudget = 1000;
+
+    m_ulPosted = 0;
+    m_ulExecuted = 0;
+    m_ulCoalesced = 0;
+    m_ulDeferred = 0;
+    m_ulDrains = 0;
+}
+
+void CExecutor::Post(TaskFn pFunc, void* pArg, TaskFn pRelease /* = NULL */, void* pKey /* = NULL */)
+{
+    Task_t* pTask = new Task_t;
+    pTask->m_pFunc = pFunc;
+    pTask->m_pArg = pArg;
+    pTask->m_pRelease = pRelease;
+    pTask->m_pKeyFunc = pKey ? NULL : (void *) pFunc;
+    pTask->m_pKeyArg = pKey ? pKey : pArg;
+
+    __sync_add_and_fetch(&m_ulPosted, 1);
+    m_Queue.Push(pTask);
+}
+
+void CExecutor::Collect()
+{
+    Task_t* pTask;
+    while ((pTask = m_Queue.Pop()) != NULL)
+    {
+        if (m_bCoalesce)
+        {
+            TaskKey_t key(pTask->m_pKeyFunc, pTask->m_pKeyArg);
+            if (!m_PendingKeys.insert(key).second)
+            {
+                if (pTask->m_pRelease)
+                    pTask->m_pRelease(pTask->m_pArg);
+
+                delete pTask;
+                m_ulCoalesced++;
+                continue;
+            }
+        }
+
+        m_Pending.push_back(pTask);
+    }
+}
+
+int CExecutor::Drain(double dBudget)
+{
+    // Tasks expect to run on the main thread, e.g. if the safe point is
+    // also called by worker threads
+    unsigned long ulThread = GetThreadIdentifier();
+    if (!__sync_bool_compare_and_swap(&m_ulOwner, 0, ulThread) && m_ulOwner != ulThread)
+        return 0;
+
+    if (__sync_lock_test_and_set(&m_bDraining, true))
+        return 0;
+
+    // Tasks that are posted by the tasks of this drain run with the next one
+    Collect();
+
+    CTracer* pTracer = GetTracer();
+    double dStart = pTracer->Now();
+    int iExecuted = 0;
+    while (!m_Pending.empty())
+    {
+        if (iExecuted > 0 && dBudget > 0 && pTracer->Now() - dStart >= dBudget)
+        {
+            m_ulDeferred++;
+            break;
+        }
+
+        Task_t* pTask = m_Pending.front();
+        m_Pending.pop_front();
+        if (!m_PendingKeys.empty())
+            m_PendingKeys.erase(TaskKey_t(pTask->m_pKeyFunc, pTask->m_pKeyArg));
+
+        pTask->m_pFunc(pTask->m_pArg);
+        delete pTask;
+
+        iExecuted++;
+        m_ulExecuted++;
+    }
+
+    m_ulDrains++;
+    __sync_lock_release(&m_bDraining);
+    return iExecuted;
+}
+
+unsigned long CExecutor::GetPending()
+{
+    return m_ulPosted - m_ulExecuted - m_ulCoalesced;
+}
+
+ExecutorStats_t CExecutor::GetStats()
+{
+    ExecutorStats_t stats;
+    stats.m_ulPosted = m_ulPosted;
+    stats.m_ulExecuted = m_ulExecuted;
+    stats.m_ulCoalesced = m_ulCoalesced;
+    stats.m_ulDeferred = m_ulDeferred;
+    stats.m_ulDrains = m_ulDrains;
+    return stats;
+}
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+CExecutor* GetExecutor()
+{
+    static CExecutor* s_pExecutor = new CExecutor();
+    return s_pExecutor;
+}
+
+bool ExecutorPreHook(HookType_t /* eHookType */, CHook* /* pHook */)
+{
+    // Most frames have nothing to do
+    CExecutor* pExecutor = GetExecutor();
+    if (pExecutor->GetPending())
+        pExecutor->Drain(pExecutor->GetBudget());
+    return false;
+}
+
+extern "C" void binutils_RunOnMain(TaskFn pFunc, void* pArg)
+{
+    GetExecutor()->Post(pFunc, pArg);
+}
@@ -0,0 +1,183 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _BINUTILS_EXECUTOR_H
+#define _BINUTILS_EXECUTOR_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <deque>
+#include <set>
+#include <utility>
+
+#include "DynamicHooks.h"
+
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+typedef void (*TaskFn)(void* pArg);
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+struct Task_t
+{
+    Task_t* volatile m_pNext;
+
+    TaskFn m_pFunc;
+    void*  m_pArg;
+
+    // Called instead of m_pFunc if the task is dropped, so it can free its
+    // argument. Might be NULL.
+    TaskFn m_pRelease;
+
+    // Tasks with the same key are duplicates (see CExecutor::SetCoalesce)
+    void*  m_pKeyFunc;
+    void*  m_pKeyArg;
+};
+
+/*
+    Intrusive multi-producer single-consumer queue (Dmitry Vyukov's
+    algorithm). Push() is wait-free and can be called by any thread. Only a
+    single thread may call Pop() at the same time.
+*/
+class CTaskQueue
+{
+public:
+    CTaskQueue();
+
+    void    Push(Task_t* pTask);
+
+    // Returns NULL if the queue is empty or if a producer hasn't finished
+    // linking its task yet. That task is returned by a later call.
+    Task_t* Pop();
+
+private:
+    Task_t* volatile m_pHead;
+    Task_t*          m_pTail;
+    Task_t           m_Stub;
+};
+
+struct ExecutorStats_t
+{
+    unsigned long m_ulPosted;
+    unsigned long m_ulExecuted;
+    unsigned long m_ulCoalesced;
+
+    // Number of drains that stopped because the budget was exhausted
+    unsigned long m_ulDeferred;
+    unsigned long m_ulDrains;
+};
+
+/*
+    Runs tasks that have been posted by any thread on the thread that drains
+    the executor (usually the main thread at a safe point, see
+    ExecutorPreHook). Posting never blocks.
+
+    Drain() moves the queued tasks into a pending list and runs them in the
+    order they have been posted until the time budget is exhausted. The rest
+    stays pending for the next drain. If coalescing is enabled, a task is
+    dropped if a task with the same key is already pending.
+
+    This file doesn't depend on Python.
+*/
+class CExecutor
+{
+public:
+    CExecutor();
+
+    // Without a key the task is identified by its function and argument
+    void Post(TaskFn pFunc, void* pArg, TaskFn pRelease = NULL, void* pKey = NULL);
+
+    // Runs pending tasks for at most dBudget microseconds, but always at
+    // least one. A budget <= 0 runs all of them. Returns the number of tasks
+    // that have been executed. Does nothing if another thread is draining or
+    // if the calling thread isn't the owner.
+    int  Drain(double dBudget);
+
+    // Only the owner (usually the main thread) runs tasks. The first thread
+    // that drains becomes the owner if none has been set.
+    void          SetOwner(unsigned long ulThread) { m_ulOwner = ulThread; }
+    unsigned long GetOwner() { return m_ulOwner; }
+
+    // Budget of the drains done by ExecutorPreHook
+    void   SetBudget(double dBudget) { m_dBudget = dBudget; }
+    double GetBudget() { return m_dBudget; }
+
+    void SetCoalesce(bool bCoalesce) { m_bCoalesce = bCoalesce; }
+    bool GetCoalesce() { return m_bCoalesce; }
+
+    // Number of tasks that have been posted, but not executed or dropped yet
+    unsigned long GetPending();
+
+    ExecutorStats_t GetStats();
+
+private:
+    typedef std::pair<void*, void*> TaskKey_t;
+
+    // Moves the queued tasks into m_Pending
+    void Collect();
+
+private:
+    CTaskQueue m_Queue;
+
+    volatile bool   m_bDraining;
+
+    // Thread identifier of the owner or 0
+    volatile unsigned long m_ulOwner;
+    volatile bool   m_bCoalesce;
+    volatile double m_dBudget;
+
+    // Only accessed by the draining thread
+    std::deque<Task_t *>  m_Pending;
+    std::set<TaskKey_t>   m_PendingKeys;
+
+    volatile unsigned long m_ulPosted;
+    volatile unsigned long m_ulExecuted;
+    volatile unsigned long m_ulCoalesced;
+    volatile unsigned long m_ulDeferred;
+    volatile unsigned long m_ulDrains;
+};
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    Returns a pointer to a static CExecutor object.
+*/
+CExecutor* GetExecutor();
+
+/*
+    Native callback that drains the executor with its budget. Installed on a
+    frame function of the engine, so tasks run at a point where the main
+    thread doesn't hold any engine locks.
+*/
+bool ExecutorPreHook(DynamicHooks::HookType_t eHookType, DynamicHooks::CHook* pHook);
+
+/*
+    Posts a native task. Exported, so native code (e.g. other extensions)
+    can post tasks without calling Python.
+*/
+extern "C" void binutils_RunOnMain(TaskFn pFunc, void* pArg);
+
+#endif // _BINUTILS_EXECUTOR_H
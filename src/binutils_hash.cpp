@@ -0,0 +1,414 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <string.h>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+#include "binutils_hash.h"
+
+
+// ============================================================================
+// >> CONSTANTS
+// ============================================================================
+typedef unsigned int       u32;
+typedef unsigned long long u64;
+
+#define PRIME32_1 0x9E3779B1U
+#define PRIME32_2 0x85EBCA77U
+#define PRIME32_3 0xC2B2AE3DU
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define STRIPE_LEN          64
+#define SECRET_CONSUME_RATE 8
+#define SECRET_SIZE         192
+
+static const unsigned char DEFAULT_SECRET[SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+
+// ============================================================================
+// >> HELPER FUNCTIONS
+// ============================================================================
+// x86 is little endian and allows unaligned reads. memcpy() keeps the
+// compiler from assuming alignment.
+static inline u32 Read32(const unsigned char* p)
+{
+    u32 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline u64 Read64(const unsigned char* p)
+{
+    u64 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline u64 RotateLeft(u64 value, int iBits)
+{
+    return (value << iBits) | (value >> (64 - iBits));
+}
+
+static inline u64 Swap64(u64 value)
+{
+    return __builtin_bswap64(value);
+}
+
+// Multiplies two 64 bit values and folds the 128 bit product
+static inline u64 Mul128Fold64(u64 left, u64 right)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = (unsigned __int128) left * right;
+    return (u64) product ^ (u64) (product >> 64);
+#else
+    u64 lolo = (left & 0xFFFFFFFF) * (right & 0xFFFFFFFF);
+    u64 hilo = (left >> 32) * (right & 0xFFFFFFFF);
+    u64 lohi = (left & 0xFFFFFFFF) * (right >> 32);
+    u64 hihi = (left >> 32) * (right >> 32);
+    u64 cross = (lolo >> 32) + (hilo & 0xFFFFFFFF) + lohi;
+    u64 upper = (hilo >> 32) + (cross >> 32) + hihi;
+    u64 lower = (cross << 32) | (lolo & 0xFFFFFFFF);
+    return lower ^ upper;
+#endif
+}
+
+static inline u64 XXH64Avalanche(u64 h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline u64 XXH3Avalanche(u64 h)
+{
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline u64 XXH3StrongAvalanche(u64 h, u64 len)
+{
+    h ^= RotateLeft(h, 49) ^ RotateLeft(h, 24);
+    h *= 0x9FB21C651E98DF25ULL;
+    h ^= (h >> 35) + len;
+    h *= 0x9FB21C651E98DF25ULL;
+    h ^= h >> 28;
+    return h;
+}
+
+static inline u64 Mix16(const unsigned char* pInput, const unsigned char* pSecret)
+{
+    return Mul128Fold64(Read64(pInput) ^ Read64(pSecret), Read64(pInput + 8) ^ Read64(pSecret + 8));
+}
+
+
+// ============================================================================
+// >> XXH3 short inputs
+// ============================================================================
+static u64 XXH3_0to16(const unsigned char* p, size_t len)
+{
+    const unsigned char* s = DEFAULT_SECRET;
+    if (len > 8)
+    {
+        u64 lo = Read64(p) ^ (Read64(s + 24) ^ Read64(s + 32));
+        u64 hi = Read64(p + len - 8) ^ (Read64(s + 40) ^ Read64(s + 48));
+        return XXH3Avalanche(len + Swap64(lo) + hi + Mul128Fold64(lo, hi));
+    }
+
+    if (len >= 4)
+    {
+        u64 input = Read32(p + len - 4) + ((u64) Read32(p) << 32);
+        return XXH3StrongAvalanche(input ^ (Read64(s + 8) ^ Read64(s + 16)), len);
+    }
+
+    if (len > 0)
+    {
+        u32 combo = ((u32) p[0] << 16) | ((u32) p[len >> 1] << 24) | p[len - 1] | ((u32) len << 8);
+        return XXH64Avalanche(combo ^ (u64) (Read32(s) ^ Read32(s + 4)));
+    }
+
+    return XXH64Avalanche(Read64(s + 56) ^ Read64(s + 64));
+}
+
+static u64 XXH3_17to128(const unsigned char* p, size_t len)
+{
+    const unsigned char* s = DEFAULT_SECRET;
+    u64 acc = len * PRIME64_1;
+    if (len > 32)
+    {
+        if (len > 64)
+        {
+            if (len > 96)
+            {
+                acc += Mix16(p + 48, s + 96);
+                acc += Mix16(p + len - 64, s + 112);
+            }
+            acc += Mix16(p + 32, s + 64);
+            acc += Mix16(p + len - 48, s + 80);
+        }
+        acc += Mix16(p + 16, s + 32);
+        acc += Mix16(p + len - 32, s + 48);
+    }
+    acc += Mix16(p, s);
+    acc += Mix16(p + len - 16, s + 16);
+    return XXH3Avalanche(acc);
+}
+
+static u64 XXH3_129to240(const unsigned char* p, size_t len)
+{
+    const unsigned char* s = DEFAULT_SECRET;
+    u64 acc = len * PRIME64_1;
+    int iRounds = len / 16;
+    for (int i=0; i < 8; i++)
+        acc += Mix16(p + 16 * i, s + 16 * i);
+
+    acc = XXH3Avalanche(acc);
+    for (int i=8; i < iRounds; i++)
+        acc += Mix16(p + 16 * i, s + 16 * (i - 8) + 3);
+
+    acc += Mix16(p + len - 16, s + 136 - 17);
+    return XXH3Avalanche(acc);
+}
+
+
+// ============================================================================
+// >> XXH3 long inputs
+// ============================================================================
+static inline void Accumulate512(u64* acc, const unsigned char* pInput, const unsigned char* pSecret)
+{
+#ifdef __SSE2__
+    __m128i* xacc = (__m128i *) acc;
+    for (int i=0; i < STRIPE_LEN / 16; i++)
+    {
+        __m128i data = _mm_loadu_si128((const __m128i *) pInput + i);
+        __m128i key = _mm_loadu_si128((const __m128i *) pSecret + i);
+        __m128i dataKey = _mm_xor_si128(data, key);
+
+        // Multiplies the lower and upper 32 bits of every 64 bit lane
+        __m128i product = _mm_mul_epu32(dataKey, _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)));
+        __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        xacc[i] = _mm_add_epi64(product, _mm_add_epi64(xacc[i], swapped));
+    }
+#else
+    for (int i=0; i < 8; i++)
+    {
+        u64 data = Read64(pInput + 8 * i);
+        u64 dataKey = data ^ Read64(pSecret + 8 * i);
+        acc[i ^ 1] += data;
+        acc[i] += (dataKey & 0xFFFFFFFF) * (dataKey >> 32);
+    }
+#endif
+}
+
+static inline void ScrambleAcc(u64* acc, const unsigned char* pSecret)
+{
+#ifdef __SSE2__
+    __m128i* xacc = (__m128i *) acc;
+    const __m128i prime = _mm_set1_epi32((int) PRIME32_1);
+    for (int i=0; i < STRIPE_LEN / 16; i++)
+    {
+        __m128i value = _mm_xor_si128(xacc[i], _mm_srli_epi64(xacc[i], 47));
+        __m128i dataKey = _mm_xor_si128(value, _mm_loadu_si128((const __m128i *) pSecret + i));
+
+        // 64 bit multiplication by a 32 bit constant
+        __m128i productLo = _mm_mul_epu32(dataKey, prime);
+        __m128i productHi = _mm_mul_epu32(_mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        xacc[i] = _mm_add_epi64(productLo, _mm_slli_epi64(productHi, 32));
+    }
+#else
+    for (int i=0; i < 8; i++)
+    {
+        u64 value = acc[i] ^ (acc[i] >> 47);
+        acc[i] = (value ^ Read64(pSecret + 8 * i)) * PRIME32_1;
+    }
+#endif
+}
+
+static u64 XXH3_Long(const unsigned char* p, size_t len)
+{
+    const unsigned char* s = DEFAULT_SECRET;
+    u64 acc[8] __attribute__((aligned(16))) = {
+        PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+        PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+    };
+
+    const size_t iStripesPerBlock = (SECRET_SIZE - STRIPE_LEN) / SECRET_CONSUME_RATE;
+    const size_t iBlockLen = STRIPE_LEN * iStripesPerBlock;
+    size_t iBlocks = (len - 1) / iBlockLen;
+    for (size_t n=0; n < iBlocks; n++)
+    {
+        for (size_t i=0; i < iStripesPerBlock; i++)
+            Accumulate512(acc, p + n * iBlockLen + i * STRIPE_LEN, s + i * SECRET_CONSUME_RATE);
+
+        ScrambleAcc(acc, s + SECRET_SIZE - STRIPE_LEN);
+    }
+
+    // Last partial block and the last stripe, which might overlap it
+    size_t iStripes = ((len - 1) - iBlockLen * iBlocks) / STRIPE_LEN;
+    for (size_t i=0; i < iStripes; i++)
+        Accumulate512(acc, p + iBlocks * iBlockLen + i * STRIPE_LEN, s + i * SECRET_CONSUME_RATE);
+
+    Accumulate512(acc, p + len - STRIPE_LEN, s + SECRET_SIZE - STRIPE_LEN - 7);
+
+    // Merge the accumulators
+    u64 result = len * PRIME64_1;
+    for (int i=0; i < 4; i++)
+        result += Mul128Fold64(acc[2 * i] ^ Read64(s + 11 + 16 * i), acc[2 * i + 1] ^ Read64(s + 11 + 16 * i + 8));
+
+    return XXH3Avalanche(result);
+}
+
+
+// ============================================================================
+// >> XXH64
+// ============================================================================
+static inline u64 XXH64Round(u64 acc, u64 input)
+{
+    acc += input * PRIME64_2;
+    acc = RotateLeft(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline u64 XXH64MergeRound(u64 acc, u64 value)
+{
+    acc ^= XXH64Round(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+unsigned long long HashXXH3(const void* pData, unsigned long ulSize)
+{
+    const unsigned char* p = (const unsigned char *) pData;
+    if (ulSize <= 16)
+        return XXH3_0to16(p, ulSize);
+
+    if (ulSize <= 128)
+        return XXH3_17to128(p, ulSize);
+
+    if (ulSize <= 240)
+        return XXH3_129to240(p, ulSize);
+
+    return XXH3_Long(p, ulSize);
+}
+
+unsigned long long HashXXH64(const void* pData, unsigned long ulSize)
+{
+    const unsigned char* p = (const unsigned char *) pData;
+    const unsigned char* pEnd = p + ulSize;
+    u64 h;
+    if (ulSize >= 32)
+    {
+        // Four independent lanes
+        u64 v1 = PRIME64_1 + PRIME64_2;
+        u64 v2 = PRIME64_2;
+        u64 v3 = 0;
+        u64 v4 = 0 - PRIME64_1;
+        const unsigned char* pLimit = pEnd - 32;
+        do
+        {
+            v1 = XXH64Round(v1, Read64(p));
+            v2 = XXH64Round(v2, Read64(p + 8));
+            v3 = XXH64Round(v3, Read64(p + 16));
+            v4 = XXH64Round(v4, Read64(p + 24));
+            p += 32;
+        } while (p <= pLimit);
+
+        h = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+        h = XXH64MergeRound(h, v1);
+        h = XXH64MergeRound(h, v2);
+        h = XXH64MergeRound(h, v3);
+        h = XXH64MergeRound(h, v4);
+    }
+    else
+        h = PRIME64_5;
+
+    h += ulSize;
+    for (; p + 8 <= pEnd; p += 8)
+    {
+        h ^= XXH64Round(0, Read64(p));
+        h = RotateLeft(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+
+    if (p + 4 <= pEnd)
+    {
+        h ^= (u64) Read32(p) * PRIME64_1;
+        h = RotateLeft(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+
+    for (; p < pEnd; p++)
+    {
+        h ^= *p * PRIME64_5;
+        h = RotateLeft(h, 11) * PRIME64_1;
+    }
+
+    return XXH64Avalanche(h);
+}
+
+unsigned long long Hash(HashAlgorithm_t eAlgorithm, const void* pData, unsigned long ulSize)
+{
+    if (eAlgorithm == HASH_XXH64)
+        return HashXXH64(pData, ulSize);
+
+    return HashXXH3(pData, ulSize);
+}
+
+bool GetHashAlgorithm(const char* szName, HashAlgorithm_t& eAlgorithm)
+{
+    if (strcmp(szName, "xxh3") == 0)
+        eAlgorithm = HASH_XXH3;
+    else if (strcmp(szName, "xxh64") == 0)
+        eAlgorithm = HASH_XXH64;
+    else
+        return false;
+
+    return true;
+}
@@ -0,0 +1,56 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+#ifndef _BINUTILS_HASH_H
+#define _BINUTILS_HASH_H
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+enum HashAlgorithm_t
+{
+    HASH_XXH3,
+    HASH_XXH64
+};
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    64 bit XXH3 with the default secret and seed 0. Inputs larger than 240
+    bytes are processed in 64 byte stripes with SSE2 if it's available.
+    Results match the reference implementation.
+*/
+unsigned long long HashXXH3(const void* pData, unsigned long ulSize);
+
+/*
+    XXH64 with seed 0.
+*/
+unsigned long long HashXXH64(const void* pData, unsigned long ulSize);
+
+unsigned long long Hash(HashAlgorithm_t eAlgorithm, const void* pData, unsigned long ulSize);
+
+/*
+    Converts "xxh3" or "xxh64". Returns false if the name is unknown.
+*/
+bool GetHashAlgorithm(const char* szName, HashAlgorithm_t& eAlgorithm);
+
+#endif // _BINUTILS_HASH_H
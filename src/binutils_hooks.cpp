@@ -20,9 +20,13 @@
 // ============================================================================
 // >> INCLUDES
 // ============================================================================
+#include <string.h>
+#include <vector>
+
 #include "binutils_hooks.h"
 #include "binutils_tools.h"
 #include "binutils_macros.h"
+#include "binutils_trace.h"
 
 #include "boost/python.hpp"
 using namespace boost::python;
@@ -31,8 +35,7 @@ using namespace boost::python;
 // ============================================================================
 // >> GLOBAL VARIABLES
 // ============================================================================
-// g_mapCallbacks[<CHook *>][<HookType_t>] -> [<PyObject *>, <PyObject *>, ...]
-std::map<CHook *, std::map<DynamicHooks::HookType_t, std::list<PyObject *> > > g_mapCallbacks;
+std::map<CHook *, std::map<DynamicHooks::HookType_t, HookCallbackList> > g_mapCallbacks;
 
 
 // ============================================================================
@@ -52,16 +55,115 @@ object GetReturnValue(CHook* pHook)
 }
 
 template<class T>
-void SetArgument(CHook* pHook, int iIndex, object value)
+void SetArgument(void* pAddr, object value)
 {
-    T val = extract<T>(value);
-    pHook->SetArgument<T>(iIndex, val);
+    *(T *) pAddr = extract<T>(value);
 }
 
 template<class T>
-object GetArgument(CHook* pHook, int iIndex)
+object GetArgument(void* pAddr)
 {
-    return object(pHook->GetArgument<T>(iIndex));
+    return object(*(T *) pAddr);
+}
+
+
+// ============================================================================
+// >> CHookCallback
+// ============================================================================
+CHookCallback::CHookCallback(PyObject* pCallable, HookType_t eType)
+{
+    Py_INCREF(pCallable);
+    m_pCallable = pCallable;
+    m_pFunc = pCallable;
+    m_pSelf = NULL;
+    if (PyMethod_Check(pCallable) && PyMethod_GET_SELF(pCallable))
+    {
+        m_pFunc = PyMethod_GET_FUNCTION(pCallable);
+        m_pSelf = PyMethod_GET_SELF(pCallable);
+    }
+
+    m_iArgCount = (m_pSelf ? 1 : 0) + (eType == HOOKTYPE_POST ? 2 : 1);
+    m_pArgs = NewArgs();
+    m_bBusy = false;
+}
+
+CHookCallback::~CHookCallback()
+{
+    Py_XDECREF(m_pArgs);
+    Py_DECREF(m_pCallable);
+}
+
+PyObject* CHookCallback::NewArgs()
+{
+    PyObject* pArgs = PyTuple_New(m_iArgCount);
+    if (pArgs && m_pSelf)
+    {
+        Py_INCREF(m_pSelf);
+        PyTuple_SET_ITEM(pArgs, 0, m_pSelf);
+    }
+    return pArgs;
+}
+
+PyObject* CHookCallback::Call(PyObject* pStackData, PyObject* pRetVal /* = NULL */)
+{
+    // Use a new tuple if the shared one is in use or has been kept
+    bool bShared = m_pArgs && !m_bBusy && Py_REFCNT(m_pArgs) == 1;
+    PyObject* pArgs = bShared ? m_pArgs : NewArgs();
+    if (!pArgs)
+        return NULL;
+
+    int iFirst = m_pSelf ? 1 : 0;
+    Py_INCREF(pStackData);
+    PyTuple_SET_ITEM(pArgs, iFirst, pStackData);
+    if (iFirst + 1 < m_iArgCount)
+    {
+        PyObject* pValue = pRetVal ? pRetVal : Py_None;
+        Py_INCREF(pValue);
+        PyTuple_SET_ITEM(pArgs, iFirst + 1, pValue);
+    }
+
+    if (bShared)
+        m_bBusy = true;
+
+    PyObject* pResult = PyObject_Call(m_pFunc, pArgs, NULL);
+    if (!bShared)
+    {
+        Py_DECREF(pArgs);
+        return pResult;
+    }
+
+    m_bBusy = false;
+    if (Py_REFCNT(pArgs) == 1)
+    {
+        // Release the arguments, but keep the tuple
+        for (int i=iFirst; i < m_iArgCount; i++)
+        {
+            PyObject* pItem = PyTuple_GET_ITEM(pArgs, i);
+            PyTuple_SET_ITEM(pArgs, i, NULL);
+            Py_DECREF(pItem);
+        }
+    }
+    else
+    {
+        // The callback kept a reference, so the tuple can't be changed
+        Py_DECREF(pArgs);
+        m_pArgs = NewArgs();
+    }
+
+    return pResult;
+}
+
+bool CHookCallback::Matches(PyObject* pCallable)
+{
+    if (pCallable == m_pCallable)
+        return true;
+
+    // Bound methods are created whenever they are accessed
+    int iResult = PyObject_RichCompareBool(m_pCallable, pCallable, Py_EQ);
+    if (iResult < 0)
+        PyErr_Clear();
+
+    return iResult == 1;
 }
 
 
@@ -70,7 +172,11 @@ object GetArgument(CHook* pHook, int iIndex)
 // ============================================================================
 bool binutils_HookHandler(DynamicHooks::HookType_t eHookType, CHook* pHook)
 {
-    std::list<PyObject *> callbacks = g_mapCallbacks[pHook][eHookType];
+    // The hooked function might have been called by any thread
+    CAcquireGIL gil;
+
+    // Callbacks might unregister themselves, so iterate over a copy
+    HookCallbackList callbacks = g_mapCallbacks[pHook][eHookType];
 
     // No need to do all this stuff, if there is no callback registered
     if (callbacks.empty())
@@ -101,16 +207,13 @@ bool binutils_HookHandler(DynamicHooks::HookType_t eHookType, CHook* pHook)
         }
     }
     
-    CStackData stackdata = CStackData(pHook);
+    // All callbacks share the converted arguments
+    object stackdata = object(CStackData(pHook));
     bool bOverride = false;
-    for (std::list<PyObject *>::iterator it=callbacks.begin(); it != callbacks.end(); it++)
+    for (HookCallbackList::iterator it=callbacks.begin(); it != callbacks.end(); it++)
     {
         BEGIN_BOOST_PY()
-            object pyretval;
-            if (eHookType == HOOKTYPE_PRE)
-                pyretval = CALL_PY_FUNC(*it, stackdata);
-            else
-                pyretval = CALL_PY_FUNC(*it, stackdata, retval);
+            object pyretval = object(handle<>((*it)->Call(stackdata.ptr(), retval.ptr())));
 
             if (!pyretval.is_none())
             {
@@ -145,6 +248,68 @@ bool binutils_HookHandler(DynamicHooks::HookType_t eHookType, CHook* pHook)
     return bOverride;
 }
 
+void ClearPythonHooks()
+{
+    std::map<CHook *, std::map<DynamicHooks::HookType_t, HookCallbackList> >::iterator it;
+    for (it=g_mapCallbacks.begin(); it != g_mapCallbacks.end(); it++)
+    {
+        it->first->RemoveCallback(HOOKTYPE_PRE, (void *) &binutils_HookHandler);
+        it->first->RemoveCallback(HOOKTYPE_POST, (void *) &binutils_HookHandler);
+    }
+
+    // Running handlers keep their copy of the callbacks
+    g_mapCallbacks.clear();
+}
+
+
+// ============================================================================
+// >> Replay
+// ============================================================================
+tuple ReplayRecording(CArgRecording& recording, object callback, int iRepeat)
+{
+    std::vector<unsigned long long> slots;
+    if (!recording.Decode(slots))
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "The recording doesn't match its parameters.")
+
+    std::string szTypes = recording.GetTypes();
+    unsigned int iCount = szTypes.size();
+    unsigned int iCalls = recording.GetCallCount();
+
+    // Callbacks might change arguments, so every call gets a fresh copy
+    std::vector<unsigned long long> args(iCount ? iCount : 1);
+
+    CHookCallback resolved(callback.ptr(), HOOKTYPE_PRE);
+    unsigned long ulCalls = 0;
+    unsigned long ulErrors = 0;
+    double dStart = GetTracer()->Now();
+    for (int iRun=0; iRun < iRepeat; iRun++)
+    {
+        for (unsigned int i=0; i < iCalls; i++)
+        {
+            if (iCount)
+                memcpy(&args[0], &slots[i * iCount], iCount * sizeof(unsigned long long));
+
+            object stackdata = object(CStackData(szTypes.c_str(), &args[0]));
+            try
+            {
+                object(handle<>(resolved.Call(stackdata.ptr())));
+            }
+            catch (...)
+            {
+                if (!ulErrors)
+                    PyErr_Print();
+
+                PyErr_Clear();
+                ulErrors++;
+            }
+            ulCalls++;
+        }
+    }
+
+    double dSeconds = (GetTracer()->Now() - dStart) / 1000000.0;
+    return boost::python::make_tuple(ulCalls, dSeconds, ulErrors);
+}
+
 
 // ============================================================================
 // >> CStackData
@@ -152,11 +317,35 @@ bool binutils_HookHandler(DynamicHooks::HookType_t eHookType, CHook* pHook)
 CStackData::CStackData(CHook* pHook)
 {
     m_pHook = pHook;
+    m_szTypes = NULL;
+    m_pSlots = NULL;
+}
+
+CStackData::CStackData(const char* szTypes, unsigned long long* pSlots)
+{
+    m_pHook = NULL;
+    m_szTypes = szTypes;
+    m_pSlots = pSlots;
+}
+
+unsigned int CStackData::GetCount()
+{
+    return m_pHook ? m_pHook->GetArgumentCount() : strlen(m_szTypes);
+}
+
+char CStackData::GetType(unsigned int iIndex)
+{
+    return m_pHook ? m_pHook->GetArgument(iIndex)->m_cParam : m_szTypes[iIndex];
+}
+
+void* CStackData::GetAddress(unsigned int iIndex)
+{
+    return m_pHook ? m_pHook->GetArgumentAddress(iIndex) : &m_pSlots[iIndex];
 }
 
 object CStackData::GetItem(unsigned int iIndex)
 {
-    if (iIndex >= (unsigned int) m_pHook->GetArgumentCount())
+    if (iIndex >= GetCount())
         BOOST_RAISE_EXCEPTION(PyExc_IndexError, "Index out of range.")
 
     // Argument already cached?
@@ -164,23 +353,24 @@ object CStackData::GetItem(unsigned int iIndex)
     if (retval)
         return retval;
 
-    switch(m_pHook->GetArgument(iIndex)->m_cParam)
+    void* pAddr = GetAddress(iIndex);
+    switch(GetType(iIndex))
     {
-        case SIGCHAR_BOOL:      retval = GetArgument<bool>(m_pHook, iIndex); break;
-        case SIGCHAR_CHAR:      retval = GetArgument<char>(m_pHook, iIndex); break;
-        case SIGCHAR_UCHAR:     retval = GetArgument<unsigned char>(m_pHook, iIndex); break;
-        case SIGCHAR_SHORT:     retval = GetArgument<short>(m_pHook, iIndex); break;
-        case SIGCHAR_USHORT:    retval = GetArgument<unsigned short>(m_pHook, iIndex); break;
-        case SIGCHAR_INT:       retval = GetArgument<int>(m_pHook, iIndex); break;
-        case SIGCHAR_UINT:      retval = GetArgument<unsigned int>(m_pHook, iIndex); break;
-        case SIGCHAR_LONG:      retval = GetArgument<long>(m_pHook, iIndex); break;
-        case SIGCHAR_ULONG:     retval = GetArgument<unsigned long>(m_pHook, iIndex); break;
-        case SIGCHAR_LONGLONG:  retval = GetArgument<long long>(m_pHook, iIndex); break;
-        case SIGCHAR_ULONGLONG: retval = GetArgument<unsigned long long>(m_pHook, iIndex); break;
-        case SIGCHAR_FLOAT:     retval = GetArgument<float>(m_pHook, iIndex); break;
-        case SIGCHAR_DOUBLE:    retval = GetArgument<double>(m_pHook, iIndex); break;
-        case SIGCHAR_POINTER:   retval = object(CPointer(m_pHook->GetArgument<unsigned long>(iIndex))); break;
-        case SIGCHAR_STRING:    retval = GetArgument<const char *>(m_pHook, iIndex); break;
+        case SIGCHAR_BOOL:      retval = GetArgument<bool>(pAddr); break;
+        case SIGCHAR_CHAR:      retval = GetArgument<char>(pAddr); break;
+        case SIGCHAR_UCHAR:     retval = GetArgument<unsigned char>(pAddr); break;
+        case SIGCHAR_SHORT:     retval = GetArgument<short>(pAddr); break;
+        case SIGCHAR_USHORT:    retval = GetArgument<unsigned short>(pAddr); break;
+        case SIGCHAR_INT:       retval = GetArgument<int>(pAddr); break;
+        case SIGCHAR_UINT:      retval = GetArgument<unsigned int>(pAddr); break;
+        case SIGCHAR_LONG:      retval = GetArgument<long>(pAddr); break;
+        case SIGCHAR_ULONG:     retval = GetArgument<unsigned long>(pAddr); break;
+        case SIGCHAR_LONGLONG:  retval = GetArgument<long long>(pAddr); break;
+        case SIGCHAR_ULONGLONG: retval = GetArgument<unsigned long long>(pAddr); break;
+        case SIGCHAR_FLOAT:     retval = GetArgument<float>(pAddr); break;
+        case SIGCHAR_DOUBLE:    retval = GetArgument<double>(pAddr); break;
+        case SIGCHAR_POINTER:   retval = object(CPointer(*(unsigned long *) pAddr)); break;
+        case SIGCHAR_STRING:    retval = GetArgument<const char *>(pAddr); break;
         default: BOOST_RAISE_EXCEPTION(PyExc_TypeError, "Unknown type.") break;
     }
     m_mapCache[iIndex] = retval;
@@ -189,28 +379,29 @@ object CStackData::GetItem(unsigned int iIndex)
 
 void CStackData::SetItem(unsigned int iIndex, object value)
 {
-    if (iIndex >= (unsigned int) m_pHook->GetArgumentCount())
+    if (iIndex >= GetCount())
         BOOST_RAISE_EXCEPTION(PyExc_IndexError, "Index out of range.")
 
     // Update cache
     m_mapCache[iIndex] = value;
-    switch(m_pHook->GetArgument(iIndex)->m_cParam)
+    void* pAddr = GetAddress(iIndex);
+    switch(GetType(iIndex))
     {
-        case SIGCHAR_BOOL:      SetArgument<bool>(m_pHook, iIndex, value); break;
-        case SIGCHAR_CHAR:      SetArgument<char>(m_pHook, iIndex, value); break;
-        case SIGCHAR_UCHAR:     SetArgument<unsigned char>(m_pHook, iIndex, value); break;
-        case SIGCHAR_SHORT:     SetArgument<short>(m_pHook, iIndex, value); break;
-        case SIGCHAR_USHORT:    SetArgument<unsigned short>(m_pHook, iIndex, value); break;
-        case SIGCHAR_INT:       SetArgument<int>(m_pHook, iIndex, value); break;
-        case SIGCHAR_UINT:      SetArgument<unsigned int>(m_pHook, iIndex, value); break;
-        case SIGCHAR_LONG:      SetArgument<long>(m_pHook, iIndex, value); break;
-        case SIGCHAR_ULONG:     SetArgument<unsigned long>(m_pHook, iIndex, value); break;
-        case SIGCHAR_LONGLONG:  SetArgument<long long>(m_pHook, iIndex, value); break;
-        case SIGCHAR_ULONGLONG: SetArgument<unsigned long long>(m_pHook, iIndex, value); break;
-        case SIGCHAR_FLOAT:     SetArgument<float>(m_pHook, iIndex, value); break;
-        case SIGCHAR_DOUBLE:    SetArgument<double>(m_pHook, iIndex, value); break;
-        case SIGCHAR_POINTER:   SetArgument<unsigned long>(m_pHook, iIndex, object(ExtractPyPtr(value))); break;
-        case SIGCHAR_STRING:    SetArgument<const char *>(m_pHook, iIndex, value); break;
+        case SIGCHAR_BOOL:      SetArgument<bool>(pAddr, value); break;
+        case SIGCHAR_CHAR:      SetArgument<char>(pAddr, value); break;
+        case SIGCHAR_UCHAR:     SetArgument<unsigned char>(pAddr, value); break;
+        case SIGCHAR_SHORT:     SetArgument<short>(pAddr, value); break;
+        case SIGCHAR_USHORT:    SetArgument<unsigned short>(pAddr, value); break;
+        case SIGCHAR_INT:       SetArgument<int>(pAddr, value); break;
+        case SIGCHAR_UINT:      SetArgument<unsigned int>(pAddr, value); break;
+        case SIGCHAR_LONG:      SetArgument<long>(pAddr, value); break;
+        case SIGCHAR_ULONG:     SetArgument<unsigned long>(pAddr, value); break;
+        case SIGCHAR_LONGLONG:  SetArgument<long long>(pAddr, value); break;
+        case SIGCHAR_ULONGLONG: SetArgument<unsigned long long>(pAddr, value); break;
+        case SIGCHAR_FLOAT:     SetArgument<float>(pAddr, value); break;
+        case SIGCHAR_DOUBLE:    SetArgument<double>(pAddr, value); break;
+        case SIGCHAR_POINTER:   SetArgument<unsigned long>(pAddr, object(ExtractPyPtr(value))); break;
+        case SIGCHAR_STRING:    SetArgument<const char *>(pAddr, value); break;
         default: BOOST_RAISE_EXCEPTION(PyExc_TypeError, "Unknown type.")
     }
-}
\ No newline at end of file
+}
@@ -24,13 +24,16 @@
 // >> INCLUDES
 // ============================================================================
 #include <map>
+#include <vector>
 
 #include "DynamicHooks.h"
 using namespace DynamicHooks;
 
 #include "binutils_tools.h"
+#include "binutils_record.h"
 
 #include "boost/python.hpp"
+#include "boost/shared_ptr.hpp"
 using namespace boost::python;
 
 
@@ -42,18 +45,99 @@ class CStackData
 public:
     CStackData(CHook* pHook);
 
+    // Arguments of a recorded call. Every argument is stored in an 8 byte
+    // slot (see CArgRecording::Decode).
+    CStackData(const char* szTypes, unsigned long long* pSlots);
+
     object GetItem(unsigned int iIndex);
     void   SetItem(unsigned int iIndex, object value);
 
+private:
+    unsigned int GetCount();
+    char  GetType(unsigned int iIndex);
+    void* GetAddress(unsigned int iIndex);
+
 private:
     CHook*                m_pHook;
+    const char*           m_szTypes;
+    unsigned long long*   m_pSlots;
     std::map<int, object> m_mapCache;
 };
 
 
+/*
+    A Python callback of a hook. The callable is resolved when it's
+    registered: bound methods are split into their function and instance, so
+    calls don't have to create a bound method or look up attributes. The
+    argument tuple is reused by all calls unless the callback keeps a
+    reference to it or the callback is called recursively.
+
+    Holds a strong reference to the callable. The GIL must be held while an
+    instance is created or destroyed.
+*/
+class CHookCallback
+{
+public:
+    CHookCallback(PyObject* pCallable, HookType_t eType);
+    ~CHookCallback();
+
+    // Returns a new reference or NULL if an exception has been raised.
+    // pRetVal is only passed to post-hooks.
+    PyObject* Call(PyObject* pStackData, PyObject* pRetVal = NULL);
+
+    // True if the callable equals the registered one
+    bool Matches(PyObject* pCallable);
+
+    PyObject* GetCallable() { return m_pCallable; }
+
+private:
+    PyObject* NewArgs();
+
+    // Don't copy the references
+    CHookCallback(const CHookCallback&);
+    CHookCallback& operator=(const CHookCallback&);
+
+private:
+    // The registered callable
+    PyObject* m_pCallable;
+
+    // Borrowed from m_pCallable. m_pSelf is NULL if it's not a bound method.
+    PyObject* m_pFunc;
+    PyObject* m_pSelf;
+
+    PyObject* m_pArgs;
+    int       m_iArgCount;
+    bool      m_bBusy;
+};
+
+typedef boost::shared_ptr<CHookCallback> HookCallbackPtr;
+typedef std::vector<HookCallbackPtr> HookCallbackList;
+
+
+// ============================================================================
+// >> GLOBAL VARIABLES
+// ============================================================================
+// g_mapCallbacks[<CHook *>][<HookType_t>] -> [<HookCallbackPtr>, ...]
+// Only accessed while the GIL is held.
+extern std::map<CHook *, std::map<DynamicHooks::HookType_t, HookCallbackList> > g_mapCallbacks;
+
+
 // ============================================================================
 // >> FUNCTIONS
 // ============================================================================
 bool binutils_HookHandler(DynamicHooks::HookType_t eHookType, CHook* pHook);
 
+/*
+    Calls the callback like a pre-hook with every call of the recording
+    (iRepeat times) as fast as possible. Returns a tuple: (calls, seconds,
+    errors). Only the first exception is printed.
+*/
+tuple ReplayRecording(CArgRecording& recording, object callback, int iRepeat = 1);
+
+/*
+    Removes the Python callbacks of all hooks and releases them. The
+    functions stay hooked and native callbacks stay registered.
+*/
+void ClearPythonHooks();
+
 #endif // _BINUTILS_HOOKS_H
@@ -0,0 +1,265 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+    #include <link.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+#include "binutils_integrity.h"
+
+
+// ============================================================================
+// >> HELPER FUNCTIONS
+// ============================================================================
+#ifdef __linux__
+struct ModuleSearch_t
+{
+    const char*                 m_szFilter;
+    std::vector<MemoryRange_t>* m_pSegments;
+};
+
+static int ExecutableSegmentsCallback(struct dl_phdr_info* pInfo, size_t /* size */, void* pData)
+{
+    ModuleSearch_t* pSearch = (ModuleSearch_t *) pData;
+
+    // The name of the executable is an empty string
+    const char* szName = pInfo->dlpi_name ? pInfo->dlpi_name : "";
+    if (pSearch->m_szFilter && !strstr(szName, pSearch->m_szFilter))
+        return 0;
+
+    for (int i=0; i < pInfo->dlpi_phnum; i++)
+    {
+        const ElfW(Phdr)& header = pInfo->dlpi_phdr[i];
+        if (header.p_type == PT_LOAD && (header.p_flags & PF_X) && header.p_memsz)
+            pSearch->m_pSegments->push_back(MemoryRange_t(pInfo->dlpi_addr + header.p_vaddr, header.p_memsz));
+    }
+    return 0;
+}
+
+static int UnloadCountCallback(struct dl_phdr_info* pInfo, size_t size, void* pData)
+{
+    // dlpi_subs is the same for all modules and only available since glibc
+    // 2.4
+    if (size >= offsetof(struct dl_phdr_info, dlpi_subs) + sizeof(pInfo->dlpi_subs))
+        *(unsigned long long *) pData = pInfo->dlpi_subs;
+
+    return 1;
+}
+
+// Returns the number of modules that have been unloaded by this process
+static unsigned long long GetUnloadCount()
+{
+    unsigned long long ullSubs = 0;
+    dl_iterate_phdr(&UnloadCountCallback, &ullSubs);
+    return ullSubs;
+}
+
+// Returns true if all pages of the range are mapped
+static bool IsMapped(unsigned long ulAddr, unsigned long ulSize)
+{
+    static unsigned long s_ulPageSize = sysconf(_SC_PAGESIZE);
+    unsigned long ulPage = ulAddr & ~(s_ulPageSize - 1);
+    for (; ulPage < ulAddr + ulSize; ulPage += s_ulPageSize)
+    {
+        unsigned char ucResident;
+        if (mincore((void *) ulPage, s_ulPageSize, &ucResident) == -1 && errno == ENOMEM)
+            return false;
+    }
+    return true;
+}
+#endif
+
+// Appends a range or extends the last one if they are adjacent
+static void AppendRange(std::vector<MemoryRange_t>& ranges, unsigned long ulAddr, unsigned long ulSize)
+{
+    if (!ranges.empty() && ranges.back().first + ranges.back().second == ulAddr)
+        ranges.back().second += ulSize;
+    else
+        ranges.push_back(MemoryRange_t(ulAddr, ulSize));
+}
+
+
+// ============================================================================
+// >> CIntegrityMonitor
+// ============================================================================
+CIntegrityMonitor::CIntegrityMonitor(unsigned long ulBlockSize, HashAlgorithm_t eAlgorithm)
+{
+    m_ulBlockSize = ulBlockSize ? ulBlockSize : 4096;
+    m_eAlgorithm = eAlgorithm;
+    m_iNext = 0;
+    m_ullVerified = 0;
+    m_ullPasses = 0;
+#ifdef __linux__
+    m_ullUnloads = GetUnloadCount();
+#else
+    m_ullUnloads = 0;
+#endif
+}
+
+void CIntegrityMonitor::DropUnmappedBlocks()
+{
+#ifdef __linux__
+    // Nothing can have been unmapped by the loader if no module has been
+    // unloaded since the last check
+    unsigned long long ullUnloads = GetUnloadCount();
+    if (ullUnloads == m_ullUnloads)
+        return;
+
+    m_ullUnloads = ullUnloads;
+
+    size_t iKept = 0;
+    size_t iNext = 0;
+    for (size_t i=0; i < m_Blocks.size(); i++)
+    {
+        if (!IsMapped(m_Blocks[i].m_ulAddr, m_Blocks[i].m_ulSize))
+            continue;
+
+        if (i < m_iNext)
+            iNext++;
+
+        m_Blocks[iKept++] = m_Blocks[i];
+    }
+
+    m_Blocks.resize(iKept);
+    m_iNext = iNext < iKept ? iNext : 0;
+#endif
+}
+
+void CIntegrityMonitor::AddRange(unsigned long ulAddr, unsigned long ulSize)
+{
+    CMutexLock lock(m_Mutex);
+    unsigned long ulEnd = ulAddr + ulSize;
+    for (unsigned long ulBlock=ulAddr; ulBlock < ulEnd; ulBlock += m_ulBlockSize)
+    {
+        IntegrityBlock_t block;
+        block.m_ulAddr = ulBlock;
+        block.m_ulSize = ulEnd - ulBlock < m_ulBlockSize ? ulEnd - ulBlock : m_ulBlockSize;
+        block.m_ullBaseline = Hash(m_eAlgorithm, (void *) block.m_ulAddr, block.m_ulSize);
+        block.m_bModified = false;
+        m_Blocks.push_back(block);
+    }
+}
+
+int CIntegrityMonitor::AddModules(const char* szFilter)
+{
+    std::vector<MemoryRange_t> segments;
+#ifdef __linux__
+    ModuleSearch_t search = {szFilter, &segments};
+    dl_iterate_phdr(&ExecutableSegmentsCallback, &search);
+#endif
+
+    for (size_t i=0; i < segments.size(); i++)
+        AddRange(segments[i].first, segments[i].second);
+
+    return (int) segments.size();
+}
+
+void CIntegrityMonitor::Rebaseline(unsigned long ulAddr, unsigned long ulSize)
+{
+    CMutexLock lock(m_Mutex);
+    DropUnmappedBlocks();
+    for (size_t i=0; i < m_Blocks.size(); i++)
+    {
+        IntegrityBlock_t& block = m_Blocks[i];
+        if (ulSize && (block.m_ulAddr + block.m_ulSize <= ulAddr || block.m_ulAddr >= ulAddr + ulSize))
+            continue;
+
+        block.m_ullBaseline = Hash(m_eAlgorithm, (void *) block.m_ulAddr, block.m_ulSize);
+        block.m_bModified = false;
+    }
+}
+
+int CIntegrityMonitor::Step(int iBudget, std::vector<MemoryRange_t>& modified)
+{
+    CMutexLock lock(m_Mutex);
+    DropUnmappedBlocks();
+    if (m_Blocks.empty() || iBudget <= 0)
+        return 0;
+
+    // Don't verify a block twice
+    if ((size_t) iBudget > m_Blocks.size())
+        iBudget = m_Blocks.size();
+
+    int iVerified = 0;
+    for (; iVerified < iBudget; iVerified++)
+    {
+        IntegrityBlock_t& block = m_Blocks[m_iNext++];
+        if (m_iNext >= m_Blocks.size())
+        {
+            m_iNext = 0;
+            m_ullPasses++;
+        }
+
+        bool bModified = Hash(m_eAlgorithm, (void *) block.m_ulAddr, block.m_ulSize) != block.m_ullBaseline;
+
+        // Only report new modifications. Restored blocks are reported again
+        // if they are modified later.
+        if (bModified && !block.m_bModified)
+            AppendRange(modified, block.m_ulAddr, block.m_ulSize);
+
+        block.m_bModified = bModified;
+    }
+
+    m_ullVerified += iVerified;
+    return iVerified;
+}
+
+void CIntegrityMonitor::GetModified(std::vector<MemoryRange_t>& modified)
+{
+    CMutexLock lock(m_Mutex);
+    for (size_t i=0; i < m_Blocks.size(); i++)
+    {
+        if (m_Blocks[i].m_bModified)
+            AppendRange(modified, m_Blocks[i].m_ulAddr, m_Blocks[i].m_ulSize);
+    }
+}
+
+void CIntegrityMonitor::Clear()
+{
+    CMutexLock lock(m_Mutex);
+    m_Blocks.clear();
+    m_iNext = 0;
+}
+
+int CIntegrityMonitor::GetBlockCount()
+{
+    CMutexLock lock(m_Mutex);
+    return (int) m_Blocks.size();
+}
+
+unsigned long long CIntegrityMonitor::GetVerifiedBlocks()
+{
+    CMutexLock lock(m_Mutex);
+    return m_ullVerified;
+}
+
+unsigned long long CIntegrityMonitor::GetPasses()
+{
+    CMutexLock lock(m_Mutex);
+    return m_ullPasses;
+}
@@ -0,0 +1,123 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+#ifndef _BINUTILS_INTEGRITY_H
+#define _BINUTILS_INTEGRITY_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+#include "binutils_hash.h"
+#include "binutils_thread.h"
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+// (address, size)
+typedef std::pair<unsigned long, unsigned long> MemoryRange_t;
+
+struct IntegrityBlock_t
+{
+    unsigned long      m_ulAddr;
+    unsigned long      m_ulSize;
+    unsigned long long m_ullBaseline;
+
+    // True if the last verification didn't match the baseline
+    bool               m_bModified;
+};
+
+/*
+    Detects modifications of memory (e.g. code) of this process. Ranges are
+    split into blocks, which are hashed when they are added. Step() verifies
+    a limited number of blocks, so the whole memory is verified over several
+    calls (e.g. one per tick) without a noticeable delay.
+
+    Blocks of modules that have been unloaded are dropped before blocks are
+    hashed again. Other ranges must stay mapped while they are monitored.
+    All methods are thread-safe. This file doesn't depend on Python.
+*/
+class CIntegrityMonitor
+{
+public:
+    CIntegrityMonitor(unsigned long ulBlockSize = 4096, HashAlgorithm_t eAlgorithm = HASH_XXH3);
+
+    void AddRange(unsigned long ulAddr, unsigned long ulSize);
+
+    /*
+        Adds the executable segments of all loaded modules whose path
+        contains szFilter (or all modules if it's NULL). Returns the number of
+        added segments.
+    */
+    int  AddModules(const char* szFilter = NULL);
+
+    /*
+        Takes the current content of all blocks that overlap the given range
+        as their new baseline, e.g. after applying a patch. A size of 0
+        includes all blocks.
+    */
+    void Rebaseline(unsigned long ulAddr = 0, unsigned long ulSize = 0);
+
+    /*
+        Verifies the next iBudget blocks and appends the ranges of blocks that
+        haven't been modified before. Adjacent blocks are merged. Returns the
+        number of verified blocks.
+    */
+    int  Step(int iBudget, std::vector<MemoryRange_t>& modified);
+
+    // Returns the ranges of all blocks that were modified when they have
+    // been verified the last time
+    void GetModified(std::vector<MemoryRange_t>& modified);
+
+    void Clear();
+
+    int                GetBlockCount();
+    unsigned long      GetBlockSize() { return m_ulBlockSize; }
+    unsigned long long GetVerifiedBlocks();
+
+    // Number of times all blocks have been verified
+    unsigned long long GetPasses();
+
+private:
+    // Removes the blocks that aren't mapped anymore if a module has been
+    // unloaded since the last call
+    void DropUnmappedBlocks();
+
+private:
+    CMutex                        m_Mutex;
+    unsigned long                 m_ulBlockSize;
+    HashAlgorithm_t               m_eAlgorithm;
+    std::vector<IntegrityBlock_t> m_Blocks;
+
+    // Index of the next block to verify
+    size_t                        m_iNext;
+    unsigned long long            m_ullVerified;
+    unsigned long long            m_ullPasses;
+
+    // Number of unloaded modules when the blocks have been checked the last
+    // time
+    unsigned long long            m_ullUnloads;
+};
+
+#endif // _BINUTILS_INTEGRITY_H
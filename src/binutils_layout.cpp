@@ -0,0 +1,526 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
+
+#include "DynamicHooks.h"
+#include "binutils_layout.h"
+
+
+// ============================================================================
+// >> NATIVE TYPES
+// ============================================================================
+struct NativeType_t
+{
+    const char*   m_szName;
+    char          m_cType;
+    unsigned long m_ulSize;
+};
+
+static const NativeType_t s_NativeTypes[] = {
+    {"bool",       SIGCHAR_BOOL,      sizeof(bool)},
+    {"char",       SIGCHAR_CHAR,      sizeof(char)},
+    {"uchar",      SIGCHAR_UCHAR,     sizeof(unsigned char)},
+    {"short",      SIGCHAR_SHORT,     sizeof(short)},
+    {"ushort",     SIGCHAR_USHORT,    sizeof(unsigned short)},
+    {"int",        SIGCHAR_INT,       sizeof(int)},
+    {"uint",       SIGCHAR_UINT,      sizeof(unsigned int)},
+    {"long",       SIGCHAR_LONG,      sizeof(long)},
+    {"ulong",      SIGCHAR_ULONG,     sizeof(unsigned long)},
+    {"long_long",  SIGCHAR_LONGLONG,  sizeof(long long)},
+    {"ulong_long", SIGCHAR_ULONGLONG, sizeof(unsigned long long)},
+    {"float",      SIGCHAR_FLOAT,     sizeof(float)},
+    {"double",     SIGCHAR_DOUBLE,    sizeof(double)},
+    {"ptr",        SIGCHAR_POINTER,   sizeof(void *)},
+    {"string",     SIGCHAR_STRING,    sizeof(char *)}
+};
+
+bool GetNativeType(const char* szName, char& cType, unsigned long& ulSize)
+{
+    for (size_t i=0; i < sizeof(s_NativeTypes) / sizeof(NativeType_t); i++)
+    {
+        if (strcmp(s_NativeTypes[i].m_szName, szName) == 0)
+        {
+            cType = s_NativeTypes[i].m_cType;
+            ulSize = s_NativeTypes[i].m_ulSize;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* GetNativeTypeName(char cType)
+{
+    for (size_t i=0; i < sizeof(s_NativeTypes) / sizeof(NativeType_t); i++)
+    {
+        if (s_NativeTypes[i].m_cType == cType)
+            return s_NativeTypes[i].m_szName;
+    }
+    return NULL;
+}
+
+
+// ============================================================================
+// >> CLayout
+// ============================================================================
+bool LayoutField_t::IsPointer() const
+{
+    return m_cType == SIGCHAR_POINTER || m_cType == SIGCHAR_STRING;
+}
+
+CLayout::CLayout(unsigned long ulSize /* = 0 */)
+{
+    m_ulSize = ulSize;
+    m_ulFieldsEnd = 0;
+    m_bCompiled = false;
+}
+
+void CLayout::AddField(const LayoutField_t& field)
+{
+    m_Fields.push_back(field);
+    m_ulFieldsEnd = std::max(m_ulFieldsEnd, field.m_ulOffset + field.m_ulSize);
+    m_bCompiled = false;
+}
+
+bool CLayout::AddField(const std::string& szName, unsigned long ulOffset, const char* szType, int iCount /* = 1 */)
+{
+    LayoutField_t field;
+    unsigned long ulSize;
+    if (!GetNativeType(szType, field.m_cType, ulSize))
+        return false;
+
+    field.m_szName = szName;
+    field.m_ulOffset = ulOffset;
+    field.m_ulSize = ulSize * iCount;
+    field.m_iCount = iCount;
+    AddField(field);
+    return true;
+}
+
+void CLayout::AddPointer(const std::string& szName, unsigned long ulOffset, LayoutPtr pPointee)
+{
+    LayoutField_t field;
+    field.m_szName = szName;
+    field.m_ulOffset = ulOffset;
+    field.m_ulSize = sizeof(void *);
+    field.m_cType = SIGCHAR_POINTER;
+    field.m_iCount = 1;
+    field.m_pPointee = pPointee;
+    AddField(field);
+}
+
+void CLayout::AddLayout(const std::string& szName, unsigned long ulOffset, CLayout* pLayout, int iCount /* = 1 */)
+{
+    // Copy the fields first, because pLayout might be this layout
+    std::vector<LayoutField_t> fields = pLayout->m_Fields;
+    unsigned long ulSize = pLayout->GetSize();
+
+    for (int i=0; i < iCount; i++)
+    {
+        std::string szPrefix = szName;
+        if (iCount != 1)
+        {
+            char szIndex[16];
+            sprintf(szIndex, "[%d]", i);
+            szPrefix += szIndex;
+        }
+
+        for (size_t j=0; j < fields.size(); j++)
+        {
+            LayoutField_t field = fields[j];
+            field.m_szName = szPrefix + "." + field.m_szName;
+            field.m_ulOffset += ulOffset + i * ulSize;
+            AddField(field);
+        }
+    }
+}
+
+const LayoutField_t* CLayout::FindField(const std::string& szName)
+{
+    for (size_t i=0; i < m_Fields.size(); i++)
+    {
+        if (m_Fields[i].m_szName == szName)
+            return &m_Fields[i];
+    }
+    return NULL;
+}
+
+unsigned long CLayout::GetSize()
+{
+    // Never return less than the fields need, because objects are copied
+    // into buffers of this size
+    return std::max(m_ulSize, m_ulFieldsEnd);
+}
+
+const std::vector<std::pair<unsigned long, unsigned long> >& CLayout::GetRanges()
+{
+    if (m_bCompiled)
+        return m_Ranges;
+
+    std::vector<std::pair<unsigned long, unsigned long> > fields;
+    for (size_t i=0; i < m_Fields.size(); i++)
+    {
+        if (!m_Fields[i].IsPointer() && m_Fields[i].m_ulSize)
+            fields.push_back(std::make_pair(m_Fields[i].m_ulOffset, m_Fields[i].m_ulSize));
+    }
+
+    // Merge overlapping and adjacent fields, so restoring an object only
+    // requires a few copies
+    std::sort(fields.begin(), fields.end());
+    m_Ranges.clear();
+    for (size_t i=0; i < fields.size(); i++)
+    {
+        unsigned long ulEnd = fields[i].first + fields[i].second;
+        if (!m_Ranges.empty() && fields[i].first <= m_Ranges.back().first + m_Ranges.back().second)
+        {
+            std::pair<unsigned long, unsigned long>& range = m_Ranges.back();
+            range.second = std::max(range.first + range.second, ulEnd) - range.first;
+        }
+        else
+        {
+            m_Ranges.push_back(fields[i]);
+        }
+    }
+
+    m_bCompiled = true;
+    return m_Ranges;
+}
+
+
+// ============================================================================
+// >> HELPER FUNCTIONS
+// ============================================================================
+static bool ReadBytes(IMemoryBackend* pBackend, unsigned long ulAddr, void* pBuffer, unsigned long ulSize, std::string& szError)
+{
+    if (!pBackend)
+    {
+        memcpy(pBuffer, (void *) ulAddr, ulSize);
+        return true;
+    }
+
+    if (pBackend->Read(ulAddr, pBuffer, ulSize))
+        return true;
+
+    char szBuffer[64];
+    sprintf(szBuffer, "Unable to read %lu bytes at 0x%lx.", ulSize, ulAddr);
+    szError = szBuffer;
+    return false;
+}
+
+static bool WriteBytes(IMemoryBackend* pBackend, unsigned long ulAddr, const void* pBuffer, unsigned long ulSize, std::string& szError)
+{
+    if (!pBackend)
+    {
+        memcpy((void *) ulAddr, pBuffer, ulSize);
+        return true;
+    }
+
+    if (pBackend->Write(ulAddr, pBuffer, ulSize))
+        return true;
+
+    char szBuffer[64];
+    sprintf(szBuffer, "Unable to write %lu bytes at 0x%lx.", ulSize, ulAddr);
+    szError = szBuffer;
+    return false;
+}
+
+/*
+    Validates the header of a blob and returns pointers to its fixup table
+    and its objects.
+*/
+static bool ParseBlob(const char* pBlob, unsigned long ulBlobSize, LayoutBlobHeader_t& header,
+    std::vector<unsigned int>& fixups, const char*& pData, std::string& szError)
+{
+    if (ulBlobSize < sizeof(LayoutBlobHeader_t))
+    {
+        szError = "The blob is too small.";
+        return false;
+    }
+
+    memcpy(&header, pBlob, sizeof(LayoutBlobHeader_t));
+    if (memcmp(header.m_szMagic, LAYOUT_BLOB_MAGIC, 4) != 0 || header.m_uiVersion != LAYOUT_BLOB_VERSION)
+    {
+        szError = "The blob hasn't been created by serialize() or by another version.";
+        return false;
+    }
+
+    if (header.m_uiPointerSize != sizeof(void *))
+    {
+        szError = "The blob has been created on another architecture.";
+        return false;
+    }
+
+    unsigned long long ullFixupSize = (unsigned long long) header.m_uiFixups * sizeof(unsigned int);
+    if (sizeof(LayoutBlobHeader_t) + ullFixupSize + header.m_uiDataSize != ulBlobSize)
+    {
+        szError = "The blob is truncated.";
+        return false;
+    }
+
+    fixups.resize(header.m_uiFixups);
+    if (header.m_uiFixups)
+        memcpy(&fixups[0], pBlob + sizeof(LayoutBlobHeader_t), (size_t) ullFixupSize);
+
+    pData = pBlob + sizeof(LayoutBlobHeader_t) + ullFixupSize;
+
+    // All slots and the offsets they contain have to be within the objects
+    for (size_t i=0; i < fixups.size(); i++)
+    {
+        unsigned long ulTarget = ULONG_MAX;
+        if ((unsigned long long) fixups[i] + sizeof(unsigned long) <= header.m_uiDataSize)
+            memcpy(&ulTarget, pData + fixups[i], sizeof(unsigned long));
+
+        if (ulTarget >= header.m_uiDataSize)
+        {
+            szError = "The blob contains an invalid pointer.";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// ============================================================================
+// >> SERIALIZATION
+// ============================================================================
+struct PendingObject_t
+{
+    unsigned long m_ulAddr;
+    CLayout*      m_pLayout;
+    unsigned long m_ulOffset;
+    int           m_iDepth;
+};
+
+typedef std::map<std::pair<unsigned long, CLayout *>, unsigned long> ObjectMap;
+
+bool SerializeLayout(IMemoryBackend* pBackend, unsigned long ulAddr, CLayout* pLayout,
+    int iDepth, std::string& szBlob, std::string& szError)
+{
+    std::string szData;
+    std::vector<unsigned int> fixups;
+
+    // Objects are visited breadth-first, so every object is copied with the
+    // smallest depth it can be reached with
+    std::deque<PendingObject_t> pending;
+    ObjectMap objects;
+
+    if (!pLayout->GetSize())
+    {
+        szError = "The layout has no size.";
+        return false;
+    }
+
+    PendingObject_t root = {ulAddr, pLayout, 0, iDepth};
+    szData.resize(pLayout->GetSize());
+    if (!ReadBytes(pBackend, ulAddr, &szData[0], szData.size(), szError))
+        return false;
+
+    objects[std::make_pair(ulAddr, pLayout)] = 0;
+    pending.push_back(root);
+
+    unsigned int uiObjects = 1;
+    while (!pending.empty())
+    {
+        PendingObject_t object = pending.front();
+        pending.pop_front();
+
+        if (object.m_iDepth == 0)
+            continue;
+
+        for (size_t i=0; i < object.m_pLayout->m_Fields.size(); i++)
+        {
+            const LayoutField_t& field = object.m_pLayout->m_Fields[i];
+            if (!field.m_pPointee || !field.m_pPointee->GetSize())
+                continue;
+
+            for (int j=0; j < field.m_iCount; j++)
+            {
+                unsigned long ulSlot = object.m_ulOffset + field.m_ulOffset + j * sizeof(void *);
+                unsigned long ulTarget;
+                memcpy(&ulTarget, &szData[ulSlot], sizeof(unsigned long));
+                if (!ulTarget)
+                    continue;
+
+                CLayout* pPointee = field.m_pPointee.get();
+                std::pair<ObjectMap::iterator, bool> result = objects.insert(
+                    std::make_pair(std::make_pair(ulTarget, pPointee), 0UL));
+
+                if (result.second)
+                {
+                    unsigned long ulOffset = (szData.size() + LAYOUT_BLOB_ALIGN - 1) & ~(LAYOUT_BLOB_ALIGN - 1);
+                    unsigned long ulSize = pPointee->GetSize();
+                    if (ulOffset + ulSize > UINT_MAX)
+                    {
+                        szError = "The object graph is too large.";
+                        return false;
+                    }
+
+                    szData.resize(ulOffset + ulSize);
+                    if (!ReadBytes(pBackend, ulTarget, &szData[ulOffset], ulSize, szError))
+                        return false;
+
+                    result.first->second = ulOffset;
+                    PendingObject_t child = {ulTarget, pPointee, ulOffset, object.m_iDepth - 1};
+                    pending.push_back(child);
+                    uiObjects++;
+                }
+
+                memcpy(&szData[ulSlot], &result.first->second, sizeof(unsigned long));
+                fixups.push_back(ulSlot);
+            }
+        }
+    }
+
+    LayoutBlobHeader_t header;
+    memcpy(header.m_szMagic, LAYOUT_BLOB_MAGIC, 4);
+    header.m_uiVersion = LAYOUT_BLOB_VERSION;
+    header.m_uiPointerSize = sizeof(void *);
+    header.m_uiRootSize = pLayout->GetSize();
+    header.m_uiObjects = uiObjects;
+    header.m_uiFixups = fixups.size();
+    header.m_uiDataSize = szData.size();
+
+    szBlob.clear();
+    szBlob.reserve(sizeof(header) + fixups.size() * sizeof(unsigned int) + szData.size());
+    szBlob.append((const char *) &header, sizeof(header));
+    if (!fixups.empty())
+        szBlob.append((const char *) &fixups[0], fixups.size() * sizeof(unsigned int));
+
+    szBlob.append(szData);
+    return true;
+}
+
+int DeserializeLayout(IMemoryBackend* pBackend, unsigned long ulAddr, CLayout* pLayout,
+    const char* pBlob, unsigned long ulBlobSize, std::string& szError)
+{
+    LayoutBlobHeader_t header;
+    std::vector<unsigned int> fixups;
+    const char* pData;
+    if (!ParseBlob(pBlob, ulBlobSize, header, fixups, pData, szError))
+        return -1;
+
+    if (header.m_uiRootSize != pLayout->GetSize())
+    {
+        szError = "The blob has been created with another layout.";
+        return -1;
+    }
+
+    std::sort(fixups.begin(), fixups.end());
+
+    std::deque<PendingObject_t> pending;
+    std::set<std::pair<unsigned long, CLayout *> > restored;
+
+    PendingObject_t root = {ulAddr, pLayout, 0, -1};
+    pending.push_back(root);
+    restored.insert(std::make_pair(0UL, pLayout));
+
+    while (!pending.empty())
+    {
+        PendingObject_t object = pending.front();
+        pending.pop_front();
+
+        if (object.m_ulOffset + object.m_pLayout->GetSize() > header.m_uiDataSize)
+        {
+            szError = "The blob doesn't match the layout.";
+            return -1;
+        }
+
+        const std::vector<std::pair<unsigned long, unsigned long> >& ranges = object.m_pLayout->GetRanges();
+        for (size_t i=0; i < ranges.size(); i++)
+        {
+            if (!WriteBytes(pBackend, object.m_ulAddr + ranges[i].first,
+                    pData + object.m_ulOffset + ranges[i].first, ranges[i].second, szError))
+                return -1;
+        }
+
+        for (size_t i=0; i < object.m_pLayout->m_Fields.size(); i++)
+        {
+            const LayoutField_t& field = object.m_pLayout->m_Fields[i];
+            if (!field.m_pPointee || !field.m_pPointee->GetSize())
+                continue;
+
+            for (int j=0; j < field.m_iCount; j++)
+            {
+                unsigned long ulSlot = object.m_ulOffset + field.m_ulOffset + j * sizeof(void *);
+                if (!std::binary_search(fixups.begin(), fixups.end(), (unsigned int) ulSlot))
+                    continue;
+
+                unsigned long ulTarget;
+                memcpy(&ulTarget, pData + ulSlot, sizeof(unsigned long));
+                if (!restored.insert(std::make_pair(ulTarget, field.m_pPointee.get())).second)
+                    continue;
+
+                // The live object graph might have changed since the blob
+                // has been created
+                unsigned long ulLive;
+                if (!ReadBytes(pBackend, object.m_ulAddr + field.m_ulOffset + j * sizeof(void *),
+                        &ulLive, sizeof(unsigned long), szError))
+                    return -1;
+
+                if (!ulLive)
+                    continue;
+
+                PendingObject_t child = {ulLive, field.m_pPointee.get(), ulTarget, -1};
+                pending.push_back(child);
+            }
+        }
+    }
+
+    return restored.size();
+}
+
+void* LoadLayoutBlob(const char* pBlob, unsigned long ulBlobSize, std::string& szError)
+{
+    LayoutBlobHeader_t header;
+    std::vector<unsigned int> fixups;
+    const char* pData;
+    if (!ParseBlob(pBlob, ulBlobSize, header, fixups, pData, szError))
+        return NULL;
+
+    char* pBase = (char *) malloc(header.m_uiDataSize ? header.m_uiDataSize : 1);
+    if (!pBase)
+    {
+        szError = "Unable to allocate memory.";
+        return NULL;
+    }
+
+    memcpy(pBase, pData, header.m_uiDataSize);
+    for (size_t i=0; i < fixups.size(); i++)
+    {
+        unsigned long ulTarget;
+        memcpy(&ulTarget, pBase + fixups[i], sizeof(unsigned long));
+        ulTarget += (unsigned long) pBase;
+        memcpy(pBase + fixups[i], &ulTarget, sizeof(unsigned long));
+    }
+
+    return pBase;
+}
@@ -0,0 +1,185 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _BINUTILS_LAYOUT_H
+#define _BINUTILS_LAYOUT_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "boost/shared_ptr.hpp"
+
+#include "binutils_memory.h"
+
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+#define LAYOUT_BLOB_MAGIC   "BULB"
+
+// Increase this number if the structure of serialized blobs changes
+#define LAYOUT_BLOB_VERSION 1
+
+// Alignment of the objects in a serialized blob
+#define LAYOUT_BLOB_ALIGN   8
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+class CLayout;
+typedef boost::shared_ptr<CLayout> LayoutPtr;
+
+struct LayoutField_t
+{
+    std::string   m_szName;
+    unsigned long m_ulOffset;
+
+    // Size of the whole field (all elements)
+    unsigned long m_ulSize;
+
+    // Signature character of the elements (see SIGCHAR_*)
+    char          m_cType;
+    int           m_iCount;
+
+    // Layout of the objects the elements of a pointer field point to. Empty
+    // if the pointers shouldn't be followed.
+    LayoutPtr     m_pPointee;
+
+    bool IsPointer() const;
+};
+
+/*
+    Describes the fields of a native object: their offsets, types and the
+    objects that pointer fields point to. Layouts are usually compiled from
+    the attributes of a TypeManager type.
+
+    Pointer fields (including strings) are never written when a blob is
+    restored. They still point to the live objects, which are restored
+    instead. This file doesn't depend on Python.
+*/
+class CLayout
+{
+public:
+    CLayout(unsigned long ulSize = 0);
+
+    // Adds a field of a native type (see GetNativeType()). Returns false if
+    // the type is unknown.
+    bool AddField(const std::string& szName, unsigned long ulOffset, const char* szType, int iCount = 1);
+
+    // Adds a pointer field. The pointer is followed if pPointee isn't empty.
+    void AddPointer(const std::string& szName, unsigned long ulOffset, LayoutPtr pPointee);
+
+    // Adds the fields of another layout <iCount> times, e.g. for embedded
+    // structs. The field names are prefixed with "<szName>." or
+    // "<szName>[<index>].".
+    void AddLayout(const std::string& szName, unsigned long ulOffset, CLayout* pLayout, int iCount = 1);
+
+    // Returns NULL if there is no field with the given name
+    const LayoutField_t* FindField(const std::string& szName);
+
+    // Returns the declared size or the end of the last field if that is
+    // greater
+    unsigned long GetSize();
+    void          SetSize(unsigned long ulSize) { m_ulSize = ulSize; }
+
+    // Merged (offset, size) ranges of all fields that aren't pointers
+    const std::vector<std::pair<unsigned long, unsigned long> >& GetRanges();
+
+public:
+    std::vector<LayoutField_t> m_Fields;
+
+private:
+    void AddField(const LayoutField_t& field);
+
+private:
+    unsigned long m_ulSize;
+
+    // End of the field that ends last
+    unsigned long m_ulFieldsEnd;
+
+    // Compiled lazily, because fields might be added after a layout has
+    // been referenced by another one
+    bool m_bCompiled;
+    std::vector<std::pair<unsigned long, unsigned long> > m_Ranges;
+};
+
+/*
+    Header of a serialized blob. It's followed by the fixup table (offsets
+    of all followed pointer slots as unsigned ints) and the objects. The
+    first object is the root object. A pointer slot in the fixup table
+    contains the offset of the object it points to relative to the first
+    object. All other pointer slots keep their original value.
+*/
+struct LayoutBlobHeader_t
+{
+    char         m_szMagic[4];
+    unsigned int m_uiVersion;
+    unsigned int m_uiPointerSize;
+
+    // Size of the root object, so a blob isn't restored with another layout
+    unsigned int m_uiRootSize;
+
+    unsigned int m_uiObjects;
+    unsigned int m_uiFixups;
+    unsigned int m_uiDataSize;
+};
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    Returns the signature character and the size of a native type name of the
+    TypeManager (e.g. "int" or "ulong_long"). Returns false if the name is
+    unknown.
+*/
+bool GetNativeType(const char* szName, char& cType, unsigned long& ulSize);
+const char* GetNativeTypeName(char cType);
+
+/*
+    Copies the object at ulAddr and all objects that are reachable within
+    iDepth pointer fields (-1 means no limit) into szBlob. Every object is
+    only copied once, so cycles are fine. pBackend may be NULL to read the
+    memory of this process. Returns false and sets szError on failure.
+*/
+bool SerializeLayout(IMemoryBackend* pBackend, unsigned long ulAddr, CLayout* pLayout,
+    int iDepth, std::string& szBlob, std::string& szError);
+
+/*
+    Writes the non-pointer fields of all objects in the blob back to the live
+    objects, which are found by following the live pointers that correspond
+    to the followed pointers of the blob. Returns the number of restored
+    objects or -1 on failure.
+*/
+int DeserializeLayout(IMemoryBackend* pBackend, unsigned long ulAddr, CLayout* pLayout,
+    const char* pBlob, unsigned long ulBlobSize, std::string& szError);
+
+/*
+    Copies the objects of a blob into a new memory block (allocated with
+    malloc()) and turns the offsets of all followed pointers into addresses.
+    Returns NULL on failure.
+*/
+void* LoadLayoutBlob(const char* pBlob, unsigned long ulBlobSize, std::string& szError);
+
+#endif // _BINUTILS_LAYOUT_H
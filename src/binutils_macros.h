@@ -27,14 +27,6 @@
 using namespace boost::python;
 
 
-// ============================================================================
-// This macro allows us to call a Python function OR Python method. It decides
-// what we need to use.
-// boost::python::object retval = CALL_PY_FUNC(PyObject*, ...);
-// ============================================================================
-#define CALL_PY_FUNC(pCallable, ...) \
-    PyObject_HasAttrString(pCallable, "__self__") ? call_method<object>(PyObject_GetAttrString(pCallable, "__self__"), extract<const char*>(PyObject_GetAttrString(pCallable, "__name__")), ##__VA_ARGS__) : call<object>(pCallable, ##__VA_ARGS__)
-
 // ============================================================================
 // Surround boost python statements with this macro in order to handle
 // exceptions.
@@ -84,6 +76,21 @@ using namespace boost::python;
         throw_error_already_set(); \
     }
 
+// ============================================================================
+// Create an instance of this class before Python is accessed in code that
+// might be executed by a thread that doesn't hold the GIL (e.g. hook handlers
+// and callbacks). The GIL is released again when the instance is destroyed.
+// ============================================================================
+class CAcquireGIL
+{
+public:
+    CAcquireGIL() { m_State = PyGILState_Ensure(); }
+    ~CAcquireGIL() { PyGILState_Release(m_State); }
+
+private:
+    PyGILState_STATE m_State;
+};
+
 // ============================================================================
 // These typedefs save some typing. Use this policy for any functions that return
 // a newly allocated instance of a class which you need to delete yourself.
@@ -0,0 +1,224 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <map>
+#include <string.h>
+
+#include "binutils_memo.h"
+#include "utilities.h"
+
+using namespace DynamicHooks;
+
+
+// ============================================================================
+// >> GLOBAL VARIABLES
+// ============================================================================
+// Guards g_mapMemoCaches. The caches have their own locks.
+CMutex g_MemoMutex;
+std::map<CHook *, CMemoCache *> g_mapMemoCaches;
+
+
+// ============================================================================
+// >> CMemoCache
+// ============================================================================
+CMemoCache::CMemoCache(int iMaxEntries)
+{
+    m_iMaxEntries = iMaxEntries;
+    memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+bool CMemoCache::Lookup(const std::string& key, unsigned long long& ullRetReg)
+{
+    CMutexLock lock(m_Mutex);
+    EntryMap::iterator it = m_Index.find(key);
+    if (it == m_Index.end())
+    {
+        m_Stats.m_ulMisses++;
+        return false;
+    }
+
+    // Move the entry to the front
+    m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+    ullRetReg = it->second->second;
+    m_Stats.m_ulHits++;
+    return true;
+}
+
+void CMemoCache::Insert(const std::string& key, unsigned long long ullRetReg)
+{
+    CMutexLock lock(m_Mutex);
+    if (m_iMaxEntries <= 0)
+        return;
+
+    // Another thread might have inserted it in the meantime
+    EntryMap::iterator it = m_Index.find(key);
+    if (it != m_Index.end())
+    {
+        it->second->second = ullRetReg;
+        m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+        return;
+    }
+
+    Evict(m_iMaxEntries - 1);
+    m_Entries.push_front(std::make_pair(key, ullRetReg));
+    m_Index[key] = m_Entries.begin();
+}
+
+void CMemoCache::Invalidate()
+{
+    CMutexLock lock(m_Mutex);
+    m_Entries.clear();
+    m_Index.clear();
+    m_Stats.m_ulInvalidations++;
+}
+
+void CMemoCache::SetMaxEntries(int iMaxEntries)
+{
+    CMutexLock lock(m_Mutex);
+    m_iMaxEntries = iMaxEntries;
+    Evict(iMaxEntries);
+}
+
+int CMemoCache::GetMaxEntries()
+{
+    CMutexLock lock(m_Mutex);
+    return m_iMaxEntries;
+}
+
+int CMemoCache::GetSize()
+{
+    CMutexLock lock(m_Mutex);
+    return (int) m_Index.size();
+}
+
+MemoStats_t CMemoCache::GetStats()
+{
+    CMutexLock lock(m_Mutex);
+    return m_Stats;
+}
+
+void CMemoCache::Evict(int iMaxEntries)
+{
+    while ((int) m_Index.size() > iMaxEntries && !m_Entries.empty())
+    {
+        m_Index.erase(m_Entries.back().first);
+        m_Entries.pop_back();
+        m_Stats.m_ulEvictions++;
+    }
+}
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+void BuildMemoKey(CHook* pHook, std::string& key)
+{
+    key.clear();
+    int iCount = pHook->GetArgumentCount();
+    for (int i=0; i < iCount; i++)
+    {
+        Param_t* pParam = pHook->GetArgument(i);
+        if (pParam->m_cParam == SIGCHAR_STRING)
+        {
+            // Hash strings by content. A marker distinguishes NULL from "".
+            const char* szValue = pHook->GetArgument<const char *>(i);
+            if (!szValue)
+            {
+                key += '\0';
+                continue;
+            }
+
+            key += '\1';
+            key.append(szValue, strlen(szValue) + 1);
+        }
+        else
+        {
+            // Only the natural size of the type, so padding of stack slots
+            // and registers doesn't end up in the key
+            key.append((const char *) pHook->GetArgumentAddress(i), GetValueSize(pParam->m_cParam));
+        }
+    }
+}
+
+CMemoCache* GetMemoCache(CHook* pHook, bool bCreate)
+{
+    CMutexLock lock(g_MemoMutex);
+    std::map<CHook *, CMemoCache *>::iterator it = g_mapMemoCaches.find(pHook);
+    if (it != g_mapMemoCaches.end())
+        return it->second;
+
+    if (!bCreate)
+        return NULL;
+
+    CMemoCache* pCache = new CMemoCache(0);
+    g_mapMemoCaches[pHook] = pCache;
+    return pCache;
+}
+
+bool MemoPreHook(HookType_t /* eHookType */, CHook* pHook)
+{
+    CMemoCache* pCache = GetMemoCache(pHook);
+    if (!pCache)
+        return false;
+
+    // Another callback of this call uses the user data already, so the key
+    // can't be passed to the post-hook
+    HookFrame_t* pFrame = GetCurrentFrame();
+    if (pFrame->m_pUserData && pFrame->m_pUserDataOwner != (void *) &MemoPreHook)
+        return false;
+
+    std::string key;
+    BuildMemoKey(pHook, key);
+
+    unsigned long long ullRetReg;
+    if (pCache->Lookup(key, ullRetReg))
+    {
+        pHook->SetReturnValue<unsigned long long>(ullRetReg);
+        return true;
+    }
+
+    // The callee might overwrite its stack arguments, so the key is passed to
+    // the post-hook
+    delete (std::string *) pFrame->m_pUserData;
+    pFrame->m_pUserData = new std::string(key);
+    pFrame->m_pUserDataOwner = (void *) &MemoPreHook;
+    return false;
+}
+
+bool MemoPostHook(HookType_t /* eHookType */, CHook* pHook)
+{
+    HookFrame_t* pFrame = GetCurrentFrame();
+    if (!pFrame->m_pUserData || pFrame->m_pUserDataOwner != (void *) &MemoPreHook)
+        return false;
+
+    std::string* pKey = (std::string *) pFrame->m_pUserData;
+    pFrame->m_pUserData = NULL;
+    pFrame->m_pUserDataOwner = NULL;
+
+    // Don't cache return values of other callbacks
+    CMemoCache* pCache = GetMemoCache(pHook);
+    if (pCache && !pFrame->m_bOverridden)
+        pCache->Insert(*pKey, pHook->GetReturnValue<unsigned long long>());
+
+    delete pKey;
+    return false;
+}
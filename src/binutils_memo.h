@@ -0,0 +1,119 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _BINUTILS_MEMO_H
+#define _BINUTILS_MEMO_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <list>
+#include <string>
+#include <utility>
+
+#include "boost/unordered_map.hpp"
+
+#include "DynamicHooks.h"
+#include "binutils_thread.h"
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+struct MemoStats_t
+{
+    unsigned long m_ulHits;
+    unsigned long m_ulMisses;
+
+    // Entries that have been removed to make room for new ones
+    unsigned long m_ulEvictions;
+
+    // Number of calls of Invalidate()
+    unsigned long m_ulInvalidations;
+};
+
+/*
+    Bounded LRU cache that maps the arguments of a hooked function to its
+    return value. The key is built from the declared parameter types: strings
+    are stored by content, all other arguments by value. Returned pointers
+    are cached as they are, so only use it for pure functions.
+
+    All methods are thread-safe. This file doesn't depend on Python.
+*/
+class CMemoCache
+{
+public:
+    CMemoCache(int iMaxEntries);
+
+    // Returns true and stores the cached return value in ullRetReg if the
+    // key is cached
+    bool Lookup(const std::string& key, unsigned long long& ullRetReg);
+    void Insert(const std::string& key, unsigned long long ullRetReg);
+
+    // Removes all entries
+    void Invalidate();
+
+    // Evicts the least recently used entries if the cache is too large now
+    void SetMaxEntries(int iMaxEntries);
+    int  GetMaxEntries();
+
+    int  GetSize();
+    MemoStats_t GetStats();
+
+private:
+    void Evict(int iMaxEntries);
+
+private:
+    typedef std::list< std::pair<std::string, unsigned long long> > EntryList;
+    typedef boost::unordered_map<std::string, EntryList::iterator> EntryMap;
+
+    CMutex      m_Mutex;
+    int         m_iMaxEntries;
+
+    // Most recently used entries first
+    EntryList   m_Entries;
+    EntryMap    m_Index;
+    MemoStats_t m_Stats;
+};
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    Builds the cache key of the current call of the given hook.
+*/
+void BuildMemoKey(DynamicHooks::CHook* pHook, std::string& key);
+
+/*
+    Returns the cache of the given hook. If bCreate is true, a new cache is
+    created if there is none. Caches are never deleted, because a thread
+    might still use it while it's disabled.
+*/
+CMemoCache* GetMemoCache(DynamicHooks::CHook* pHook, bool bCreate = false);
+
+/*
+    Native callbacks of the cache. The pre-hook returns the cached value
+    without calling the original function. The post-hook stores the return
+    value, unless another pre-hook has overridden the call.
+*/
+bool MemoPreHook(DynamicHooks::HookType_t eHookType, DynamicHooks::CHook* pHook);
+bool MemoPostHook(DynamicHooks::HookType_t eHookType, DynamicHooks::CHook* pHook);
+
+#endif // _BINUTILS_MEMO_H
@@ -0,0 +1,99 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+#ifndef _BINUTILS_MEMORY_H
+#define _BINUTILS_MEMORY_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <string>
+#include <vector>
+
+#include "boost/shared_ptr.hpp"
+#include "boost/enable_shared_from_this.hpp"
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+struct Module_t
+{
+    std::string   m_szPath;
+    unsigned long m_ulBase;
+    unsigned long m_ulSize;
+};
+
+
+/*
+    A memory backend serves reads and writes of pointers that don't refer to
+    the memory of the current process (e.g. another process or a core dump).
+    Pointers without a backend access the memory directly.
+*/
+class IMemoryBackend: public boost::enable_shared_from_this<IMemoryBackend>
+{
+public:
+    virtual ~IMemoryBackend() {}
+
+    /*
+        Reads ulSize bytes at ulAddr into pBuffer. Returns false if at least
+        one byte couldn't be read.
+    */
+    virtual bool Read(unsigned long ulAddr, void* pBuffer, unsigned long ulSize) = 0;
+
+    /*
+        Writes ulSize bytes from pBuffer to ulAddr. Returns false if at least
+        one byte couldn't be written.
+    */
+    virtual bool Write(unsigned long ulAddr, const void* pBuffer, unsigned long ulSize) = 0;
+
+    /*
+        Returns a pointer to a local copy of the given range that stays valid
+        as long as the backend exists, or NULL if the backend can't provide
+        one.
+    */
+    virtual const void* GetDirect(unsigned long /* ulAddr */, unsigned long /* ulSize */) { return NULL; }
+
+    /*
+        Fills the given vector with all modules that are mapped into the
+        address space of the backend.
+    */
+    virtual void GetModules(std::vector<Module_t>& modules) = 0;
+
+    /*
+        Drops all cached data. Call this once per tick.
+    */
+    virtual void Invalidate() {}
+};
+
+typedef boost::shared_ptr<IMemoryBackend> BackendPtr;
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    Returns the backend that is used for pointers created from Python. An
+    empty pointer means the memory of the current process.
+*/
+BackendPtr GetDefaultBackend();
+void       SetDefaultBackend(BackendPtr pBackend);
+
+#endif // _BINUTILS_MEMORY_H
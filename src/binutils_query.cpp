@@ -0,0 +1,362 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+#include "DynamicHooks.h"
+#include "binutils_layout.h"
+#include "binutils_query.h"
+
+
+// ============================================================================
+// >> HELPER FUNCTIONS
+// ============================================================================
+template<class T>
+inline bool Compare(CompareOp_t eOp, T left, T right)
+{
+    switch(eOp)
+    {
+        case COMPARE_EQ: return left == right;
+        case COMPARE_NE: return left != right;
+        case COMPARE_LT: return left < right;
+        case COMPARE_LE: return left <= right;
+        case COMPARE_GT: return left > right;
+        case COMPARE_GE: return left >= right;
+    }
+    return false;
+}
+
+// Keeps the entries of the selection whose bit is set. The selection is
+// compacted in place, which is fine, because iKept never exceeds i.
+inline void KeepSelected(std::vector<unsigned int>& selection, size_t i, int iBits, size_t& iKept)
+{
+    for (int iLane=0; iLane < 4; iLane++)
+    {
+        if (iBits & (1 << iLane))
+            selection[iKept++] = selection[i + iLane];
+    }
+}
+
+template<class T>
+void GatherInt32(std::vector<int>& column, const std::vector<const char *>& objects,
+    const std::vector<unsigned int>& selection, unsigned long ulOffset)
+{
+    column.resize(selection.size());
+    for (size_t i=0; i < selection.size(); i++)
+        column[i] = *(const T *) (objects[selection[i]] + ulOffset);
+}
+
+size_t FilterInt32(const int* pColumn, CompareOp_t eOp, int iValue, std::vector<unsigned int>& selection)
+{
+    size_t iCount = selection.size();
+    size_t iKept = 0;
+    size_t i = 0;
+
+#ifdef __SSE2__
+    __m128i value = _mm_set1_epi32(iValue);
+    __m128i ones = _mm_set1_epi32(-1);
+    for (; i + 4 <= iCount; i += 4)
+    {
+        __m128i column = _mm_loadu_si128((const __m128i *) (pColumn + i));
+        __m128i result;
+        switch(eOp)
+        {
+            case COMPARE_EQ: result = _mm_cmpeq_epi32(column, value); break;
+            case COMPARE_NE: result = _mm_xor_si128(_mm_cmpeq_epi32(column, value), ones); break;
+            case COMPARE_LT: result = _mm_cmplt_epi32(column, value); break;
+            case COMPARE_GE: result = _mm_xor_si128(_mm_cmplt_epi32(column, value), ones); break;
+            case COMPARE_GT: result = _mm_cmpgt_epi32(column, value); break;
+            default:         result = _mm_xor_si128(_mm_cmpgt_epi32(column, value), ones); break;
+        }
+        KeepSelected(selection, i, _mm_movemask_ps(_mm_castsi128_ps(result)), iKept);
+    }
+#endif
+
+    for (; i < iCount; i++)
+    {
+        if (Compare(eOp, pColumn[i], iValue))
+            selection[iKept++] = selection[i];
+    }
+    return iKept;
+}
+
+size_t FilterFloat(const float* pColumn, CompareOp_t eOp, float fValue, std::vector<unsigned int>& selection)
+{
+    size_t iCount = selection.size();
+    size_t iKept = 0;
+    size_t i = 0;
+
+#ifdef __SSE2__
+    // Same results as the scalar comparisons, even for NaN
+    __m128 value = _mm_set1_ps(fValue);
+    for (; i + 4 <= iCount; i += 4)
+    {
+        __m128 column = _mm_loadu_ps(pColumn + i);
+        __m128 result;
+        switch(eOp)
+        {
+            case COMPARE_EQ: result = _mm_cmpeq_ps(column, value); break;
+            case COMPARE_NE: result = _mm_cmpneq_ps(column, value); break;
+            case COMPARE_LT: result = _mm_cmplt_ps(column, value); break;
+            case COMPARE_LE: result = _mm_cmple_ps(column, value); break;
+            case COMPARE_GT: result = _mm_cmpgt_ps(column, value); break;
+            default:         result = _mm_cmpge_ps(column, value); break;
+        }
+        KeepSelected(selection, i, _mm_movemask_ps(result), iKept);
+    }
+#endif
+
+    for (; i < iCount; i++)
+    {
+        if (Compare(eOp, pColumn[i], fValue))
+            selection[iKept++] = selection[i];
+    }
+    return iKept;
+}
+
+
+// ============================================================================
+// >> CQuery
+// ============================================================================
+bool CQuery::Run(IMemoryBackend* pBackend, std::vector<unsigned int>& matches, std::string& szError)
+{
+    size_t iCount = m_Addresses.size();
+    std::vector<const char *> objects(iCount);
+    std::vector<unsigned int> selection;
+    selection.reserve(iCount);
+
+    // Remote objects are copied once, so every predicate reads the copy
+    std::string buffer;
+    unsigned long ulExtent = GetPredicateExtent(m_Predicates);
+    if (pBackend && ulExtent)
+        buffer.resize(iCount * ulExtent);
+
+    for (size_t i=0; i < iCount; i++)
+    {
+        unsigned long ulAddr = m_Addresses[i];
+        if (!ulAddr)
+            continue;
+
+        if (pBackend && ulExtent)
+        {
+            if (!pBackend->Read(ulAddr, &buffer[i * ulExtent], ulExtent))
+            {
+                char szBuffer[64];
+                sprintf(szBuffer, "Unable to read the object at 0x%lx.", ulAddr);
+                szError = szBuffer;
+                return false;
+            }
+            objects[i] = &buffer[i * ulExtent];
+        }
+        else
+            objects[i] = (const char *) ulAddr;
+
+        selection.push_back(i);
+    }
+
+    for (size_t i=0; i < m_Predicates.size() && !selection.empty(); i++)
+        Filter(m_Predicates[i], objects, selection);
+
+    matches.swap(selection);
+    return true;
+}
+
+void CQuery::Filter(const FieldPredicate_t& predicate, const std::vector<const char *>& objects,
+    std::vector<unsigned int>& selection)
+{
+    size_t iCount = selection.size();
+    unsigned long ulOffset = predicate.m_ulOffset;
+    char cType = predicate.m_cType;
+
+    // Constants that don't fit into the column are compared one by one
+    ValueClass_t eClass = GetValueClass(cType);
+    bool bSmallInt = GetFieldTypeSize(cType) < sizeof(int) || cType == SIGCHAR_INT;
+    bool bIntColumn = bSmallInt && (eClass == VALUE_SIGNED
+        ? predicate.m_Value.m_llValue >= INT_MIN && predicate.m_Value.m_llValue <= INT_MAX
+        : predicate.m_Value.m_ullValue <= INT_MAX);
+
+    bool bUIntColumn = (cType == SIGCHAR_UINT || (cType == SIGCHAR_ULONG && sizeof(unsigned long) == 4))
+        && predicate.m_Value.m_ullValue <= UINT_MAX;
+
+    float fValue = (float) predicate.m_Value.m_dValue;
+    bool bFloatColumn = cType == SIGCHAR_FLOAT && (double) fValue == predicate.m_Value.m_dValue;
+
+    size_t iKept;
+    if (bIntColumn)
+    {
+        switch(cType)
+        {
+            case SIGCHAR_BOOL:   GatherInt32<bool>(m_IntColumn, objects, selection, ulOffset); break;
+            case SIGCHAR_CHAR:   GatherInt32<char>(m_IntColumn, objects, selection, ulOffset); break;
+            case SIGCHAR_UCHAR:  GatherInt32<unsigned char>(m_IntColumn, objects, selection, ulOffset); break;
+            case SIGCHAR_SHORT:  GatherInt32<short>(m_IntColumn, objects, selection, ulOffset); break;
+            case SIGCHAR_USHORT: GatherInt32<unsigned short>(m_IntColumn, objects, selection, ulOffset); break;
+            default:             GatherInt32<int>(m_IntColumn, objects, selection, ulOffset); break;
+        }
+
+        int iValue = (int) predicate.m_Value.m_llValue;
+        iKept = FilterInt32(&m_IntColumn[0], predicate.m_eOp, iValue, selection);
+    }
+    else if (bUIntColumn)
+    {
+        // Flipping the sign bit turns unsigned into signed comparisons
+        m_IntColumn.resize(iCount);
+        for (size_t i=0; i < iCount; i++)
+            m_IntColumn[i] = (int) (*(unsigned int *) (objects[selection[i]] + ulOffset) ^ 0x80000000u);
+
+        int iValue = (int) ((unsigned int) predicate.m_Value.m_ullValue ^ 0x80000000u);
+        iKept = FilterInt32(&m_IntColumn[0], predicate.m_eOp, iValue, selection);
+    }
+    else if (bFloatColumn)
+    {
+        m_FloatColumn.resize(iCount);
+        for (size_t i=0; i < iCount; i++)
+            m_FloatColumn[i] = *(float *) (objects[selection[i]] + ulOffset);
+
+        iKept = FilterFloat(&m_FloatColumn[0], predicate.m_eOp, fValue, selection);
+    }
+    else
+    {
+        iKept = 0;
+        for (size_t i=0; i < iCount; i++)
+        {
+            if (MatchPredicate(predicate, objects[selection[i]]))
+                selection[iKept++] = selection[i];
+        }
+    }
+
+    selection.resize(iKept);
+}
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+bool GetCompareOp(const char* szOp, CompareOp_t& eOp)
+{
+    static const struct { const char* m_szOp; CompareOp_t m_eOp; } s_Ops[] = {
+        {"==", COMPARE_EQ},
+        {"!=", COMPARE_NE},
+        {"<",  COMPARE_LT},
+        {"<=", COMPARE_LE},
+        {">",  COMPARE_GT},
+        {">=", COMPARE_GE}
+    };
+
+    for (size_t i=0; i < sizeof(s_Ops) / sizeof(s_Ops[0]); i++)
+    {
+        if (strcmp(s_Ops[i].m_szOp, szOp) == 0)
+        {
+            eOp = s_Ops[i].m_eOp;
+            return true;
+        }
+    }
+    return false;
+}
+
+ValueClass_t GetValueClass(char cType)
+{
+    switch(cType)
+    {
+        case SIGCHAR_CHAR:
+        case SIGCHAR_SHORT:
+        case SIGCHAR_INT:
+        case SIGCHAR_LONG:
+        case SIGCHAR_LONGLONG:  return VALUE_SIGNED;
+        case SIGCHAR_FLOAT:
+        case SIGCHAR_DOUBLE:    return VALUE_FLOAT;
+    }
+    return VALUE_UNSIGNED;
+}
+
+unsigned long GetFieldTypeSize(char cType)
+{
+    const char* szName = GetNativeTypeName(cType);
+    char cFound;
+    unsigned long ulSize;
+    if (!szName || !GetNativeType(szName, cFound, ulSize))
+        return 0;
+
+    return ulSize;
+}
+
+FieldValue_t ReadFieldValue(char cType, const void* pField)
+{
+    FieldValue_t value;
+    switch(cType)
+    {
+        case SIGCHAR_BOOL:      value.m_ullValue = *(bool *) pField; break;
+        case SIGCHAR_CHAR:      value.m_llValue = *(char *) pField; break;
+        case SIGCHAR_UCHAR:     value.m_ullValue = *(unsigned char *) pField; break;
+        case SIGCHAR_SHORT:     value.m_llValue = *(short *) pField; break;
+        case SIGCHAR_USHORT:    value.m_ullValue = *(unsigned short *) pField; break;
+        case SIGCHAR_INT:       value.m_llValue = *(int *) pField; break;
+        case SIGCHAR_UINT:      value.m_ullValue = *(unsigned int *) pField; break;
+        case SIGCHAR_LONG:      value.m_llValue = *(long *) pField; break;
+        case SIGCHAR_ULONG:     value.m_ullValue = *(unsigned long *) pField; break;
+        case SIGCHAR_LONGLONG:  value.m_llValue = *(long long *) pField; break;
+        case SIGCHAR_ULONGLONG: value.m_ullValue = *(unsigned long long *) pField; break;
+        case SIGCHAR_FLOAT:     value.m_dValue = *(float *) pField; break;
+        case SIGCHAR_DOUBLE:    value.m_dValue = *(double *) pField; break;
+        default:                value.m_ullValue = *(unsigned long *) pField; break;
+    }
+    return value;
+}
+
+bool MatchPredicate(const FieldPredicate_t& predicate, const char* pObject)
+{
+    FieldValue_t value = ReadFieldValue(predicate.m_cType, pObject + predicate.m_ulOffset);
+    switch(GetValueClass(predicate.m_cType))
+    {
+        case VALUE_SIGNED: return Compare(predicate.m_eOp, value.m_llValue, predicate.m_Value.m_llValue);
+        case VALUE_FLOAT:  return Compare(predicate.m_eOp, value.m_dValue, predicate.m_Value.m_dValue);
+        default:           return Compare(predicate.m_eOp, value.m_ullValue, predicate.m_Value.m_ullValue);
+    }
+}
+
+bool MatchPredicates(const std::vector<FieldPredicate_t>& predicates, const char* pObject)
+{
+    for (size_t i=0; i < predicates.size(); i++)
+    {
+        if (!MatchPredicate(predicates[i], pObject))
+            return false;
+    }
+    return true;
+}
+
+unsigned long GetPredicateExtent(const std::vector<FieldPredicate_t>& predicates)
+{
+    unsigned long ulExtent = 0;
+    for (size_t i=0; i < predicates.size(); i++)
+    {
+        unsigned long ulEnd = predicates[i].m_ulOffset + GetFieldTypeSize(predicates[i].m_cType);
+        if (ulEnd > ulExtent)
+            ulExtent = ulEnd;
+    }
+    return ulExtent;
+}
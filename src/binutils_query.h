@@ -0,0 +1,147 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _BINUTILS_QUERY_H
+#define _BINUTILS_QUERY_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <string>
+#include <vector>
+
+#include "binutils_layout.h"
+#include "binutils_memory.h"
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+enum CompareOp_t
+{
+    COMPARE_EQ,
+    COMPARE_NE,
+    COMPARE_LT,
+    COMPARE_LE,
+    COMPARE_GT,
+    COMPARE_GE
+};
+
+// Fields are compared in the class of their type
+enum ValueClass_t
+{
+    VALUE_SIGNED,
+    VALUE_UNSIGNED,
+    VALUE_FLOAT
+};
+
+union FieldValue_t
+{
+    long long          m_llValue;
+    unsigned long long m_ullValue;
+    double             m_dValue;
+};
+
+/*
+    Compares a field of native type (see SIGCHAR_*) with a constant, e.g.
+    "health > 0". Pointers and strings are compared by their address.
+*/
+struct FieldPredicate_t
+{
+    unsigned long m_ulOffset;
+    char          m_cType;
+    CompareOp_t   m_eOp;
+
+    // Converted to the class of the field type
+    FieldValue_t  m_Value;
+};
+
+/*
+    Filters a set of objects with predicates on their fields. Every
+    predicate is only tested on the objects that matched the previous ones.
+    Fields of types with up to 32 bits are gathered into a column first,
+    which is compared with SSE2 (setup.py passes -msse2). Without SSE2 the
+    columns are compared with a scalar loop. Other fields are compared one
+    by one. NULL addresses never match.
+*/
+class CQuery
+{
+public:
+    void SetAddresses(const std::vector<unsigned long>& addresses) { m_Addresses = addresses; }
+    const std::vector<unsigned long>& GetAddresses() { return m_Addresses; }
+
+    void AddPredicate(const FieldPredicate_t& predicate) { m_Predicates.push_back(predicate); }
+    const std::vector<FieldPredicate_t>& GetPredicates() { return m_Predicates; }
+
+    // Returns the indexes of all matching addresses. pBackend may be NULL to
+    // read the memory of this process. Returns false and sets szError if
+    // an object couldn't be read.
+    bool Run(IMemoryBackend* pBackend, std::vector<unsigned int>& matches, std::string& szError);
+
+public:
+    // Used to look up fields by name. Might be empty.
+    LayoutPtr  m_pLayout;
+
+    // Address space of the objects. Empty for this process.
+    BackendPtr m_pBackend;
+
+private:
+    // Removes the objects that don't match the predicate from the selection
+    void Filter(const FieldPredicate_t& predicate, const std::vector<const char *>& objects,
+        std::vector<unsigned int>& selection);
+
+private:
+    std::vector<unsigned long>    m_Addresses;
+    std::vector<FieldPredicate_t> m_Predicates;
+
+    // Reused by all runs
+    std::vector<int>              m_IntColumn;
+    std::vector<float>            m_FloatColumn;
+};
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    Parses "==", "!=", "<", "<=", ">" or ">=". Returns false if the operator
+    is unknown.
+*/
+bool GetCompareOp(const char* szOp, CompareOp_t& eOp);
+
+ValueClass_t  GetValueClass(char cType);
+
+// Returns 0 if the type is unknown
+unsigned long GetFieldTypeSize(char cType);
+
+/*
+    Reads a field and converts it to the class of its type. This file
+    doesn't depend on Python.
+*/
+FieldValue_t ReadFieldValue(char cType, const void* pField);
+
+bool MatchPredicate(const FieldPredicate_t& predicate, const char* pObject);
+
+// True if the object matches all predicates
+bool MatchPredicates(const std::vector<FieldPredicate_t>& predicates, const char* pObject);
+
+// Number of bytes of an object that have to be read to test the predicates
+unsigned long GetPredicateExtent(const std::vector<FieldPredicate_t>& predicates);
+
+#endif // _BINUTILS_QUERY_H
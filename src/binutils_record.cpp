@@ -0,0 +1,298 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <map>
+#include <stdio.h>
+#include <string.h>
+
+#include "binutils_record.h"
+#include "binutils_memo.h"
+#include "utilities.h"
+
+using namespace DynamicHooks;
+
+
+// ============================================================================
+// >> GLOBAL VARIABLES
+// ============================================================================
+// Guards g_mapArgRecorders. The recorders have their own locks.
+CMutex g_RecordMutex;
+std::map<CHook *, CArgRecorder *> g_mapArgRecorders;
+
+
+// ============================================================================
+// >> CArgRecording
+// ============================================================================
+void CArgRecording::SetParams(CHook* pHook)
+{
+    m_Params.clear();
+    int iCount = pHook->GetArgumentCount();
+    for (int i=0; i < iCount; i++)
+    {
+        // Same size as BuildMemoKey() uses. Zeroed, because it's written to
+        // files including its padding.
+        RecordedParam_t param;
+        memset(&param, 0, sizeof(param));
+        param.m_cParam = pHook->GetArgument(i)->m_cParam;
+        param.m_uiSize = GetValueSize(param.m_cParam);
+        m_Params.push_back(param);
+    }
+}
+
+bool CArgRecording::Save(const char* szPath, std::string& szError)
+{
+    FILE* pFile = fopen(szPath, "wb");
+    if (!pFile)
+    {
+        szError = "Unable to open the file.";
+        return false;
+    }
+
+    RecordingHeader_t header;
+    memcpy(header.m_szMagic, RECORDING_MAGIC, 4);
+    header.m_uiVersion = RECORDING_VERSION;
+    header.m_uiParams = m_Params.size();
+    header.m_uiCalls = m_Calls.size();
+
+    bool bResult = fwrite(&header, sizeof(header), 1, pFile) == 1;
+    for (size_t i=0; bResult && i < m_Params.size(); i++)
+        bResult = fwrite(&m_Params[i], sizeof(RecordedParam_t), 1, pFile) == 1;
+
+    for (size_t i=0; bResult && i < m_Calls.size(); i++)
+    {
+        unsigned int uiLength = m_Calls[i].size();
+        bResult = fwrite(&uiLength, sizeof(uiLength), 1, pFile) == 1 &&
+            fwrite(m_Calls[i].data(), 1, uiLength, pFile) == uiLength;
+    }
+
+    if (fclose(pFile) != 0 || !bResult)
+    {
+        szError = "Unable to write the file.";
+        return false;
+    }
+    return true;
+}
+
+bool CArgRecording::Load(const char* szPath, std::string& szError)
+{
+    m_Params.clear();
+    m_Calls.clear();
+
+    FILE* pFile = fopen(szPath, "rb");
+    if (!pFile)
+    {
+        szError = "Unable to open the file.";
+        return false;
+    }
+
+    RecordingHeader_t header;
+    bool bResult = fread(&header, sizeof(header), 1, pFile) == 1;
+    if (!bResult || memcmp(header.m_szMagic, RECORDING_MAGIC, 4) != 0 || header.m_uiVersion != RECORDING_VERSION)
+    {
+        fclose(pFile);
+        szError = "Not a recording or unsupported version.";
+        return false;
+    }
+
+    for (unsigned int i=0; bResult && i < header.m_uiParams; i++)
+    {
+        RecordedParam_t param;
+        bResult = fread(&param, sizeof(param), 1, pFile) == 1 && param.m_uiSize <= sizeof(unsigned long long);
+        m_Params.push_back(param);
+    }
+
+    std::string call;
+    for (unsigned int i=0; bResult && i < header.m_uiCalls; i++)
+    {
+        unsigned int uiLength;
+        bResult = fread(&uiLength, sizeof(uiLength), 1, pFile) == 1;
+        if (!bResult)
+            break;
+
+        call.resize(uiLength);
+        bResult = !uiLength || fread(&call[0], 1, uiLength, pFile) == uiLength;
+        m_Calls.push_back(call);
+    }
+
+    fclose(pFile);
+    if (!bResult)
+    {
+        m_Params.clear();
+        m_Calls.clear();
+        szError = "The recording is truncated or broken.";
+        return false;
+    }
+    return true;
+}
+
+std::string CArgRecording::GetTypes()
+{
+    std::string szTypes;
+    for (size_t i=0; i < m_Params.size(); i++)
+        szTypes += m_Params[i].m_cParam;
+
+    return szTypes;
+}
+
+bool CArgRecording::Decode(std::vector<unsigned long long>& slots)
+{
+    size_t iCount = m_Params.size();
+    slots.assign(m_Calls.size() * iCount, 0);
+    for (size_t i=0; i < m_Calls.size(); i++)
+    {
+        const std::string& call = m_Calls[i];
+        unsigned long long* pSlots = &slots[i * iCount];
+        size_t iPos = 0;
+        for (size_t j=0; j < iCount; j++)
+        {
+            if (m_Params[j].m_cParam == SIGCHAR_STRING)
+            {
+                // See BuildMemoKey: '\0' is NULL, '\1' is followed by the
+                // null-terminated content
+                if (iPos >= call.size())
+                    return false;
+
+                if (call[iPos++] == '\0')
+                    continue;
+
+                const char* szValue = call.data() + iPos;
+                const void* pEnd = memchr(szValue, '\0', call.size() - iPos);
+                if (!pEnd)
+                    return false;
+
+                *(const char **) &pSlots[j] = szValue;
+                iPos += (const char *) pEnd - szValue + 1;
+            }
+            else
+            {
+                if (iPos + m_Params[j].m_uiSize > call.size())
+                    return false;
+
+                memcpy(&pSlots[j], call.data() + iPos, m_Params[j].m_uiSize);
+                iPos += m_Params[j].m_uiSize;
+            }
+        }
+
+        if (iPos != call.size())
+            return false;
+    }
+    return true;
+}
+
+
+// ============================================================================
+// >> CArgRecorder
+// ============================================================================
+CArgRecorder::CArgRecorder()
+{
+    m_bEnabled = false;
+    m_iMaxCalls = 0;
+    m_ulDropped = 0;
+}
+
+void CArgRecorder::Start(CHook* pHook, int iMaxCalls)
+{
+    CMutexLock lock(m_Mutex);
+    m_Recording.SetParams(pHook);
+    m_Recording.m_Calls.clear();
+    m_iMaxCalls = iMaxCalls;
+    m_ulDropped = 0;
+    m_bEnabled = true;
+}
+
+void CArgRecorder::Stop()
+{
+    CMutexLock lock(m_Mutex);
+    m_bEnabled = false;
+}
+
+void CArgRecorder::Record(CHook* pHook)
+{
+    // Unlocked check, so disabled recorders don't slow down the hook
+    if (!m_bEnabled)
+        return;
+
+    std::string call;
+    BuildMemoKey(pHook, call);
+
+    CMutexLock lock(m_Mutex);
+    if (!m_bEnabled)
+        return;
+
+    if ((int) m_Recording.m_Calls.size() >= m_iMaxCalls)
+        m_ulDropped++;
+    else
+        m_Recording.m_Calls.push_back(call);
+}
+
+void CArgRecorder::GetRecording(CArgRecording& recording)
+{
+    CMutexLock lock(m_Mutex);
+    recording = m_Recording;
+}
+
+int CArgRecorder::GetCallCount()
+{
+    CMutexLock lock(m_Mutex);
+    return m_Recording.GetCallCount();
+}
+
+int CArgRecorder::GetMaxCalls()
+{
+    CMutexLock lock(m_Mutex);
+    return m_iMaxCalls;
+}
+
+unsigned long CArgRecorder::GetDropped()
+{
+    CMutexLock lock(m_Mutex);
+    return m_ulDropped;
+}
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+CArgRecorder* GetArgRecorder(CHook* pHook, bool bCreate)
+{
+    CMutexLock lock(g_RecordMutex);
+    std::map<CHook *, CArgRecorder *>::iterator it = g_mapArgRecorders.find(pHook);
+    if (it != g_mapArgRecorders.end())
+        return it->second;
+
+    if (!bCreate)
+        return NULL;
+
+    CArgRecorder* pRecorder = new CArgRecorder();
+    g_mapArgRecorders[pHook] = pRecorder;
+    return pRecorder;
+}
+
+bool RecordPreHook(HookType_t /* eHookType */, CHook* pHook)
+{
+    CArgRecorder* pRecorder = GetArgRecorder(pHook);
+    if (pRecorder)
+        pRecorder->Record(pHook);
+
+    return false;
+}
@@ -0,0 +1,147 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+#ifndef _BINUTILS_RECORD_H
+#define _BINUTILS_RECORD_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <string>
+#include <vector>
+
+#include "DynamicHooks.h"
+#include "binutils_thread.h"
+
+
+// ============================================================================
+// >> CONSTANTS
+// ============================================================================
+#define RECORDING_MAGIC   "BUAR"
+#define RECORDING_VERSION 2
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+struct RecordedParam_t
+{
+    char         m_cParam;
+
+    // Natural size of the argument (see GetValueSize()). Never larger than
+    // 8 bytes.
+    unsigned int m_uiSize;
+};
+
+/*
+    Arguments of recorded calls. Every call is stored like a cache key of
+    CMemoCache (see BuildMemoKey): strings by content, all other arguments by
+    value. The file consists of the header, the parameters and the calls.
+    Every call is prefixed by its length.
+
+    This file doesn't depend on Python.
+*/
+struct RecordingHeader_t
+{
+    char         m_szMagic[4];
+    unsigned int m_uiVersion;
+    unsigned int m_uiParams;
+    unsigned int m_uiCalls;
+};
+
+class CArgRecording
+{
+public:
+    // Takes the parameter types of the given hook
+    void SetParams(DynamicHooks::CHook* pHook);
+
+    bool Save(const char* szPath, std::string& szError);
+    bool Load(const char* szPath, std::string& szError);
+
+    int  GetArgumentCount() { return (int) m_Params.size(); }
+    int  GetCallCount() { return (int) m_Calls.size(); }
+
+    // Returns one character per argument, e.g. "ipZ"
+    std::string GetTypes();
+
+    /*
+        Decodes every call into 8 byte slots, one per argument. Strings are
+        stored as pointers into the recorded calls, so the slots are only
+        valid as long as the recording isn't changed. Returns false if a call
+        doesn't match the parameters.
+    */
+    bool Decode(std::vector<unsigned long long>& slots);
+
+public:
+    std::vector<RecordedParam_t> m_Params;
+    std::vector<std::string>     m_Calls;
+};
+
+/*
+    Records the arguments of every call of a hook until the maximum number of
+    calls has been reached. Further calls are only counted.
+
+    All methods are thread-safe.
+*/
+class CArgRecorder
+{
+public:
+    CArgRecorder();
+
+    // Removes all recorded calls and starts recording
+    void Start(DynamicHooks::CHook* pHook, int iMaxCalls);
+    void Stop();
+
+    bool IsEnabled() { return m_bEnabled; }
+
+    void Record(DynamicHooks::CHook* pHook);
+
+    // Copies the recorded calls
+    void GetRecording(CArgRecording& recording);
+
+    int  GetCallCount();
+    int  GetMaxCalls();
+    unsigned long GetDropped();
+
+private:
+    CMutex        m_Mutex;
+    bool          m_bEnabled;
+    int           m_iMaxCalls;
+    unsigned long m_ulDropped;
+    CArgRecording m_Recording;
+};
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    Returns the recorder of the given hook. If bCreate is true, a new
+    recorder is created if there is none. Recorders are never deleted,
+    because a thread might still use it while it's disabled.
+*/
+CArgRecorder* GetArgRecorder(DynamicHooks::CHook* pHook, bool bCreate = false);
+
+/*
+    Native pre-hook callback of the recorder.
+*/
+bool RecordPreHook(DynamicHooks::HookType_t eHookType, DynamicHooks::CHook* pHook);
+
+#endif // _BINUTILS_RECORD_H
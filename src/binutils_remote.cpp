@@ -0,0 +1,280 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef __linux__
+    #include <unistd.h>
+    #include <limits.h>
+    #include <sys/uio.h>
+#endif
+
+#include "binutils_remote.h"
+
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+// Maximum number of iovec structs per system call
+#ifndef IOV_MAX
+    #define IOV_MAX 1024
+#endif
+
+
+// ============================================================================
+// >> CRemoteProcess
+// ============================================================================
+CRemoteProcess::CRemoteProcess(int iPid)
+{
+    m_iPid = iPid;
+    m_bCacheEnabled = true;
+    m_ulHits = 0;
+    m_ulMisses = 0;
+    m_ulSysCalls = 0;
+#ifdef __linux__
+    m_ulPageSize = sysconf(_SC_PAGESIZE);
+#else
+    m_ulPageSize = 4096;
+#endif
+}
+
+CRemoteProcess::~CRemoteProcess()
+{
+    Invalidate();
+}
+
+void CRemoteProcess::Invalidate()
+{
+    for (std::map<unsigned long, unsigned char*>::iterator iter=m_Pages.begin(); iter != m_Pages.end(); iter++)
+        delete [] iter->second;
+
+    m_Pages.clear();
+}
+
+void CRemoteProcess::SetCacheEnabled(bool bEnabled)
+{
+    m_bCacheEnabled = bEnabled;
+    if (!bEnabled)
+        Invalidate();
+}
+
+bool CRemoteProcess::ReadRaw(unsigned long ulAddr, void* pBuffer, unsigned long ulSize)
+{
+#ifdef __linux__
+    struct iovec local = {pBuffer, ulSize};
+    struct iovec remote = {(void *) ulAddr, ulSize};
+    m_ulSysCalls++;
+    return process_vm_readv(m_iPid, &local, 1, &remote, 1, 0) == (ssize_t) ulSize;
+#else
+    return false;
+#endif
+}
+
+bool CRemoteProcess::FetchPages(const std::vector<unsigned long>& pages)
+{
+#ifdef __linux__
+    bool bResult = true;
+    size_t start = 0;
+    while (start < pages.size())
+    {
+        size_t count = pages.size() - start;
+        if (count > IOV_MAX)
+            count = IOV_MAX;
+
+        std::vector<struct iovec> local(count);
+        std::vector<struct iovec> remote(count);
+        for (size_t i=0; i < count; i++)
+        {
+            local[i].iov_base = new unsigned char[m_ulPageSize];
+            local[i].iov_len = m_ulPageSize;
+            remote[i].iov_base = (void *) pages[start + i];
+            remote[i].iov_len = m_ulPageSize;
+        }
+
+        m_ulSysCalls++;
+        ssize_t iRead = process_vm_readv(m_iPid, &local[0], count, &remote[0], count, 0);
+        size_t complete = iRead > 0 ? iRead / m_ulPageSize : 0;
+
+        for (size_t i=0; i < count; i++)
+        {
+            if (i < complete)
+                m_Pages[pages[start + i]] = (unsigned char *) local[i].iov_base;
+            else
+                delete [] (unsigned char *) local[i].iov_base;
+        }
+
+        // The read stops at the first page that is not mapped. Skip it and
+        // continue with the next one.
+        if (complete < count)
+        {
+            bResult = false;
+            complete++;
+        }
+
+        start += complete;
+    }
+    return bResult;
+#else
+    return false;
+#endif
+}
+
+bool CRemoteProcess::Prefetch(const std::vector<std::pair<unsigned long, unsigned long> >& ranges)
+{
+    std::vector<unsigned long> missing;
+    for (size_t i=0; i < ranges.size(); i++)
+    {
+        if (!ranges[i].second)
+            continue;
+
+        unsigned long ulFirst = ranges[i].first & ~(m_ulPageSize - 1);
+        unsigned long ulLast = (ranges[i].first + ranges[i].second - 1) & ~(m_ulPageSize - 1);
+        for (unsigned long ulPage=ulFirst; ulPage <= ulLast; ulPage += m_ulPageSize)
+        {
+            if (m_Pages.find(ulPage) == m_Pages.end())
+                missing.push_back(ulPage);
+        }
+    }
+
+    // Remove duplicates of overlapping ranges
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+    return FetchPages(missing);
+}
+
+bool CRemoteProcess::Read(unsigned long ulAddr, void* pBuffer, unsigned long ulSize)
+{
+    if (!ulSize)
+        return true;
+
+    if (!m_bCacheEnabled)
+        return ReadRaw(ulAddr, pBuffer, ulSize);
+
+    unsigned long ulFirst = ulAddr & ~(m_ulPageSize - 1);
+    unsigned long ulLast = (ulAddr + ulSize - 1) & ~(m_ulPageSize - 1);
+
+    // Fetch all missing pages with a single system call
+    std::vector<unsigned long> missing;
+    for (unsigned long ulPage=ulFirst; ulPage <= ulLast; ulPage += m_ulPageSize)
+    {
+        if (m_Pages.find(ulPage) == m_Pages.end())
+            missing.push_back(ulPage);
+    }
+
+    if (missing.empty())
+        m_ulHits++;
+    else
+    {
+        m_ulMisses++;
+        if (!FetchPages(missing))
+            return false;
+    }
+
+    unsigned char* pDest = (unsigned char *) pBuffer;
+    for (unsigned long ulPage=ulFirst; ulPage <= ulLast; ulPage += m_ulPageSize)
+    {
+        unsigned long ulStart = ulPage < ulAddr ? ulAddr - ulPage : 0;
+        unsigned long ulEnd = ulAddr + ulSize - ulPage;
+        if (ulEnd > m_ulPageSize)
+            ulEnd = m_ulPageSize;
+
+        memcpy(pDest, m_Pages[ulPage] + ulStart, ulEnd - ulStart);
+        pDest += ulEnd - ulStart;
+    }
+    return true;
+}
+
+bool CRemoteProcess::Write(unsigned long ulAddr, const void* pBuffer, unsigned long ulSize)
+{
+#ifdef __linux__
+    if (!ulSize)
+        return true;
+
+    struct iovec local = {(void *) pBuffer, ulSize};
+    struct iovec remote = {(void *) ulAddr, ulSize};
+    m_ulSysCalls++;
+    if (process_vm_writev(m_iPid, &local, 1, &remote, 1, 0) != (ssize_t) ulSize)
+        return false;
+
+    // Keep cached pages up to date
+    unsigned long ulFirst = ulAddr & ~(m_ulPageSize - 1);
+    unsigned long ulLast = (ulAddr + ulSize - 1) & ~(m_ulPageSize - 1);
+    const unsigned char* pSource = (const unsigned char *) pBuffer;
+    for (unsigned long ulPage=ulFirst; ulPage <= ulLast; ulPage += m_ulPageSize)
+    {
+        unsigned long ulStart = ulPage < ulAddr ? ulAddr - ulPage : 0;
+        unsigned long ulEnd = ulAddr + ulSize - ulPage;
+        if (ulEnd > m_ulPageSize)
+            ulEnd = m_ulPageSize;
+
+        std::map<unsigned long, unsigned char*>::iterator iter = m_Pages.find(ulPage);
+        if (iter != m_Pages.end())
+            memcpy(iter->second + ulStart, pSource, ulEnd - ulStart);
+
+        pSource += ulEnd - ulStart;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CRemoteProcess::GetModules(std::vector<Module_t>& modules)
+{
+    modules.clear();
+
+    char szMaps[64];
+    sprintf(szMaps, "/proc/%d/maps", m_iPid);
+    FILE* pFile = fopen(szMaps, "r");
+    if (!pFile)
+        return;
+
+    // Each line looks like this:
+    // 08048000-08056000 r-xp 00000000 03:0c 64593 /usr/sbin/gpm
+    char szLine[4096];
+    while (fgets(szLine, sizeof(szLine), pFile))
+    {
+        unsigned long ulStart, ulEnd;
+        char szPath[4096] = {0};
+        if (sscanf(szLine, "%lx-%lx %*s %*s %*s %*s %4095[^\n]", &ulStart, &ulEnd, szPath) != 3)
+            continue;
+
+        // Skip anonymous mappings and pseudo paths like [heap]
+        if (szPath[0] != '/')
+            continue;
+
+        // Mappings of the same file are contiguous
+        if (!modules.empty() && modules.back().m_szPath == szPath)
+        {
+            modules.back().m_ulSize = ulEnd - modules.back().m_ulBase;
+            continue;
+        }
+
+        Module_t module = {szPath, ulStart, ulEnd - ulStart};
+        modules.push_back(module);
+    }
+
+    fclose(pFile);
+}
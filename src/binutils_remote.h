@@ -0,0 +1,81 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+#ifndef _BINUTILS_REMOTE_H
+#define _BINUTILS_REMOTE_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <map>
+#include <vector>
+
+#include "binutils_memory.h"
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+/*
+    Serves reads and writes from/to another process via process_vm_readv()
+    and process_vm_writev(). Reads are cached page by page until Invalidate()
+    is called, so reading several attributes of an object only requires a
+    single system call.
+*/
+class CRemoteProcess: public IMemoryBackend
+{
+public:
+    CRemoteProcess(int iPid);
+    virtual ~CRemoteProcess();
+
+    virtual bool Read(unsigned long ulAddr, void* pBuffer, unsigned long ulSize);
+    virtual bool Write(unsigned long ulAddr, const void* pBuffer, unsigned long ulSize);
+    virtual void GetModules(std::vector<Module_t>& modules);
+    virtual void Invalidate();
+
+    /*
+        Reads all pages of the given ranges that are not cached yet with as
+        few system calls as possible. Returns false if a page couldn't be
+        read.
+    */
+    bool Prefetch(const std::vector<std::pair<unsigned long, unsigned long> >& ranges);
+
+    void SetCacheEnabled(bool bEnabled);
+    bool IsCacheEnabled() { return m_bCacheEnabled; }
+
+public:
+    int           m_iPid;
+
+    // Statistics
+    unsigned long m_ulHits;
+    unsigned long m_ulMisses;
+    unsigned long m_ulSysCalls;
+
+private:
+    bool ReadRaw(unsigned long ulAddr, void* pBuffer, unsigned long ulSize);
+    bool FetchPages(const std::vector<unsigned long>& pages);
+
+private:
+    bool                                    m_bCacheEnabled;
+    unsigned long                           m_ulPageSize;
+    std::map<unsigned long, unsigned char*> m_Pages;
+};
+
+#endif // _BINUTILS_REMOTE_H
@@ -21,27 +21,82 @@
 // >> INCLUDES
 // ============================================================================
 #include <stdio.h>
+#include <map>
+#include <string>
 #ifdef _WIN32
     #include <windows.h>
 #else
-    #include <fcntl.h>
+    #include <dlfcn.h>
     #include <link.h>
-    #include <sys/mman.h>
 #endif
 
 #include "dynload.h"
 
 #include "binutils_scanner.h"
+#include "binutils_elf.h"
+#include "binutils_search.h"
+#include "binutils_trace.h"
 #include "binutils_tools.h"
 
 
+// ============================================================================
+// >> HELPERS
+// ============================================================================
+#ifdef __linux__
+// Returns the path of a binary that has been loaded by this process
+const char* GetLinkMapPath(unsigned long ulHandle)
+{
+    // The main program doesn't have a name
+    const char* szName = ((struct link_map *) ulHandle)->l_name;
+    return *szName ? szName : "/proc/self/exe";
+}
+#endif
+
+
 // ============================================================================
 // >> CBinaryFile class
 // ============================================================================
-CBinaryFile::CBinaryFile(unsigned long ulAddr, unsigned long ulSize)
+CBinaryFile::CBinaryFile(unsigned long ulHandle, unsigned long ulAddr, unsigned long ulSize)
+{
+    m_ulHandle = ulHandle;
+    m_ulAddr = ulAddr;
+    m_ulSize = ulSize;
+}
+
+CBinaryFile::CBinaryFile(unsigned long ulAddr, unsigned long ulSize, BackendPtr pBackend, const char* szPath)
 {
+    m_ulHandle = 0;
     m_ulAddr = ulAddr;
     m_ulSize = ulSize;
+    m_pBackend = pBackend;
+    m_szPath = szPath;
+}
+
+unsigned char* CBinaryFile::GetScanBase()
+{
+    if (!m_pBackend)
+        return (unsigned char *) m_ulAddr;
+
+    const void* pDirect = m_pBackend->GetDirect(m_ulAddr, m_ulSize);
+    if (pDirect)
+        return (unsigned char *) pDirect;
+
+    if (m_Image.empty())
+    {
+        m_Image.assign(m_ulSize, 0);
+
+        // The binary might contain gaps that aren't mapped. In that case
+        // copy it page by page and leave the gaps zeroed.
+        if (!m_pBackend->Read(m_ulAddr, &m_Image[0], m_ulSize))
+        {
+            for (unsigned long ulOffset=0; ulOffset < m_ulSize; ulOffset += 4096)
+            {
+                unsigned long ulChunk = m_ulSize - ulOffset < 4096 ? m_ulSize - ulOffset : 4096;
+                m_pBackend->Read(m_ulAddr + ulOffset, &m_Image[ulOffset], ulChunk);
+            }
+        }
+    }
+    return &m_Image[0];
 }
 
 CPointer* CBinaryFile::FindSignature(object szSignature)
@@ -50,153 +105,281 @@ CPointer* CBinaryFile::FindSignature(object szSignature)
     if (!sigstr)
         return new CPointer();
 
+    int iLength = len(szSignature);
+
+    CTraceScope scope("find_signature");
+    if (scope.IsEnabled())
+        scope.SetName(FormatBytes(sigstr, iLength));
+
     // Search for a cached signature
-    for (std::list<Signature_t>::iterator iter=m_Signatures.begin(); iter != m_Signatures.end(); iter++)
+    unsigned long ulAddr;
+    bool bCached = FindCachedSignature(sigstr, ulAddr);
+    scope.SetCacheHit(bCached);
+    if (bCached)
+        return new CPointer(ulAddr, m_pBackend);
+
+    unsigned char* start = GetScanBase();
+    unsigned char* found = FindPattern(start, m_ulSize, sigstr, iLength);
+    if (!found)
     {
-        Signature_t sig = *iter;
-        if (strcmp((const char *) sig.m_szSignature, (const char *) sigstr) == 0)
-            return new CPointer(sig.m_ulAddr);
+        scope.SetBytes(m_ulSize);
+        return new CPointer();
     }
 
-    int iLength = len(szSignature);
+    ulAddr = m_ulAddr + (found - start);
+    scope.SetBytes(found - start + iLength);
+
+    // Add our signature to the cache
+    AddCachedSignature(sigstr, iLength, ulAddr);
+    return new CPointer(ulAddr, m_pBackend);
+}
 
-    unsigned char* base = (unsigned char *) m_ulAddr;
-    unsigned char* end  = (unsigned char *) (base + m_ulSize - iLength);
+list CBinaryFile::FindSignatures(object oSignatures, int iThreads /* = 0 */)
+{
+    int iCount = len(oSignatures);
+    std::vector<unsigned long> ulAddresses(iCount, 0);
 
-    while(base < end)
+    // Collect all signatures that haven't been cached yet
+    std::vector<Pattern_t> patterns;
+    std::vector<int> indexes;
+    for (int i=0; i < iCount; i++)
     {
-        int i = 0;
-        for(; i < iLength; i++)
-        {
-            if (sigstr[i] == '\x2A')
-                continue;
+        object oSignature = oSignatures[i];
+        unsigned char* sigstr = GetByteRepr(oSignature);
+        if (!sigstr || FindCachedSignature(sigstr, ulAddresses[i]))
+            continue;
 
-            if (sigstr[i] != base[i])
-                break;
-        }
+        Pattern_t pattern = {sigstr, (int) len(oSignature)};
+        patterns.push_back(pattern);
+        indexes.push_back(i);
+    }
 
-        if (i == iLength)
-        {
-            unsigned long ulAddr = (unsigned long) base;
+    CTraceScope scope("find_signatures");
+    if (scope.IsEnabled())
+    {
+        char szName[64];
+        sprintf(szName, "%d signatures (%d cached)", iCount, iCount - (int) patterns.size());
+        scope.SetName(szName);
+        scope.SetBytes(patterns.empty() ? 0 : m_ulSize);
+        scope.SetCacheHit(patterns.empty());
+    }
+
+    // Scan for all remaining signatures at once. The byte strings are still
+    // referenced by oSignatures, so it's safe to release the GIL.
+    std::vector<unsigned long> ulResults;
+    unsigned char* start = patterns.empty() ? NULL : GetScanBase();
+    Py_BEGIN_ALLOW_THREADS
+    FindPatterns(start, m_ulSize, patterns, ulResults, iThreads);
+    Py_END_ALLOW_THREADS
+
+    for (size_t i=0; i < patterns.size(); i++)
+    {
+        if (ulResults[i])
+            ulResults[i] = m_ulAddr + (ulResults[i] - (unsigned long) start);
 
-            // Add our signature to the cache
-            Signature_t sig_t = {new unsigned char[iLength+1], ulAddr};
-            strcpy((char*) sig_t.m_szSignature, (char*) sigstr);
-            m_Signatures.push_back(sig_t);
-            return new CPointer(ulAddr);
+        ulAddresses[indexes[i]] = ulResults[i];
+        if (ulResults[i])
+            AddCachedSignature((unsigned char *) patterns[i].m_pBytes, patterns[i].m_iLength, ulResults[i]);
+    }
+
+    list results;
+    for (int i=0; i < iCount; i++)
+        results.append(CPointer(ulAddresses[i], m_pBackend));
+
+    return results;
+}
+
+bool CBinaryFile::FindCachedSignature(unsigned char* szSignature, unsigned long& ulAddr)
+{
+    for (std::list<Signature_t>::iterator iter=m_Signatures.begin(); iter != m_Signatures.end(); iter++)
+    {
+        Signature_t sig = *iter;
+        if (strcmp((const char *) sig.m_szSignature, (const char *) szSignature) == 0)
+        {
+            ulAddr = sig.m_ulAddr;
+            return true;
         }
-        base++;
     }
-    return new CPointer();
+    return false;
+}
+
+void CBinaryFile::AddCachedSignature(unsigned char* szSignature, int iLength, unsigned long ulAddr)
+{
+    Signature_t sig_t = {new unsigned char[iLength+1], ulAddr};
+    strcpy((char*) sig_t.m_szSignature, (char*) szSignature);
+    m_Signatures.push_back(sig_t);
 }
 
 CPointer* CBinaryFile::FindSymbol(char* szSymbol)
 {
-#ifdef _WIN32
-    return new CPointer((unsigned long) GetProcAddress((HMODULE) m_ulAddr, szSymbol));
+    CTraceScope scope("find_symbol", szSymbol);
+    std::vector<const char *> symbols(1, szSymbol);
+    std::vector<unsigned long> ulResults;
+    LookupSymbols(symbols, ulResults);
+    return new CPointer(ulResults[0], m_pBackend);
+}
 
-#elif defined(__linux__)
-    // -----------------------------------------
-    // We need to use mmap now that VALVe has
-    // made them all private!
-    // Thank you to DamagedSoul from AlliedMods
-    // for the following code.
-    // It can be found at:
-    // http://hg.alliedmods.net/sourcemod-central/file/dc361050274d/core/logic/MemoryUtils.cpp
-    // -----------------------------------------
-    struct link_map *dlmap;
-    struct stat dlstat;
-    int dlfile;
-    uintptr_t map_base;
-    Elf32_Ehdr *file_hdr;
-    Elf32_Shdr *sections, *shstrtab_hdr, *symtab_hdr, *strtab_hdr;
-    Elf32_Sym *symtab;
-    const char *shstrtab, *strtab;
-    uint16_t section_count;
-    uint32_t symbol_count;
-
-    dlmap = (struct link_map *) m_ulAddr;
-    symtab_hdr = NULL;
-    strtab_hdr = NULL;
-
-    dlfile = open(dlmap->l_name, O_RDONLY);
-    if (dlfile == -1 || fstat(dlfile, &dlstat) == -1)
-    {
-        close(dlfile);
-        return new CPointer();
-    }
+list CBinaryFile::FindSymbols(object oSymbols)
+{
+    int iCount = len(oSymbols);
+    std::vector<const char *> symbols(iCount);
+    for (int i=0; i < iCount; i++)
+        symbols[i] = extract<const char *>(oSymbols[i]);
 
-    /* Map library file into memory */
-    file_hdr = (Elf32_Ehdr *)mmap(NULL, dlstat.st_size, PROT_READ, MAP_PRIVATE, dlfile, 0);
-    map_base = (uintptr_t)file_hdr;
-    if (file_hdr == MAP_FAILED)
+    CTraceScope scope("find_symbols");
+    if (scope.IsEnabled())
     {
-        close(dlfile);
-        return new CPointer();
+        char szName[64];
+        sprintf(szName, "%d symbols", iCount);
+        scope.SetName(szName);
     }
-    close(dlfile);
 
-    if (file_hdr->e_shoff == 0 || file_hdr->e_shstrndx == SHN_UNDEF)
-    {
-        munmap(file_hdr, dlstat.st_size);
-        return new CPointer();
-    }
+    std::vector<unsigned long> ulResults;
+    LookupSymbols(symbols, ulResults);
 
-    sections = (Elf32_Shdr *)(map_base + file_hdr->e_shoff);
-    section_count = file_hdr->e_shnum;
-    /* Get ELF section header string table */
-    shstrtab_hdr = &sections[file_hdr->e_shstrndx];
-    shstrtab = (const char *)(map_base + shstrtab_hdr->sh_offset);
+    list results;
+    for (int i=0; i < iCount; i++)
+        results.append(CPointer(ulResults[i], m_pBackend));
 
-    /* Iterate sections while looking for ELF symbol table and string table */
-    for (uint16_t i = 0; i < section_count; i++)
-    {
-        Elf32_Shdr &hdr = sections[i];
-        const char *section_name = shstrtab + hdr.sh_name;
+    return results;
+}
 
-        if (strcmp(section_name, ".symtab") == 0)
-            symtab_hdr = &hdr;
+#ifdef __linux__
+struct SymbolLookup_t
+{
+    std::map<std::string, std::vector<size_t> > m_Wanted;
+    std::vector<unsigned long>*                 m_pResults;
+};
 
-        else if (strcmp(section_name, ".strtab") == 0)
-            strtab_hdr = &hdr;
-    }
+bool LookupSymbolCallback(const char* szName, unsigned long ulValue, unsigned long /* ulSize */, void* pData)
+{
+    SymbolLookup_t* lookup = (SymbolLookup_t *) pData;
+    std::map<std::string, std::vector<size_t> >::iterator iter = lookup->m_Wanted.find(szName);
+    if (iter == lookup->m_Wanted.end())
+        return true;
 
-    /* Uh oh, we don't have a symbol table or a string table */
-    if (symtab_hdr == NULL || strtab_hdr == NULL)
+    for (size_t j = 0; j < iter->second.size(); j++)
+        (*lookup->m_pResults)[iter->second[j]] = ulValue;
+
+    lookup->m_Wanted.erase(iter);
+    return !lookup->m_Wanted.empty();
+}
+
+struct SymbolSearch_t
+{
+    // Address relative to the load bias
+    unsigned long m_ulTarget;
+
+    unsigned long m_ulValue;
+    std::string   m_szName;
+};
+
+bool SymbolizeCallback(const char* szName, unsigned long ulValue, unsigned long /* ulSize */, void* pData)
+{
+    // Find the closest symbol at or before the address
+    SymbolSearch_t* search = (SymbolSearch_t *) pData;
+    if (ulValue <= search->m_ulTarget && (search->m_szName.empty() || ulValue > search->m_ulValue))
     {
-        munmap(file_hdr, dlstat.st_size);
-        return new CPointer();
+        search->m_ulValue = ulValue;
+        search->m_szName = szName;
     }
+    return true;
+}
+#endif
 
-    symtab = (Elf32_Sym *)(map_base + symtab_hdr->sh_offset);
-    strtab = (const char *)(map_base + strtab_hdr->sh_offset);
-    symbol_count = symtab_hdr->sh_size / symtab_hdr->sh_entsize;
-    void* sym_addr = NULL;
+unsigned long CBinaryFile::GetLoadBias(unsigned long ulLoadBase)
+{
+#ifdef __linux__
+    // Binaries start at the page of their first loadable segment
+    return m_ulAddr - ulLoadBase;
+#else
+    return 0;
+#endif
+}
 
-    /* Iterate symbol table starting from the position we were at last time */
-    for (uint32_t i = 0; i < symbol_count; i++)
-    {
-        Elf32_Sym &sym = symtab[i];
-        unsigned char sym_type = ELF32_ST_TYPE(sym.st_info);
-        const char *sym_name = strtab + sym.st_name;
+unsigned long CBinaryFile::GetLoadBias()
+{
+#ifdef __linux__
+    // The load base is only required for binaries of a memory backend
+    if (!m_pBackend)
+        return ((struct link_map *) m_ulHandle)->l_addr;
 
-        /* Skip symbols that are undefined or do not refer to functions or objects */
-        if (sym.st_shndx == SHN_UNDEF || (sym_type != STT_FUNC && sym_type != STT_OBJECT))
-            continue;
+    CElfFile elf;
+    if (!elf.Open(GetPath()))
+        BOOST_RAISE_EXCEPTION(PyExc_IOError, "Unable to open the file of the binary.")
 
-        if (strcmp(szSymbol, sym_name) == 0)
-        {
-            sym_addr = (void *)(dlmap->l_addr + sym.st_value);
-            break;
-        }
+    return GetLoadBias(elf.GetLoadBase());
+#else
+    // Addresses are relative to the image base on Windows
+    return m_ulAddr;
+#endif
+}
+
+const char* CBinaryFile::GetPath()
+{
+#ifdef __linux__
+    if (!m_pBackend)
+        return GetLinkMapPath(m_ulHandle);
+#endif
+    return m_szPath.c_str();
+}
+
+void CBinaryFile::LookupSymbols(const std::vector<const char *>& symbols, std::vector<unsigned long>& ulResults)
+{
+    ulResults.assign(symbols.size(), 0);
+
+#ifdef _WIN32
+    // Symbols of binaries in a memory backend are not supported on Windows
+    if (m_pBackend)
+        return;
+
+    for (size_t i=0; i < symbols.size(); i++)
+        ulResults[i] = (unsigned long) GetProcAddress((HMODULE) m_ulHandle, symbols[i]);
+
+#elif defined(__linux__)
+    // Map the requested names to their indexes, so all of them can be
+    // resolved in a single pass over the symbol table
+    SymbolLookup_t lookup;
+    lookup.m_pResults = &ulResults;
+    for (size_t i=0; i < symbols.size(); i++)
+        lookup.m_Wanted[symbols[i]].push_back(i);
+
+    CElfFile elf;
+    if (symbols.empty() || !elf.Open(GetPath()) || !elf.ForEachSymbol(&LookupSymbolCallback, &lookup))
+        return;
+
+    unsigned long ulBias = GetLoadBias(elf.GetLoadBase());
+    for (size_t i=0; i < ulResults.size(); i++)
+    {
+        if (ulResults[i])
+            ulResults[i] += ulBias;
     }
 
-    // Unmap the file now.
-    munmap(file_hdr, dlstat.st_size);
-    return new CPointer((unsigned long) sym_addr);
+#else
+#error "CBinaryFile::LookupSymbols() is not implemented on this OS"
+#endif
+}
+
+object CBinaryFile::Symbolize(unsigned long ulAddr)
+{
+#ifdef __linux__
+    CTraceScope scope("symbolize");
+    CElfFile elf;
+    if (!elf.Open(GetPath()))
+        return object();
+
+    if (ulAddr < m_ulAddr || ulAddr >= m_ulAddr + m_ulSize)
+        return object();
+
+    SymbolSearch_t search;
+    search.m_ulTarget = ulAddr - GetLoadBias(elf.GetLoadBase());
+    search.m_ulValue = 0;
+    if (!elf.ForEachSymbol(&SymbolizeCallback, &search) || search.m_szName.empty())
+        return object();
 
+    return boost::python::make_tuple(search.m_szName, search.m_ulTarget - search.m_ulValue);
 #else
-#error "CBinaryFile::FindSymbol() is not implemented on this OS"
+    return object();
 #endif
 }
 
@@ -222,6 +405,7 @@ bool str_ends_with(const char *szString, const char *szSuffix)
 
 CBinaryFile* CBinaryManager::FindBinary(char* szPath, bool bSrvCheck /* = true */)
 {
+    CTraceScope scope("find_binary", szPath);
     std::string szBinaryPath = szPath;
 #ifdef __linux__
     if (bSrvCheck && !str_ends_with(szBinaryPath.data(), "_srv"))
@@ -241,41 +425,120 @@ CBinaryFile* CBinaryManager::FindBinary(char* szPath, bool bSrvCheck /* = true *
             BOOST_RAISE_EXCEPTION(PyExc_IOError, szBinaryPath.data())
     }
 
+    bool bCached;
+    CBinaryFile* binary = GetBinary(ulAddr, bCached);
+    scope.SetCacheHit(bCached);
+    if (binary && !bCached)
+        scope.SetBytes(binary->GetSize());
+
+    return binary;
+}
+
+CBinaryFile* CBinaryManager::GetBinary(unsigned long ulHandle, bool& bCached)
+{
     // Search for an existing BinaryFile object
     for (std::list<CBinaryFile *>::iterator iter=m_Binaries.begin(); iter != m_Binaries.end(); iter++)
     {
         CBinaryFile* binary = *iter;
-        if (binary->GetAddress() == ulAddr)
+        if (!binary->GetBackend() && binary->GetHandle() == ulHandle)
         {
+            bCached = true;
+
             // We don't need to open it several times
-            dlFreeLibrary((DLLib *) ulAddr);
+            dlFreeLibrary((DLLib *) ulHandle);
             return binary;
         }
     }
 
+    bCached = false;
+
+    unsigned long ulAddr;
     unsigned long ulSize;
 
 #ifdef _WIN32
-    IMAGE_DOS_HEADER* dos = (IMAGE_DOS_HEADER *) ulAddr;
+    IMAGE_DOS_HEADER* dos = (IMAGE_DOS_HEADER *) ulHandle;
     IMAGE_NT_HEADERS* nt  = (IMAGE_NT_HEADERS *) ((BYTE *) dos + dos->e_lfanew);
+    ulAddr = ulHandle;
     ulSize = nt->OptionalHeader.SizeOfImage;
 
 #elif defined(__linux__)
-    // TODO: Retrieve whole size
-    struct stat buf;
-    if (stat(szBinaryPath.data(), &buf) == -1)
+    // The handle is the link_map of the binary. Its image spans all of its
+    // loadable segments, starting at the page of the first one.
+    CElfFile elf;
+    if (!elf.Open(GetLinkMapPath(ulHandle)))
     {
-        dlFreeLibrary((DLLib *) ulAddr);
+        dlFreeLibrary((DLLib *) ulHandle);
         return NULL;
     }
-    ulSize = buf.st_size;
+    ulAddr = ((struct link_map *) ulHandle)->l_addr + elf.GetLoadBase();
+    ulSize = elf.GetImageSize();
 
 #else
-#error "CBinaryManager::FindBinary() is not implemented on this OS"
+#error "CBinaryManager::GetBinary() is not implemented on this OS"
 #endif
 
     // Create a new Binary object and add it to the list
-    CBinaryFile* binary = new CBinaryFile(ulAddr, ulSize);
+    CBinaryFile* binary = new CBinaryFile(ulHandle, ulAddr, ulSize);
+    m_Binaries.push_front(binary);
+    return binary;
+}
+
+CBinaryFile* CBinaryManager::FindBinary(char* szPath, bool bSrvCheck, BackendPtr pBackend)
+{
+    if (!pBackend)
+        return FindBinary(szPath, bSrvCheck);
+
+    CTraceScope scope("find_binary", szPath);
+
+    // Binaries of a memory backend are always shared libraries of a Linux
+    // process
+    std::string szBinaryPath = szPath;
+    if (bSrvCheck && !str_ends_with(szBinaryPath.data(), "_srv"))
+        szBinaryPath += "_srv.so";
+    else if (!str_ends_with(szBinaryPath.data(), ".so"))
+        szBinaryPath += ".so";
+
+    std::string szSuffix = "/" + szBinaryPath;
+    std::vector<Module_t> modules;
+    pBackend->GetModules(modules);
+
+    std::vector<Module_t>::iterator module = modules.begin();
+    for (; module != modules.end(); module++)
+    {
+        if (module->m_szPath == szBinaryPath || str_ends_with(module->m_szPath.data(), szSuffix.data()))
+            break;
+    }
+
+    if (module == modules.end())
+    {
+        szBinaryPath = "Unable to find " + szBinaryPath;
+        BOOST_RAISE_EXCEPTION(PyExc_IOError, szBinaryPath.data())
+    }
+
+    bool bCached;
+    CBinaryFile* binary = GetBinary(*module, pBackend, bCached);
+    scope.SetCacheHit(bCached);
+    if (!bCached)
+        scope.SetBytes(module->m_ulSize);
+
+    return binary;
+}
+
+CBinaryFile* CBinaryManager::GetBinary(const Module_t& module, BackendPtr pBackend, bool& bCached)
+{
+    // Search for an existing BinaryFile object
+    for (std::list<CBinaryFile *>::iterator iter=m_Binaries.begin(); iter != m_Binaries.end(); iter++)
+    {
+        CBinaryFile* binary = *iter;
+        if (binary->GetBackend() == pBackend && binary->GetAddress() == module.m_ulBase)
+        {
+            bCached = true;
+            return binary;
+        }
+    }
+
+    bCached = false;
+    CBinaryFile* binary = new CBinaryFile(module.m_ulBase, module.m_ulSize, pBackend, module.m_szPath.data());
     m_Binaries.push_front(binary);
     return binary;
 }
@@ -283,8 +546,87 @@ CBinaryFile* CBinaryManager::FindBinary(char* szPath, bool bSrvCheck /* = true *
 // ============================================================================
 // >> FUNCTIONS
 // ============================================================================
-CBinaryFile* FindBinary(char* szPath, bool bSrvCheck /* = true */)
+CBinaryManager* GetBinaryManager()
 {
     static CBinaryManager* s_pBinaryManager = new CBinaryManager();
-    return s_pBinaryManager->FindBinary(szPath, bSrvCheck);
+    return s_pBinaryManager;
+}
+
+CBinaryFile* FindBinary(char* szPath, bool bSrvCheck /* = true */)
+{
+    return GetBinaryManager()->FindBinary(szPath, bSrvCheck, GetDefaultBackend());
+}
+
+CBinaryFile* FindBinary(char* szPath, bool bSrvCheck, BackendPtr pBackend)
+{
+    return GetBinaryManager()->FindBinary(szPath, bSrvCheck, pBackend);
+}
+
+// Symbolizes an address of this process
+object Symbolize(unsigned long ulAddr)
+{
+    unsigned long ulBase;
+    std::string szPath;
+    CBinaryFile* binary = NULL;
+
+#ifdef _WIN32
+    HMODULE hModule;
+    char szFileName[MAX_PATH];
+    if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+            (LPCSTR) ulAddr, &hModule) || !GetModuleFileNameA(hModule, szFileName, sizeof(szFileName)))
+        return object();
+
+    ulBase = (unsigned long) hModule;
+    szPath = szFileName;
+
+#elif defined(__linux__)
+    Dl_info info;
+    struct link_map* pMap = NULL;
+    if (!dladdr1((void *) ulAddr, &info, (void **) &pMap, RTLD_DL_LINKMAP) || !pMap)
+        return object();
+
+    ulBase = (unsigned long) info.dli_fbase;
+    szPath = GetLinkMapPath((unsigned long) pMap);
+
+    // Take a reference like FindBinary() does. The main program is opened
+    // with NULL.
+    void* pHandle = dlopen(*pMap->l_name ? pMap->l_name : NULL, RTLD_NOW | RTLD_NOLOAD);
+    if (pHandle)
+    {
+        bool bCached;
+        binary = GetBinaryManager()->GetBinary((unsigned long) pHandle, bCached);
+    }
+
+#else
+#error "Symbolize() is not implemented on this OS"
+#endif
+
+    object symbol = binary ? binary->Symbolize(ulAddr) : object();
+    if (symbol.is_none())
+        return boost::python::make_tuple(szPath, object(), ulAddr - ulBase);
+
+    return boost::python::make_tuple(szPath, symbol[0], symbol[1]);
+}
+
+object Symbolize(BackendPtr pBackend, unsigned long ulAddr)
+{
+    if (!pBackend)
+        return Symbolize(ulAddr);
+
+    std::vector<Module_t> modules;
+    pBackend->GetModules(modules);
+    for (std::vector<Module_t>::iterator module=modules.begin(); module != modules.end(); module++)
+    {
+        if (ulAddr < module->m_ulBase || ulAddr >= module->m_ulBase + module->m_ulSize)
+            continue;
+
+        bool bCached;
+        CBinaryFile* binary = GetBinaryManager()->GetBinary(*module, pBackend, bCached);
+        object symbol = binary->Symbolize(ulAddr);
+        if (symbol.is_none())
+            return boost::python::make_tuple(module->m_szPath, object(), ulAddr - module->m_ulBase);
+
+        return boost::python::make_tuple(module->m_szPath, symbol[0], symbol[1]);
+    }
+    return object();
 }
\ No newline at end of file
@@ -24,6 +24,8 @@
 // >> INCLUDES
 // ============================================================================
 #include <list>
+#include <string>
+#include <vector>
 #include "binutils_tools.h"
 
 
@@ -40,18 +42,60 @@ struct Signature_t
 class CBinaryFile
 {
 public:
-    CBinaryFile(unsigned long ulAddr, unsigned long ulSize);
+    CBinaryFile(unsigned long ulHandle, unsigned long ulAddr, unsigned long ulSize);
+    CBinaryFile(unsigned long ulAddr, unsigned long ulSize, BackendPtr pBackend, const char* szPath);
 
     CPointer* FindSignature(object szSignature);
     CPointer* FindSymbol(char* szSymbol);
     CPointer* FindPointer(object szSignature, int iOffset);
 
+    list      FindSignatures(object oSignatures, int iThreads = 0);
+    list      FindSymbols(object oSymbols);
+
+    /*
+        Returns a (symbol, offset) tuple of the closest symbol at or before
+        the given address or None.
+    */
+    object    Symbolize(unsigned long ulAddr);
+
+    // Returns the path of the file this binary has been loaded from
+    const char*   GetPath();
+
+    /*
+        Returns the value that has to be added to the virtual addresses of
+        the binary's file to get addresses of this binary.
+    */
+    unsigned long GetLoadBias();
+
+    // Returns the start of the image of this binary
     unsigned long GetAddress() { return m_ulAddr; }
+
+    // Returns the handle of dlLoadLibrary() or 0 for binaries of a memory
+    // backend
+    unsigned long GetHandle() { return m_ulHandle; }
     unsigned long GetSize() { return m_ulSize; }
+    BackendPtr    GetBackend() { return m_pBackend; }
 
 private:
+    bool FindCachedSignature(unsigned char* szSignature, unsigned long& ulAddr);
+    void AddCachedSignature(unsigned char* szSignature, int iLength, unsigned long ulAddr);
+    void LookupSymbols(const std::vector<const char *>& symbols, std::vector<unsigned long>& ulResults);
+    unsigned long GetLoadBias(unsigned long ulLoadBase);
+
+    /*
+        Returns a local view of the binary that can be scanned. Binaries of a
+        memory backend are copied once, unless the backend provides direct
+        access.
+    */
+    unsigned char* GetScanBase();
+
+private:
+    unsigned long          m_ulHandle;
     unsigned long          m_ulAddr;
     unsigned long          m_ulSize;
+    BackendPtr             m_pBackend;
+    std::string            m_szPath;
+    std::vector<unsigned char> m_Image;
     std::list<Signature_t> m_Signatures;
 };
 
@@ -60,6 +104,15 @@ class CBinaryManager
 {
 public:
     CBinaryFile* FindBinary(char* szPath, bool bSrvCheck = true);
+    CBinaryFile* FindBinary(char* szPath, bool bSrvCheck, BackendPtr pBackend);
+
+    // Returns the BinaryFile object of a module of a memory backend
+    CBinaryFile* GetBinary(const Module_t& module, BackendPtr pBackend, bool& bCached);
+
+    // Returns the BinaryFile object of a library that has been loaded by
+    // dlLoadLibrary(). Takes over the reference of the handle. Returns NULL
+    // if the binary can't be read.
+    CBinaryFile* GetBinary(unsigned long ulHandle, bool& bCached);
 
 private:
     std::list<CBinaryFile*> m_Binaries;
@@ -69,5 +122,14 @@ private:
 // >> FUNCTIONS
 // ============================================================================
 CBinaryFile* FindBinary(char* szPath, bool bSrvCheck = true);
+CBinaryFile* FindBinary(char* szPath, bool bSrvCheck, BackendPtr pBackend);
+
+/*
+    Returns a (module, symbol, offset) tuple for an address of a memory
+    backend (or this process if it's NULL) or None if the address doesn't
+    belong to a module. The symbol is None if the module doesn't have a
+    symbol table.
+*/
+object       Symbolize(BackendPtr pBackend, unsigned long ulAddr);
 
 #endif // _BINUTILS_SCANNER_H
\ No newline at end of file
@@ -0,0 +1,206 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <string.h>
+
+#include "binutils_search.h"
+#include "binutils_thread.h"
+
+
+// ============================================================================
+// >> HELPER FUNCTIONS
+// ============================================================================
+inline bool MatchPattern(const unsigned char* pAddr, const unsigned char* pPattern, int iLength)
+{
+    for (int i=0; i < iLength; i++)
+    {
+        if (pPattern[i] != SIGNATURE_WILDCARD && pPattern[i] != pAddr[i])
+            return false;
+    }
+    return true;
+}
+
+// Returns the index of the first byte that is not a wildcard
+inline int GetAnchor(const unsigned char* pPattern, int iLength)
+{
+    for (int i=0; i < iLength; i++)
+    {
+        if (pPattern[i] != SIGNATURE_WILDCARD)
+            return i;
+    }
+    return -1;
+}
+
+
+// ============================================================================
+// >> FindPattern
+// ============================================================================
+unsigned char* FindPattern(unsigned char* pBase, unsigned long ulSize,
+    const unsigned char* pPattern, int iLength)
+{
+    if (iLength <= 0 || (unsigned long) iLength > ulSize)
+        return NULL;
+
+    int iAnchor = GetAnchor(pPattern, iLength);
+    if (iAnchor == -1)
+        return pBase;
+
+    // Let memchr() skip to the next possible candidate
+    unsigned char* pEnd = pBase + ulSize - iLength;
+    unsigned char* pPos = pBase;
+    while (pPos <= pEnd)
+    {
+        unsigned char* pFound = (unsigned char *) memchr(pPos + iAnchor,
+            pPattern[iAnchor], (pEnd - pPos) + 1);
+
+        if (!pFound)
+            break;
+
+        pPos = pFound - iAnchor;
+        if (MatchPattern(pPos, pPattern, iLength))
+            return pPos;
+
+        pPos++;
+    }
+    return NULL;
+}
+
+
+// ============================================================================
+// >> FindPatterns
+// ============================================================================
+struct ScanJob_t
+{
+    unsigned char*                m_pBase;
+    unsigned long                 m_ulSize;
+    unsigned long                 m_ulStart;
+    unsigned long                 m_ulEnd;
+    const std::vector<Pattern_t>* m_pPatterns;
+    const std::vector<int>*       m_pBuckets;
+    const std::vector<int>*       m_pAnchors;
+    std::vector<unsigned long>    m_ulResults;
+};
+
+void ScanChunk(void* pArg)
+{
+    ScanJob_t* job = (ScanJob_t *) pArg;
+    const std::vector<Pattern_t>& patterns = *job->m_pPatterns;
+    const std::vector<int>* buckets = job->m_pBuckets;
+    const std::vector<int>& anchors = *job->m_pAnchors;
+
+    int iRemaining = (int) patterns.size();
+    job->m_ulResults.assign(patterns.size(), 0);
+
+    // Each position is the position of an anchor byte. Since positions are
+    // increasing, the first match of a pattern is also its lowest address
+    // within this chunk.
+    for (unsigned long ulPos=job->m_ulStart; ulPos < job->m_ulEnd && iRemaining > 0; ulPos++)
+    {
+        const std::vector<int>& bucket = buckets[job->m_pBase[ulPos]];
+        for (size_t i=0; i < bucket.size(); i++)
+        {
+            int iIndex = bucket[i];
+            if (job->m_ulResults[iIndex])
+                continue;
+
+            const Pattern_t& pattern = patterns[iIndex];
+            if (ulPos < (unsigned long) anchors[iIndex])
+                continue;
+
+            unsigned long ulCandidate = ulPos - anchors[iIndex];
+            if (ulCandidate + pattern.m_iLength > job->m_ulSize)
+                continue;
+
+            if (MatchPattern(job->m_pBase + ulCandidate, pattern.m_pBytes, pattern.m_iLength))
+            {
+                job->m_ulResults[iIndex] = (unsigned long) (job->m_pBase + ulCandidate);
+                iRemaining--;
+            }
+        }
+    }
+}
+
+void FindPatterns(unsigned char* pBase, unsigned long ulSize,
+    const std::vector<Pattern_t>& patterns, std::vector<unsigned long>& ulResults,
+    int iThreads /* = 0 */)
+{
+    ulResults.assign(patterns.size(), 0);
+    if (patterns.empty() || !ulSize)
+        return;
+
+    // Sort the patterns into buckets by their anchor byte. Patterns that only
+    // consist of wildcards match at the beginning of the block.
+    std::vector<int> buckets[256];
+    std::vector<int> anchors(patterns.size());
+    for (size_t i=0; i < patterns.size(); i++)
+    {
+        anchors[i] = GetAnchor(patterns[i].m_pBytes, patterns[i].m_iLength);
+        if (anchors[i] == -1)
+            ulResults[i] = patterns[i].m_iLength <= (int) ulSize ? (unsigned long) pBase : 0;
+        else
+            buckets[patterns[i].m_pBytes[anchors[i]]].push_back((int) i);
+    }
+
+    if (iThreads <= 0)
+        iThreads = GetProcessorCount();
+
+    // Don't create threads for tiny chunks
+    const unsigned long ulMinChunkSize = 1024 * 1024;
+    if (ulSize / iThreads < ulMinChunkSize)
+        iThreads = (int) (ulSize / ulMinChunkSize) + 1;
+
+    std::vector<ScanJob_t> jobs(iThreads);
+    std::vector<void *> args(iThreads);
+    unsigned long ulChunkSize = ulSize / iThreads;
+    for (int i=0; i < iThreads; i++)
+    {
+        ScanJob_t& job = jobs[i];
+        job.m_pBase     = pBase;
+        job.m_ulSize    = ulSize;
+        job.m_ulStart   = i * ulChunkSize;
+        job.m_ulEnd     = (i == iThreads - 1) ? ulSize : (i + 1) * ulChunkSize;
+        job.m_pPatterns = &patterns;
+        job.m_pBuckets  = buckets;
+        job.m_pAnchors  = &anchors;
+        args[i] = &job;
+    }
+
+    RunParallel(&ScanChunk, &args[0], iThreads);
+
+    // Chunks are ordered, so the first chunk with a match has the lowest
+    // address
+    for (size_t i=0; i < patterns.size(); i++)
+    {
+        if (anchors[i] == -1)
+            continue;
+
+        for (int j=0; j < iThreads; j++)
+        {
+            if (jobs[j].m_ulResults[i])
+            {
+                ulResults[i] = jobs[j].m_ulResults[i];
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,69 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+#ifndef _BINUTILS_SEARCH_H
+#define _BINUTILS_SEARCH_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <vector>
+
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+// Bytes with this value match every byte in memory
+#define SIGNATURE_WILDCARD 0x2A
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+struct Pattern_t
+{
+    const unsigned char* m_pBytes;
+    int                  m_iLength;
+};
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    Returns the first address in the given memory block that matches the
+    pattern or NULL.
+*/
+unsigned char* FindPattern(unsigned char* pBase, unsigned long ulSize,
+    const unsigned char* pPattern, int iLength);
+
+/*
+    Searches the given memory block for all patterns at once and splits the
+    block into iThreads parts that are scanned in parallel. If iThreads is 0,
+    the number of processors is used.
+
+    The address of the first match of each pattern is written to the
+    corresponding element of ulResults (0 if the pattern wasn't found).
+*/
+void FindPatterns(unsigned char* pBase, unsigned long ulSize,
+    const std::vector<Pattern_t>& patterns, std::vector<unsigned long>& ulResults,
+    int iThreads = 0);
+
+#endif // _BINUTILS_SEARCH_H
@@ -0,0 +1,247 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+    #include <sys/syscall.h>
+#endif
+
+#include <vector>
+#include "binutils_thread.h"
+
+
+// ============================================================================
+// >> HELPER FUNCTIONS
+// ============================================================================
+struct ThreadData_t
+{
+    ThreadFn m_pFunc;
+    void*    m_pArg;
+};
+
+#ifdef _WIN32
+DWORD WINAPI ThreadEntry(LPVOID pData)
+#else
+void* ThreadEntry(void* pData)
+#endif
+{
+    ThreadData_t* data = (ThreadData_t *) pData;
+    data->m_pFunc(data->m_pArg);
+    return 0;
+}
+
+#ifdef _WIN32
+// Fiber local storage only passes the value to the callback, so it also
+// stores the exit function
+struct ThreadKeyValue_t
+{
+    ThreadExitFn m_pExitFunc;
+    void*        m_pValue;
+};
+
+VOID WINAPI ThreadKeyCallback(PVOID pData)
+{
+    ThreadKeyValue_t* data = (ThreadKeyValue_t *) pData;
+    if (data->m_pValue)
+        data->m_pExitFunc(data->m_pValue);
+
+    delete data;
+}
+#endif
+
+
+// ============================================================================
+// >> CMutex
+// ============================================================================
+CMutex::CMutex()
+{
+#ifdef _WIN32
+    CRITICAL_SECTION* pSection = new CRITICAL_SECTION;
+    InitializeCriticalSection(pSection);
+    m_pHandle = pSection;
+#else
+    pthread_mutex_t* pMutex = new pthread_mutex_t;
+    pthread_mutex_init(pMutex, NULL);
+    m_pHandle = pMutex;
+#endif
+}
+
+CMutex::~CMutex()
+{
+#ifdef _WIN32
+    DeleteCriticalSection((CRITICAL_SECTION *) m_pHandle);
+    delete (CRITICAL_SECTION *) m_pHandle;
+#else
+    pthread_mutex_destroy((pthread_mutex_t *) m_pHandle);
+    delete (pthread_mutex_t *) m_pHandle;
+#endif
+}
+
+void CMutex::Lock()
+{
+#ifdef _WIN32
+    EnterCriticalSection((CRITICAL_SECTION *) m_pHandle);
+#else
+    pthread_mutex_lock((pthread_mutex_t *) m_pHandle);
+#endif
+}
+
+void CMutex::Unlock()
+{
+#ifdef _WIN32
+    LeaveCriticalSection((CRITICAL_SECTION *) m_pHandle);
+#else
+    pthread_mutex_unlock((pthread_mutex_t *) m_pHandle);
+#endif
+}
+
+
+// ============================================================================
+// >> CThreadKey
+// ============================================================================
+CThreadKey::CThreadKey(ThreadExitFn pExitFunc)
+{
+    m_pExitFunc = pExitFunc;
+#ifdef _WIN32
+    m_ulKey = (unsigned long) FlsAlloc(&ThreadKeyCallback);
+#else
+    pthread_key_t key;
+    pthread_key_create(&key, pExitFunc);
+    m_ulKey = (unsigned long) key;
+#endif
+}
+
+CThreadKey::~CThreadKey()
+{
+#ifdef _WIN32
+    FlsFree((DWORD) m_ulKey);
+#else
+    pthread_key_delete((pthread_key_t) m_ulKey);
+#endif
+}
+
+void* CThreadKey::Get()
+{
+#ifdef _WIN32
+    ThreadKeyValue_t* data = (ThreadKeyValue_t *) FlsGetValue((DWORD) m_ulKey);
+    return data ? data->m_pValue : NULL;
+#else
+    return pthread_getspecific((pthread_key_t) m_ulKey);
+#endif
+}
+
+void CThreadKey::Set(void* pValue)
+{
+#ifdef _WIN32
+    ThreadKeyValue_t* data = (ThreadKeyValue_t *) FlsGetValue((DWORD) m_ulKey);
+    if (!data)
+    {
+        data = new ThreadKeyValue_t;
+        data->m_pExitFunc = m_pExitFunc;
+        FlsSetValue((DWORD) m_ulKey, data);
+    }
+    data->m_pValue = pValue;
+#else
+    pthread_setspecific((pthread_key_t) m_ulKey, pValue);
+#endif
+}
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+int GetProcessorCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int iCount = (int) info.dwNumberOfProcessors;
+#elif defined(__linux__)
+    int iCount = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    #error "Implement me!"
+#endif
+    return iCount > 0 ? iCount : 1;
+}
+
+unsigned long GetThreadIdentifier()
+{
+#ifdef _WIN32
+    return (unsigned long) GetCurrentThreadId();
+#elif defined(__linux__)
+    return (unsigned long) syscall(SYS_gettid);
+#else
+    #error "Implement me!"
+#endif
+}
+
+void RunParallel(ThreadFn pFunc, void** ppArgs, int iCount)
+{
+    if (iCount <= 0)
+        return;
+
+    std::vector<ThreadData_t> data(iCount);
+
+#ifdef _WIN32
+    std::vector<HANDLE> threads(iCount, (HANDLE) NULL);
+#else
+    std::vector<pthread_t> threads(iCount);
+    std::vector<bool> started(iCount, false);
+#endif
+
+    // The first element is processed by the calling thread
+    for (int i=1; i < iCount; i++)
+    {
+        data[i].m_pFunc = pFunc;
+        data[i].m_pArg = ppArgs[i];
+
+    #ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, &ThreadEntry, &data[i], 0, NULL);
+        if (!threads[i])
+            pFunc(ppArgs[i]);
+    #else
+        started[i] = pthread_create(&threads[i], NULL, &ThreadEntry, &data[i]) == 0;
+        if (!started[i])
+            pFunc(ppArgs[i]);
+    #endif
+    }
+
+    pFunc(ppArgs[0]);
+
+    for (int i=1; i < iCount; i++)
+    {
+    #ifdef _WIN32
+        if (threads[i])
+        {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+    #else
+        if (started[i])
+            pthread_join(threads[i], NULL);
+    #endif
+    }
+}
@@ -0,0 +1,119 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+#ifndef _BINUTILS_THREAD_H
+#define _BINUTILS_THREAD_H
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+typedef void (*ThreadFn)(void* pArg);
+
+// Called with the value of a thread key when a thread exits
+typedef void (*ThreadExitFn)(void* pValue);
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+/*
+    Non-recursive mutex. The native handle is allocated in the source file,
+    so this header doesn't need to include windows.h.
+*/
+class CMutex
+{
+public:
+    CMutex();
+    ~CMutex();
+
+    void Lock();
+    void Unlock();
+
+private:
+    // Don't copy the native handle
+    CMutex(const CMutex&);
+    CMutex& operator=(const CMutex&);
+
+private:
+    void* m_pHandle;
+};
+
+/*
+    Locks the given mutex until the instance goes out of scope.
+*/
+class CMutexLock
+{
+public:
+    CMutexLock(CMutex& mutex): m_Mutex(mutex) { m_Mutex.Lock(); }
+    ~CMutexLock() { m_Mutex.Unlock(); }
+
+private:
+    CMutex& m_Mutex;
+};
+
+/*
+    Pointer with a value per thread. The exit function is called in a thread
+    that exits while its value is not NULL. Keys should live as long as the
+    process, because threads might still exit after they have been deleted.
+*/
+class CThreadKey
+{
+public:
+    CThreadKey(ThreadExitFn pExitFunc);
+    ~CThreadKey();
+
+    void* Get();
+    void  Set(void* pValue);
+
+private:
+    // Don't copy the native key
+    CThreadKey(const CThreadKey&);
+    CThreadKey& operator=(const CThreadKey&);
+
+private:
+    unsigned long m_ulKey;
+    ThreadExitFn  m_pExitFunc;
+};
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    Returns the number of online processors. Returns at least 1.
+*/
+int GetProcessorCount();
+
+/*
+    Returns the ID of the calling thread.
+*/
+unsigned long GetThreadIdentifier();
+
+/*
+    Calls pFunc once for each element of ppArgs in its own thread and waits
+    until all threads have finished. If a thread can't be created, the
+    function is called in the calling thread instead.
+
+    This file doesn't depend on Python, so it can also be used by the native
+    tools and benchmarks.
+*/
+void RunParallel(ThreadFn pFunc, void** ppArgs, int iCount);
+
+#endif // _BINUTILS_THREAD_H
@@ -0,0 +1,213 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <x86intrin.h>
+
+#include "binutils_timeline.h"
+#include "binutils_trace.h"
+
+using namespace DynamicHooks;
+
+
+// ============================================================================
+// >> GLOBAL VARIABLES
+// ============================================================================
+// Buffer of the calling thread. It's created on the first event.
+static __thread TimelineBuffer_t* t_pBuffer = NULL;
+
+
+// ============================================================================
+// >> CTimeline
+// ============================================================================
+CTimeline::CTimeline(): m_BufferKey(&ReleaseBuffer)
+{
+    m_bEnabled = false;
+    m_uiTick = 0;
+    m_ullStartTime = __rdtsc();
+    m_dStartTime = GetTracer()->Now();
+}
+
+void CTimeline::SetSpanName(CHook* pHook, const std::string& szName)
+{
+    CMutexLock lock(m_Mutex);
+    m_mapNames[pHook] = szName;
+}
+
+TimelineBuffer_t* CTimeline::GetBuffer()
+{
+    if (t_pBuffer)
+        return t_pBuffer;
+
+    CMutexLock lock(m_Mutex);
+
+    // Prefer the buffer of an exited thread over allocating a new one
+    TimelineBuffer_t* pBuffer = NULL;
+    for (size_t i=0; i < m_Buffers.size() && !pBuffer; i++)
+    {
+        if (m_Buffers[i]->m_bExited)
+            pBuffer = m_Buffers[i];
+    }
+
+    if (!pBuffer)
+    {
+        pBuffer = new TimelineBuffer_t;
+        m_Buffers.push_back(pBuffer);
+    }
+
+    pBuffer->m_ulThread = GetThreadIdentifier();
+    pBuffer->m_bExited = false;
+    pBuffer->m_ulCount = 0;
+
+    m_BufferKey.Set(pBuffer);
+    t_pBuffer = pBuffer;
+    return pBuffer;
+}
+
+void CTimeline::ReleaseBuffer(void* pBuffer)
+{
+    // Events that are added after this point get a new buffer
+    t_pBuffer = NULL;
+
+    CTimeline* pTimeline = GetTimeline();
+    CMutexLock lock(pTimeline->m_Mutex);
+    ((TimelineBuffer_t *) pBuffer)->m_bExited = true;
+}
+
+void CTimeline::AddEvent(TimelineEventType_t eType, CHook* pHook, bool bTick /* = false */)
+{
+    if (!m_bEnabled)
+        return;
+
+    TimelineBuffer_t* pBuffer = GetBuffer();
+    unsigned long ulCount = pBuffer->m_ulCount;
+
+    TimelineEvent_t& event = pBuffer->m_Events[ulCount % TIMELINE_BUFFER_SIZE];
+    event.m_ullTime = __rdtsc();
+    event.m_pHook = pHook;
+    event.m_uiTick = bTick ? NextTick() : m_uiTick;
+    event.m_usDepth = (unsigned short) GetFrameDepth();
+    event.m_ucType = (unsigned char) eType;
+
+    // Publish the event after it has been written
+    __sync_synchronize();
+    pBuffer->m_ulCount = ulCount + 1;
+}
+
+void CTimeline::Clear()
+{
+    CMutexLock lock(m_Mutex);
+    std::vector<TimelineBuffer_t *> buffers;
+    for (size_t i=0; i < m_Buffers.size(); i++)
+    {
+        if (m_Buffers[i]->m_bExited)
+        {
+            delete m_Buffers[i];
+            continue;
+        }
+
+        m_Buffers[i]->m_ulCount = 0;
+        buffers.push_back(m_Buffers[i]);
+    }
+    m_Buffers.swap(buffers);
+}
+
+void CTimeline::GetSpans(unsigned int uiFirstTick, unsigned int uiLastTick, std::vector<TimelineSpan_t>& spans)
+{
+    // Calibrate the time stamp counter with the whole lifetime of the
+    // timeline
+    unsigned long long ullNow = __rdtsc();
+    double dElapsed = GetTracer()->Now() - m_dStartTime;
+    double dTicksPerMicrosecond = dElapsed > 0 ? (ullNow - m_ullStartTime) / dElapsed : 1.0;
+
+    CMutexLock lock(m_Mutex);
+    for (size_t i=0; i < m_Buffers.size(); i++)
+    {
+        TimelineBuffer_t* pBuffer = m_Buffers[i];
+        unsigned long ulCount = pBuffer->m_ulCount;
+        unsigned long ulFirst = ulCount > TIMELINE_BUFFER_SIZE ? ulCount - TIMELINE_BUFFER_SIZE : 0;
+
+        // Begin events of spans that haven't ended yet
+        std::vector<TimelineEvent_t> open;
+        for (unsigned long ulIndex=ulFirst; ulIndex < ulCount; ulIndex++)
+        {
+            TimelineEvent_t event = pBuffer->m_Events[ulIndex % TIMELINE_BUFFER_SIZE];
+            if (event.m_ucType == TIMELINE_BEGIN)
+            {
+                open.push_back(event);
+                continue;
+            }
+
+            // The begin event might have been overwritten already. Don't drop
+            // the outer spans in that case.
+            int iBegin = (int) open.size() - 1;
+            while (iBegin >= 0 && (open[iBegin].m_pHook != event.m_pHook || open[iBegin].m_usDepth != event.m_usDepth))
+                iBegin--;
+
+            if (iBegin < 0)
+                continue;
+
+            TimelineEvent_t begin = open[iBegin];
+            open.resize(iBegin);
+
+            if (begin.m_uiTick < uiFirstTick || begin.m_uiTick > uiLastTick)
+                continue;
+
+            TimelineSpan_t span;
+            std::map<CHook *, std::string>::iterator it = m_mapNames.find(begin.m_pHook);
+            span.m_szName = it != m_mapNames.end() ? it->second : "unknown";
+            span.m_ulThread = pBuffer->m_ulThread;
+            span.m_dStart = m_dStartTime + (long long) (begin.m_ullTime - m_ullStartTime) / dTicksPerMicrosecond;
+            span.m_dDuration = (event.m_ullTime - begin.m_ullTime) / dTicksPerMicrosecond;
+            span.m_iDepth = begin.m_usDepth;
+            span.m_uiTick = begin.m_uiTick;
+            spans.push_back(span);
+        }
+    }
+}
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+CTimeline* GetTimeline()
+{
+    static CTimeline* s_pTimeline = new CTimeline();
+    return s_pTimeline;
+}
+
+bool TimelinePreHook(HookType_t /* eHookType */, CHook* pHook)
+{
+    GetTimeline()->AddEvent(TIMELINE_BEGIN, pHook);
+    return false;
+}
+
+bool TimelineTickPreHook(HookType_t /* eHookType */, CHook* pHook)
+{
+    GetTimeline()->AddEvent(TIMELINE_BEGIN, pHook, true);
+    return false;
+}
+
+bool TimelinePostHook(HookType_t /* eHookType */, CHook* pHook)
+{
+    GetTimeline()->AddEvent(TIMELINE_END, pHook);
+    return false;
+}
@@ -0,0 +1,174 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _BINUTILS_TIMELINE_H
+#define _BINUTILS_TIMELINE_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <map>
+#include <string>
+#include <vector>
+
+#include "DynamicHooks.h"
+#include "binutils_thread.h"
+
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+// Number of events per thread. Older events are overwritten.
+#define TIMELINE_BUFFER_SIZE 65536
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+enum TimelineEventType_t
+{
+    TIMELINE_BEGIN,
+    TIMELINE_END
+};
+
+struct TimelineEvent_t
+{
+    // Value of the time stamp counter
+    unsigned long long   m_ullTime;
+    DynamicHooks::CHook* m_pHook;
+    unsigned int         m_uiTick;
+
+    // Number of hooked functions the thread was executing
+    unsigned short       m_usDepth;
+    unsigned char        m_ucType;
+};
+
+/*
+    Ring buffer of a single thread. Only that thread writes to it.
+*/
+struct TimelineBuffer_t
+{
+    unsigned long            m_ulThread;
+
+    // True if the thread has exited. The buffer is reused by the next thread
+    // that starts recording.
+    bool                     m_bExited;
+
+    // Number of events that have been written since the last Clear()
+    volatile unsigned long   m_ulCount;
+    TimelineEvent_t          m_Events[TIMELINE_BUFFER_SIZE];
+};
+
+/*
+    A begin event and its end event.
+*/
+struct TimelineSpan_t
+{
+    std::string   m_szName;
+    unsigned long m_ulThread;
+
+    // Microseconds on the time line of the tracer (see CTracer::Now())
+    double        m_dStart;
+    double        m_dDuration;
+
+    int           m_iDepth;
+    unsigned int  m_uiTick;
+};
+
+/*
+    Records the begin and the end of hooked functions with the time stamp
+    counter. The events are written by native hook callbacks into a ring
+    buffer per thread, so recording neither calls Python nor takes a lock.
+    A tick (e.g. a server frame) starts whenever a tick span begins or
+    NextTick() is called.
+
+    The time stamp counter has to be invariant, which is the case on all
+    recent x86 processors. This file doesn't depend on Python.
+*/
+class CTimeline
+{
+public:
+    CTimeline();
+
+    void Enable(bool bEnable) { m_bEnabled = bEnable; }
+    bool IsEnabled() { return m_bEnabled; }
+
+    // Sets the name that is used for the spans of the given hook
+    void SetSpanName(DynamicHooks::CHook* pHook, const std::string& szName);
+
+    unsigned int GetTick() { return m_uiTick; }
+    unsigned int NextTick() { return __sync_add_and_fetch(&m_uiTick, 1); }
+
+    // Adds an event to the buffer of the calling thread
+    void AddEvent(TimelineEventType_t eType, DynamicHooks::CHook* pHook, bool bTick = false);
+
+    // Discards all events and frees the buffers of exited threads. Threads
+    // that are recording at the same time might keep a few of them.
+    void Clear();
+
+    // Pairs the recorded events of all threads and returns the spans that
+    // begin in the given range of ticks. Spans without an end event are
+    // skipped.
+    void GetSpans(unsigned int uiFirstTick, unsigned int uiLastTick, std::vector<TimelineSpan_t>& spans);
+
+private:
+    TimelineBuffer_t* GetBuffer();
+
+    // Marks the buffer of an exiting thread as reusable
+    static void ReleaseBuffer(void* pBuffer);
+
+private:
+    volatile bool         m_bEnabled;
+    volatile unsigned int m_uiTick;
+
+    // Guards m_Buffers and m_mapNames
+    CMutex m_Mutex;
+
+    // Calls ReleaseBuffer() when a thread with a buffer exits
+    CThreadKey m_BufferKey;
+
+    // Buffers are kept after their thread has exited, so its events can
+    // still be exported. They are reused by new threads and freed by Clear().
+    std::vector<TimelineBuffer_t *>              m_Buffers;
+    std::map<DynamicHooks::CHook *, std::string> m_mapNames;
+
+    // Time stamp counter and tracer time at the creation of the timeline.
+    // They are used to convert time stamps into microseconds.
+    unsigned long long m_ullStartTime;
+    double             m_dStartTime;
+};
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    Returns a pointer to a static CTimeline object.
+*/
+CTimeline* GetTimeline();
+
+/*
+    Native callbacks of timeline spans. The tick variant also starts a new
+    tick. All of them only record if the timeline is enabled.
+*/
+bool TimelinePreHook(DynamicHooks::HookType_t eHookType, DynamicHooks::CHook* pHook);
+bool TimelineTickPreHook(DynamicHooks::HookType_t eHookType, DynamicHooks::CHook* pHook);
+bool TimelinePostHook(DynamicHooks::HookType_t eHookType, DynamicHooks::CHook* pHook);
+
+#endif // _BINUTILS_TIMELINE_H
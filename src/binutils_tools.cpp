@@ -20,8 +20,11 @@
 // ============================================================================
 // >> INCLUDES
 // ============================================================================
+#include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "dyncall.h"
 #include "dyncall_signature.h"
@@ -29,10 +32,15 @@
 #include "binutils_tools.h"
 #include "binutils_macros.h"
 #include "binutils_hooks.h"
+#include "binutils_executor.h"
+#include "binutils_hash.h"
+#include "binutils_memo.h"
+#include "binutils_record.h"
+#include "binutils_thread.h"
+#include "binutils_timeline.h"
 
 
 DCCallVM* g_pCallVM = dcNewCallVM(4096);
-extern std::map<CHook *, std::map<DynamicHooks::HookType_t, std::list<PyObject *> > > g_mapCallbacks;
 
 CHookManager* g_pHookMngr = GetHookManager();
 
@@ -47,6 +55,288 @@ inline size_t UTIL_GetSize(void* ptr)
 #endif
 }
 
+// Converts a value to the representation of rules (see Rule_t)
+unsigned long long ToRuleValue(char cType, object oValue)
+{
+    switch(cType)
+    {
+        case SIGCHAR_VOID:      return 0;
+        case SIGCHAR_BOOL:      return extract<bool>(oValue);
+        case SIGCHAR_CHAR:      return (long long) extract<char>(oValue);
+        case SIGCHAR_UCHAR:     return extract<unsigned char>(oValue);
+        case SIGCHAR_SHORT:     return (long long) extract<short>(oValue);
+        case SIGCHAR_USHORT:    return extract<unsigned short>(oValue);
+        case SIGCHAR_INT:       return (long long) extract<int>(oValue);
+        case SIGCHAR_UINT:      return extract<unsigned int>(oValue);
+        case SIGCHAR_LONG:      return (long long) extract<long>(oValue);
+        case SIGCHAR_ULONG:     return extract<unsigned long>(oValue);
+        case SIGCHAR_LONGLONG:  return extract<long long>(oValue);
+        case SIGCHAR_ULONGLONG: return extract<unsigned long long>(oValue);
+        case SIGCHAR_POINTER:   return ExtractPyPtr(oValue);
+        case SIGCHAR_FLOAT:
+        {
+            float fValue = extract<float>(oValue);
+            unsigned long long ullValue = 0;
+            memcpy(&ullValue, &fValue, sizeof(float));
+            return ullValue;
+        }
+        case SIGCHAR_DOUBLE:
+        {
+            double dValue = extract<double>(oValue);
+            unsigned long long ullValue;
+            memcpy(&ullValue, &dValue, sizeof(double));
+            return ullValue;
+        }
+    }
+
+    // The rule would keep a pointer to a Python string
+    BOOST_RAISE_EXCEPTION(PyExc_TypeError, "Strings can't be used in rules.")
+    return 0;
+}
+
+object FromRuleValue(char cType, unsigned long long ullValue)
+{
+    switch(cType)
+    {
+        case SIGCHAR_VOID:      return object();
+        case SIGCHAR_BOOL:      return object((bool) ullValue);
+        case SIGCHAR_CHAR:      return object((char) ullValue);
+        case SIGCHAR_UCHAR:     return object((unsigned char) ullValue);
+        case SIGCHAR_SHORT:     return object((short) ullValue);
+        case SIGCHAR_USHORT:    return object((unsigned short) ullValue);
+        case SIGCHAR_INT:       return object((int) ullValue);
+        case SIGCHAR_UINT:      return object((unsigned int) ullValue);
+        case SIGCHAR_LONG:      return object((long) ullValue);
+        case SIGCHAR_ULONG:     return object((unsigned long) ullValue);
+        case SIGCHAR_LONGLONG:  return object((long long) ullValue);
+        case SIGCHAR_ULONGLONG: return object(ullValue);
+        case SIGCHAR_POINTER:   return object(CPointer((unsigned long) ullValue));
+        case SIGCHAR_FLOAT:
+        {
+            float fValue;
+            memcpy(&fValue, &ullValue, sizeof(float));
+            return object(fValue);
+        }
+        case SIGCHAR_DOUBLE:
+        {
+            double dValue;
+            memcpy(&dValue, &ullValue, sizeof(double));
+            return object(dValue);
+        }
+    }
+    return object();
+}
+
+// ============================================================================
+// Call arguments
+// ============================================================================
+// Size of the scratch arena of every thread that calls functions
+#define CALL_SCRATCH_SIZE 65536
+
+static __thread char*         t_pScratch = NULL;
+static __thread unsigned long t_ulScratchUsed = 0;
+
+/*
+    Keeps the memory that pointer arguments refer to alive until the call
+    has returned. Buffers of Python objects are pinned, so they can't be
+    resized, and structs are packed into the scratch arena of the calling
+    thread (or the heap if it's full). Calls might be nested, so the arena
+    is used like a stack.
+*/
+class CCallArgs
+{
+public:
+    CCallArgs()
+    {
+        m_ulScratchMark = t_ulScratchUsed;
+    }
+
+    ~CCallArgs()
+    {
+        for (size_t i=0; i < m_Buffers.size(); i++)
+            PyBuffer_Release(&m_Buffers[i]);
+
+        for (size_t i=0; i < m_HeapBlocks.size(); i++)
+            free(m_HeapBlocks[i]);
+
+        t_ulScratchUsed = m_ulScratchMark;
+    }
+
+    // Returns NULL if the object doesn't support the buffer protocol.
+    // Functions might write to the buffer, so read-only buffers like strings
+    // are only accepted if bReadOnly is true. Their memory must not change.
+    void* Pin(PyObject* pObject, bool bReadOnly)
+    {
+        if (PyObject_CheckBuffer(pObject))
+        {
+            Py_buffer view;
+            if (PyObject_GetBuffer(pObject, &view, bReadOnly ? PyBUF_SIMPLE : PyBUF_WRITABLE) == -1)
+                throw_error_already_set();
+
+            m_Buffers.push_back(view);
+            return view.buf;
+        }
+
+#if PY_MAJOR_VERSION < 3
+        // E.g. array.array only supports the old buffer protocol. The tuple
+        // of arguments keeps the object alive.
+        void* pBuffer;
+        Py_ssize_t size;
+        if (PyObject_AsWriteBuffer(pObject, &pBuffer, &size) == 0)
+            return pBuffer;
+
+        PyErr_Clear();
+        const void* pReadBuffer;
+        if (PyObject_AsReadBuffer(pObject, &pReadBuffer, &size) == 0)
+        {
+            if (bReadOnly)
+                return (void *) pReadBuffer;
+
+            BOOST_RAISE_EXCEPTION(PyExc_TypeError, "The buffer is read-only. Use Function.set_const_param() if the function doesn't write to it.")
+        }
+
+        PyErr_Clear();
+#endif
+        return NULL;
+    }
+
+    // Returns a zeroed memory block
+    void* Alloc(unsigned long ulSize)
+    {
+        // Keep the blocks aligned for doubles and SSE types
+        unsigned long ulAligned = (ulSize + 15) & ~15UL;
+        if (!t_pScratch)
+            t_pScratch = (char *) malloc(CALL_SCRATCH_SIZE);
+
+        void* pBlock;
+        if (t_pScratch && t_ulScratchUsed + ulAligned <= CALL_SCRATCH_SIZE)
+        {
+            pBlock = t_pScratch + t_ulScratchUsed;
+            t_ulScratchUsed += ulAligned;
+        }
+        else
+        {
+            pBlock = malloc(ulAligned ? ulAligned : 1);
+            if (!pBlock)
+                BOOST_RAISE_EXCEPTION(PyExc_MemoryError, "Unable to allocate memory for a struct.")
+
+            m_HeapBlocks.push_back(pBlock);
+        }
+
+        memset(pBlock, 0, ulSize);
+        return pBlock;
+    }
+
+private:
+    std::vector<Py_buffer> m_Buffers;
+    std::vector<void *>    m_HeapBlocks;
+    unsigned long          m_ulScratchMark;
+};
+
+// Converts a pointer argument. Besides integers, pointers and array views,
+// every object that supports the buffer protocol is accepted (see
+// CCallArgs::Pin()).
+unsigned long ToPointerArg(object oValue, CCallArgs& callArgs, bool bReadOnly)
+{
+    if (oValue.is_none())
+        return 0;
+
+    extract<unsigned long> address(oValue);
+    if (address.check())
+        return address();
+
+    extract<CPointer *> pointer(oValue);
+    if (pointer.check())
+        return pointer()->GetAddress();
+
+    // Views are passed as the address of their array
+    extract<CArrayView *> view(oValue);
+    if (view.check())
+        return view()->m_ulAddr;
+
+    void* pBuffer = callArgs.Pin(oValue.ptr(), bReadOnly);
+    if (!pBuffer)
+        BOOST_RAISE_EXCEPTION(PyExc_TypeError, "Expected an integer, a pointer or an object that supports the buffer protocol.")
+
+    return (unsigned long) pBuffer;
+}
+
+// Returns true if the argument of a struct parameter should be packed.
+// Addresses, pointers and array views (which are sequences) are passed as
+// they are.
+bool IsStructValue(object oValue)
+{
+    PyObject* pValue = oValue.ptr();
+    if (pValue == Py_None || PyIndex_Check(pValue))
+        return false;
+
+    if (extract<CPointer *>(oValue).check() || extract<CArrayView *>(oValue).check())
+        return false;
+
+    return PyDict_Check(pValue) || (PySequence_Check(pValue) && !PyObject_CheckBuffer(pValue));
+}
+
+// Writes the value of a field. Arrays are passed as sequences, char arrays
+// also as strings.
+void PackField(const LayoutField_t& field, object oValue, char* pStruct, CCallArgs& callArgs, bool bReadOnly)
+{
+    char* pDest = pStruct + field.m_ulOffset;
+    if (field.m_iCount > 1 && field.m_cType == SIGCHAR_CHAR && PyBytes_Check(oValue.ptr()))
+    {
+        Py_ssize_t size = PyBytes_GET_SIZE(oValue.ptr());
+        memcpy(pDest, PyBytes_AS_STRING(oValue.ptr()), std::min((unsigned long) size, field.m_ulSize));
+        return;
+    }
+
+    unsigned long ulElementSize = field.m_ulSize / field.m_iCount;
+    for (int i=0; i < field.m_iCount; i++)
+    {
+        object oElement = field.m_iCount > 1 ? object(oValue[i]) : oValue;
+        unsigned long long ullValue;
+        if (field.IsPointer())
+            ullValue = ToPointerArg(oElement, callArgs, bReadOnly);
+        else
+            ullValue = ToRuleValue(field.m_cType, oElement);
+
+        // Rule values keep the value in the lowest bytes
+        memcpy(pDest + i * ulElementSize, &ullValue, ulElementSize);
+    }
+}
+
+// Packs a sequence (one value per field) or a dict (values by field name)
+// into a new struct. Missing fields of dicts are zero. Pointer fields accept
+// read-only buffers if bReadOnly is true.
+unsigned long PackStruct(CLayout* pLayout, object oValues, CCallArgs& callArgs, bool bReadOnly)
+{
+    // The size covers all fields, even if a smaller size has been declared
+    char* pStruct = (char *) callArgs.Alloc(pLayout->GetSize());
+    std::vector<LayoutField_t>& fields = pLayout->m_Fields;
+    if (PyDict_Check(oValues.ptr()))
+    {
+        dict values = extract<dict>(oValues);
+        for (size_t i=0; i < fields.size(); i++)
+        {
+            object oValue = values.get(fields[i].m_szName);
+            if (!oValue.is_none())
+                PackField(fields[i], oValue, pStruct, callArgs, bReadOnly);
+        }
+        return (unsigned long) pStruct;
+    }
+
+    if ((size_t) len(oValues) != fields.size())
+    {
+        char szError[64];
+        sprintf(szError, "Expected %d values for the struct.", (int) fields.size());
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, szError)
+    }
+
+    for (size_t i=0; i < fields.size(); i++)
+        PackField(fields[i], oValues[i], pStruct, callArgs, bReadOnly);
+
+    return (unsigned long) pStruct;
+}
+
+
 // ============================================================================
 // CPointer class
 // ============================================================================
@@ -55,17 +345,66 @@ CPointer::CPointer(unsigned long ulAddr /* = 0 */)
     m_ulAddr = ulAddr;
 }
 
+CPointer::CPointer(unsigned long ulAddr, BackendPtr pBackend)
+{
+    m_ulAddr = ulAddr;
+    m_pBackend = pBackend;
+}
+
+void CPointer::RequireLocal()
+{
+    if (m_pBackend)
+        BOOST_RAISE_EXCEPTION(PyExc_NotImplementedError, "This operation is only available for pointers of the current process.")
+}
+
 int CPointer::Compare(object oOther, unsigned long ulNum)
 {
     unsigned long ulOther = ExtractPyPtr(oOther);
     if (!m_ulAddr || ulOther == 0)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "At least one pointer is NULL.")
 
+    if (m_pBackend)
+    {
+        // Both pointers are in the address space of the backend
+        if (!ulNum)
+            return 0;
+
+        std::vector<unsigned char> buffer(ulNum * 2);
+        ReadMemory(m_pBackend.get(), m_ulAddr, &buffer[0], ulNum);
+        ReadMemory(m_pBackend.get(), ulOther, &buffer[ulNum], ulNum);
+        return memcmp(&buffer[0], &buffer[ulNum], ulNum);
+    }
+
     return memcmp((void *) m_ulAddr, (void *) ulOther, ulNum);
 }
 
+unsigned long long CPointer::Hash(unsigned long ulSize, const char* szAlgorithm)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
+
+    HashAlgorithm_t eAlgorithm;
+    if (!GetHashAlgorithm(szAlgorithm, eAlgorithm))
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Unknown hash algorithm.")
+
+    if (m_pBackend)
+    {
+        std::vector<unsigned char> buffer(ulSize);
+        if (ulSize)
+            ReadMemory(m_pBackend.get(), m_ulAddr, &buffer[0], ulSize);
+
+        return ::Hash(eAlgorithm, ulSize ? &buffer[0] : NULL, ulSize);
+    }
+
+    return ::Hash(eAlgorithm, (void *) m_ulAddr, ulSize);
+}
+
 bool CPointer::IsOverlapping(object oOther, unsigned long ulNumBytes)
 {
+    // Pointers into different address spaces never overlap
+    if (GetDestBackend(oOther) != m_pBackend)
+        return false;
+
     unsigned long ulOther = ExtractPyPtr(oOther);
 	if (m_ulAddr <= ulOther)
 		return m_ulAddr + ulNumBytes > ulOther;
@@ -82,8 +421,18 @@ CPointer* CPointer::SearchBytes(object oBytes, unsigned long ulNumBytes)
     if (ulNumBytes < iByteLen)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Search range is too small.")
 
-    unsigned char* base  = (unsigned char *) m_ulAddr;
-    unsigned char* end   = (unsigned char *) (m_ulAddr + ulNumBytes - (iByteLen - 1));
+    // Search in a local copy of the memory block
+    std::vector<unsigned char> buffer;
+    unsigned long ulBase = m_ulAddr;
+    if (m_pBackend)
+    {
+        buffer.resize(ulNumBytes);
+        ReadMemory(m_pBackend.get(), m_ulAddr, &buffer[0], ulNumBytes);
+        ulBase = (unsigned long) &buffer[0];
+    }
+
+    unsigned char* base  = (unsigned char *) ulBase;
+    unsigned char* end   = (unsigned char *) (ulBase + ulNumBytes - (iByteLen - 1));
     unsigned char* bytes = GetByteRepr(oBytes);
 
     while (base < end)
@@ -99,13 +448,22 @@ CPointer* CPointer::SearchBytes(object oBytes, unsigned long ulNumBytes)
         }
 
         if (i == iByteLen)
-            return new CPointer((unsigned long) base);
+            return new CPointer((unsigned long) base - ulBase + m_ulAddr, m_pBackend);
 
         base++;
     }
     return NULL;
 }
 
+BackendPtr CPointer::GetDestBackend(object oDest)
+{
+    extract<CPointer *> dest(oDest);
+    if (dest.check())
+        return dest()->m_pBackend;
+
+    return m_pBackend;
+}
+
 void CPointer::Copy(object oDest, unsigned long ulNumBytes)
 {
     unsigned long ulDest = ExtractPyPtr(oDest);
@@ -115,7 +473,7 @@ void CPointer::Copy(object oDest, unsigned long ulNumBytes)
     if (IsOverlapping(oDest, ulNumBytes))
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointers are overlapping!")
 
-    memcpy((void *) ulDest, (void *) m_ulAddr, ulNumBytes);
+    Move(oDest, ulNumBytes);
 }
 
 void CPointer::Move(object oDest, unsigned long ulNumBytes)
@@ -124,14 +482,44 @@ void CPointer::Move(object oDest, unsigned long ulNumBytes)
     if (!m_ulAddr || ulDest == 0)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "At least one pointer is NULL.")
 
-    memmove((void *) ulDest, (void *) m_ulAddr, ulNumBytes);
+    BackendPtr pDestBackend = GetDestBackend(oDest);
+    if (!m_pBackend && !pDestBackend)
+    {
+        memmove((void *) ulDest, (void *) m_ulAddr, ulNumBytes);
+        return;
+    }
+
+    if (!ulNumBytes)
+        return;
+
+    // Remote to local and local to remote don't need a buffer
+    if (!pDestBackend)
+    {
+        ReadMemory(m_pBackend.get(), m_ulAddr, (void *) ulDest, ulNumBytes);
+        return;
+    }
+
+    if (!m_pBackend)
+    {
+        WriteMemory(pDestBackend.get(), ulDest, (void *) m_ulAddr, ulNumBytes);
+        return;
+    }
+
+    // Within the same or between two remote address spaces. The buffer also
+    // makes overlapping ranges safe.
+    std::vector<unsigned char> buffer(ulNumBytes);
+    ReadMemory(m_pBackend.get(), m_ulAddr, &buffer[0], ulNumBytes);
+    WriteMemory(pDestBackend.get(), ulDest, &buffer[0], ulNumBytes);
 }
 
-const char * CPointer::GetStringArray(int iOffset /* = 0 */)
+std::string CPointer::GetStringArray(int iOffset /* = 0 */)
 {
     if (!m_ulAddr)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
 
+    if (m_pBackend)
+        return ReadString(m_pBackend.get(), m_ulAddr + iOffset);
+
     return (char *) (m_ulAddr + iOffset);
 }
 
@@ -142,6 +530,8 @@ void CPointer::SetStringArray(char* szText, int iOffset /* = 0 */, int iSize /*
 
     if (iSize == -1)
     {
+        // We can't ask the allocator of another process
+        RequireLocal();
         iSize = UTIL_GetSize((void *) (m_ulAddr + iOffset));
         if(!iSize)
             BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Unable to retrieve size of address.")
@@ -150,6 +540,12 @@ void CPointer::SetStringArray(char* szText, int iOffset /* = 0 */, int iSize /*
     if ((int) strlen(szText) >= iSize)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "String exceeds size of memory block.")
 
+    if (m_pBackend)
+    {
+        WriteMemory(m_pBackend.get(), m_ulAddr + iOffset, szText, strlen(szText) + 1);
+        return;
+    }
+
     strcpy((char *) (m_ulAddr + iOffset), szText);
 }
 
@@ -158,7 +554,7 @@ CPointer* CPointer::GetPtr(int iOffset /* = 0 */)
     if (!m_ulAddr)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
 
-    return new CPointer(*(unsigned long *) (m_ulAddr + iOffset));
+    return new CPointer(Get<unsigned long>(iOffset), m_pBackend);
 }
 
 void CPointer::SetPtr(object oPtr, int iOffset /* = 0 */)
@@ -166,11 +562,12 @@ void CPointer::SetPtr(object oPtr, int iOffset /* = 0 */)
     if (!m_ulAddr)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
 
-    *(unsigned long *) (m_ulAddr + iOffset) = ExtractPyPtr(oPtr);
+    Set<unsigned long>(ExtractPyPtr(oPtr), iOffset);
 }
 
 unsigned long CPointer::GetSize()
 {
+    RequireLocal();
     return UTIL_GetSize((void *) m_ulAddr);
 }
 
@@ -179,27 +576,33 @@ CPointer* CPointer::GetVirtualFunc(int iIndex)
     if (!m_ulAddr)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
 
-    void** vtable = *(void ***) m_ulAddr;
+    unsigned long vtable = Get<unsigned long>();
     if (!vtable)
-        return new CPointer();
+        return new CPointer(0, m_pBackend);
 
-    return new CPointer((unsigned long) vtable[iIndex]);
+    return CPointer(vtable, m_pBackend).GetPtr(iIndex * sizeof(void *));
 }
 
 void CPointer::Realloc(unsigned long ulSize)
 {
+    RequireLocal();
     m_ulAddr = (unsigned long) realloc((void *) m_ulAddr, ulSize);
 }
 
 void CPointer::Dealloc()
 {
+    RequireLocal();
     free((void *) m_ulAddr);
     m_ulAddr = 0;
 }
 
 CFunction* CPointer::MakeFunction(Convention_t eConv, char* szParams, PyObject* pConverter /* = NULL */)
 {
-    return new CFunction(m_ulAddr, eConv, szParams, pConverter);
+    // The address is still useful for hooks in other processes, but we can't
+    // call it
+    CFunction* pFunc = new CFunction(m_ulAddr, eConv, szParams, pConverter);
+    pFunc->m_pBackend = m_pBackend;
+    return pFunc;
 }
 
 CFunction* CPointer::MakeVirtualFunction(int iIndex, Convention_t eConv, char* szParams, PyObject* pConverter /* = NULL */)
@@ -209,15 +612,15 @@ CFunction* CPointer::MakeVirtualFunction(int iIndex, Convention_t eConv, char* s
 
 CPtrArray CPointer::MakePtrArray(unsigned int iTypeSize, int iLength /* = -1 */, PyObject* pConverter /* = NULL */)
 {
-    return CPtrArray(m_ulAddr, iTypeSize, iLength, pConverter);
+    return CPtrArray(m_ulAddr, iTypeSize, iLength, pConverter, m_pBackend);
 }
 
 
 // ============================================================================
 // CPtrArray class
 // ============================================================================
-CPtrArray::CPtrArray(unsigned long ulAddr, unsigned int iTypeSize, int iLength /* = -1 */, PyObject* pConverter /* = NULL */)
-: CArray<unsigned long>::CArray(ulAddr, iLength)
+CPtrArray::CPtrArray(unsigned long ulAddr, unsigned int iTypeSize, int iLength /* = -1 */, PyObject* pConverter /* = NULL */, BackendPtr pBackend /* = BackendPtr() */)
+: CArray<unsigned long>::CArray(ulAddr, iLength, pBackend)
 {
     m_iTypeSize = iTypeSize;
     m_oConverter = pConverter ? object(handle<>(borrowed(pConverter))) : eval("lambda x: x");
@@ -231,10 +634,221 @@ object CPtrArray::GetItem(unsigned int iIndex)
 void CPtrArray::SetItem(unsigned int iIndex, object oValue)
 {
     unsigned long ulAddr = ExtractPyPtr(oValue);
+    if (m_pBackend)
+    {
+        // Both pointers are in the address space of the backend
+        CPointer(ulAddr, m_pBackend).Move(object(m_ulAddr + (iIndex * m_iTypeSize)), m_iTypeSize);
+        return;
+    }
+
     memcpy((void *) (m_ulAddr + (iIndex * m_iTypeSize)), (void *) ulAddr, m_iTypeSize);
 }
 
 
+// ============================================================================
+// CArrayView class
+// ============================================================================
+CArrayView::CArrayView(unsigned long ulAddr, unsigned int uiStride, unsigned int uiLength, object oConverter,
+    bool bIndirect /* = false */, unsigned int uiPageSize /* = 256 */, BackendPtr pBackend /* = BackendPtr() */)
+{
+    m_ulAddr = ulAddr;
+    m_uiStride = uiStride;
+    m_uiLength = uiLength;
+    m_oConverter = oConverter.is_none() ? eval("lambda x: x") : oConverter;
+    m_bIndirect = bIndirect;
+    m_uiPageSize = uiPageSize ? uiPageSize : 1;
+    m_pBackend = pBackend;
+    m_bFiltered = false;
+    m_uiLoadedPages = 0;
+}
+
+unsigned int CArrayView::GetLength()
+{
+    return m_bFiltered ? m_Addresses.size() : m_uiLength;
+}
+
+void CArrayView::GetElementAddresses(unsigned int uiFirst, unsigned int uiCount, std::vector<unsigned long>& addresses)
+{
+    addresses.resize(uiCount);
+    if (m_bFiltered)
+    {
+        std::copy(m_Addresses.begin() + uiFirst, m_Addresses.begin() + uiFirst + uiCount, addresses.begin());
+        return;
+    }
+
+    unsigned long ulFirst = m_ulAddr + (unsigned long) uiFirst * m_uiStride;
+    if (!m_bIndirect)
+    {
+        for (unsigned int i=0; i < uiCount; i++)
+            addresses[i] = ulFirst + (unsigned long) i * m_uiStride;
+    }
+    else if (!m_pBackend)
+    {
+        for (unsigned int i=0; i < uiCount; i++)
+            addresses[i] = *(unsigned long *) (ulFirst + (unsigned long) i * m_uiStride);
+    }
+    else if (m_uiStride == sizeof(unsigned long))
+    {
+        // A single read for all slots of the page
+        ReadMemory(m_pBackend.get(), ulFirst, &addresses[0], uiCount * sizeof(unsigned long));
+    }
+    else
+    {
+        for (unsigned int i=0; i < uiCount; i++)
+            ReadMemory(m_pBackend.get(), ulFirst + (unsigned long) i * m_uiStride, &addresses[i], sizeof(unsigned long));
+    }
+}
+
+void CArrayView::ReadPage(unsigned int uiPage, unsigned long ulExtent, std::vector<unsigned long>& addresses,
+    std::string& buffer, std::vector<const char *>& data)
+{
+    unsigned int uiFirst = uiPage * m_uiPageSize;
+    unsigned int uiCount = std::min(m_uiPageSize, GetLength() - uiFirst);
+    GetElementAddresses(uiFirst, uiCount, addresses);
+
+    data.resize(uiCount);
+    if (!m_pBackend)
+    {
+        for (unsigned int i=0; i < uiCount; i++)
+            data[i] = (const char *) addresses[i];
+
+        return;
+    }
+
+    // Elements of a plain table are read with a single read
+    if (!m_bFiltered && !m_bIndirect && ulExtent <= m_uiStride)
+    {
+        buffer.resize((unsigned long) uiCount * m_uiStride);
+        ReadMemory(m_pBackend.get(), addresses[0], &buffer[0], buffer.size());
+        for (unsigned int i=0; i < uiCount; i++)
+            data[i] = &buffer[(unsigned long) i * m_uiStride];
+
+        return;
+    }
+
+    buffer.resize(uiCount * ulExtent);
+    for (unsigned int i=0; i < uiCount; i++)
+    {
+        data[i] = NULL;
+        if (addresses[i])
+        {
+            ReadMemory(m_pBackend.get(), addresses[i], &buffer[i * ulExtent], ulExtent);
+            data[i] = &buffer[i * ulExtent];
+        }
+    }
+}
+
+object CArrayView::GetItem(int iIndex)
+{
+    unsigned int uiLength = GetLength();
+    if (iIndex < 0)
+        iIndex += uiLength;
+
+    if (iIndex < 0 || (unsigned int) iIndex >= uiLength)
+        BOOST_RAISE_EXCEPTION(PyExc_IndexError, "Index out of range.")
+
+    unsigned int uiPage = iIndex / m_uiPageSize;
+    if (m_Pages.empty())
+        m_Pages.resize((uiLength + m_uiPageSize - 1) / m_uiPageSize);
+
+    object& page = m_Pages[uiPage];
+    if (page.is_none())
+    {
+        std::vector<unsigned long> addresses;
+        GetElementAddresses(uiPage * m_uiPageSize, std::min(m_uiPageSize, uiLength - uiPage * m_uiPageSize), addresses);
+
+        list elements;
+        for (size_t i=0; i < addresses.size(); i++)
+            elements.append(addresses[i] ? m_oConverter(CPointer(addresses[i], m_pBackend)) : object());
+
+        page = elements;
+        m_uiLoadedPages++;
+    }
+
+    return page[iIndex % m_uiPageSize];
+}
+
+boost::shared_ptr<CArrayView> CArrayView::Filter(const std::vector<FieldPredicate_t>& predicates)
+{
+    boost::shared_ptr<CArrayView> pView(new CArrayView(m_ulAddr, m_uiStride, 0, m_oConverter, m_bIndirect, m_uiPageSize, m_pBackend));
+    pView->m_pLayout = m_pLayout;
+    pView->m_bFiltered = true;
+
+    unsigned long ulExtent = GetPredicateExtent(predicates);
+    unsigned int uiPages = (GetLength() + m_uiPageSize - 1) / m_uiPageSize;
+    std::vector<unsigned long> addresses;
+    std::vector<const char *> data;
+    std::string buffer;
+    for (unsigned int uiPage=0; uiPage < uiPages; uiPage++)
+    {
+        ReadPage(uiPage, ulExtent, addresses, buffer, data);
+        for (size_t i=0; i < data.size(); i++)
+        {
+            if (data[i] && MatchPredicates(predicates, data[i]))
+                pView->m_Addresses.push_back(addresses[i]);
+        }
+    }
+
+    return pView;
+}
+
+list CArrayView::Map(unsigned long ulOffset, char cType)
+{
+    list values;
+    unsigned long ulExtent = ulOffset + GetFieldTypeSize(cType);
+    unsigned int uiPages = (GetLength() + m_uiPageSize - 1) / m_uiPageSize;
+    std::vector<unsigned long> addresses;
+    std::vector<const char *> data;
+    std::string buffer;
+    for (unsigned int uiPage=0; uiPage < uiPages; uiPage++)
+    {
+        ReadPage(uiPage, ulExtent, addresses, buffer, data);
+        for (size_t i=0; i < data.size(); i++)
+        {
+            if (data[i])
+                values.append(FieldValueToObject(cType, ReadFieldValue(cType, data[i] + ulOffset), m_pBackend));
+            else
+                values.append(object());
+        }
+    }
+
+    return values;
+}
+
+list CArrayView::GetAddresses()
+{
+    list result;
+    std::vector<unsigned long> addresses;
+    unsigned int uiLength = GetLength();
+    for (unsigned int uiFirst=0; uiFirst < uiLength; uiFirst += m_uiPageSize)
+    {
+        GetElementAddresses(uiFirst, std::min(m_uiPageSize, uiLength - uiFirst), addresses);
+        for (size_t i=0; i < addresses.size(); i++)
+            result.append(addresses[i]);
+    }
+
+    return result;
+}
+
+CArrayViewIterator::CArrayViewIterator(object oView)
+{
+    m_oView = oView;
+    m_pView = extract<CArrayView *>(oView);
+    m_uiIndex = 0;
+}
+
+object CArrayViewIterator::Next()
+{
+    if (m_uiIndex >= m_pView->GetLength())
+    {
+        PyErr_SetNone(PyExc_StopIteration);
+        throw_error_already_set();
+    }
+
+    return m_pView->GetItem(m_uiIndex++);
+}
+
+
 // ============================================================================
 // CFunction class
 // ============================================================================
@@ -252,6 +866,11 @@ object CFunction::__call__(object args)
     if (!m_ulAddr)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
 
+    RequireLocal();
+
+    // Must outlive the call
+    CCallArgs callArgs;
+
     dcReset(g_pCallVM);
     dcMode(g_pCallVM, GetDynCallConvention(m_eConv));
     char* ptr = m_szParams;
@@ -281,7 +900,15 @@ object CFunction::__call__(object args)
             case DC_SIGCHAR_ULONGLONG: dcArgLongLong(g_pCallVM, extract<unsigned long long>(arg)); break;
             case DC_SIGCHAR_FLOAT:     dcArgFloat(g_pCallVM, extract<float>(arg)); break;
             case DC_SIGCHAR_DOUBLE:    dcArgDouble(g_pCallVM, extract<double>(arg)); break;
-            case DC_SIGCHAR_POINTER:   dcArgPointer(g_pCallVM, ExtractPyPtr(arg)); break;
+            case DC_SIGCHAR_POINTER:
+            {
+                bool bConst = !m_ConstParams.empty() && m_ConstParams.count(pos);
+                std::map<int, LayoutPtr>::iterator it = m_StructParams.empty() ? m_StructParams.end() : m_StructParams.find(pos);
+                if (it != m_StructParams.end() && IsStructValue(arg))
+                    dcArgPointer(g_pCallVM, PackStruct(it->second.get(), arg, callArgs, bConst));
+                else
+                    dcArgPointer(g_pCallVM, ToPointerArg(arg, callArgs, bConst));
+            } break;
             case DC_SIGCHAR_STRING:    dcArgPointer(g_pCallVM, (unsigned long) (void *) extract<char *>(arg)); break;
             default: BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Unknown parameter type.")
         }
@@ -322,11 +949,24 @@ object CFunction::CallTrampoline(object args)
     if (!m_ulAddr)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
 
+    void* pTrampoline = NULL;
     CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
-    if (!pHook)
+    if (pHook)
+        pTrampoline = pHook->m_pTrampoline;
+    else
+    {
+        CRedirect* pRedirect = g_pHookMngr->FindRedirect((void *) m_ulAddr);
+        if (pRedirect && pRedirect->IsEnabled())
+            pTrampoline = pRedirect->m_pTrampoline;
+    }
+
+    if (!pTrampoline)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function was not hooked.")
 
-    return CFunction((unsigned long) pHook->m_pTrampoline, m_eConv, m_szParams, m_oConverter.ptr()).__call__(args);
+    CFunction trampoline((unsigned long) pTrampoline, m_eConv, m_szParams, m_oConverter.ptr());
+    trampoline.m_StructParams = m_StructParams;
+    trampoline.m_ConstParams = m_ConstParams;
+    return trampoline.__call__(args);
 }
 
 void CFunction::Hook(DynamicHooks::HookType_t eType, PyObject* pCallable)
@@ -334,9 +974,14 @@ void CFunction::Hook(DynamicHooks::HookType_t eType, PyObject* pCallable)
     if (!m_ulAddr)
         BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
 
+    RequireLocal();
+
     CHook* pHook = g_pHookMngr->HookFunction((void *) m_ulAddr, m_eConv, m_szParams);
+    if (!pHook)
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "Unable to hook the function.")
+
     pHook->AddCallback(eType, (void *) &binutils_HookHandler);
-    g_mapCallbacks[pHook][eType].push_back(pCallable);
+    g_mapCallbacks[pHook][eType].push_back(HookCallbackPtr(new CHookCallback(pCallable, eType)));
 }
 
 void CFunction::Unhook(DynamicHooks::HookType_t eType, PyObject* pCallable)
@@ -348,7 +993,20 @@ void CFunction::Unhook(DynamicHooks::HookType_t eType, PyObject* pCallable)
     if (!pHook)
         return;
 
-    g_mapCallbacks[pHook][eType].remove(pCallable);
+    // Running handlers keep their copy of the callbacks, so a callback is
+    // released when its last call has returned
+    HookCallbackList& callbacks = g_mapCallbacks[pHook][eType];
+    for (HookCallbackList::iterator it=callbacks.begin(); it != callbacks.end();)
+    {
+        if ((*it)->Matches(pCallable))
+            it = callbacks.erase(it);
+        else
+            it++;
+    }
+
+    // Don't let the bridge acquire the GIL if there is nothing to call
+    if (callbacks.empty())
+        pHook->RemoveCallback(eType, (void *) &binutils_HookHandler);
 }
 
 void CFunction::AddPreHook(PyObject* pCallable)
@@ -371,20 +1029,567 @@ void CFunction::RemovePostHook(PyObject* pCallable)
     Unhook(HOOKTYPE_POST, pCallable);
 }
 
-void CFunction::SetParams(char* szParams)
+list CFunction::GetHooks(DynamicHooks::HookType_t eType)
 {
-    strcpy(m_szParams, szParams);
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    list callbacks;
+    CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
+    if (!pHook)
+        return callbacks;
+
+    HookCallbackList& registered = g_mapCallbacks[pHook][eType];
+    for (HookCallbackList::iterator it=registered.begin(); it != registered.end(); it++)
+        callbacks.append(object(handle<>(borrowed((*it)->GetCallable()))));
+
+    return callbacks;
 }
 
-const char* CFunction::GetParams()
+list CFunction::GetPreHooks()
 {
-    return (const char *) m_szParams;
+    return GetHooks(HOOKTYPE_PRE);
 }
 
+list CFunction::GetPostHooks()
+{
+    return GetHooks(HOOKTYPE_POST);
+}
+
+void CFunction::HookNative(DynamicHooks::HookType_t eType, object oCallback)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    RequireLocal();
+
+    unsigned long ulCallback = ExtractPyPtr(oCallback);
+    if (!ulCallback)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Callback pointer is NULL.")
+
+    CHook* pHook = g_pHookMngr->HookFunction((void *) m_ulAddr, m_eConv, m_szParams);
+    if (!pHook)
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "Unable to hook the function.")
+
+    pHook->AddCallback(eType, (void *) ulCallback);
+}
+
+void CFunction::UnhookNative(DynamicHooks::HookType_t eType, object oCallback)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
+    if (!pHook)
+        return;
+
+    pHook->RemoveCallback(eType, (void *) ExtractPyPtr(oCallback));
+}
+
+void CFunction::AddNativePreHook(object oCallback)
+{
+    HookNative(HOOKTYPE_PRE, oCallback);
+}
+
+void CFunction::AddNativePostHook(object oCallback)
+{
+    HookNative(HOOKTYPE_POST, oCallback);
+}
+
+void CFunction::RemoveNativePreHook(object oCallback)
+{
+    UnhookNative(HOOKTYPE_PRE, oCallback);
+}
+
+void CFunction::RemoveNativePostHook(object oCallback)
+{
+    UnhookNative(HOOKTYPE_POST, oCallback);
+}
+
+void CFunction::EnableCache(int iMaxEntries)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    if (iMaxEntries <= 0)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "The cache needs at least one entry.")
+
+    RequireLocal();
+
+    CHook* pHook = g_pHookMngr->HookFunction((void *) m_ulAddr, m_eConv, m_szParams);
+    if (!pHook)
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "Unable to hook the function.")
+
+    if (pHook->m_pRetParam->m_cParam == SIGCHAR_VOID)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Functions without a return value can't be cached.")
+
+    GetMemoCache(pHook, true)->SetMaxEntries(iMaxEntries);
+
+    // The cache should be asked before any other pre-hook is called
+    pHook->AddCallback(HOOKTYPE_PRE, (void *) &MemoPreHook, true);
+
+    pHook->AddCallback(HOOKTYPE_POST, (void *) &MemoPostHook);
+}
+
+void CFunction::DisableCache()
+{
+    CMemoCache* pCache = FindMemoCache();
+    if (!pCache)
+        return;
+
+    CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
+    if (pHook)
+    {
+        pHook->RemoveCallback(HOOKTYPE_PRE, (void *) &MemoPreHook);
+        pHook->RemoveCallback(HOOKTYPE_POST, (void *) &MemoPostHook);
+    }
+
+    // Threads that are still inside the hook might insert a last entry
+    pCache->SetMaxEntries(0);
+    pCache->Invalidate();
+}
+
+void CFunction::InvalidateCache()
+{
+    CMemoCache* pCache = FindMemoCache();
+    if (pCache)
+        pCache->Invalidate();
+}
+
+dict CFunction::GetCacheStats()
+{
+    dict stats;
+    CMemoCache* pCache = FindMemoCache();
+    if (!pCache)
+        return stats;
+
+    MemoStats_t data = pCache->GetStats();
+    unsigned long ulCalls = data.m_ulHits + data.m_ulMisses;
+
+    stats["hits"] = data.m_ulHits;
+    stats["misses"] = data.m_ulMisses;
+    stats["evictions"] = data.m_ulEvictions;
+    stats["invalidations"] = data.m_ulInvalidations;
+    stats["size"] = pCache->GetSize();
+    stats["max_entries"] = pCache->GetMaxEntries();
+    stats["hit_rate"] = ulCalls ? (double) data.m_ulHits / ulCalls : 0.0;
+    return stats;
+}
+
+CMemoCache* CFunction::FindMemoCache()
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
+    return pHook ? GetMemoCache(pHook) : NULL;
+}
+
+void CFunction::StartRecording(int iMaxCalls)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    if (iMaxCalls <= 0)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "At least one call has to be recorded.")
+
+    RequireLocal();
+
+    CHook* pHook = g_pHookMngr->HookFunction((void *) m_ulAddr, m_eConv, m_szParams);
+    if (!pHook)
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "Unable to hook the function.")
+
+    GetArgRecorder(pHook, true)->Start(pHook, iMaxCalls);
+
+    // Record the arguments before other pre-hooks can change them
+    pHook->AddCallback(HOOKTYPE_PRE, (void *) &RecordPreHook, true);
+}
+
+void CFunction::StopRecording()
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
+    if (!pHook)
+        return;
+
+    pHook->RemoveCallback(HOOKTYPE_PRE, (void *) &RecordPreHook);
+
+    CArgRecorder* pRecorder = GetArgRecorder(pHook);
+    if (pRecorder)
+        pRecorder->Stop();
+}
+
+int CFunction::SaveRecording(const char* szPath)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
+    CArgRecorder* pRecorder = pHook ? GetArgRecorder(pHook) : NULL;
+    if (!pRecorder)
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "The function hasn't been recorded.")
+
+    // Don't block the recording threads while writing
+    CArgRecording recording;
+    pRecorder->GetRecording(recording);
+
+    std::string szError;
+    if (!recording.Save(szPath, szError))
+        BOOST_RAISE_EXCEPTION(PyExc_IOError, szError.data())
+
+    return recording.GetCallCount();
+}
+
+dict CFunction::GetRecordingStats()
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    dict stats;
+    CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
+    CArgRecorder* pRecorder = pHook ? GetArgRecorder(pHook) : NULL;
+    if (!pRecorder)
+        return stats;
+
+    stats["enabled"] = pRecorder->IsEnabled();
+    stats["calls"] = pRecorder->GetCallCount();
+    stats["max_calls"] = pRecorder->GetMaxCalls();
+    stats["dropped"] = pRecorder->GetDropped();
+    return stats;
+}
+
+CFunction* CFunction::Redirect(object oTarget)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    RequireLocal();
+
+    unsigned long ulTarget = ExtractPyPtr(oTarget);
+    if (!ulTarget)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Target pointer is NULL.")
+
+    // The bridge and the redirect would overwrite each other
+    if (g_pHookMngr->FindHook((void *) m_ulAddr))
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "Function is hooked.")
+
+    if (IsRedirected())
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "Function is already redirected.")
+
+    CRedirect* pRedirect = g_pHookMngr->RedirectFunction((void *) m_ulAddr, (void *) ulTarget);
+    if (!pRedirect)
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "Unable to redirect the function.")
+
+    CFunction* pOriginal = new CFunction((unsigned long) pRedirect->m_pTrampoline, m_eConv, m_szParams, m_oConverter.ptr());
+    pOriginal->m_StructParams = m_StructParams;
+    pOriginal->m_ConstParams = m_ConstParams;
+    return pOriginal;
+}
+
+void CFunction::RemoveRedirect()
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    g_pHookMngr->RestoreFunction((void *) m_ulAddr);
+}
+
+bool CFunction::IsRedirected()
+{
+    CRedirect* pRedirect = g_pHookMngr->FindRedirect((void *) m_ulAddr);
+    return pRedirect && pRedirect->IsEnabled();
+}
+
+void CFunction::AddTimelineSpan(const char* szName, bool bTick /* = false */)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    RequireLocal();
+
+    CHook* pHook = g_pHookMngr->HookFunction((void *) m_ulAddr, m_eConv, m_szParams);
+    if (!pHook)
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "Unable to hook the function.")
+
+    GetTimeline()->SetSpanName(pHook, szName);
+
+    // The span should enclose all other callbacks
+    void* pPreHook = bTick ? (void *) &TimelineTickPreHook : (void *) &TimelinePreHook;
+    pHook->RemoveCallback(HOOKTYPE_PRE, bTick ? (void *) &TimelinePreHook : (void *) &TimelineTickPreHook);
+    pHook->AddCallback(HOOKTYPE_PRE, pPreHook, true);
+
+    pHook->AddCallback(HOOKTYPE_POST, (void *) &TimelinePostHook);
+}
+
+void CFunction::RemoveTimelineSpan()
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
+    if (!pHook)
+        return;
+
+    pHook->RemoveCallback(HOOKTYPE_PRE, (void *) &TimelinePreHook);
+    pHook->RemoveCallback(HOOKTYPE_PRE, (void *) &TimelineTickPreHook);
+    pHook->RemoveCallback(HOOKTYPE_POST, (void *) &TimelinePostHook);
+}
+
+void CFunction::AddSafePoint(double dBudget /* = 1000 */)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    RequireLocal();
+
+    CHook* pHook = g_pHookMngr->HookFunction((void *) m_ulAddr, m_eConv, m_szParams);
+    if (!pHook)
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "Unable to hook the function.")
+
+    // Safe points are added by the main thread, so it owns the tasks
+    GetExecutor()->SetOwner(GetThreadIdentifier());
+    GetExecutor()->SetBudget(dBudget);
+    pHook->AddCallback(HOOKTYPE_PRE, (void *) &ExecutorPreHook);
+}
+
+void CFunction::RemoveSafePoint()
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
+    if (pHook)
+        pHook->RemoveCallback(HOOKTYPE_PRE, (void *) &ExecutorPreHook);
+}
+
+void CFunction::AddRule(DynamicHooks::Rule_t& rule)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    RequireLocal();
+
+    CHook* pHook = g_pHookMngr->HookFunction((void *) m_ulAddr, m_eConv, m_szParams);
+    if (!pHook)
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "Unable to hook the function.")
+
+    if (!pHook->AddRule(rule))
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, "Unable to compile the rules.")
+}
+
+void CFunction::AddSetRule(int iIndex, object oValue)
+{
+    Rule_t rule;
+    rule.m_eType = RULE_SET_ARGUMENT;
+    rule.m_iIndex = iIndex;
+    rule.m_ullValue = ToRuleValue(GetParamType(iIndex), oValue);
+    rule.m_ullMax = 0;
+    AddRule(rule);
+}
+
+void CFunction::AddClampRule(int iIndex, object oMin, object oMax)
+{
+    char cType = GetParamType(iIndex);
+    if (cType == SIGCHAR_BOOL)
+        BOOST_RAISE_EXCEPTION(PyExc_TypeError, "Booleans can't be clamped.")
+
+    if (extract<bool>(oMin > oMax))
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "The minimum is greater than the maximum.")
+
+    Rule_t rule;
+    rule.m_eType = RULE_CLAMP_ARGUMENT;
+    rule.m_iIndex = iIndex;
+    rule.m_ullValue = ToRuleValue(cType, oMin);
+    rule.m_ullMax = ToRuleValue(cType, oMax);
+    AddRule(rule);
+}
+
+void CFunction::AddSupersedeRule(object oValue /* = object() */)
+{
+    char cType = GetParamType(-1);
+    if (cType != SIGCHAR_VOID && oValue.is_none())
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "A return value is required.")
+
+    Rule_t rule;
+    rule.m_eType = RULE_SUPERSEDE;
+    rule.m_iIndex = 0;
+    rule.m_ullValue = ToRuleValue(cType, oValue);
+    rule.m_ullMax = 0;
+    AddRule(rule);
+}
+
+void CFunction::ClearRules()
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
+    if (pHook)
+        pHook->ClearRules();
+}
+
+list CFunction::GetRules()
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+    list rules;
+    CHook* pHook = g_pHookMngr->FindHook((void *) m_ulAddr);
+    if (!pHook)
+        return rules;
+
+    for(std::list<Rule_t>::iterator it=pHook->m_Rules.begin(); it != pHook->m_Rules.end(); it++)
+    {
+        if (it->m_eType == RULE_SUPERSEDE)
+        {
+            rules.append(boost::python::make_tuple(it->m_eType, object(),
+                FromRuleValue(pHook->m_pRetParam->m_cParam, it->m_ullValue), object()));
+            continue;
+        }
+
+        char cType = pHook->GetArgument(it->m_iIndex)->m_cParam;
+        rules.append(boost::python::make_tuple(it->m_eType, it->m_iIndex,
+            FromRuleValue(cType, it->m_ullValue),
+            it->m_eType == RULE_CLAMP_ARGUMENT ? FromRuleValue(cType, it->m_ullMax) : object()));
+    }
+    return rules;
+}
+
+char CFunction::GetParamType(int iIndex)
+{
+    // Same rules as ParseParams(): "v" doesn't count as a parameter
+    int iCount = 0;
+    char* ptr = m_szParams;
+    while (*ptr != '\0' && *ptr != ')')
+    {
+        if (*ptr != SIGCHAR_VOID)
+        {
+            if (iCount == iIndex)
+                return *ptr;
+
+            iCount++;
+        }
+        ptr++;
+    }
+
+    if (iIndex >= 0)
+        BOOST_RAISE_EXCEPTION(PyExc_IndexError, "Index out of range.")
+
+    if (*ptr == '\0')
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "String parameter has no return type.")
+
+    return *++ptr;
+}
+
+void CFunction::SetParams(char* szParams)
+{
+    strcpy(m_szParams, szParams);
+
+    // The indexes might refer to other types now
+    m_StructParams.clear();
+    m_ConstParams.clear();
+}
+
+const char* CFunction::GetParams()
+{
+    return (const char *) m_szParams;
+}
+
+void CFunction::SetStructParam(int iIndex, object oLayout)
+{
+    if (GetParamType(iIndex) != SIGCHAR_POINTER)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Structs can only be passed to pointer parameters.")
+
+    if (oLayout.is_none())
+        m_StructParams.erase(iIndex);
+    else
+        m_StructParams[iIndex] = extract<LayoutPtr>(oLayout);
+}
+
+dict CFunction::GetStructParams()
+{
+    dict result;
+    for (std::map<int, LayoutPtr>::iterator it=m_StructParams.begin(); it != m_StructParams.end(); it++)
+        result[it->first] = it->second;
+
+    return result;
+}
+
+void CFunction::SetConstParam(int iIndex, bool bConst /* = true */)
+{
+    if (GetParamType(iIndex) != SIGCHAR_POINTER)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Only pointer parameters can be const.")
+
+    if (bConst)
+        m_ConstParams.insert(iIndex);
+    else
+        m_ConstParams.erase(iIndex);
+}
+
+list CFunction::GetConstParams()
+{
+    list result;
+    for (std::set<int>::iterator it=m_ConstParams.begin(); it != m_ConstParams.end(); it++)
+        result.append(*it);
+
+    return result;
+}
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+object FieldValueToObject(char cType, FieldValue_t value, BackendPtr pBackend /* = BackendPtr() */)
+{
+    switch(cType)
+    {
+        case SIGCHAR_BOOL:    return object((bool) value.m_ullValue);
+        case SIGCHAR_POINTER: return object(CPointer((unsigned long) value.m_ullValue, pBackend));
+        case SIGCHAR_STRING:
+        {
+            if (!value.m_ullValue)
+                return object();
+
+            if (pBackend)
+                return object(ReadString(pBackend.get(), (unsigned long) value.m_ullValue));
+
+            return object((const char *) value.m_ullValue);
+        }
+    }
+
+    switch(GetValueClass(cType))
+    {
+        case VALUE_SIGNED: return object(value.m_llValue);
+        case VALUE_FLOAT:  return object(value.m_dValue);
+        default:           return object(value.m_ullValue);
+    }
+}
+
+std::string ReadString(IMemoryBackend* pBackend, unsigned long ulAddr)
+{
+    if (!ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
+
+    // Read small chunks that don't cross a page boundary, so we don't fail
+    // on strings at the end of a mapping
+    std::string result;
+    char szChunk[64];
+    while (true)
+    {
+        unsigned long ulChunk = sizeof(szChunk) - (ulAddr % sizeof(szChunk));
+        ReadMemory(pBackend, ulAddr, szChunk, ulChunk);
+
+        const char* pEnd = (const char *) memchr(szChunk, '\0', ulChunk);
+        if (pEnd)
+            return result.append(szChunk, pEnd - szChunk);
+
+        result.append(szChunk, ulChunk);
+        ulAddr += ulChunk;
+    }
+}
 
-// ============================================================================
-// >> FUNCTIONS
-// ============================================================================
 int GetError()
 {
     return dcGetError(g_pCallVM);
@@ -24,7 +24,13 @@
 // >> INCLUDES
 // ============================================================================
 #include <malloc.h>
+#include <map>
+#include <set>
+#include <string>
 #include "binutils_macros.h"
+#include "binutils_memory.h"
+#include "binutils_layout.h"
+#include "binutils_query.h"
 #include "dyncall.h"
 
 #include "DynamicHooks.h"
@@ -45,6 +51,11 @@ using namespace boost::python;
 // ============================================================================
 inline int GetDynCallConvention(Convention_t eConv)
 {
+#ifdef __x86_64__
+    // There is only one calling convention on x64 (System V AMD64 ABI)
+    (void) eConv;
+    return DC_CALL_C_DEFAULT;
+#else
     switch (eConv)
     {
         case CONV_CDECL: return DC_CALL_C_DEFAULT;
@@ -59,6 +70,7 @@ inline int GetDynCallConvention(Convention_t eConv)
 
     // TODO: Throw exception
     return 0;
+#endif
 }
 
 // ============================================================================
@@ -72,22 +84,59 @@ class CArray;
 
 class CPtrArray;
 
+class CMemoCache;
+
+// ============================================================================
+// >> MEMORY ACCESS
+// ============================================================================
+inline void ReadMemory(IMemoryBackend* pBackend, unsigned long ulAddr, void* pBuffer, unsigned long ulSize)
+{
+    if (!pBackend->Read(ulAddr, pBuffer, ulSize))
+        BOOST_RAISE_EXCEPTION(PyExc_IOError, "Unable to read memory.")
+}
+
+inline void WriteMemory(IMemoryBackend* pBackend, unsigned long ulAddr, const void* pBuffer, unsigned long ulSize)
+{
+    if (!pBackend->Write(ulAddr, pBuffer, ulSize))
+        BOOST_RAISE_EXCEPTION(PyExc_IOError, "Unable to write memory.")
+}
+
+std::string ReadString(IMemoryBackend* pBackend, unsigned long ulAddr);
+
+// Return type of CPointer::Get<T>(). Strings might have to be copied from
+// other address spaces, so they are returned as Python strings.
+template<class T>
+struct GetResult_t
+{
+    typedef T type;
+};
+
+template<>
+struct GetResult_t<const char *>
+{
+    typedef object type;
+};
+
+// Converts a value of ReadFieldValue() (see binutils_query.h)
+object FieldValueToObject(char cType, FieldValue_t value, BackendPtr pBackend = BackendPtr());
+
 // CPointer class
 class CPointer
 {
 public:
     CPointer(unsigned long ulAddr = 0);
+    CPointer(unsigned long ulAddr, BackendPtr pBackend);
 
     operator unsigned long() const { return m_ulAddr; }
 
     // Implement some operators
     template<class T>
     const CPointer operator+(T const& rhs)
-    { return CPointer(m_ulAddr + rhs); }
+    { return CPointer(m_ulAddr + rhs, m_pBackend); }
 
     template<class T>
     const CPointer operator-(T const& rhs)
-    { return CPointer(m_ulAddr - rhs); }
+    { return CPointer(m_ulAddr - rhs, m_pBackend); }
 
     template<class T>
     const CPointer operator+=(T const& rhs)
@@ -109,11 +158,18 @@ public:
     { return m_ulAddr != rhs; }
 
     template<class T>
-    T Get(int iOffset = 0)
+    typename GetResult_t<T>::type Get(int iOffset = 0)
     {
         if (!m_ulAddr)
             BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
 
+        if (m_pBackend)
+        {
+            T value;
+            ReadMemory(m_pBackend.get(), m_ulAddr + iOffset, &value, sizeof(T));
+            return value;
+        }
+
         return *(T *) (m_ulAddr + iOffset);
     }
 
@@ -124,10 +180,16 @@ public:
             BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
 
         unsigned long newAddr = m_ulAddr + iOffset;
+        if (m_pBackend)
+        {
+            WriteMemory(m_pBackend.get(), newAddr, &value, sizeof(T));
+            return;
+        }
+
         *(T *) newAddr = value;
     }
 
-    const char *        GetStringArray(int iOffset = 0);
+    std::string         GetStringArray(int iOffset = 0);
     void                SetStringArray(char* szText, int iOffset = 0, int iSize = -1);
 
     CPointer*           GetPtr(int iOffset = 0);
@@ -140,9 +202,14 @@ public:
     CPointer*           SearchBytes(object oBytes, unsigned long ulNumBytes);
 
     int                 Compare(object oOther, unsigned long ulNum);
+    unsigned long long  Hash(unsigned long ulSize, const char* szAlgorithm = "xxh3");
     void                Copy(object oDest, unsigned long ulNumBytes);
     void                Move(object oDest, unsigned long ulNumBytes);
 
+    // Returns the backend of a destination pointer. Addresses passed as
+    // integers refer to the address space of this pointer.
+    BackendPtr          GetDestBackend(object oDest);
+
     CPointer*           GetVirtualFunc(int iIndex);
 
     void                Realloc(unsigned long ulSize);
@@ -152,13 +219,51 @@ public:
     CFunction*          MakeVirtualFunction(int iIndex, Convention_t eConv, char* szParams, PyObject* pConverter = NULL);
 
     template<class T>
-    CArray<T>           MakeArray(int iLength = -1)  { return CArray<T>(m_ulAddr, iLength); }
+    CArray<T>           MakeArray(int iLength = -1)  { return CArray<T>(m_ulAddr, iLength, m_pBackend); }
     CPtrArray           MakePtrArray(unsigned int iTypeSize, int iLength = -1, PyObject* pConverter = NULL);
 
+    bool                IsRemote() { return m_pBackend.get() != NULL; }
+
+    // Raises an exception if the pointer doesn't refer to the memory of this
+    // process
+    void                RequireLocal();
+
 public:
     unsigned long m_ulAddr;
+
+    // Backend that serves reads and writes. Empty for the current process.
+    BackendPtr    m_pBackend;
 };
 
+// Strings have to be copied from other address spaces
+template<>
+inline object CPointer::Get<const char *>(int iOffset)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
+
+    if (!m_pBackend)
+    {
+        const char* szValue = *(const char **) (m_ulAddr + iOffset);
+        return szValue ? str(szValue) : object();
+    }
+
+    unsigned long ulValue = Get<unsigned long>(iOffset);
+    return ulValue ? str(ReadString(m_pBackend.get(), ulValue)) : object();
+}
+
+template<>
+inline void CPointer::Set<const char *>(const char* value, int iOffset)
+{
+    if (!m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
+
+    if (m_pBackend)
+        BOOST_RAISE_EXCEPTION(PyExc_NotImplementedError, "Cannot store a local string pointer in another address space.")
+
+    *(const char **) (m_ulAddr + iOffset) = value;
+}
+
 
 // CFunction class
 class CFunction: public CPointer
@@ -178,13 +283,84 @@ public:
     void RemovePreHook(PyObject* pCallable);
     void RemovePostHook(PyObject* pCallable);
 
+    // Native callbacks are called directly by DynamicHooks
+    void HookNative(HookType_t eType, object oCallback);
+    void UnhookNative(HookType_t eType, object oCallback);
+
+    void AddNativePreHook(object oCallback);
+    void AddNativePostHook(object oCallback);
+
+    void RemoveNativePreHook(object oCallback);
+    void RemoveNativePostHook(object oCallback);
+
+    // Returns the registered Python callbacks
+    list GetHooks(HookType_t eType);
+    list GetPreHooks();
+    list GetPostHooks();
+
+    // Memoization of pure functions (see binutils_memo.h)
+    void EnableCache(int iMaxEntries = 1024);
+    void DisableCache();
+    void InvalidateCache();
+    dict GetCacheStats();
+
+    // Records the arguments of every call (see binutils_record.h)
+    void StartRecording(int iMaxCalls = 100000);
+    void StopRecording();
+    int  SaveRecording(const char* szPath);
+    dict GetRecordingStats();
+
+    // Replaces the function with a native one (see CRedirect). Returns a
+    // function that calls the original one.
+    CFunction* Redirect(object oTarget);
+    void RemoveRedirect();
+    bool IsRedirected();
+
+    // Records the calls in the timeline (see binutils_timeline.h)
+    void AddTimelineSpan(const char* szName, bool bTick = false);
+    void RemoveTimelineSpan();
+
+    // Drains the tasks of run_on_main() whenever the function is called
+    // (see binutils_executor.h)
+    void AddSafePoint(double dBudget = 1000);
+    void RemoveSafePoint();
+
+    // Rules are compiled into the hook and applied without calling Python
+    void AddSetRule(int iIndex, object oValue);
+    void AddClampRule(int iIndex, object oMin, object oMax);
+    void AddSupersedeRule(object oValue = object());
+    void ClearRules();
+    list GetRules();
+
     void SetParams(char* szPrams);
     const char* GetParams();
 
+    // Pointer parameters that accept sequences and dicts, which are packed
+    // with the layout for the call. Pass None to remove the layout.
+    void SetStructParam(int iIndex, object oLayout);
+    dict GetStructParams();
+
+    // Pointer parameters that also accept read-only buffers (e.g. strings),
+    // because the function doesn't write to them
+    void SetConstParam(int iIndex, bool bConst = true);
+    list GetConstParams();
+
+private:
+    // Returns NULL if the function isn't hooked or has no cache
+    CMemoCache* FindMemoCache();
+
+    void AddRule(DynamicHooks::Rule_t& rule);
+
+    // Returns the type of a parameter or the return type if iIndex is -1
+    char GetParamType(int iIndex);
+
 public:
     char         m_szParams[MAX_PARAMETER_STR];
     Convention_t m_eConv;
     object       m_oConverter;
+
+    std::map<int, LayoutPtr> m_StructParams;
+    std::set<int>            m_ConstParams;
 };
 
 
@@ -193,14 +369,15 @@ template<class T>
 class CArray: public CPointer
 {
 public:
-    CArray(unsigned long ulAddr, int iLength = -1)
+    CArray(unsigned long ulAddr, int iLength = -1, BackendPtr pBackend = BackendPtr())
     {
         m_ulAddr = ulAddr;
+        m_pBackend = pBackend;
         m_iLength = iLength;
         m_iTypeSize = sizeof(T);
     }
 
-    T GetItem(unsigned int iIndex)
+    typename GetResult_t<T>::type GetItem(unsigned int iIndex)
     {
         if (iIndex >= m_iLength && m_iLength != -1)
             BOOST_RAISE_EXCEPTION(PyExc_IndexError, "Index out of range.")
@@ -226,7 +403,7 @@ public:
 class CPtrArray: public CArray<unsigned long>
 {
 public:
-    CPtrArray(unsigned long ulAddr, unsigned int iTypeSize, int iLength = -1, PyObject* pConverter = NULL);
+    CPtrArray(unsigned long ulAddr, unsigned int iTypeSize, int iLength = -1, PyObject* pConverter = NULL, BackendPtr pBackend = BackendPtr());
 
     object GetItem(unsigned int iIndex);
     void   SetItem(unsigned int iIndex, object oValue);
@@ -236,6 +413,79 @@ public:
 };
 
 
+// CArrayView class
+/*
+    Lazy view of a large native table. Elements are converted in pages of
+    m_uiPageSize elements when one of them is accessed for the first time.
+    Elements of indirect tables are pointers to the objects, which might be
+    NULL. Views returned by Filter() contain the matching elements of their
+    base view.
+*/
+class CArrayView
+{
+public:
+    CArrayView(unsigned long ulAddr, unsigned int uiStride, unsigned int uiLength, object oConverter,
+        bool bIndirect = false, unsigned int uiPageSize = 256, BackendPtr pBackend = BackendPtr());
+
+    unsigned int GetLength();
+    object GetItem(int iIndex);
+
+    // Returns a new view of all elements that match all predicates. NULL
+    // elements never match.
+    boost::shared_ptr<CArrayView> Filter(const std::vector<FieldPredicate_t>& predicates);
+
+    // Reads a field of every element without converting the elements.
+    // NULL elements result in None.
+    list Map(unsigned long ulOffset, char cType);
+
+    list GetAddresses();
+    unsigned int GetLoadedPages() { return m_uiLoadedPages; }
+
+private:
+    void GetElementAddresses(unsigned int uiFirst, unsigned int uiCount, std::vector<unsigned long>& addresses);
+
+    // Returns the first ulExtent bytes of every element of a page (NULL for
+    // NULL elements). Local elements aren't copied.
+    void ReadPage(unsigned int uiPage, unsigned long ulExtent, std::vector<unsigned long>& addresses,
+        std::string& buffer, std::vector<const char *>& data);
+
+public:
+    unsigned long m_ulAddr;
+    unsigned int  m_uiStride;
+    bool          m_bIndirect;
+    unsigned int  m_uiPageSize;
+    object        m_oConverter;
+    BackendPtr    m_pBackend;
+
+    // Used to look up fields by name. Might be empty.
+    LayoutPtr     m_pLayout;
+
+private:
+    unsigned int  m_uiLength;
+
+    // Element addresses of filtered views
+    bool                       m_bFiltered;
+    std::vector<unsigned long> m_Addresses;
+
+    // Converted pages. None if a page hasn't been converted yet.
+    std::vector<object>        m_Pages;
+    unsigned int               m_uiLoadedPages;
+};
+
+class CArrayViewIterator
+{
+public:
+    CArrayViewIterator(object oView);
+
+    object Next();
+
+private:
+    object        m_oView;
+    CArrayView*   m_pView;
+    unsigned int  m_uiIndex;
+};
+
+
 // ============================================================================
 // >> FUNCTIONS
 // ============================================================================
@@ -258,6 +508,12 @@ inline unsigned long ExtractPyPtr(object obj)
     return pPtr->GetAddress();
 }
 
+inline CPointer* NewPointer(unsigned long ulAddr = 0)
+{
+    // Pointers created from Python use the default backend
+    return new CPointer(ulAddr, GetDefaultBackend());
+}
+
 inline CPointer* Alloc(unsigned long ulSize)
 {
     return new CPointer((unsigned long) malloc(ulSize));
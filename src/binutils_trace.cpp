@@ -0,0 +1,127 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <stdio.h>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#include "binutils_trace.h"
+#include "binutils_thread.h"
+
+
+// ============================================================================
+// >> HELPER FUNCTIONS
+// ============================================================================
+inline double GetMicroseconds()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER s_Frequency = {0};
+    if (!s_Frequency.QuadPart)
+        QueryPerformanceFrequency(&s_Frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart * 1000000.0 / (double) s_Frequency.QuadPart;
+#elif defined(__linux__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+#else
+    #error "Implement me!"
+#endif
+}
+
+
+// ============================================================================
+// >> CTracer
+// ============================================================================
+CTracer::CTracer()
+{
+    m_bEnabled = false;
+    m_dStart = GetMicroseconds();
+}
+
+double CTracer::Now()
+{
+    return GetMicroseconds() - m_dStart;
+}
+
+void CTracer::AddEvent(const TraceEvent_t& event)
+{
+    if (m_bEnabled)
+        m_Events.push_back(event);
+}
+
+
+// ============================================================================
+// >> CTraceScope
+// ============================================================================
+CTraceScope::CTraceScope(const char* szCategory, const char* szName /* = "" */)
+{
+    CTracer* pTracer = GetTracer();
+    m_bEnabled = pTracer->IsEnabled();
+    if (!m_bEnabled)
+        return;
+
+    m_Event.m_szCategory = szCategory;
+    m_Event.m_szName = szName;
+    m_Event.m_ulThread = GetThreadIdentifier();
+    m_Event.m_ulBytes = 0;
+    m_Event.m_iCacheHit = -1;
+    m_Event.m_dStart = pTracer->Now();
+}
+
+CTraceScope::~CTraceScope()
+{
+    if (!m_bEnabled)
+        return;
+
+    CTracer* pTracer = GetTracer();
+    m_Event.m_dDuration = pTracer->Now() - m_Event.m_dStart;
+    pTracer->AddEvent(m_Event);
+}
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+CTracer* GetTracer()
+{
+    static CTracer* s_pTracer = new CTracer();
+    return s_pTracer;
+}
+
+std::string FormatBytes(const unsigned char* pBytes, int iLength)
+{
+    std::string result;
+    char szByte[4];
+    for (int i=0; i < iLength; i++)
+    {
+        sprintf(szByte, i ? " %02X" : "%02X", pBytes[i]);
+        result += szByte;
+    }
+    return result;
+}
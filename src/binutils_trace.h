@@ -0,0 +1,120 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+#ifndef _BINUTILS_TRACE_H
+#define _BINUTILS_TRACE_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <string>
+#include <vector>
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+struct TraceEvent_t
+{
+    std::string   m_szCategory;
+    std::string   m_szName;
+    unsigned long m_ulThread;
+
+    // Microseconds since the tracer has been created
+    double        m_dStart;
+    double        m_dDuration;
+
+    // Number of bytes that have been scanned or read
+    unsigned long m_ulBytes;
+
+    // -1 = no cache involved, 0 = cache miss, 1 = cache hit
+    int           m_iCacheHit;
+};
+
+
+class CTracer
+{
+public:
+    CTracer();
+
+    void   Enable(bool bEnable) { m_bEnabled = bEnable; }
+    bool   IsEnabled() { return m_bEnabled; }
+
+    /*
+        Returns the number of microseconds since the tracer has been created.
+    */
+    double Now();
+
+    void   AddEvent(const TraceEvent_t& event);
+    void   Clear() { m_Events.clear(); }
+
+    const std::vector<TraceEvent_t>& GetEvents() { return m_Events; }
+
+private:
+    bool                      m_bEnabled;
+    double                    m_dStart;
+    std::vector<TraceEvent_t> m_Events;
+};
+
+
+/*
+    Measures the time between its creation and destruction and adds an event
+    to the tracer. Does nothing if tracing is disabled.
+
+    {
+        CTraceScope scope("find_signature");
+        if (scope.IsEnabled())
+            scope.SetName(FormatBytes(pSignature, iLength));
+        ...
+        scope.SetBytes(ulScanned);
+    }
+*/
+class CTraceScope
+{
+public:
+    CTraceScope(const char* szCategory, const char* szName = "");
+    ~CTraceScope();
+
+    bool IsEnabled() { return m_bEnabled; }
+
+    void SetName(const std::string& szName) { m_Event.m_szName = szName; }
+    void SetBytes(unsigned long ulBytes) { m_Event.m_ulBytes = ulBytes; }
+    void SetCacheHit(bool bHit) { m_Event.m_iCacheHit = bHit; }
+
+private:
+    bool         m_bEnabled;
+    TraceEvent_t m_Event;
+};
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+/*
+    Returns a pointer to a static CTracer object.
+*/
+CTracer* GetTracer();
+
+/*
+    Returns a hex representation of the given bytes, e.g. "55 8B EC 2A".
+*/
+std::string FormatBytes(const unsigned char* pBytes, int iLength);
+
+#endif // _BINUTILS_TRACE_H
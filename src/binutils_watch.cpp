@@ -0,0 +1,318 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+    #include <dirent.h>
+    #include <time.h>
+    #include <unistd.h>
+    #include <sys/ioctl.h>
+    #include <sys/mman.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <linux/perf_event.h>
+    #include <linux/hw_breakpoint.h>
+#endif
+
+#include "binutils_watch.h"
+
+
+// ============================================================================
+// >> HELPER FUNCTIONS
+// ============================================================================
+#ifdef __linux__
+/*
+    Returns the names of all entries of a /proc directory, or false if it
+    can't be read.
+*/
+static bool ListProcDirectory(const char* szPath, std::vector<std::string>& names)
+{
+    DIR* pDir = opendir(szPath);
+    if (!pDir)
+        return false;
+
+    struct dirent* pEntry;
+    while ((pEntry = readdir(pDir)) != NULL)
+    {
+        if (pEntry->d_name[0] != '.')
+            names.push_back(pEntry->d_name);
+    }
+    closedir(pDir);
+    return true;
+}
+#endif
+
+
+// ============================================================================
+// >> CHardwareWatch
+// ============================================================================
+CHardwareWatch::CHardwareWatch()
+{
+    m_ulAddr = 0;
+    m_iLength = 0;
+    m_eMode = WATCH_WRITE;
+    m_ullLost = 0;
+}
+
+CHardwareWatch::~CHardwareWatch()
+{
+    Stop();
+}
+
+bool CHardwareWatch::Start(unsigned long ulAddr, int iLength, WatchMode_t eMode, int iPages, std::string& szError)
+{
+#ifdef __linux__
+    CMutexLock lock(m_Mutex);
+    szError.clear();
+    if (!m_Events.empty())
+    {
+        szError = "The watch is already active.";
+        return false;
+    }
+
+    if (eMode != WATCH_EXECUTE && iLength != 1 && iLength != 2 && iLength != 4 && iLength != 8)
+    {
+        szError = "The length must be 1, 2, 4 or 8.";
+        return false;
+    }
+
+    if (eMode != WATCH_EXECUTE && ulAddr % iLength)
+    {
+        szError = "The address must be aligned to the length.";
+        return false;
+    }
+
+    if (iPages <= 0 || (iPages & (iPages - 1)))
+    {
+        szError = "The number of pages must be a power of 2.";
+        return false;
+    }
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_BREAKPOINT;
+    attr.size = sizeof(attr);
+    attr.bp_addr = ulAddr;
+    attr.sample_period = 1;
+    attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME;
+    attr.use_clockid = 1;
+    attr.clockid = CLOCK_MONOTONIC;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // Threads that are created later report to the ring of their creator
+    attr.inherit = 1;
+
+    switch (eMode)
+    {
+        case WATCH_WRITE:     attr.bp_type = HW_BREAKPOINT_W; attr.bp_len = iLength; break;
+        case WATCH_READWRITE: attr.bp_type = HW_BREAKPOINT_RW; attr.bp_len = iLength; break;
+        case WATCH_EXECUTE:   attr.bp_type = HW_BREAKPOINT_X; attr.bp_len = sizeof(long); break;
+    }
+
+    std::vector<std::string> threads;
+    if (!ListProcDirectory("/proc/self/task", threads))
+    {
+        szError = "Unable to list the threads of the process.";
+        return false;
+    }
+
+    // Inherited events can only be mapped if they are bound to a CPU. So
+    // every thread gets an event per CPU and all events of a CPU write to
+    // the ring of the first one.
+    int iCPUs = sysconf(_SC_NPROCESSORS_CONF);
+
+    // Every event needs a file descriptor. Check the limit up front instead
+    // of failing with EMFILE after a few hundred events.
+    std::vector<std::string> files;
+    struct rlimit limit;
+    if (ListProcDirectory("/proc/self/fd", files) && getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+    {
+        unsigned long ulNeeded = threads.size() * iCPUs;
+        unsigned long ulFree = limit.rlim_cur > files.size() ? limit.rlim_cur - files.size() : 0;
+        if (ulNeeded > ulFree)
+        {
+            char szMessage[256];
+            snprintf(szMessage, sizeof(szMessage), "Watching %lu threads on %d CPUs needs %lu file descriptors, but only %lu "
+                "of %lu are free. Raise RLIMIT_NOFILE (ulimit -n).", (unsigned long) threads.size(), iCPUs, ulNeeded,
+                ulFree, (unsigned long) limit.rlim_cur);
+            szError = szMessage;
+            return false;
+        }
+    }
+
+    std::vector<int> rings(iCPUs, -1);
+    unsigned long ulPageSize = sysconf(_SC_PAGESIZE);
+    for (size_t i=0; i < threads.size() && szError.empty(); i++)
+    {
+        pid_t tid = atoi(threads[i].c_str());
+        for (int iCPU=0; iCPU < iCPUs; iCPU++)
+        {
+            int iFile = syscall(__NR_perf_event_open, &attr, tid, iCPU, -1, PERF_FLAG_FD_CLOEXEC);
+            if (iFile == -1)
+            {
+                // The thread has exited in the meantime or the CPU is offline
+                if (errno == ESRCH || errno == ENODEV)
+                    continue;
+
+                szError = errno == ENOSPC ? "No free debug register." : strerror(errno);
+                break;
+            }
+
+            WatchEvent_t event = {iFile, NULL, 0};
+            if (rings[iCPU] != -1)
+            {
+                if (ioctl(iFile, PERF_EVENT_IOC_SET_OUTPUT, rings[iCPU]) == -1)
+                {
+                    close(iFile);
+                    szError = "Unable to redirect the samples.";
+                    break;
+                }
+            }
+            else
+            {
+                // One header page and the data pages
+                event.m_ulRingSize = (iPages + 1) * ulPageSize;
+                void* pRing = mmap(NULL, event.m_ulRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, iFile, 0);
+                if (pRing == MAP_FAILED)
+                {
+                    close(iFile);
+                    szError = "Unable to map the ring buffer.";
+                    break;
+                }
+
+                event.m_pRing = (unsigned char *) pRing;
+                rings[iCPU] = iFile;
+            }
+            m_Events.push_back(event);
+        }
+    }
+
+    if (!szError.empty() || m_Events.empty())
+    {
+        if (szError.empty())
+            szError = "Unable to watch any thread.";
+
+        Close();
+        return false;
+    }
+
+    m_ulAddr = ulAddr;
+    m_iLength = eMode == WATCH_EXECUTE ? sizeof(long) : iLength;
+    m_eMode = eMode;
+    m_ullLost = 0;
+    return true;
+#else
+    szError = "Hardware watches are only supported on Linux.";
+    return false;
+#endif
+}
+
+void CHardwareWatch::Stop()
+{
+    CMutexLock lock(m_Mutex);
+    Close();
+}
+
+void CHardwareWatch::Close()
+{
+#ifdef __linux__
+    for (size_t i=0; i < m_Events.size(); i++)
+    {
+        if (m_Events[i].m_pRing)
+            munmap(m_Events[i].m_pRing, m_Events[i].m_ulRingSize);
+
+        close(m_Events[i].m_iFile);
+    }
+#endif
+    m_Events.clear();
+}
+
+void CHardwareWatch::Drain(std::vector<WatchHit_t>& hits)
+{
+    CMutexLock lock(m_Mutex);
+    for (size_t i=0; i < m_Events.size(); i++)
+    {
+        if (m_Events[i].m_pRing)
+            DrainEvent(m_Events[i], hits);
+    }
+}
+
+void CHardwareWatch::DrainEvent(WatchEvent_t& event, std::vector<WatchHit_t>& hits)
+{
+#ifdef __linux__
+    struct perf_event_mmap_page* pHeader = (struct perf_event_mmap_page *) event.m_pRing;
+    unsigned long ulPageSize = sysconf(_SC_PAGESIZE);
+    unsigned char* pData = event.m_pRing + ulPageSize;
+    unsigned long ulDataSize = event.m_ulRingSize - ulPageSize;
+
+    // Pairs with the barrier of the kernel after writing the samples
+    unsigned long long ullHead = pHeader->data_head;
+    __sync_synchronize();
+
+    unsigned long long ullTail = pHeader->data_tail;
+    unsigned char record[256];
+    while (ullTail < ullHead)
+    {
+        // Records might wrap around the end of the ring
+        struct perf_event_header header;
+        for (unsigned int i=0; i < sizeof(header); i++)
+            ((unsigned char *) &header)[i] = pData[(ullTail + i) % ulDataSize];
+
+        if (header.size < sizeof(header) || header.size > sizeof(record))
+        {
+            // Broken record. Skip everything that has been written.
+            ullTail = ullHead;
+            break;
+        }
+
+        for (unsigned int i=0; i < header.size; i++)
+            record[i] = pData[(ullTail + i) % ulDataSize];
+
+        unsigned long long* pValues = (unsigned long long *) (record + sizeof(header));
+        if (header.type == PERF_RECORD_SAMPLE)
+        {
+            // ip, pid/tid, time
+            WatchHit_t hit;
+            hit.m_ulPC = pValues[0];
+            hit.m_ulThread = (unsigned int) (pValues[1] >> 32);
+            hit.m_ullTime = pValues[2];
+            hits.push_back(hit);
+        }
+        else if (header.type == PERF_RECORD_LOST)
+        {
+            // id, lost
+            m_ullLost += pValues[1];
+        }
+        ullTail += header.size;
+    }
+
+    // Don't let the kernel overwrite the samples before they have been read
+    __sync_synchronize();
+    pHeader->data_tail = ullTail;
+#endif
+}
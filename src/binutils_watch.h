@@ -0,0 +1,120 @@
+/**
+* =============================================================================
+* binutils
+* Copyright(C) 2013 Ayuto. All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+#ifndef _BINUTILS_WATCH_H
+#define _BINUTILS_WATCH_H
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <string>
+#include <vector>
+
+#include "binutils_thread.h"
+
+
+// ============================================================================
+// >> CLASSES
+// ============================================================================
+enum WatchMode_t
+{
+    WATCH_WRITE,
+    WATCH_READWRITE,
+    WATCH_EXECUTE
+};
+
+struct WatchHit_t
+{
+    // Address of the instruction after the one that has accessed the watched
+    // range (data watches) or the watched address (execute watches)
+    unsigned long      m_ulPC;
+    unsigned long      m_ulThread;
+
+    // Nanoseconds of CLOCK_MONOTONIC
+    unsigned long long m_ullTime;
+};
+
+/*
+    Watches a range of memory with a hardware breakpoint (debug register) of
+    every thread of the process. The kernel writes a sample to a ring buffer
+    whenever the range is accessed, so there is no overhead until then.
+
+    Threads that exist when the watch is started get an event per CPU.
+    Threads that are created later inherit the events of the creating
+    thread. All events of a CPU write to the same ring buffer.
+
+    Only supported on Linux. This file doesn't depend on Python.
+*/
+class CHardwareWatch
+{
+public:
+    CHardwareWatch();
+    ~CHardwareWatch();
+
+    /*
+        Starts watching. iLength must be 1, 2, 4 or 8 and the address must be
+        aligned to it. Execute watches always cover one instruction. iPages
+        is the size of each ring buffer and must be a power of 2.
+    */
+    bool Start(unsigned long ulAddr, int iLength, WatchMode_t eMode, int iPages, std::string& szError);
+    void Stop();
+
+    bool IsActive() { return !m_Events.empty(); }
+
+    /*
+        Moves all samples from the ring buffers to hits. Samples that didn't
+        fit into a full ring buffer are counted by GetLost().
+    */
+    void Drain(std::vector<WatchHit_t>& hits);
+
+    unsigned long      GetAddress() { return m_ulAddr; }
+    int                GetLength() { return m_iLength; }
+    WatchMode_t        GetMode() { return m_eMode; }
+    int                GetEventCount() { return (int) m_Events.size(); }
+    unsigned long long GetLost() { return m_ullLost; }
+
+private:
+    // Don't copy the file descriptors
+    CHardwareWatch(const CHardwareWatch&);
+    CHardwareWatch& operator=(const CHardwareWatch&);
+
+    struct WatchEvent_t
+    {
+        int            m_iFile;
+
+        // NULL if the samples are written to the ring of another event
+        unsigned char* m_pRing;
+        unsigned long  m_ulRingSize;
+    };
+
+    // Closes all events. The mutex has to be locked.
+    void Close();
+    void DrainEvent(WatchEvent_t& event, std::vector<WatchHit_t>& hits);
+
+private:
+    CMutex                    m_Mutex;
+    unsigned long             m_ulAddr;
+    int                       m_iLength;
+    WatchMode_t               m_eMode;
+    unsigned long long        m_ullLost;
+    std::vector<WatchEvent_t> m_Events;
+};
+
+#endif // _BINUTILS_WATCH_H
@@ -20,11 +20,25 @@
 // ============================================================================
 // >> INCLUDES
 // ============================================================================
+#include <errno.h>
+#include <stdlib.h>
+
 #include "binutils_macros.h"
 #include "binutils_scanner.h"
 #include "binutils_tools.h"
 #include "binutils_hooks.h"
 #include "binutils_callback.h"
+#include "binutils_core.h"
+#include "binutils_elf.h"
+#include "binutils_memory.h"
+#include "binutils_remote.h"
+#include "binutils_thread.h"
+#include "binutils_trace.h"
+#include "binutils_timeline.h"
+#include "binutils_layout.h"
+#include "binutils_watch.h"
+#include "binutils_integrity.h"
+#include "binutils_executor.h"
 
 #include "dyncall.h"
 
@@ -34,18 +48,38 @@ void ExposeArrays();
 void ExposeDynCall();
 void ExposeDynamicHooks();
 void ExposeCallbacks();
+void ExposeTrace();
+void ExposeTimeline();
+void ExposeMemory();
+void ExposeLayout();
+void ExposeWatch();
+void ExposeIntegrity();
+void ExposeExecutor();
+void ExposeQuery();
 
 // ============================================================================
 // >> Expose the binutils module
 // ============================================================================
 BOOST_PYTHON_MODULE(_binutils)
 {
+    // Hooks and callbacks might be called by other threads. They acquire the
+    // GIL, so it has to exist.
+    PyEval_InitThreads();
+
     ExposeScanner();
     ExposeTools();
     ExposeArrays();
     ExposeDynCall();
     ExposeDynamicHooks();
     ExposeCallbacks();
+    ExposeTrace();
+    ExposeTimeline();
+    ExposeMemory();
+    ExposeLayout();
+    ExposeWatch();
+    ExposeIntegrity();
+    ExposeExecutor();
+    ExposeQuery();
 }
 
 // ============================================================================
@@ -53,6 +87,12 @@ BOOST_PYTHON_MODULE(_binutils)
 // ============================================================================
 // Overloads
 BOOST_PYTHON_FUNCTION_OVERLOADS(find_binary_overload, FindBinary, 1, 2);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(find_signatures_overload, CBinaryFile::FindSignatures, 1, 2)
+
+object SymbolizeAddress(unsigned long ulAddr)
+{
+    return Symbolize(BackendPtr(), ulAddr);
+}
 
 void ExposeScanner()
 {
@@ -80,6 +120,19 @@ void ExposeScanner()
             manage_new_object_policy()
         )
 
+        .def("find_signatures",
+            &CBinaryFile::FindSignatures,
+            find_signatures_overload(
+                args("signatures", "threads"),
+                "Searches for all signatures in a single multi-threaded pass. Returns a list of pointers.")
+        )
+
+        .def("find_symbols",
+            &CBinaryFile::FindSymbols,
+            "Returns a list with the addresses of all given symbols. The symbol table is only read once.",
+            args("symbols")
+        )
+
         // Special methods
         .def("__getitem__",
             &CBinaryFile::FindSymbol,
@@ -88,23 +141,46 @@ void ExposeScanner()
             manage_new_object_policy()
         )
 
+        .def("symbolize",
+            &CBinaryFile::Symbolize,
+            "Returns a (symbol, offset) tuple of the closest symbol at or before the given address or None.",
+            args("addr")
+        )
+
         // Properties
         .add_property("address",
             &CBinaryFile::GetAddress,
             "Returns the base address of this binary."
         )
 
+        .add_property("path",
+            &CBinaryFile::GetPath,
+            "Returns the path of the file this binary has been loaded from."
+        )
+
         .add_property("size",
             &CBinaryFile::GetSize,
             "Returns the size of this binary."
         )
+
+        .add_property("load_bias",
+            (unsigned long (CBinaryFile::*)()) &CBinaryFile::GetLoadBias,
+            "Returns the value that has to be added to a virtual address of the binary's file to get an address of this binary."
+        )
     ;
 
     def("find_binary",
-        &FindBinary,
+        (CBinaryFile* (*)(char*, bool)) &FindBinary,
         find_binary_overload(
             args("path", "srv_check"),
-            "Returns a CBinaryFile object or None.")[reference_existing_object_policy()]
+            "Returns a CBinaryFile object or None. Uses the default memory backend if one is set.")[reference_existing_object_policy()]
+    );
+
+    def("symbolize",
+        &SymbolizeAddress,
+        "Returns a (module, symbol, offset) tuple for the given address of this process or None if it doesn't belong to a module. "\
+        "Use MemoryBackend.symbolize() for addresses of a memory backend.",
+        args("addr")
     );
 }
 
@@ -115,6 +191,13 @@ void ExposeScanner()
 // Overloads
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(make_function_overload, CPointer::MakeFunction, 2, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(make_virtual_function_overload, CPointer::MakeVirtualFunction, 3, 4)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(hash_overload, CPointer::Hash, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(enable_cache_overload, CFunction::EnableCache, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(add_timeline_span_overload, CFunction::AddTimelineSpan, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(add_safe_point_overload, CFunction::AddSafePoint, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(add_supersede_rule_overload, CFunction::AddSupersedeRule, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(start_recording_overload, CFunction::StartRecording, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(set_const_param_overload, CFunction::SetConstParam, 1, 2)
 
 // get_<type> methods
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(get_bool_overload,         CPointer::Get<bool>, 0, 1)
@@ -172,7 +255,8 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(make_ptr_array_overload,        CPointer:
 void ExposeTools()
 {
     // CPointer class
-    class_<CPointer>("Pointer", init< optional<unsigned long> >())
+    class_<CPointer>("Pointer", no_init)
+        .def("__init__", make_constructor(&NewPointer, default_call_policies(), (arg("addr")=0)))
         .def(init<const CPointer&>())
 
         // Class methods
@@ -222,6 +306,14 @@ void ExposeTools()
             args("other", "num")
         )
 
+        .def("hash",
+            &CPointer::Hash,
+            hash_overload(
+                args("size", "algo"),
+                "Returns the 64 bit hash of the first <size> bytes. Supported algorithms are 'xxh3' (vectorized) and 'xxh64'. "\
+                "Results match the reference implementations with seed 0.")
+        )
+
         .def("is_overlapping",
             &CPointer::IsOverlapping,
             "Returns True if the pointers are overlapping each other.",
@@ -237,13 +329,13 @@ void ExposeTools()
 
         .def("copy",
             &CPointer::Copy,
-            "Copies <num_bytes> from <self> to the pointer <destination>. Overlapping is not allowed!",
+            "Copies <num_bytes> from <self> to the pointer <destination>. Overlapping is not allowed! Both pointers may belong to different address spaces. Integer destinations belong to the address space of <self>.",
             args("destination", "num_bytes")
         )
 
         .def("move",
             &CPointer::Move,
-            "Copies <num_bytes> from <self> to the pointer <destination>. Overlapping is allowed!",
+            "Copies <num_bytes> from <self> to the pointer <destination>. Overlapping is allowed! Both pointers may belong to different address spaces. Integer destinations belong to the address space of <self>.",
             args("destination", "num_bytes")
         )
 
@@ -628,11 +720,21 @@ void ExposeTools()
            "Returns the address of this memory block."
         )
 
+        .def_readwrite("backend",
+            &CPointer::m_pBackend,
+            "Returns the memory backend of this pointer or None if it refers to the memory of this process."
+        )
+
         // Properties
         .add_property("size",
             &CPointer::GetSize,
             "Returns the size of this memory block."
         )
+
+        .add_property("remote",
+            &CPointer::IsRemote,
+            "Returns True if this pointer doesn't refer to the memory of this process."
+        )
     ;
 
 
@@ -643,7 +745,8 @@ void ExposeTools()
         // Class methods
         CLASS_METHOD_VARIADIC("__call__",
             &CFunction::__call__,
-            "Calls the function dynamically."
+            "Calls the function dynamically. Pointer parameters accept integers, pointers and every object that supports the buffer protocol "\
+            "(e.g. bytes, bytearray or array). Buffers are pinned until the call returns. See set_struct_param() for sequences."
         )
 
         CLASS_METHOD_VARIADIC("call_trampoline",
@@ -671,13 +774,169 @@ void ExposeTools()
             "Removes a post-hook callback."
         )
 
+        .def("add_native_pre_hook",
+            &CFunction::AddNativePreHook,
+            args("callback"),
+            "Adds the address of a native pre-hook callback: bool (*)(int hook_type, CHook* hook). It's called without acquiring the GIL."
+        )
+
+        .def("add_native_post_hook",
+            &CFunction::AddNativePostHook,
+            args("callback"),
+            "Adds the address of a native post-hook callback: bool (*)(int hook_type, CHook* hook). It's called without acquiring the GIL."
+        )
+
+        .def("remove_native_pre_hook",
+            &CFunction::RemoveNativePreHook,
+            args("callback"),
+            "Removes a native pre-hook callback. The function stays hooked."
+        )
+
+        .def("remove_native_post_hook",
+            &CFunction::RemoveNativePostHook,
+            args("callback"),
+            "Removes a native post-hook callback. The function stays hooked."
+        )
+
+        .def("enable_cache",
+            &CFunction::EnableCache,
+            enable_cache_overload(
+                args("max_entries"),
+                "Caches the return value by arguments in native code (LRU). Calls with cached arguments don't call the original function. Only use it for pure functions.")
+        )
+
+        .def("disable_cache",
+            &CFunction::DisableCache,
+            "Disables and clears the cache. The function stays hooked."
+        )
+
+        .def("invalidate_cache",
+            &CFunction::InvalidateCache,
+            "Removes all cached return values."
+        )
+
+        .def("start_recording",
+            &CFunction::StartRecording,
+            start_recording_overload(
+                args("max_calls"),
+                "Records the arguments of every call in native code until <max_calls> calls have been recorded. Previously recorded calls are removed.")
+        )
+
+        .def("stop_recording",
+            &CFunction::StopRecording,
+            "Stops recording the arguments. The function stays hooked."
+        )
+
+        .def("save_recording",
+            &CFunction::SaveRecording,
+            args("path"),
+            "Writes the recorded calls to a file that can be loaded with Recording(). Returns the number of written calls."
+        )
+
+        .def("add_timeline_span",
+            &CFunction::AddTimelineSpan,
+            add_timeline_span_overload(
+                args("name", "tick"),
+                "Records every call of the function as a span in the timeline. If <tick> is True, every call starts a new tick.")
+        )
+
+        .def("remove_timeline_span",
+            &CFunction::RemoveTimelineSpan,
+            "Stops recording the function in the timeline. The function stays hooked."
+        )
+
+        .def("add_safe_point",
+            &CFunction::AddSafePoint,
+            add_safe_point_overload(
+                args("budget"),
+                "Runs the tasks of run_on_main() whenever the function is called, but for at most <budget> microseconds per call. "\
+                "Choose a frame function of the engine that is called by the main thread while it doesn't hold any locks. Call this on "\
+                "the main thread: calls of the function by other threads don't run tasks.")
+        )
+
+        .def("remove_safe_point",
+            &CFunction::RemoveSafePoint,
+            "Stops running tasks when the function is called. The function stays hooked."
+        )
+
+        .def("add_set_rule",
+            &CFunction::AddSetRule,
+            args("index", "value"),
+            "Sets the argument at the given index to a constant whenever the function is called. The rule is compiled into the hook and doesn't call Python."
+        )
+
+        .def("add_clamp_rule",
+            &CFunction::AddClampRule,
+            args("index", "minimum", "maximum"),
+            "Clamps the argument at the given index to a range whenever the function is called. The rule is compiled into the hook and doesn't call Python."
+        )
+
+        .def("add_supersede_rule",
+            &CFunction::AddSupersedeRule,
+            add_supersede_rule_overload(
+                args("value"),
+                "Returns the given value without calling the original function or any callback.")
+        )
+
+        .def("clear_rules",
+            &CFunction::ClearRules,
+            "Removes all rules. The function stays hooked."
+        )
+
+        .def("set_struct_param",
+            &CFunction::SetStructParam,
+            args("index", "layout"),
+            "Lets the pointer parameter at the given index accept a sequence with one value per field of the Layout or a dict of values by "\
+            "field name. The struct is packed into a scratch buffer of the calling thread for the duration of the call. Pass None to remove the layout."
+        )
+
+        .def("set_const_param",
+            &CFunction::SetConstParam,
+            set_const_param_overload(
+                args("index", "const"),
+                "Lets the pointer parameter at the given index (and the pointer fields of its struct) accept read-only buffers like strings. "\
+                "Only use it if the function doesn't write to the memory. Other pointer parameters require writable buffers.")
+        )
+
+        .def("redirect",
+            &CFunction::Redirect,
+            args("target"),
+            "Patches the entry of the function with a jump to the given native function. Returns a Function object that calls the original function, so the replacement can chain to it.",
+            manage_new_object_policy()
+        )
+
+        .def("remove_redirect",
+            &CFunction::RemoveRedirect,
+            "Restores the original function. Functions returned by redirect() stay valid."
+        )
+
         // Attributes
+        .add_property("is_redirected",
+            &CFunction::IsRedirected,
+            "Returns True if the function is redirected."
+        )
+
+        .add_property("rules",
+            &CFunction::GetRules,
+            "Returns a list of all rules in the order they are applied: (type, index, value, maximum)."
+        )
+
         .add_property("parameters",
             &CFunction::GetParams,
             &CFunction::SetParams,
             "Returns the parameter string."
         )
 
+        .add_property("struct_params",
+            &CFunction::GetStructParams,
+            "Returns a dict of the layouts of struct parameters by index."
+        )
+
+        .add_property("const_params",
+            &CFunction::GetConstParams,
+            "Returns a list of the indexes of const pointer parameters."
+        )
+
         .def_readwrite("convention",
             &CFunction::m_eConv,
             "Returns the calling convention."
@@ -687,6 +946,26 @@ void ExposeTools()
             &CFunction::m_oConverter,
             "Returns the converter."
         )
+
+        .add_property("cache_stats",
+            &CFunction::GetCacheStats,
+            "Returns a dict with the hits, misses, evictions, invalidations, size, max_entries and hit_rate of the cache. Empty if the cache has never been enabled."
+        )
+
+        .add_property("recording_stats",
+            &CFunction::GetRecordingStats,
+            "Returns a dict with the number of recorded and dropped calls, max_calls and enabled. Empty if the function has never been recorded."
+        )
+
+        .add_property("pre_hooks",
+            &CFunction::GetPreHooks,
+            "Returns a list of all registered pre-hook callbacks."
+        )
+
+        .add_property("post_hooks",
+            &CFunction::GetPostHooks,
+            "Returns a list of all registered post-hook callbacks."
+        )
     ;
 
     DEFINE_CLASS_METHOD_VARIADIC(Function, __call__);
@@ -712,6 +991,108 @@ void ExposeTools()
         .def_readwrite("size", &CArray<type>::m_iTypeSize) \
     ;
 
+// Fields are either names of the layout or (offset, type) tuples
+void ResolveField(CLayout* pLayout, object oField, unsigned long& ulOffset, char& cType)
+{
+    extract<std::string> name(oField);
+    if (name.check())
+    {
+        if (!pLayout)
+            BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Fields can only be passed by name if a layout is given.")
+
+        const LayoutField_t* pField = pLayout->FindField(name());
+        if (!pField)
+        {
+            std::string szError = "Unknown field \"" + name() + "\".";
+            BOOST_RAISE_EXCEPTION(PyExc_ValueError, szError.data())
+        }
+
+        if (pField->m_iCount != 1)
+            BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Array fields can't be used.")
+
+        ulOffset = pField->m_ulOffset;
+        cType = pField->m_cType;
+        return;
+    }
+
+    unsigned long ulSize;
+    const char* szType = extract<const char *>(oField[1]);
+    if (!GetNativeType(szType, cType, ulSize))
+    {
+        std::string szError = std::string("Unknown type \"") + szType + "\".";
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, szError.data())
+    }
+
+    ulOffset = extract<unsigned long>(oField[0]);
+}
+
+FieldPredicate_t MakePredicate(CLayout* pLayout, object oField, const char* szOp, object oValue)
+{
+    FieldPredicate_t predicate;
+    ResolveField(pLayout, oField, predicate.m_ulOffset, predicate.m_cType);
+    if (!GetCompareOp(szOp, predicate.m_eOp))
+    {
+        std::string szError = std::string("Unknown operator \"") + szOp + "\".";
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, szError.data())
+    }
+
+    switch(GetValueClass(predicate.m_cType))
+    {
+        case VALUE_SIGNED: predicate.m_Value.m_llValue = extract<long long>(oValue); break;
+        case VALUE_FLOAT:  predicate.m_Value.m_dValue = extract<double>(oValue); break;
+        default:
+        {
+            bool bAddress = predicate.m_cType == SIGCHAR_POINTER || predicate.m_cType == SIGCHAR_STRING;
+            predicate.m_Value.m_ullValue = bAddress ? (oValue.is_none() ? 0 : ExtractPyPtr(oValue)) : extract<unsigned long long>(oValue)();
+        }
+    }
+    return predicate;
+}
+
+boost::shared_ptr<CArrayView> NewArrayView(object oAddr, unsigned int uiStride, unsigned int uiLength, object oConverter,
+    bool bIndirect, object oLayout, unsigned int uiPageSize)
+{
+    if (!uiStride)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "The stride has to be at least 1.")
+
+    // Views of pointers use the backend of the pointer
+    BackendPtr pBackend;
+    extract<CPointer *> pointer(oAddr);
+    if (pointer.check())
+        pBackend = pointer()->m_pBackend;
+
+    boost::shared_ptr<CArrayView> pView(new CArrayView(ExtractPyPtr(oAddr), uiStride, uiLength, oConverter, bIndirect, uiPageSize, pBackend));
+    if (!oLayout.is_none())
+        pView->m_pLayout = extract<LayoutPtr>(oLayout);
+
+    return pView;
+}
+
+boost::shared_ptr<CArrayView> ArrayViewFilter(CArrayView& view, object oField, const char* szOp, object oValue)
+{
+    std::vector<FieldPredicate_t> predicates;
+    predicates.push_back(MakePredicate(view.m_pLayout.get(), oField, szOp, oValue));
+    return view.Filter(predicates);
+}
+
+list ArrayViewMap(CArrayView& view, object oField)
+{
+    unsigned long ulOffset;
+    char cType;
+    ResolveField(view.m_pLayout.get(), oField, ulOffset, cType);
+    return view.Map(ulOffset, cType);
+}
+
+CArrayViewIterator ArrayViewIter(object oView)
+{
+    return CArrayViewIterator(oView);
+}
+
+object ArrayViewIteratorSelf(object oIterator)
+{
+    return oIterator;
+}
+
 void ExposeArrays()
 {
     EXPOSE_ARRAY(bool, "BoolArray");
@@ -734,6 +1115,73 @@ void ExposeArrays()
         .def("__setitem__", &CPtrArray::SetItem)
         .def_readwrite("converter", &CPtrArray::m_oConverter)
     ;
+
+    class_<CArrayView, boost::shared_ptr<CArrayView> >("ArrayView", no_init)
+        .def("__init__", make_constructor(&NewArrayView, default_call_policies(), (arg("addr"), arg("stride"), arg("length"),
+            arg("converter")=object(), arg("indirect")=false, arg("layout")=object(), arg("page_size")=256)))
+
+        .def("__len__",
+            &CArrayView::GetLength,
+            "Returns the number of elements."
+        )
+
+        .def("__getitem__",
+            &CArrayView::GetItem,
+            "Returns the converted element at the given index. The page of the element is converted if it's accessed for the first time."
+        )
+
+        .def("__iter__",
+            &ArrayViewIter,
+            "Iterates over the converted elements. Pages are converted when the iterator reaches them."
+        )
+
+        .def("filter",
+            &ArrayViewFilter,
+            "Returns a view of all elements whose field compares to <value> (e.g. filter('team', '==', 2)). "\
+            "The comparison is done natively, so elements are only converted when the new view is accessed. "\
+            "<field> is the name of a field of the layout or an (offset, type) tuple. "\
+            "Operators: ==, !=, <, <=, >, >=. NULL elements of indirect tables never match.",
+            args("field", "op", "value")
+        )
+
+        .def("map",
+            &ArrayViewMap,
+            "Returns a list of the values of the given field of all elements (None for NULL elements) without converting the elements.",
+            args("field")
+        )
+
+        // Properties
+        .add_property("addresses",
+            &CArrayView::GetAddresses,
+            "Returns a list of the addresses of all elements (0 for NULL elements)."
+        )
+
+        .add_property("loaded_pages",
+            &CArrayView::GetLoadedPages,
+            "Returns the number of pages that have been converted."
+        )
+
+        .def_readonly("page_size",
+            &CArrayView::m_uiPageSize,
+            "Returns the number of elements per page."
+        )
+
+        .def_readwrite("converter",
+            &CArrayView::m_oConverter,
+            "Returns the converter of the elements. Pages that have already been converted aren't affected."
+        )
+
+        .add_property("layout",
+            make_getter(&CArrayView::m_pLayout, return_value_policy<return_by_value>()),
+            "Returns the layout that is used to look up fields by name."
+        )
+    ;
+
+    class_<CArrayViewIterator>("ArrayViewIterator", no_init)
+        .def("__iter__", &ArrayViewIteratorSelf)
+        .def("next", &CArrayViewIterator::Next)
+        .def("__next__", &CArrayViewIterator::Next)
+    ;
 }
 
 // ============================================================================
@@ -760,8 +1208,26 @@ void ExposeDynCall()
 // ============================================================================
 // >> Expose DynamicHooks
 // ============================================================================
+boost::shared_ptr<CArgRecording> LoadRecording(const char* szPath)
+{
+    boost::shared_ptr<CArgRecording> recording(new CArgRecording());
+    std::string szError;
+    if (!recording->Load(szPath, szError))
+        BOOST_RAISE_EXCEPTION(PyExc_IOError, szError.data())
+
+    return recording;
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(replay_recording_overload, ReplayRecording, 2, 3)
+
 void ExposeDynamicHooks()
 {
+    enum_<RuleType_t>("RuleType")
+        .value("SET_ARGUMENT", RULE_SET_ARGUMENT)
+        .value("CLAMP_ARGUMENT", RULE_CLAMP_ARGUMENT)
+        .value("SUPERSEDE", RULE_SUPERSEDE)
+    ;
+
     class_<CStackData>("StackData", init<CHook*>())
 
         // Special methods
@@ -775,6 +1241,33 @@ void ExposeDynamicHooks()
             "Sets the argument at the specified index."
         )
     ;
+
+    class_<CArgRecording, boost::shared_ptr<CArgRecording> >("Recording", no_init)
+        .def("__init__", make_constructor(&LoadRecording, default_call_policies(), args("path")))
+
+        .def("__len__",
+            &CArgRecording::GetCallCount,
+            "Returns the number of recorded calls."
+        )
+
+        .def("replay",
+            &ReplayRecording,
+            replay_recording_overload(
+                args("callback", "repeat"),
+                "Calls <callback> like a pre-hook with a StackData object of every recorded call (<repeat> times) as fast as possible. Returns a tuple: (calls, seconds, errors).")
+        )
+
+        // Properties
+        .add_property("types",
+            &CArgRecording::GetTypes,
+            "Returns the types of the recorded arguments, e.g. 'ipZ'."
+        )
+    ;
+
+    def("clear_python_hooks",
+        &ClearPythonHooks,
+        "Removes the Python callbacks of all hooked functions and releases them. The functions stay hooked and native callbacks stay registered."
+    );
 }
 
 // ============================================================================
@@ -793,4 +1286,1226 @@ void ExposeCallbacks()
             "The Python function that gets called by the C++ callback"
         )
     ;
-}
\ No newline at end of file
+}
+
+// ============================================================================
+// >> Expose the tracer
+// ============================================================================
+void EnableTrace(bool bEnable)
+{
+    GetTracer()->Enable(bEnable);
+}
+
+bool IsTraceEnabled()
+{
+    return GetTracer()->IsEnabled();
+}
+
+void ClearTrace()
+{
+    GetTracer()->Clear();
+}
+
+double GetTraceTime()
+{
+    return GetTracer()->Now();
+}
+
+void AddTraceEvent(const char* szCategory, const char* szName, double dStart,
+    double dDuration, unsigned long ulBytes = 0, int iCacheHit = -1)
+{
+    TraceEvent_t event;
+    event.m_szCategory = szCategory;
+    event.m_szName = szName;
+    event.m_ulThread = GetThreadIdentifier();
+    event.m_dStart = dStart;
+    event.m_dDuration = dDuration;
+    event.m_ulBytes = ulBytes;
+    event.m_iCacheHit = iCacheHit;
+    GetTracer()->AddEvent(event);
+}
+
+list GetTraceEvents()
+{
+    list events;
+    const std::vector<TraceEvent_t>& vecEvents = GetTracer()->GetEvents();
+    for (size_t i=0; i < vecEvents.size(); i++)
+    {
+        const TraceEvent_t& event = vecEvents[i];
+        events.append(boost::python::make_tuple(event.m_szCategory, event.m_szName,
+            event.m_ulThread, event.m_dStart, event.m_dDuration,
+            event.m_ulBytes, event.m_iCacheHit));
+    }
+    return events;
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(add_trace_event_overload, AddTraceEvent, 4, 6);
+
+void ExposeTrace()
+{
+    def("enable_trace",
+        &EnableTrace,
+        "Enables or disables recording of trace events.",
+        args("enable")
+    );
+
+    def("is_trace_enabled",
+        &IsTraceEnabled,
+        "Returns True if trace events are recorded."
+    );
+
+    def("clear_trace",
+        &ClearTrace,
+        "Removes all recorded trace events."
+    );
+
+    def("get_trace_time",
+        &GetTraceTime,
+        "Returns the current trace time in microseconds."
+    );
+
+    def("add_trace_event",
+        &AddTraceEvent,
+        add_trace_event_overload(
+            args("category", "name", "start", "duration", "bytes", "cache_hit"),
+            "Adds a trace event. <start> and <duration> are in microseconds. <cache_hit> is -1 if no cache was involved.")
+    );
+
+    def("get_trace_events",
+        &GetTraceEvents,
+        "Returns a list of all recorded events: (category, name, thread, start, duration, bytes, cache_hit)"
+    );
+}
+
+// ============================================================================
+// >> Expose the timeline
+// ============================================================================
+void EnableTimeline(bool bEnable)
+{
+    GetTimeline()->Enable(bEnable);
+}
+
+bool IsTimelineEnabled()
+{
+    return GetTimeline()->IsEnabled();
+}
+
+void ClearTimeline()
+{
+    GetTimeline()->Clear();
+}
+
+unsigned int GetTimelineTick()
+{
+    return GetTimeline()->GetTick();
+}
+
+unsigned int NextTimelineTick()
+{
+    return GetTimeline()->NextTick();
+}
+
+list GetTimelineSpans(unsigned int uiFirstTick = 0, unsigned int uiLastTick = UINT_MAX)
+{
+    std::vector<TimelineSpan_t> vecSpans;
+    GetTimeline()->GetSpans(uiFirstTick, uiLastTick, vecSpans);
+
+    list spans;
+    for (size_t i=0; i < vecSpans.size(); i++)
+    {
+        const TimelineSpan_t& span = vecSpans[i];
+        spans.append(boost::python::make_tuple(span.m_szName, span.m_ulThread,
+            span.m_dStart, span.m_dDuration, span.m_iDepth, span.m_uiTick));
+    }
+    return spans;
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(get_timeline_spans_overload, GetTimelineSpans, 0, 2);
+
+void ExposeTimeline()
+{
+    def("enable_timeline",
+        &EnableTimeline,
+        "Enables or disables recording of timeline spans.",
+        args("enable")
+    );
+
+    def("is_timeline_enabled",
+        &IsTimelineEnabled,
+        "Returns True if timeline spans are recorded."
+    );
+
+    def("clear_timeline",
+        &ClearTimeline,
+        "Removes all recorded timeline events."
+    );
+
+    def("get_timeline_tick",
+        &GetTimelineTick,
+        "Returns the current tick of the timeline."
+    );
+
+    def("next_timeline_tick",
+        &NextTimelineTick,
+        "Starts a new tick and returns it. Use it if no function has been added as a tick span."
+    );
+
+    def("get_timeline_spans",
+        &GetTimelineSpans,
+        get_timeline_spans_overload(
+            args("first_tick", "last_tick"),
+            "Returns a list of all recorded spans that begin in the given range of ticks: (name, thread, start, duration, depth, tick)")
+    );
+}
+
+// ============================================================================
+// >> Expose memory backends
+// ============================================================================
+object BackendRead(IMemoryBackend& backend, unsigned long ulAddr, unsigned long ulSize)
+{
+    std::string buffer(ulSize, '\0');
+    if (ulSize)
+        ReadMemory(&backend, ulAddr, &buffer[0], ulSize);
+
+    return object(handle<>(PyBytes_FromStringAndSize(buffer.data(), ulSize)));
+}
+
+void BackendWrite(IMemoryBackend& backend, unsigned long ulAddr, object oData)
+{
+    unsigned char* data = GetByteRepr(oData);
+    if (!data)
+        BOOST_RAISE_EXCEPTION(PyExc_TypeError, "Expected a byte string.")
+
+    WriteMemory(&backend, ulAddr, data, len(oData));
+}
+
+CPointer* BackendPointer(IMemoryBackend& backend, unsigned long ulAddr)
+{
+    return new CPointer(ulAddr, backend.shared_from_this());
+}
+
+CBinaryFile* BackendFindBinary(IMemoryBackend& backend, char* szPath, bool bSrvCheck = true)
+{
+    return FindBinary(szPath, bSrvCheck, backend.shared_from_this());
+}
+
+list BackendGetModules(IMemoryBackend& backend)
+{
+    std::vector<Module_t> modules;
+    backend.GetModules(modules);
+
+    list result;
+    for (size_t i=0; i < modules.size(); i++)
+        result.append(boost::python::make_tuple(modules[i].m_szPath, modules[i].m_ulBase, modules[i].m_ulSize));
+
+    return result;
+}
+
+object BackendSymbolize(IMemoryBackend& backend, unsigned long ulAddr)
+{
+    return Symbolize(backend.shared_from_this(), ulAddr);
+}
+
+void ExtractRanges(object oRanges, std::vector<std::pair<unsigned long, unsigned long> >& ranges)
+{
+    for (int i=0; i < len(oRanges); i++)
+    {
+        object oRange = oRanges[i];
+        ranges.push_back(std::make_pair(
+            extract<unsigned long>(oRange[0])(), extract<unsigned long>(oRange[1])()));
+    }
+}
+
+bool RemoteProcessPrefetch(CRemoteProcess& process, object oRanges)
+{
+    std::vector<std::pair<unsigned long, unsigned long> > ranges;
+    ExtractRanges(oRanges, ranges);
+    return process.Prefetch(ranges);
+}
+
+boost::shared_ptr<CCoreFile> NewCoreFile(const char* szPath)
+{
+    boost::shared_ptr<CCoreFile> core(new CCoreFile());
+    std::string szError;
+    if (!core->Open(szPath, szError))
+        BOOST_RAISE_EXCEPTION(PyExc_IOError, szError.data())
+
+    return core;
+}
+
+long long PyWriteSnapshot(const char* szPath, object oRanges, BackendPtr pBackend = BackendPtr())
+{
+    std::vector<std::pair<unsigned long, unsigned long> > ranges;
+    ExtractRanges(oRanges, ranges);
+
+    // Snapshots of the current process are read via process_vm_readv(), so
+    // unmapped pages are skipped instead of crashing the process
+    if (!pBackend)
+    {
+#ifdef __linux__
+        pBackend = BackendPtr(new CRemoteProcess(getpid()));
+#else
+        BOOST_RAISE_EXCEPTION(PyExc_NotImplementedError, "Snapshots of the current process are only supported on Linux.")
+#endif
+    }
+
+    long long llBytes = WriteSnapshot(pBackend.get(), szPath, ranges);
+    if (llBytes == -1)
+        BOOST_RAISE_EXCEPTION(PyExc_IOError, "Unable to write the snapshot file.")
+
+    return llBytes;
+}
+
+boost::shared_ptr<CBinaryImage> NewBinaryImage(const char* szPath)
+{
+    boost::shared_ptr<CBinaryImage> image(new CBinaryImage());
+    std::string szError;
+    if (!image->Open(szPath, szError))
+        BOOST_RAISE_EXCEPTION(PyExc_IOError, szError.data())
+
+    return image;
+}
+
+object BinaryImageGetBuildId(CBinaryImage& image)
+{
+    if (image.GetBuildId().empty())
+        return object();
+
+    return object(image.GetBuildId());
+}
+
+object GetBuildId(const char* szPath)
+{
+    CElfFile elf;
+    if (!elf.Open(szPath))
+        BOOST_RAISE_EXCEPTION(PyExc_IOError, "Unable to open the file as an ELF file.")
+
+    std::string szBuildId = elf.GetBuildId();
+    if (szBuildId.empty())
+        return object();
+
+    return object(szBuildId);
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(backend_find_binary_overload, BackendFindBinary, 2, 3);
+BOOST_PYTHON_FUNCTION_OVERLOADS(write_snapshot_overload, PyWriteSnapshot, 2, 3);
+
+void ExposeMemory()
+{
+    class_<IMemoryBackend, BackendPtr, boost::noncopyable>("MemoryBackend", no_init)
+        .def("read",
+            &BackendRead,
+            "Reads <size> bytes at the given address and returns them as a byte string.",
+            args("addr", "size")
+        )
+
+        .def("write",
+            &BackendWrite,
+            "Writes the given byte string to the given address.",
+            args("addr", "data")
+        )
+
+        .def("pointer",
+            &BackendPointer,
+            "Returns a Pointer object that reads and writes through this backend.",
+            args("addr"),
+            manage_new_object_policy()
+        )
+
+        .def("find_binary",
+            &BackendFindBinary,
+            backend_find_binary_overload(
+                args("path", "srv_check"),
+                "Returns a BinaryFile object of a module that is mapped by this backend.")[reference_existing_object_policy()]
+        )
+
+        .def("invalidate",
+            &IMemoryBackend::Invalidate,
+            "Drops all cached data. Call this once per tick."
+        )
+
+        .def("symbolize",
+            &BackendSymbolize,
+            "Returns a (module, symbol, offset) tuple for the given address or None if it doesn't belong to a module.",
+            args("addr")
+        )
+
+        // Properties
+        .add_property("modules",
+            &BackendGetModules,
+            "Returns a list of all mapped modules: (path, base, size)"
+        )
+    ;
+
+    class_<CRemoteProcess, boost::shared_ptr<CRemoteProcess>, bases<IMemoryBackend>, boost::noncopyable>("RemoteProcess", init<int>(args("pid")))
+        .def("prefetch",
+            &RemoteProcessPrefetch,
+            "Reads all pages of the given (addr, size) tuples that are not cached yet with as few system calls as possible. "\
+            "Returns False if a page couldn't be read.",
+            args("ranges")
+        )
+
+        // Properties
+        .def_readonly("pid",
+            &CRemoteProcess::m_iPid,
+            "Returns the ID of the process."
+        )
+
+        .add_property("cache_enabled",
+            &CRemoteProcess::IsCacheEnabled,
+            &CRemoteProcess::SetCacheEnabled,
+            "Set this to False to read every value with a separate system call."
+        )
+
+        .def_readonly("hits",
+            &CRemoteProcess::m_ulHits,
+            "Returns the number of reads that were served from the page cache."
+        )
+
+        .def_readonly("misses",
+            &CRemoteProcess::m_ulMisses,
+            "Returns the number of reads that required a system call."
+        )
+
+        .def_readonly("syscalls",
+            &CRemoteProcess::m_ulSysCalls,
+            "Returns the number of system calls."
+        )
+    ;
+
+    class_<CCoreFile, boost::shared_ptr<CCoreFile>, bases<IMemoryBackend>, boost::noncopyable>("CoreFile", no_init)
+        .def("__init__", make_constructor(&NewCoreFile, default_call_policies(), args("path")))
+
+        // Properties
+        .add_property("path",
+            make_function(&CCoreFile::GetPath, return_value_policy<copy_const_reference>()),
+            "Returns the path of the core or snapshot file."
+        )
+    ;
+
+    class_<CBinaryImage, boost::shared_ptr<CBinaryImage>, bases<IMemoryBackend>, boost::noncopyable>("BinaryImage", no_init)
+        .def("__init__", make_constructor(&NewBinaryImage, default_call_policies(), args("path")))
+
+        // Properties
+        .add_property("path",
+            make_function(&CBinaryImage::GetPath, return_value_policy<copy_const_reference>()),
+            "Returns the path of the binary."
+        )
+
+        .add_property("build_id",
+            &BinaryImageGetBuildId,
+            "Returns the GNU build ID of the binary as a hex string or None."
+        )
+    ;
+
+    def("get_build_id",
+        &GetBuildId,
+        "Returns the GNU build ID of the given ELF file as a hex string or None.",
+        args("path")
+    );
+
+    def("write_snapshot",
+        &PyWriteSnapshot,
+        write_snapshot_overload(
+            args("path", "ranges", "backend"),
+            "Writes the given (addr, size) ranges and all modules of a backend (or the current process) to a snapshot file, "\
+            "which can be opened with CoreFile. Returns the number of bytes that have been written.")
+    );
+
+    def("set_default_backend",
+        &SetDefaultBackend,
+        "Sets the backend of all pointers and binaries that are created from Python. Pass None to use the memory of this process again.",
+        args("backend")
+    );
+
+    def("get_default_backend",
+        &GetDefaultBackend,
+        "Returns the default memory backend or None."
+    );
+}
+
+// ============================================================================
+// >> Expose CLayout
+// ============================================================================
+void LayoutAddField(CLayout& layout, const std::string& szName, unsigned long ulOffset, const char* szType, int iCount = 1)
+{
+    if (iCount < 1)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "The count has to be at least 1.")
+
+    if (!layout.AddField(szName, ulOffset, szType, iCount))
+    {
+        std::string szError = std::string("Unknown type \"") + szType + "\".";
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, szError.data())
+    }
+}
+
+void LayoutAddPointer(CLayout& layout, const std::string& szName, unsigned long ulOffset, object oPointee = object())
+{
+    LayoutPtr pPointee;
+    if (!oPointee.is_none())
+        pPointee = extract<LayoutPtr>(oPointee);
+
+    layout.AddPointer(szName, ulOffset, pPointee);
+}
+
+void LayoutAddLayout(CLayout& layout, const std::string& szName, unsigned long ulOffset, CLayout& other, int iCount = 1)
+{
+    if (iCount < 1)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "The count has to be at least 1.")
+
+    layout.AddLayout(szName, ulOffset, &other, iCount);
+}
+
+list LayoutGetFields(CLayout& layout)
+{
+    list result;
+    for (size_t i=0; i < layout.m_Fields.size(); i++)
+    {
+        const LayoutField_t& field = layout.m_Fields[i];
+        result.append(boost::python::make_tuple(field.m_szName, field.m_ulOffset, GetNativeTypeName(field.m_cType),
+            field.m_iCount, field.m_pPointee ? object(field.m_pPointee) : object()));
+    }
+    return result;
+}
+
+const char* ExtractBlob(object oBlob, Py_ssize_t& size)
+{
+    char* pBlob;
+    if (PyBytes_AsStringAndSize(oBlob.ptr(), &pBlob, &size) == -1)
+        throw_error_already_set();
+
+    return pBlob;
+}
+
+object Serialize(CPointer& ptr, CLayout& layout, int iDepth = -1)
+{
+    if (!ptr.m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
+
+    std::string szBlob, szError;
+    if (!SerializeLayout(ptr.m_pBackend.get(), ptr.m_ulAddr, &layout, iDepth, szBlob, szError))
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, szError.data())
+
+    return object(handle<>(PyBytes_FromStringAndSize(szBlob.data(), szBlob.size())));
+}
+
+int DeserializeInto(CPointer& ptr, object oBlob, CLayout& layout)
+{
+    if (!ptr.m_ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Pointer is NULL.")
+
+    Py_ssize_t size;
+    const char* pBlob = ExtractBlob(oBlob, size);
+
+    std::string szError;
+    int iObjects = DeserializeLayout(ptr.m_pBackend.get(), ptr.m_ulAddr, &layout, pBlob, size, szError);
+    if (iObjects == -1)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, szError.data())
+
+    return iObjects;
+}
+
+CPointer* Deserialize(object oBlob)
+{
+    Py_ssize_t size;
+    const char* pBlob = ExtractBlob(oBlob, size);
+
+    std::string szError;
+    void* pObject = LoadLayoutBlob(pBlob, size, szError);
+    if (!pObject)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, szError.data())
+
+    return new CPointer((unsigned long) pObject);
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(layout_add_field_overload, LayoutAddField, 4, 5);
+BOOST_PYTHON_FUNCTION_OVERLOADS(layout_add_pointer_overload, LayoutAddPointer, 3, 4);
+BOOST_PYTHON_FUNCTION_OVERLOADS(layout_add_layout_overload, LayoutAddLayout, 4, 5);
+BOOST_PYTHON_FUNCTION_OVERLOADS(serialize_overload, Serialize, 2, 3);
+
+void ExposeLayout()
+{
+    class_<CLayout, LayoutPtr, boost::noncopyable>("Layout", init<optional<unsigned long> >(args("size")))
+        .def("add_field",
+            &LayoutAddField,
+            layout_add_field_overload(
+                args("layout", "name", "offset", "type", "count"),
+                "Adds a field of a native type (e.g. \"int\" or \"float\"). Pass a count greater than 1 for inline arrays.")
+        )
+
+        .def("add_pointer",
+            &LayoutAddPointer,
+            layout_add_pointer_overload(
+                args("layout", "name", "offset", "pointee"),
+                "Adds a pointer field. serialize() follows the pointer if <pointee> is the layout of the object it points to.")
+        )
+
+        .def("add_layout",
+            &LayoutAddLayout,
+            layout_add_layout_overload(
+                args("layout", "name", "offset", "other", "count"),
+                "Adds the fields of another layout <count> times, e.g. for embedded structs. The names of the fields are prefixed with <name>.")
+        )
+
+        // Properties
+        .add_property("size",
+            &CLayout::GetSize,
+            &CLayout::SetSize,
+            "Returns the size of the object. If no size has been set or a field ends behind it, the end of the last field is returned."
+        )
+
+        .add_property("fields",
+            &LayoutGetFields,
+            "Returns a list of all fields: (name, offset, type, count, pointee)"
+        )
+    ;
+
+    def("serialize",
+        &Serialize,
+        serialize_overload(
+            args("pointer", "layout", "follow_pointers"),
+            "Copies the object and all objects that can be reached within <follow_pointers> pointer fields (-1 means no limit) into a "\
+            "position-independent byte string. Every object is only copied once, so cycles are fine.")
+    );
+
+    def("deserialize_into",
+        &DeserializeInto,
+        "Writes all fields of a serialized object graph that aren't pointers back to the live objects. Returns the number of restored objects.",
+        args("pointer", "blob", "layout")
+    );
+
+    def("deserialize",
+        &Deserialize,
+        "Copies a serialized object graph into a new memory block and returns a pointer to the root object. Free it with Pointer.dealloc().",
+        args("blob"),
+        manage_new_object_policy()
+    );
+}
+
+// ============================================================================
+// >> Expose CHardwareWatch
+// ============================================================================
+boost::shared_ptr<CHardwareWatch> HardwareWatch(object oAddr, int iLength = 4, WatchMode_t eMode = WATCH_WRITE, int iPages = 16)
+{
+    unsigned long ulAddr = ExtractPyPtr(oAddr);
+    if (!ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Address is NULL.")
+
+    boost::shared_ptr<CHardwareWatch> watch(new CHardwareWatch());
+    std::string szError;
+    if (!watch->Start(ulAddr, iLength, eMode, iPages, szError))
+        BOOST_RAISE_EXCEPTION(PyExc_RuntimeError, szError.data())
+
+    return watch;
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(hw_watch_overload, HardwareWatch, 1, 4)
+
+list HardwareWatchDrain(CHardwareWatch& watch)
+{
+    std::vector<WatchHit_t> hits;
+    watch.Drain(hits);
+
+    list result;
+    for (size_t i=0; i < hits.size(); i++)
+        result.append(boost::python::make_tuple(hits[i].m_ulPC, hits[i].m_ulThread, hits[i].m_ullTime));
+
+    return result;
+}
+
+void ExposeWatch()
+{
+    enum_<WatchMode_t>("WatchMode")
+        .value("WRITE", WATCH_WRITE)
+        .value("READWRITE", WATCH_READWRITE)
+        .value("EXECUTE", WATCH_EXECUTE)
+    ;
+
+    class_<CHardwareWatch, boost::shared_ptr<CHardwareWatch>, boost::noncopyable>("HardwareWatch", no_init)
+        .def("drain",
+            &HardwareWatchDrain,
+            "Removes all samples from the ring buffers and returns them as (pc, thread, time) tuples. The pc of data watches "\
+            "points to the instruction after the one that has accessed the memory. Times are nanoseconds of CLOCK_MONOTONIC."
+        )
+
+        .def("stop",
+            &CHardwareWatch::Stop,
+            "Stops watching and frees the debug registers. Samples that haven't been drained are lost."
+        )
+
+        // Properties
+        .add_property("address",
+            &CHardwareWatch::GetAddress,
+            "Returns the watched address."
+        )
+
+        .add_property("length",
+            &CHardwareWatch::GetLength,
+            "Returns the number of watched bytes."
+        )
+
+        .add_property("mode",
+            &CHardwareWatch::GetMode,
+            "Returns the WatchMode."
+        )
+
+        .add_property("active",
+            &CHardwareWatch::IsActive,
+            "Returns True until stop() has been called."
+        )
+
+        .add_property("events",
+            &CHardwareWatch::GetEventCount,
+            "Returns the number of perf events (threads times CPUs)."
+        )
+
+        .add_property("lost",
+            &CHardwareWatch::GetLost,
+            "Returns the number of samples that have been lost, because a ring buffer was full."
+        )
+    ;
+
+    def("hw_watch",
+        &HardwareWatch,
+        hw_watch_overload(
+            args("address", "length", "mode", "pages"),
+            "Watches <length> bytes (1, 2, 4 or 8) at the given address with a hardware breakpoint in all threads of the process "\
+            "and returns a HardwareWatch object. Accesses are sampled into ring buffers of <pages> pages per CPU. Only supported on Linux.")
+    );
+}
+
+// ============================================================================
+// >> Expose CIntegrityMonitor
+// ============================================================================
+boost::shared_ptr<CIntegrityMonitor> NewIntegrityMonitor(unsigned long ulBlockSize = 4096, const char* szAlgorithm = "xxh3")
+{
+    HashAlgorithm_t eAlgorithm;
+    if (!GetHashAlgorithm(szAlgorithm, eAlgorithm))
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Unknown hash algorithm.")
+
+    if (!ulBlockSize)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "The block size must be greater than 0.")
+
+    return boost::shared_ptr<CIntegrityMonitor>(new CIntegrityMonitor(ulBlockSize, eAlgorithm));
+}
+
+list RangesToList(const std::vector<MemoryRange_t>& ranges)
+{
+    list result;
+    for (size_t i=0; i < ranges.size(); i++)
+        result.append(boost::python::make_tuple(ranges[i].first, ranges[i].second));
+
+    return result;
+}
+
+void IntegrityMonitorAddRange(CIntegrityMonitor& monitor, object oAddr, unsigned long ulSize)
+{
+    unsigned long ulAddr = ExtractPyPtr(oAddr);
+    if (!ulAddr)
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Address is NULL.")
+
+    monitor.AddRange(ulAddr, ulSize);
+}
+
+int IntegrityMonitorAddModules(CIntegrityMonitor& monitor, object oFilter = object())
+{
+    if (oFilter.is_none())
+        return monitor.AddModules();
+
+    return monitor.AddModules(extract<const char *>(oFilter));
+}
+
+void IntegrityMonitorRebaseline(CIntegrityMonitor& monitor, object oAddr = object(0), unsigned long ulSize = 0)
+{
+    monitor.Rebaseline(ExtractPyPtr(oAddr), ulSize);
+}
+
+list IntegrityMonitorStep(CIntegrityMonitor& monitor, int iBudget)
+{
+    std::vector<MemoryRange_t> modified;
+    monitor.Step(iBudget, modified);
+    return RangesToList(modified);
+}
+
+list IntegrityMonitorGetModified(CIntegrityMonitor& monitor)
+{
+    std::vector<MemoryRange_t> modified;
+    monitor.GetModified(modified);
+    return RangesToList(modified);
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(new_integrity_monitor_overload, NewIntegrityMonitor, 0, 2)
+BOOST_PYTHON_FUNCTION_OVERLOADS(add_modules_overload, IntegrityMonitorAddModules, 1, 2)
+BOOST_PYTHON_FUNCTION_OVERLOADS(rebaseline_overload, IntegrityMonitorRebaseline, 1, 3)
+
+void ExposeIntegrity()
+{
+    class_<CIntegrityMonitor, boost::shared_ptr<CIntegrityMonitor>, boost::noncopyable>("IntegrityMonitor", no_init)
+        .def("__init__", make_constructor(&NewIntegrityMonitor, default_call_policies(), (arg("block_size")=4096, arg("algo")="xxh3")))
+
+        .def("add_range",
+            &IntegrityMonitorAddRange,
+            "Hashes the blocks of the given range of this process as their baseline.",
+            args("addr", "size")
+        )
+
+        .def("add_modules",
+            &IntegrityMonitorAddModules,
+            add_modules_overload(
+                args("filter"),
+                "Adds the executable segments of all loaded modules whose path contains <filter> (or all modules if it's None). "\
+                "Returns the number of added segments.")
+        )
+
+        .def("rebaseline",
+            &IntegrityMonitorRebaseline,
+            rebaseline_overload(
+                args("addr", "size"),
+                "Takes the current content of all blocks that overlap the given range (or all blocks if <size> is 0) as their new baseline. "\
+                "Call it after applying your own patches.")
+        )
+
+        .def("step",
+            &IntegrityMonitorStep,
+            "Verifies the next <budget> blocks and returns the (addr, size) ranges of blocks that have been modified since the last verification. "\
+            "Call it once per tick to verify all blocks over time.",
+            args("budget")
+        )
+
+        .def("clear",
+            &CIntegrityMonitor::Clear,
+            "Removes all blocks."
+        )
+
+        // Properties
+        .add_property("modified",
+            &IntegrityMonitorGetModified,
+            "Returns the (addr, size) ranges of all blocks that didn't match their baseline when they have been verified the last time."
+        )
+
+        .add_property("blocks",
+            &CIntegrityMonitor::GetBlockCount,
+            "Returns the number of blocks."
+        )
+
+        .add_property("block_size",
+            &CIntegrityMonitor::GetBlockSize,
+            "Returns the size of the blocks."
+        )
+
+        .add_property("verified",
+            &CIntegrityMonitor::GetVerifiedBlocks,
+            "Returns the number of blocks that have been verified."
+        )
+
+        .add_property("passes",
+            &CIntegrityMonitor::GetPasses,
+            "Returns the number of times all blocks have been verified."
+        )
+    ;
+}
+
+// ============================================================================
+// >> Expose the executor
+// ============================================================================
+// The task argument is a tuple: (callable, args, key). The key is only kept
+// alive, so its address can't be reused by another key while it's pending.
+void RunPythonTask(void* pArg)
+{
+    CAcquireGIL gil;
+    PyObject* pTask = (PyObject *) pArg;
+    PyObject* pResult = PyObject_Call(PyTuple_GET_ITEM(pTask, 0), PyTuple_GET_ITEM(pTask, 1), NULL);
+    if (pResult)
+        Py_DECREF(pResult);
+    else
+        // Unlike PyErr_Print() this doesn't exit the process on SystemExit
+        PyErr_WriteUnraisable(PyTuple_GET_ITEM(pTask, 0));
+
+    Py_DECREF(pTask);
+}
+
+void ReleasePythonTask(void* pArg)
+{
+    CAcquireGIL gil;
+    Py_DECREF((PyObject *) pArg);
+}
+
+// Native task with a key. The key is referenced for the same reason.
+struct KeyedNativeTask_t
+{
+    TaskFn    m_pFunc;
+    void*     m_pArg;
+    PyObject* m_pKey;
+};
+
+void ReleaseKeyedNativeTask(void* pArg)
+{
+    KeyedNativeTask_t* pTask = (KeyedNativeTask_t *) pArg;
+    {
+        CAcquireGIL gil;
+        Py_DECREF(pTask->m_pKey);
+    }
+    delete pTask;
+}
+
+void RunKeyedNativeTask(void* pArg)
+{
+    KeyedNativeTask_t* pTask = (KeyedNativeTask_t *) pArg;
+    pTask->m_pFunc(pTask->m_pArg);
+    ReleaseKeyedNativeTask(pArg);
+}
+
+void RunOnMain(object oTask, tuple oArgs = tuple(), object oKey = object())
+{
+    // Keys are compared by identity. Comparing hashes would drop tasks whose
+    // keys only collide (e.g. hash(-1) == hash(-2)) and comparing with __eq__
+    // would require the GIL while collecting.
+    void* pKey = oKey.is_none() ? NULL : (void *) oKey.ptr();
+
+    // Native functions get a single pointer argument
+    extract<CPointer *> pointer(oTask);
+    if (pointer.check())
+    {
+        if (len(oArgs) > 1)
+            BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Native tasks accept only one argument.")
+
+        TaskFn pFunc = (TaskFn) pointer()->GetAddress();
+        if (!pFunc)
+            BOOST_RAISE_EXCEPTION(PyExc_ValueError, "Function pointer is NULL.")
+
+        void* pArg = len(oArgs) ? (void *) ExtractPyPtr(oArgs[0]) : NULL;
+        if (!pKey)
+        {
+            GetExecutor()->Post(pFunc, pArg);
+            return;
+        }
+
+        KeyedNativeTask_t* pTask = new KeyedNativeTask_t;
+        pTask->m_pFunc = pFunc;
+        pTask->m_pArg = pArg;
+        pTask->m_pKey = oKey.ptr();
+        Py_INCREF(pTask->m_pKey);
+        GetExecutor()->Post(&RunKeyedNativeTask, pTask, &ReleaseKeyedNativeTask, pKey);
+        return;
+    }
+
+    if (!PyCallable_Check(oTask.ptr()))
+        BOOST_RAISE_EXCEPTION(PyExc_TypeError, "Task is neither callable nor a function pointer.")
+
+    // Calls of the same callable without arguments are duplicates
+    if (!pKey && !len(oArgs))
+        pKey = oTask.ptr();
+
+    tuple oTaskData = boost::python::make_tuple(oTask, oArgs, oKey);
+    PyObject* pTaskData = oTaskData.ptr();
+    Py_INCREF(pTaskData);
+    GetExecutor()->Post(&RunPythonTask, pTaskData, &ReleasePythonTask, pKey);
+}
+
+int DrainMainTasks(double dBudget = 0)
+{
+    return GetExecutor()->Drain(dBudget);
+}
+
+void SetTaskCoalescing(bool bCoalesce)
+{
+    GetExecutor()->SetCoalesce(bCoalesce);
+}
+
+dict GetExecutorStats()
+{
+    CExecutor* pExecutor = GetExecutor();
+    ExecutorStats_t stats = pExecutor->GetStats();
+
+    dict result;
+    result["posted"] = stats.m_ulPosted;
+    result["executed"] = stats.m_ulExecuted;
+    result["coalesced"] = stats.m_ulCoalesced;
+    result["deferred"] = stats.m_ulDeferred;
+    result["drains"] = stats.m_ulDrains;
+    result["pending"] = pExecutor->GetPending();
+    result["budget"] = pExecutor->GetBudget();
+    result["coalesce"] = pExecutor->GetCoalesce();
+    return result;
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(run_on_main_overload, RunOnMain, 1, 3)
+BOOST_PYTHON_FUNCTION_OVERLOADS(drain_main_tasks_overload, DrainMainTasks, 0, 1)
+
+void ExposeExecutor()
+{
+    def("run_on_main",
+        &RunOnMain,
+        run_on_main_overload(
+            args("task", "args", "key"),
+            "Runs the task at the next safe point (see Function.add_safe_point()) without blocking the calling thread. "\
+            "<task> is either a callable that is called with <args> or the address of a native function void (*)(void*) "\
+            "that is called with the first element of <args>. If coalescing is enabled, the task is dropped if a task with the same "\
+            "<key> is still pending. Keys are compared by identity, so use the same object (e.g. a constant string) for duplicates. "\
+            "Without a key, calls of the same callable without arguments are duplicates.")
+    );
+
+    def("drain_main_tasks",
+        &DrainMainTasks,
+        drain_main_tasks_overload(
+            args("budget"),
+            "Runs the pending tasks for at most <budget> microseconds (all of them if it's 0) and returns the number of executed tasks. "\
+            "Use it if no safe point has been added. Tasks only run on the thread that added the safe point or drained first, "\
+            "so this returns 0 on other threads.")
+    );
+
+    def("set_task_coalescing",
+        &SetTaskCoalescing,
+        "Enables or disables dropping of duplicate tasks.",
+        args("coalesce")
+    );
+
+    def("get_executor_stats",
+        &GetExecutorStats,
+        "Returns a dictionary with statistics of the tasks of run_on_main()."
+    );
+}
+
+// ============================================================================
+// >> Expose queries
+// ============================================================================
+std::string Trim(const std::string& szText)
+{
+    size_t iStart = szText.find_first_not_of(" \t");
+    if (iStart == std::string::npos)
+        return "";
+
+    return szText.substr(iStart, szText.find_last_not_of(" \t") - iStart + 1);
+}
+
+// Parses a constant of a condition: an integer (decimal or hex with a 0x
+// prefix), a float, True, False or None
+object ParseConstant(const std::string& szValue)
+{
+    if (szValue == "True" || szValue == "true")
+        return object(true);
+
+    if (szValue == "False" || szValue == "false")
+        return object(false);
+
+    if (szValue == "None" || szValue == "NULL")
+        return object();
+
+    // A leading zero doesn't mean octal
+    const char* szStart = szValue.c_str();
+    const char* szDigits = szStart + (*szStart == '-' || *szStart == '+');
+    int iBase = szDigits[0] == '0' && (szDigits[1] == 'x' || szDigits[1] == 'X') ? 16 : 10;
+
+    char* szEnd;
+    errno = 0;
+    long long llValue = strtoll(szStart, &szEnd, iBase);
+    if (*szStart && !*szEnd)
+    {
+        if (errno != ERANGE)
+            return object(llValue);
+
+        // Unsigned 64 bit constants don't fit into a long long
+        errno = 0;
+        unsigned long long ullValue = strtoull(szStart, &szEnd, iBase);
+        if (*szStart != '-' && errno != ERANGE)
+            return object(ullValue);
+
+        std::string szError = "Constant \"" + szValue + "\" is out of range.";
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, szError.data())
+    }
+
+    double dValue = strtod(szStart, &szEnd);
+    if (*szStart && !*szEnd)
+        return object(dValue);
+
+    std::string szError = "Invalid constant \"" + szValue + "\".";
+    BOOST_RAISE_EXCEPTION(PyExc_ValueError, szError.data())
+    return object();
+}
+
+// Conditions are either strings like "health > 0" or (field, op, value)
+// tuples
+FieldPredicate_t ParseCondition(CLayout* pLayout, object oCondition)
+{
+    extract<std::string> text(oCondition);
+    if (!text.check())
+        return MakePredicate(pLayout, oCondition[0], extract<const char *>(oCondition[1]), oCondition[2]);
+
+    std::string szCondition = text();
+    size_t iOp = szCondition.find_first_of("=!<>");
+    if (iOp == std::string::npos || iOp == 0)
+    {
+        std::string szError = "Invalid condition \"" + szCondition + "\".";
+        BOOST_RAISE_EXCEPTION(PyExc_ValueError, szError.data())
+    }
+
+    size_t iOpLength = iOp + 1 < szCondition.size() && szCondition[iOp + 1] == '=' ? 2 : 1;
+    std::string szField = Trim(szCondition.substr(0, iOp));
+    std::string szOp = szCondition.substr(iOp, iOpLength);
+    object oValue = ParseConstant(Trim(szCondition.substr(iOp + iOpLength)));
+    return MakePredicate(pLayout, object(szField), szOp.c_str(), oValue);
+}
+
+boost::shared_ptr<CQuery> Select(object oPointers, object oLayout = object())
+{
+    boost::shared_ptr<CQuery> pQuery(new CQuery());
+    std::vector<unsigned long> addresses;
+
+    // Views already know their addresses, layout and backend
+    extract<CArrayView *> view(oPointers);
+    if (view.check())
+    {
+        list oAddresses = view()->GetAddresses();
+        for (int i=0; i < len(oAddresses); i++)
+            addresses.push_back(extract<unsigned long>(oAddresses[i]));
+
+        pQuery->m_pLayout = view()->m_pLayout;
+        pQuery->m_pBackend = view()->m_pBackend;
+    }
+    else
+    {
+        // Integers belong to the address space of the pointers
+        bool bHasPointer = false;
+        object oIter = oPointers.attr("__iter__")();
+        PyObject* pItem;
+        while ((pItem = PyIter_Next(oIter.ptr())) != NULL)
+        {
+            object oItem = object(handle<>(pItem));
+            addresses.push_back(oItem.is_none() ? 0 : ExtractPyPtr(oItem));
+
+            extract<CPointer *> pointer(oItem);
+            if (!pointer.check())
+                continue;
+
+            if (bHasPointer && pointer()->m_pBackend != pQuery->m_pBackend)
+                BOOST_RAISE_EXCEPTION(PyExc_ValueError, "All pointers have to belong to the same address space.")
+
+            pQuery->m_pBackend = pointer()->m_pBackend;
+            bHasPointer = true;
+        }
+
+        if (PyErr_Occurred())
+            throw_error_already_set();
+    }
+
+    if (!oLayout.is_none())
+        pQuery->m_pLayout = extract<LayoutPtr>(oLayout);
+
+    pQuery->SetAddresses(addresses);
+    return pQuery;
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(select_overload, Select, 1, 2)
+
+object QueryWhere(back_reference<CQuery&> query, tuple conditions)
+{
+    for (int i=0; i < len(conditions); i++)
+        query.get().AddPredicate(ParseCondition(query.get().m_pLayout.get(), conditions[i]));
+
+    return query.source();
+}
+
+void RunQuery(CQuery& query, std::vector<unsigned int>& matches)
+{
+    std::string szError;
+    if (!query.Run(query.m_pBackend.get(), matches, szError))
+        BOOST_RAISE_EXCEPTION(PyExc_IOError, szError.data())
+}
+
+list QueryAddresses(CQuery& query)
+{
+    std::vector<unsigned int> matches;
+    RunQuery(query, matches);
+
+    list result;
+    const std::vector<unsigned long>& addresses = query.GetAddresses();
+    for (size_t i=0; i < matches.size(); i++)
+        result.append(addresses[matches[i]]);
+
+    return result;
+}
+
+unsigned int QueryCount(CQuery& query)
+{
+    std::vector<unsigned int> matches;
+    RunQuery(query, matches);
+    return matches.size();
+}
+
+list QueryTable(CQuery& query, tuple fields)
+{
+    std::vector<FieldPredicate_t> columns(len(fields));
+    for (size_t i=0; i < columns.size(); i++)
+        ResolveField(query.m_pLayout.get(), fields[i], columns[i].m_ulOffset, columns[i].m_cType);
+
+    std::vector<unsigned int> matches;
+    RunQuery(query, matches);
+
+    // The columns of remote objects are read with a single read per object
+    unsigned long ulExtent = GetPredicateExtent(columns);
+    std::string buffer(ulExtent, '\0');
+
+    list rows;
+    const std::vector<unsigned long>& addresses = query.GetAddresses();
+    for (size_t i=0; i < matches.size(); i++)
+    {
+        const char* pObject = (const char *) addresses[matches[i]];
+        if (query.m_pBackend && ulExtent)
+        {
+            ReadMemory(query.m_pBackend.get(), addresses[matches[i]], &buffer[0], ulExtent);
+            pObject = &buffer[0];
+        }
+
+        list row;
+        row.append(addresses[matches[i]]);
+        for (size_t j=0; j < columns.size(); j++)
+        {
+            FieldValue_t value = ReadFieldValue(columns[j].m_cType, pObject + columns[j].m_ulOffset);
+            row.append(FieldValueToObject(columns[j].m_cType, value, query.m_pBackend));
+        }
+        rows.append(tuple(row));
+    }
+
+    return rows;
+}
+
+void ExposeQuery()
+{
+    class_<CQuery, boost::shared_ptr<CQuery>, boost::noncopyable>("Query", no_init)
+        CLASS_METHOD_VARIADIC("where",
+            &QueryWhere,
+            "Adds conditions that all matching objects have to fulfill and returns the query. A condition is either a string like "\
+            "\"health > 0\" or a tuple: (field, op, value). <field> is the name of a field of the layout or an (offset, type) tuple. "\
+            "Operators: ==, !=, <, <=, >, >="
+        )
+
+        .def("addresses",
+            &QueryAddresses,
+            "Returns a list of the addresses of all objects that fulfill all conditions. The fields are read whenever it's called."
+        )
+
+        .def("count",
+            &QueryCount,
+            "Returns the number of objects that fulfill all conditions."
+        )
+
+        CLASS_METHOD_VARIADIC("table",
+            &QueryTable,
+            "Returns a list of tuples with the address and the values of the given fields of all objects that fulfill all conditions."
+        )
+
+    ;
+
+    DEFINE_CLASS_METHOD_VARIADIC(Query, where);
+    DEFINE_CLASS_METHOD_VARIADIC(Query, table);
+
+    def("select",
+        &Select,
+        select_overload(
+            args("pointers", "layout"),
+            "Creates a query over the objects at the given addresses (an iterable of pointers or an ArrayView). "\
+            "Conditions are evaluated natively: the compared fields are gathered into columns, which are compared with SSE2. Builds "\
+            "without SSE2 compare the columns with a scalar loop, which returns the same results. All pointers have to belong to the same "\
+            "address space. Example: select(players, layout).where('team == 2', 'health > 0').addresses()")
+    );
+}
@@ -31,10 +31,14 @@
 // ============================================================================
 // >> INCLUDES
 // ============================================================================
+#include <stddef.h>
+#include <algorithm>
+
 #include "DynamicHooks.h"
 using namespace DynamicHooks;
 
 #include "asm.h"
+#include "asm_x64.h"
 #include "utilities.h"
 
 #include "AsmJit.h"
@@ -46,6 +50,18 @@ using namespace AsmJit;
 // ============================================================================
 #define JMP_SIZE 6
 
+// Size of the code block of a hook on x86-64
+#define CODE_BLOCK_SIZE 4096
+
+// Offset of the absolute jump in the code block of a redirect. Its address
+// operand (offset 6) is aligned to 8 bytes.
+#define REDIRECT_STUB_OFFSET (CODE_BLOCK_SIZE - 14)
+
+// Milliseconds replaced rules are kept, because other threads might still
+// execute them. The rules don't call anything, so a thread only stays in them
+// for that long if it has been suspended.
+#define RULES_GRACE_PERIOD 10000
+
 
 // ============================================================================
 // >> CHookManager
@@ -58,8 +74,22 @@ CHook* CHookManager::HookFunction(void* pFunc, Convention_t eConvention, char* s
 	CHook* pHook = FindHook(pFunc);
 	if (pHook)
 		return pHook;
+
+	// The jump of the redirect would be relocated into the trampoline
+	CRedirect* pRedirect = FindRedirect(pFunc);
+	if (pRedirect && pRedirect->IsEnabled())
+		return NULL;
 	
 	pHook = new CHook(pFunc, eConvention, szParams);
+
+	// The function couldn't be hooked (e.g. because an instruction couldn't
+	// be relocated)
+	if (!pHook->m_pBridge)
+	{
+		delete pHook;
+		return NULL;
+	}
+
 	m_Hooks.push_back(pHook);
 	return pHook;
 }
@@ -94,6 +124,55 @@ void CHookManager::UnhookAllFunctions()
 		delete *it;
 
 	m_Hooks.clear();
+
+	for(std::list<CRedirect *>::iterator it=m_Redirects.begin(); it != m_Redirects.end(); it++)
+		delete *it;
+
+	m_Redirects.clear();
+}
+
+CRedirect* CHookManager::RedirectFunction(void* pFunc, void* pTarget)
+{
+	if (!pFunc || !pTarget || FindHook(pFunc))
+		return NULL;
+
+	CRedirect* pRedirect = FindRedirect(pFunc);
+	if (!pRedirect)
+	{
+		pRedirect = new CRedirect(pFunc);
+		if (!pRedirect->m_pTrampoline)
+		{
+			delete pRedirect;
+			return NULL;
+		}
+		m_Redirects.push_back(pRedirect);
+	}
+	else if (pRedirect->IsEnabled())
+		return NULL;
+
+	pRedirect->Enable(pTarget);
+	return pRedirect;
+}
+
+void CHookManager::RestoreFunction(void* pFunc)
+{
+	CRedirect* pRedirect = FindRedirect(pFunc);
+	if (pRedirect)
+		pRedirect->Disable();
+}
+
+CRedirect* CHookManager::FindRedirect(void* pFunc)
+{
+	if (!pFunc)
+		return NULL;
+
+	for(std::list<CRedirect *>::iterator it=m_Redirects.begin(); it != m_Redirects.end(); it++)
+	{
+		CRedirect* pRedirect = *it;
+		if (pRedirect->m_pFunc == pFunc)
+			return pRedirect;
+	}
+	return NULL;
 }
 
 
@@ -101,6 +180,8 @@ void CHookManager::UnhookAllFunctions()
 // >> CHook
 // ============================================================================
 void* CreateBridge(CHook*);
+void* CreateEntry(CHook*);
+void* CreateRules(CHook*);
 
 CHook::CHook(void* pFunc, Convention_t eConvention, char* szParams)
 {
@@ -113,13 +194,69 @@ CHook::CHook(void* pFunc, Convention_t eConvention, char* szParams)
 	m_pRetParam  = new Param_t;
 	ParseParams(eConvention, szParams, m_pParams, m_pRetParam);
 
-	// Allocate space for the return register buffer
-	m_pRetReg = malloc(m_pRetParam->m_iSize);
-	m_pESP = NULL;
-	m_pECX = NULL;
+	m_pPostCallback = NULL;
+	m_pEntry = NULL;
+
+	for (int i=0; i < HOOKTYPE_COUNT; i++)
+		m_pCallbacks[i] = new std::vector<void *>;
+
+	m_iReaders = 0;
+	m_iCallbacksLock = 0;
+	m_pEntryTarget = NULL;
+	m_pRules = NULL;
+	m_pRulesNext = NULL;
 
 	unsigned char* pTarget = (unsigned char *) pFunc;
 
+#ifdef __x86_64__
+	m_pTrampoline = NULL;
+	m_pBridge = NULL;
+	m_pOriginalBytes = NULL;
+	m_iOriginalSize = 0;
+	m_iCodeSize = 0;
+
+	// The trampoline must be near the function, so RIP-relative operands can
+	// be relocated. A near bridge can also be reached with a 5 byte jump.
+	m_pCode = (unsigned char *) AllocateNear(pFunc, CODE_BLOCK_SIZE);
+	if (!m_pCode)
+		return;
+
+	int iJmpSize = IsNear(m_pCode, pFunc) ? OP_JMP_SIZE : OP_JMP_ABS_SIZE;
+
+	// Copy and relocate the instructions that will be overwritten
+	int iTrampolineSize;
+	int iBytesToCopy = copy_bytes_x64(pTarget, m_pCode, iJmpSize, &iTrampolineSize);
+	if (iBytesToCopy == -1)
+		return;
+
+	// Write a jump after the copied bytes to the rest of the function
+	iTrampolineSize += inject_jmp_x64(m_pCode + iTrampolineSize, pTarget + iBytesToCopy);
+	m_iCodeSize = (iTrampolineSize + 15) & ~15;
+	m_pTrampoline = m_pCode;
+
+	// Save the original bytes, so they can be restored later
+	m_iOriginalSize = iBytesToCopy;
+	m_pOriginalBytes = new unsigned char[iBytesToCopy];
+	memcpy(m_pOriginalBytes, pTarget, iBytesToCopy);
+
+	// Create the bridge function and the entry
+	m_pBridge = CreateBridge(this);
+	if (m_pBridge)
+		m_pEntry = CreateEntry(this);
+
+	if (!m_pEntry)
+	{
+		m_pBridge = NULL;
+		return;
+	}
+	UpdateEntry();
+
+	// Write a jump to the entry and fill the rest with NOPs
+	SetMemPatchable(pTarget, iBytesToCopy);
+	int iWritten = inject_jmp_x64(pTarget, m_pEntry);
+	fill_nop(pTarget + iWritten, iBytesToCopy - iWritten);
+#else
+
 	// Determine the number of bytes we need to copy
 	int iBytesToCopy = copy_bytes(pTarget, NULL, JMP_SIZE);
 
@@ -140,18 +277,24 @@ CHook::CHook(void* pFunc, Convention_t eConvention, char* szParams)
 	// Save the trampoline
 	m_pTrampoline = (void *) pCopiedBytes;
 
-	// Create the bridge function
+	// Create the bridge function and the entry
 	m_pBridge = CreateBridge(this);
+	m_pEntry = CreateEntry(this);
+	UpdateEntry();
 
-	// Write a jump to the bridge
-	WriteJMP((unsigned char *) pFunc, m_pBridge);
-
+	// Write a jump to the entry
+	WriteJMP((unsigned char *) pFunc, m_pEntry);
+#endif
 }
 
 CHook::~CHook()
 {
-	// Free the return register buffer
-	free(m_pRetReg);
+	// Free the callback lists
+	for (int i=0; i < HOOKTYPE_COUNT; i++)
+		delete m_pCallbacks[i];
+
+	for(std::list< std::vector<void *> * >::iterator it=m_RetiredCallbacks.begin(); it != m_RetiredCallbacks.end(); it++)
+		delete *it;
 
 	// Delete the return parameter struct
 	delete m_pRetParam;
@@ -165,40 +308,162 @@ CHook::~CHook()
 		pNext = temp;
 	}
 
+#ifdef __x86_64__
+	// Restore the original bytes. The trampoline contains relocated
+	// instructions, so it can't be copied back.
+	if (m_pOriginalBytes && m_pBridge)
+	{
+		SetMemPatchable(m_pFunc, m_iOriginalSize);
+		memcpy(m_pFunc, m_pOriginalBytes, m_iOriginalSize);
+	}
+	delete [] m_pOriginalBytes;
+
+	// Free the trampoline, the bridge and the post-hook code
+	FreeNear(m_pCode, CODE_BLOCK_SIZE);
+#else
 	// Copy back the previously copied bytes
 	copy_bytes((unsigned char *) m_pTrampoline, (unsigned char *) m_pFunc, JMP_SIZE);
 
 	// Free the trampoline array
 	free(m_pTrampoline);
 
-	// Free the asm bridge
+	// Free the asm bridge, the post-hook code and the entry
 	MemoryManager::getGlobal()->free(m_pBridge);
+	MemoryManager::getGlobal()->free(m_pPostCallback);
+	MemoryManager::getGlobal()->free(m_pEntry);
+#endif
+
+	// Free the rules
+	if (m_pRules)
+		MemoryManager::getGlobal()->free(m_pRules);
+
+	for(std::list<RetiredRules_t>::iterator it=m_RetiredRules.begin(); it != m_RetiredRules.end(); it++)
+		MemoryManager::getGlobal()->free(it->m_pCode);
 }
 
-void CHook::AddCallback(HookType_t eHookType, void* pCallback)
+void CHook::AddCallback(HookType_t eHookType, void* pCallback, bool bFront /* = false */)
 {
 	if (!pCallback)
 		return;
 
+	while (__sync_lock_test_and_set(&m_iCallbacksLock, 1));
+
 	if (!IsCallbackRegistered(eHookType, pCallback))
-		m_Callbacks[eHookType].push_back(pCallback);
+	{
+		std::vector<void *>* pCallbacks = new std::vector<void *>(*m_pCallbacks[eHookType]);
+		pCallbacks->insert(bFront ? pCallbacks->begin() : pCallbacks->end(), pCallback);
+		PublishCallbacks(eHookType, pCallbacks);
+	}
+
+	// The entry has to jump to the bridge if this is the first callback
+	UpdateEntry();
+	__sync_lock_release(&m_iCallbacksLock);
 }
 
 void CHook::RemoveCallback(HookType_t eHookType, void* pCallback)
 {
+	while (__sync_lock_test_and_set(&m_iCallbacksLock, 1));
+
 	if (IsCallbackRegistered(eHookType, pCallback))
-		m_Callbacks[eHookType].remove(pCallback);
+	{
+		std::vector<void *>* pCallbacks = new std::vector<void *>(*m_pCallbacks[eHookType]);
+		pCallbacks->erase(std::find(pCallbacks->begin(), pCallbacks->end(), pCallback));
+		PublishCallbacks(eHookType, pCallbacks);
+	}
+
+	UpdateEntry();
+	__sync_lock_release(&m_iCallbacksLock);
+}
+
+void CHook::PublishCallbacks(HookType_t eHookType, std::vector<void *>* pCallbacks)
+{
+	std::vector<void *>* pOldCallbacks = m_pCallbacks[eHookType];
+	m_RetiredCallbacks.push_back(pOldCallbacks);
+
+	// The new list must be visible before the readers are counted. Threads
+	// that start reading afterwards can only see the new list.
+	__atomic_store_n(&m_pCallbacks[eHookType], pCallbacks, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&m_iReaders, __ATOMIC_SEQ_CST) != 0)
+		return;
+
+	for(std::list< std::vector<void *> * >::iterator it=m_RetiredCallbacks.begin(); it != m_RetiredCallbacks.end(); it++)
+		delete *it;
+
+	m_RetiredCallbacks.clear();
 }
 
 bool CHook::IsCallbackRegistered(HookType_t eHookType, void* pCallback)
 {
-	std::list<void *> callbacks = m_Callbacks[eHookType];
-	for(std::list<void *>::iterator it=callbacks.begin(); it != callbacks.end(); it++)
+	std::vector<void *>* pCallbacks = BeginRead(eHookType);
+	bool bResult = std::find(pCallbacks->begin(), pCallbacks->end(), pCallback) != pCallbacks->end();
+	EndRead();
+	return bResult;
+}
+
+bool CHook::HasCallbacks()
+{
+	bool bResult = false;
+	for (int i=0; i < HOOKTYPE_COUNT && !bResult; i++)
 	{
-		if (*it == pCallback)
-			return true;
+		bResult = !BeginRead((HookType_t) i)->empty();
+		EndRead();
+	}
+	return bResult;
+}
+
+bool CHook::AddRule(const Rule_t& rule)
+{
+	if (!m_pEntry)
+		return false;
+
+	if (rule.m_eType != RULE_SUPERSEDE && (rule.m_iIndex < 0 || rule.m_iIndex >= GetArgumentCount()))
+		return false;
+
+	m_Rules.push_back(rule);
+	void* pRules = CreateRules(this);
+	if (!pRules)
+	{
+		m_Rules.pop_back();
+		return false;
+	}
+
+	ReplaceRules(pRules);
+	return true;
+}
+
+void CHook::ClearRules()
+{
+	m_Rules.clear();
+	ReplaceRules(NULL);
+}
+
+void CHook::ReplaceRules(void* pRules)
+{
+	void* pOldRules = m_pRules;
+	m_pRules = pRules;
+	UpdateEntry();
+
+	unsigned int uiNow = GetMilliseconds();
+	while (!m_RetiredRules.empty() && uiNow - m_RetiredRules.front().m_uiRetiredAt >= RULES_GRACE_PERIOD)
+	{
+		MemoryManager::getGlobal()->free(m_RetiredRules.front().m_pCode);
+		m_RetiredRules.pop_front();
+	}
+
+	if (pOldRules)
+	{
+		RetiredRules_t retired = {pOldRules, uiNow};
+		m_RetiredRules.push_back(retired);
 	}
-	return false;
+}
+
+void CHook::UpdateEntry()
+{
+	void* pNext = HasCallbacks() ? m_pBridge : m_pTrampoline;
+
+	// The rules must know where to continue before the entry jumps to them
+	m_pRulesNext = pNext;
+	m_pEntryTarget = m_pRules ? m_pRules : pNext;
 }
 
 int CHook::GetPopSize()
@@ -237,6 +502,113 @@ Param_t* CHook::GetArgument(int iIndex)
 }
 
 
+// ============================================================================
+// >> CRedirect
+// ============================================================================
+CRedirect::CRedirect(void* pFunc)
+{
+	m_pFunc = pFunc;
+	m_pTarget = NULL;
+	m_pTrampoline = NULL;
+	m_pOriginalBytes = NULL;
+	m_iOriginalSize = 0;
+
+	unsigned char* pFuncBytes = (unsigned char *) pFunc;
+
+#ifdef __x86_64__
+	// The trampoline must be near the function, so RIP-relative operands can
+	// be relocated. A near block can also be reached with a 5 byte jump.
+	m_pCode = (unsigned char *) AllocateNear(pFunc, CODE_BLOCK_SIZE);
+	if (!m_pCode)
+		return;
+
+	int iJmpSize = IsNear(m_pCode, pFunc) ? OP_JMP_SIZE : OP_JMP_ABS_SIZE;
+
+	// Copy and relocate the instructions that will be overwritten
+	int iTrampolineSize;
+	int iBytesToCopy = copy_bytes_x64(pFuncBytes, m_pCode, iJmpSize, &iTrampolineSize);
+	if (iBytesToCopy == -1)
+		return;
+
+	// Jump to the rest of the function
+	inject_jmp_x64(m_pCode + iTrampolineSize, pFuncBytes + iBytesToCopy);
+
+	// Prepare the absolute jump to far replacements. Enable() only replaces
+	// its aligned address operand.
+	unsigned char* pStub = m_pCode + REDIRECT_STUB_OFFSET;
+	pStub[0] = 0xFF;
+	pStub[1] = 0x25;
+	*(int *) (pStub + 2) = 0;
+
+	unsigned char* pCode = m_pCode;
+#else
+	int iBytesToCopy = copy_bytes(pFuncBytes, NULL, OP_JMP_SIZE);
+
+	// Copy the instructions that will be overwritten and add a jump to the
+	// rest of the function
+	unsigned char* pCode = (unsigned char *) malloc(iBytesToCopy + JMP_SIZE);
+	SetMemPatchable(pCode, iBytesToCopy + JMP_SIZE);
+	copy_bytes(pFuncBytes, pCode, OP_JMP_SIZE);
+	WriteJMP(pCode + iBytesToCopy, pFuncBytes + iBytesToCopy);
+#endif
+
+	// Save the original bytes, so they can be restored later
+	m_iOriginalSize = iBytesToCopy;
+	m_pOriginalBytes = new unsigned char[iBytesToCopy];
+	memcpy(m_pOriginalBytes, pFuncBytes, iBytesToCopy);
+	m_pTrampoline = pCode;
+}
+
+CRedirect::~CRedirect()
+{
+	Disable();
+	delete [] m_pOriginalBytes;
+
+#ifdef __x86_64__
+	if (m_pCode)
+		FreeNear(m_pCode, CODE_BLOCK_SIZE);
+#else
+	free(m_pTrampoline);
+#endif
+}
+
+void CRedirect::Enable(void* pTarget)
+{
+	if (!m_pTrampoline || !pTarget)
+		return;
+
+	void* pJmpTarget = pTarget;
+#ifdef __x86_64__
+	// Jump to the absolute jump in the code block if the replacement is too
+	// far away for a 5 byte jump
+	if (!IsNear(pTarget, m_pFunc) && IsNear(m_pCode, m_pFunc))
+	{
+		pJmpTarget = m_pCode + REDIRECT_STUB_OFFSET;
+		*(void* volatile *) (m_pCode + REDIRECT_STUB_OFFSET + 6) = pTarget;
+		__sync_synchronize();
+	}
+#endif
+
+	// Replace the entry with the jump and fill the rest with NOPs
+	unsigned char* pPatch = new unsigned char[m_iOriginalSize];
+	int iJmpSize = BuildJMP(pPatch, m_pFunc, pJmpTarget);
+	fill_nop(pPatch + iJmpSize, m_iOriginalSize - iJmpSize);
+	PatchCodeAtomic(m_pFunc, pPatch, m_iOriginalSize);
+	delete [] pPatch;
+
+	m_pTarget = pTarget;
+}
+
+void CRedirect::Disable()
+{
+	if (!m_pTarget)
+		return;
+
+	PatchCodeAtomic(m_pFunc, m_pOriginalBytes, m_iOriginalSize);
+	m_pTarget = NULL;
+}
+
+
 // ============================================================================
 // >> GetHookManager
 // ============================================================================
@@ -249,19 +621,94 @@ CHookManager* GetHookManager()
 }
 
 
+// ============================================================================
+// >> Frames
+// ============================================================================
+struct FrameStack_t
+{
+	int         m_iDepth;
+	HookFrame_t m_Frames[MAX_HOOK_FRAMES];
+};
+
+// Allocated per thread on first access and released when the thread exits
+static __thread FrameStack_t t_FrameStack;
+
+/*
+	Called by the bridge. Pushes a new frame and redirects the return address
+	to the post-hook code. Returns NULL if the thread is already nested too
+	deeply. The bridge skips the callbacks in that case.
+*/
+#ifdef __x86_64__
+HookFrame_t* PushFrame(CHook* pHook, void** pESP, Registers_t* pRegisters)
+#else
+HookFrame_t* PushFrame(CHook* pHook, void** pESP, void* pECX)
+#endif
+{
+	FrameStack_t* pStack = &t_FrameStack;
+	if (pStack->m_iDepth == MAX_HOOK_FRAMES)
+		return NULL;
+
+	HookFrame_t* pFrame = &pStack->m_Frames[pStack->m_iDepth++];
+	pFrame->m_pHook = pHook;
+	pFrame->m_pRetAddr = *pESP;
+	pFrame->m_pESP = pESP;
+	pFrame->m_ullRetReg = 0;
+	pFrame->m_bOverridden = false;
+	pFrame->m_pUserData = NULL;
+	pFrame->m_pUserDataOwner = NULL;
+#ifdef __x86_64__
+	pFrame->m_pECX = NULL;
+	pFrame->m_Registers = *pRegisters;
+#else
+	pFrame->m_pECX = pECX;
+#endif
+
+	*pESP = pHook->m_pPostCallback;
+	return pFrame;
+}
+
+/*
+	Called by the post-hook code. The returned frame stays valid until the
+	next call of PushFrame() in this thread.
+*/
+HookFrame_t* PopFrame()
+{
+	return &t_FrameStack.m_Frames[--t_FrameStack.m_iDepth];
+}
+
+namespace DynamicHooks {
+HookFrame_t* GetCurrentFrame()
+{
+	return &t_FrameStack.m_Frames[t_FrameStack.m_iDepth - 1];
+}
+
+int GetFrameDepth()
+{
+	return t_FrameStack.m_iDepth;
+}
+}
+
+
 // ============================================================================
 // >> HookHandler
 // ============================================================================
 int HookHandler(HookType_t eHookType, CHook* pHook)
 {
+	// Other threads might add or remove callbacks at the same time. The list
+	// stays valid until EndRead() is called, even if it's replaced.
 	bool bOverride = false;
-	std::list<void *> callbacks = pHook->m_Callbacks[eHookType];
-	for(std::list<void *>::iterator it=callbacks.begin(); it != callbacks.end(); it++)
+	std::vector<void *>* pCallbacks = pHook->BeginRead(eHookType);
+	for(std::vector<void *>::iterator it=pCallbacks->begin(); it != pCallbacks->end(); it++)
 	{
 		bool result = ((HookFn) *it)(eHookType, pHook);
 		if (result)
 			bOverride = true;
 	}
+	pHook->EndRead();
+
+	if (eHookType == HOOKTYPE_PRE)
+		GetCurrentFrame()->m_bOverridden = bOverride;
+
 	return bOverride;
 }
 
@@ -269,37 +716,242 @@ int HookHandler(HookType_t eHookType, CHook* pHook)
 // ============================================================================
 // >> CreateBridge
 // ============================================================================
-void Write_SaveRegisters(Assembler& a, CHook* pHook)
+/*
+	The bridge and the post-hook code don't store anything in the CHook
+	instance. All call specific data is stored in the frame of the calling
+	thread, which is retrieved with a call to PushFrame(), GetCurrentFrame()
+	or PopFrame().
+*/
+#define FRAME_RETADDR   offsetof(HookFrame_t, m_pRetAddr)
+#define FRAME_ECX       offsetof(HookFrame_t, m_pECX)
+#define FRAME_RETREG    offsetof(HookFrame_t, m_ullRetReg)
+
+#ifdef __x86_64__
+#define FRAME_REGISTERS offsetof(HookFrame_t, m_Registers)
+
+// Size of the register buffer on the stack. Keeps the stack aligned to 16
+// bytes.
+#define REGISTERS_SIZE  sizeof(Registers_t)
+
+/*
+	System V AMD64 ABI. All code is written to the code block of the hook.
+	r10 and r11 are used as scratch registers, because they are neither
+	preserved nor used to pass arguments.
+*/
+void* WriteCode(Assembler& a, CHook* pHook)
 {
-	a.mov(dword_ptr_abs(&pHook->m_pESP), esp);
+	sysint_t iSize = a.getCodeSize();
+	if (pHook->m_iCodeSize + iSize > CODE_BLOCK_SIZE)
+		return NULL;
 
-#ifdef _WIN32
-	if (pHook->m_eConvention == CONV_THISCALL)
-		// On Windows the this pointer is saved in ecx
-		a.mov(dword_ptr_abs(&pHook->m_pECX), ecx);
-#endif
+	unsigned char* pCode = pHook->m_pCode + pHook->m_iCodeSize;
+	sysint_t iWritten = a.relocCode(pCode);
+	pHook->m_iCodeSize += (iWritten + 15) & ~15;
+	return pCode;
+}
+
+void Write_SaveRegisters(Assembler& a, const GPReg& base)
+{
+	a.mov(qword_ptr(base, 0), rdi);
+	a.mov(qword_ptr(base, 8), rsi);
+	a.mov(qword_ptr(base, 16), rdx);
+	a.mov(qword_ptr(base, 24), rcx);
+	a.mov(qword_ptr(base, 32), r8);
+	a.mov(qword_ptr(base, 40), r9);
+	for (int i=0; i < 8; i++)
+		a.movq(qword_ptr(base, 48 + i * 8), xmm(i));
+
+	a.mov(qword_ptr(base, 112), rax);
+}
+
+void Write_RestoreRegisters(Assembler& a, const GPReg& base)
+{
+	a.mov(rdi, qword_ptr(base, 0));
+	a.mov(rsi, qword_ptr(base, 8));
+	a.mov(rdx, qword_ptr(base, 16));
+	a.mov(rcx, qword_ptr(base, 24));
+	a.mov(r8, qword_ptr(base, 32));
+	a.mov(r9, qword_ptr(base, 40));
+	for (int i=0; i < 8; i++)
+		a.movq(xmm(i), qword_ptr(base, 48 + i * 8));
+
+	a.mov(rax, qword_ptr(base, 112));
+}
+
+void Write_Call(Assembler& a, void* pFunc)
+{
+	a.mov(rax, imm((sysint_t) pFunc));
+	a.call(rax);
 }
 
+/*
+	Expects rax and xmm0 at [rsp] and [rsp + 8] and the frame in rax.
+*/
 void Write_SaveReturnValue(Assembler& a, CHook* pHook)
+{
+	char type = pHook->m_pRetParam->m_cParam;
+	if (type == SIGCHAR_FLOAT || type == SIGCHAR_DOUBLE)
+		a.mov(r11, qword_ptr(rsp, 8));
+	else
+		a.mov(r11, qword_ptr(rsp));
+
+	a.mov(qword_ptr(rax, FRAME_RETREG), r11);
+}
+
+/*
+	Expects the frame in rax.
+*/
+void Write_RestoreReturnValue(Assembler& a, CHook* pHook)
+{
+	char type = pHook->m_pRetParam->m_cParam;
+	if (type == SIGCHAR_FLOAT || type == SIGCHAR_DOUBLE)
+		a.movq(xmm0, qword_ptr(rax, FRAME_RETREG));
+	else
+		a.mov(rax, qword_ptr(rax, FRAME_RETREG));
+}
+
+void Write_CallHandler(Assembler& a, CHook* pHook, HookType_t eHookType)
+{
+	a.mov(edi, imm(eHookType));
+	a.mov(rsi, imm((sysint_t) pHook));
+	Write_Call(a, (void *) &HookHandler);
+}
+
+void* CreatePostCallback(CHook* pHook)
+{
+	Assembler a;
+
+	// The return address has been popped, so the stack is aligned to 16
+	// bytes. Save the return registers, because retrieving the frame
+	// doesn't preserve them.
+	a.sub(rsp, imm(16));
+	a.mov(qword_ptr(rsp), rax);
+	a.movq(qword_ptr(rsp, 8), xmm0);
+
+	// Save the return value for later access
+	Write_Call(a, (void *) &GetCurrentFrame);
+	Write_SaveReturnValue(a, pHook);
+
+	// Call the post-hook handler
+	Write_CallHandler(a, pHook, HOOKTYPE_POST);
+
+	// Remove the frame. It stays valid until the next hooked call.
+	Write_Call(a, (void *) &PopFrame);
+	a.mov(r11, qword_ptr(rax, FRAME_RETADDR));
+
+	// Use the new return value
+	Write_RestoreReturnValue(a, pHook);
+
+	// Jump to the original return address
+	a.add(rsp, imm(16));
+	a.jmp(r11);
+
+	return WriteCode(a, pHook);
+}
+
+void* CreateBridge(CHook* pHook)
+{
+	pHook->m_pPostCallback = CreatePostCallback(pHook);
+	if (!pHook->m_pPostCallback)
+		return NULL;
+
+	Assembler a;
+	Label label_skip = a.newLabel();
+	Label label_override = a.newLabel();
+
+	// Save the argument registers on the stack. This also aligns the stack
+	// to 16 bytes.
+	a.sub(rsp, imm(REGISTERS_SIZE));
+	Write_SaveRegisters(a, rsp);
+
+	// Push a new frame. This copies the registers and redirects the return
+	// address to the post-hook code.
+	a.mov(rdi, imm((sysint_t) pHook));
+	a.lea(rsi, qword_ptr(rsp, REGISTERS_SIZE));
+	a.mov(rdx, rsp);
+	Write_Call(a, (void *) &PushFrame);
+	a.test(rax, rax);
+	a.jz(label_skip);
+
+	// Call the pre-hook handler and jump to label_override if true was
+	// returned
+	Write_CallHandler(a, pHook, HOOKTYPE_PRE);
+	a.cmp(eax, true);
+	a.je(label_override);
+
+	// The handler doesn't preserve the argument registers and callbacks might
+	// have modified them in the frame
+	Write_Call(a, (void *) &GetCurrentFrame);
+	a.lea(r11, qword_ptr(rax, FRAME_REGISTERS));
+	Write_RestoreRegisters(a, r11);
+	a.add(rsp, imm(REGISTERS_SIZE));
+
+	// Jump to the trampoline
+	a.mov(r11, imm((sysint_t) pHook->m_pTrampoline));
+	a.jmp(r11);
+
+	// This code will be executed if the thread is nested too deeply
+	a.bind(label_skip);
+	Write_RestoreRegisters(a, rsp);
+	a.add(rsp, imm(REGISTERS_SIZE));
+	a.mov(r11, imm((sysint_t) pHook->m_pTrampoline));
+	a.jmp(r11);
+
+	// This code will be executed if a pre-hook returns true
+	a.bind(label_override);
+
+	// Use the new return value
+	Write_Call(a, (void *) &GetCurrentFrame);
+	Write_RestoreReturnValue(a, pHook);
+	a.add(rsp, imm(REGISTERS_SIZE));
+
+	// Finally, return to the caller (via the post-hook code)
+	a.ret();
+
+	return WriteCode(a, pHook);
+}
+
+#else
+/*
+	Expects the frame in eax.
+*/
+void Write_RestoreReturnValue(Assembler& a, CHook* pHook)
 {
 	char type = pHook->m_pRetParam->m_cParam;
 	if (type == SIGCHAR_FLOAT)
-		a.fst(dword_ptr_abs(pHook->m_pRetReg));
+		a.fld(dword_ptr(eax, FRAME_RETREG));
 	else if (type == SIGCHAR_DOUBLE)
-		a.fst(qword_ptr_abs(pHook->m_pRetReg));
+		a.fld(qword_ptr(eax, FRAME_RETREG));
 	else
-		a.mov_ptr(pHook->m_pRetReg, eax);
+	{
+		// 64 bit integers are returned in edx:eax
+		a.mov(edx, dword_ptr(eax, FRAME_RETREG + 4));
+		a.mov(eax, dword_ptr(eax, FRAME_RETREG));
+	}
 }
 
-void Write_RestoreReturnValue(Assembler& a, CHook* pHook)
+void Write_SaveReturnValue(Assembler& a, CHook* pHook)
 {
+	// Retrieving the frame doesn't preserve eax, edx and st0. So, they are
+	// stored on the stack first.
 	char type = pHook->m_pRetParam->m_cParam;
+	a.sub(esp, imm(8));
 	if (type == SIGCHAR_FLOAT)
-		a.fld(dword_ptr_abs(pHook->m_pRetReg));
+		a.fstp(dword_ptr(esp));
 	else if (type == SIGCHAR_DOUBLE)
-		a.fld(qword_ptr_abs(pHook->m_pRetReg));
+		a.fstp(qword_ptr(esp));
 	else
-		a.mov_ptr(eax, pHook->m_pRetReg);
+	{
+		a.mov(dword_ptr(esp), eax);
+		a.mov(dword_ptr(esp, 4), edx);
+	}
+
+	a.call((void *) &GetCurrentFrame);
+	a.mov(ecx, dword_ptr(esp));
+	a.mov(dword_ptr(eax, FRAME_RETREG), ecx);
+	a.mov(ecx, dword_ptr(esp, 4));
+	a.mov(dword_ptr(eax, FRAME_RETREG + 4), ecx);
+	a.add(esp, imm(8));
 }
 
 void Write_CallHandler(Assembler& a, CHook* pHook, HookType_t eHookType)
@@ -314,65 +966,57 @@ void* CreatePostCallback(CHook* pHook)
 {
 	Assembler a;
 	
-	// Save the return value for later access
-	Write_SaveReturnValue(a, pHook);
-	
 	// On Windows thiscalls and stdcalls we have to subtract the pop size, so
-	// the post-hook callbacks can access the arguments again
+	// the arguments won't be overwritten and the post-hook callbacks can
+	// access them again
 	Imm iBytesToPop = imm(pHook->GetPopSize());
 
 	// Subtract the previous added bytes
 	a.sub(esp, iBytesToPop);
 
+	// Save the return value for later access
+	Write_SaveReturnValue(a, pHook);
+
 	// Call the post-hook handler
 	Write_CallHandler(a, pHook, HOOKTYPE_POST);
 
 	// Add them again to the stack
 	a.add(esp, iBytesToPop);
 
+	// Remove the frame. It stays valid until the next hooked call.
+	a.call((void *) &PopFrame);
+	a.push(dword_ptr(eax, FRAME_RETADDR));
+
 	// Use the new return value
 	Write_RestoreReturnValue(a, pHook);
 
-	// Jump to the original return address
-	a.jmp(dword_ptr_abs(&pHook->m_pRetAddr));
-
-	// TODO: Free this if the bridge gets freed or figure out how to get the
-	//       address of labels.
+	// Return to the original return address
+	a.ret();
 	return a.make();
 }
 
-void Write_ModifyReturnAddress(Assembler& a, CHook* pHook)
-{
-	// Unfortunately, there is no Assembler::mov(Mem, Mem). That's why this
-	// workaround is required.
-	void* pEDX = NULL;
-
-	// Store edx in pEDX
-	a.mov(dword_ptr_abs(&pEDX), edx);
-
-	// Store the return address in edx
-	a.mov(edx, dword_ptr(esp));
-
-	// Store return address in m_pRetAddr, so we can access it later
-	a.mov(dword_ptr_abs(&pHook->m_pRetAddr), edx);
-
-	// Restore edx
-	a.mov(edx, dword_ptr_abs(&pEDX));
-
-	// Override the return address. This is a redirect to our post-hook code
-	a.mov(dword_ptr(esp), imm((sysint_t) CreatePostCallback(pHook)));
-}
-
 void* CreateBridge(CHook* pHook)
 {
+	pHook->m_pPostCallback = CreatePostCallback(pHook);
+
 	Assembler a;
+	Label label_skip = a.newLabel();
 	Label label_override = a.newLabel();
 
-	// Write a redirect to the post-hook code
-	Write_ModifyReturnAddress(a, pHook);
-
-	// Save esp and ecx (on Windows) for later access (arguments and thisptr)
-	Write_SaveRegisters(a, pHook);
+	// Push a new frame. This saves esp and ecx (arguments and this pointer on
+	// Windows) and redirects the return address to the post-hook code.
+	a.push(ecx);
+	a.push(edx);
+	a.lea(eax, dword_ptr(esp, 8));
+	a.push(ecx);
+	a.push(eax);
+	a.push(imm((sysint_t) pHook));
+	a.call((void *) &PushFrame);
+	a.add(esp, imm(12));
+	a.pop(edx);
+	a.pop(ecx);
+	a.test(eax, eax);
+	a.jz(label_skip);
 	
 	// Call the pre-hook handler and jump to label_override if true was returned
 	Write_CallHandler(a, pHook, HOOKTYPE_PRE);
@@ -383,22 +1027,377 @@ void* CreateBridge(CHook* pHook)
 	// Restore ecx, because it changes either in the global hook handler ('cause of the loop)
 	// or in a registered hook handler (through SetArgument). That's a problem if the trampoline
 	// requires a valid this pointer -- e.g. if it uses virtual functions of its class.
-	// TODO: Add a Write_RestorePreservedRegisters()
 	if (pHook->m_eConvention == CONV_THISCALL)
-		a.mov(ecx, dword_ptr_abs(&pHook->m_pECX));
+	{
+		a.call((void *) &GetCurrentFrame);
+		a.mov(ecx, dword_ptr(eax, FRAME_ECX));
+	}
 #endif
 
-	// Jump to the trampoline
+	// Jump to the trampoline. This is also done directly if the thread is
+	// nested too deeply.
+	a.bind(label_skip);
 	a.jmp(pHook->m_pTrampoline);
 
 	// This code will be executed if a pre-hook returns true
 	a.bind(label_override);
 
 	// Use the new return value
+	a.call((void *) &GetCurrentFrame);
 	Write_RestoreReturnValue(a, pHook);
 
-	// Finally, return to the caller
+	// Finally, return to the caller (via the post-hook code)
+	a.ret(imm(pHook->GetPopSize()));
+
+	return a.make();
+}
+#endif
+
+
+// ============================================================================
+// >> CreateEntry / CreateRules
+// ============================================================================
+/*
+	The entry is the code the hooked function jumps to. It jumps indirectly
+	to m_pEntryTarget, so the rules can be replaced and the bridge can be
+	skipped without patching the hooked function again.
+
+	The rules are applied directly in the entry of the function. They only
+	use registers that are neither preserved nor used to pass arguments, so
+	they don't need to call anything. Every change compiles them into a new
+	block, which only uses absolute jumps and doesn't have to be near the
+	function.
+
+	Clamped integers are compared with their real width. The bytes above
+	a char or short argument are undefined.
+*/
+bool IsSignedType(char cType)
+{
+	switch(cType)
+	{
+		case SIGCHAR_CHAR:
+		case SIGCHAR_SHORT:
+		case SIGCHAR_INT:
+		case SIGCHAR_LONG:
+		case SIGCHAR_LONGLONG:
+			return true;
+	}
+	return false;
+}
+
+#ifdef __x86_64__
+void* CreateEntry(CHook* pHook)
+{
+	Assembler a;
+	a.mov(r11, imm((sysint_t) &pHook->m_pEntryTarget));
+	a.jmp(qword_ptr(r11));
+	return WriteCode(a, pHook);
+}
+
+/*
+	Returns the location of an argument after the argument registers have
+	been saved on the stack.
+*/
+Mem GetRuleOperand(Param_t* pParam)
+{
+	int iDisp;
+	if (pParam->m_iRegister != ARG_REG_NONE)
+		iDisp = pParam->m_iRegister * sizeof(unsigned long long);
+	else
+		// Skip the register buffer and the return address
+		iDisp = REGISTERS_SIZE + sizeof(void *) + pParam->m_iOffset;
+
+	switch (GetValueSize(pParam->m_cParam))
+	{
+		case 1:  return byte_ptr(rsp, iDisp);
+		case 2:  return word_ptr(rsp, iDisp);
+		case 8:  return qword_ptr(rsp, iDisp);
+	}
+	return dword_ptr(rsp, iDisp);
+}
+
+void Write_Rule(Assembler& a, Rule_t& rule, Param_t* pParam)
+{
+	Mem value = GetRuleOperand(pParam);
+	int iSize = GetValueSize(pParam->m_cParam);
+	char type = pParam->m_cParam;
+
+	// Register of r11 with the size of the argument
+	GPReg reg = iSize == 1 ? r11b : iSize == 2 ? r11w : iSize == 4 ? r11d : r11;
+
+	if (rule.m_eType == RULE_SET_ARGUMENT)
+	{
+		a.mov(r11, imm((sysint_t) rule.m_ullValue));
+		a.mov(value, reg);
+	}
+	else if (type == SIGCHAR_FLOAT || type == SIGCHAR_DOUBLE)
+	{
+		// xmm0 and xmm1 are restored from the register buffer later
+		if (type == SIGCHAR_FLOAT)
+		{
+			a.movss(xmm0, value);
+			a.mov(r11, imm((sysint_t) rule.m_ullValue));
+			a.movq(xmm1, r11);
+			a.maxss(xmm0, xmm1);
+			a.mov(r11, imm((sysint_t) rule.m_ullMax));
+			a.movq(xmm1, r11);
+			a.minss(xmm0, xmm1);
+			a.movss(value, xmm0);
+		}
+		else
+		{
+			a.movsd(xmm0, value);
+			a.mov(r11, imm((sysint_t) rule.m_ullValue));
+			a.movq(xmm1, r11);
+			a.maxsd(xmm0, xmm1);
+			a.mov(r11, imm((sysint_t) rule.m_ullMax));
+			a.movq(xmm1, r11);
+			a.minsd(xmm0, xmm1);
+			a.movsd(value, xmm0);
+		}
+	}
+	else
+	{
+		// Compare all integers with 64 bits
+		bool bSigned = IsSignedType(type);
+		if (iSize == 8)
+			a.mov(r11, value);
+		else if (iSize == 4)
+		{
+			if (bSigned)
+				a.movsxd(r11, value);
+			else
+				a.mov(r11d, value);
+		}
+		else if (bSigned)
+			a.movsx(r11, value);
+		else
+			a.movzx(r11d, value);
+
+		a.mov(r10, imm((sysint_t) rule.m_ullValue));
+		a.cmp(r11, r10);
+		a.cmov(bSigned ? C_LESS : C_BELOW, r11, r10);
+
+		a.mov(r10, imm((sysint_t) rule.m_ullMax));
+		a.cmp(r11, r10);
+		a.cmov(bSigned ? C_GREATER : C_ABOVE, r11, r10);
+
+		a.mov(value, reg);
+	}
+}
+
+void Write_Supersede(Assembler& a, CHook* pHook, unsigned long long ullValue)
+{
+	char type = pHook->m_pRetParam->m_cParam;
+	if (type == SIGCHAR_FLOAT || type == SIGCHAR_DOUBLE)
+	{
+		a.mov(r11, imm((sysint_t) ullValue));
+		a.movq(xmm0, r11);
+	}
+	else if (type != SIGCHAR_VOID)
+		a.mov(rax, imm((sysint_t) ullValue));
+
+	a.ret();
+}
+
+void* CreateRules(CHook* pHook)
+{
+	Assembler a;
+
+	// A supersede rule makes all other rules pointless
+	for(std::list<Rule_t>::iterator it=pHook->m_Rules.begin(); it != pHook->m_Rules.end(); it++)
+	{
+		if (it->m_eType == RULE_SUPERSEDE)
+		{
+			Write_Supersede(a, pHook, it->m_ullValue);
+			return a.make();
+		}
+	}
+
+	// Save the argument registers, so all arguments can be accessed in memory
+	a.sub(rsp, imm(REGISTERS_SIZE));
+	Write_SaveRegisters(a, rsp);
+
+	for(std::list<Rule_t>::iterator it=pHook->m_Rules.begin(); it != pHook->m_Rules.end(); it++)
+		Write_Rule(a, *it, pHook->GetArgument(it->m_iIndex));
+
+	Write_RestoreRegisters(a, rsp);
+	a.add(rsp, imm(REGISTERS_SIZE));
+
+	// Continue with the bridge or the trampoline
+	a.mov(r11, imm((sysint_t) &pHook->m_pRulesNext));
+	a.jmp(qword_ptr(r11));
+	return a.make();
+}
+
+#else
+void* CreateEntry(CHook* pHook)
+{
+	Assembler a;
+	a.jmp(dword_ptr_abs((void *) &pHook->m_pEntryTarget));
+	return a.make();
+}
+
+/*
+	Returns the displacement of an argument after ecx has been pushed.
+*/
+int GetRuleDisplacement(CHook* pHook, int iIndex)
+{
+#ifdef _WIN32
+	if (pHook->m_eConvention == CONV_THISCALL && iIndex == 0)
+		return 0;
+#endif
+
+	// Skip ecx and the return address
+	return 8 + pHook->GetArgument(iIndex)->m_iOffset;
+}
+
+/*
+	SSE2 can't load 64 bit constants into a register directly.
+*/
+void Write_LoadDouble(Assembler& a, const XMMReg& reg, unsigned long long ullValue)
+{
+	a.push(imm((sysint_t) (ullValue >> 32)));
+	a.push(imm((sysint_t) ullValue));
+	a.movsd(reg, qword_ptr(esp));
+	a.add(esp, imm(8));
+}
+
+void Write_Rule(Assembler& a, CHook* pHook, Rule_t& rule)
+{
+	Param_t* pParam = pHook->GetArgument(rule.m_iIndex);
+	int iDisp = GetRuleDisplacement(pHook, rule.m_iIndex);
+	char type = pParam->m_cParam;
+
+	sysint_t iLow = (sysint_t) rule.m_ullValue;
+	sysint_t iHigh = (sysint_t) (rule.m_ullValue >> 32);
+	sysint_t iMaxLow = (sysint_t) rule.m_ullMax;
+	sysint_t iMaxHigh = (sysint_t) (rule.m_ullMax >> 32);
+
+	if (rule.m_eType == RULE_SET_ARGUMENT)
+	{
+		a.mov(dword_ptr(esp, iDisp), imm(iLow));
+		if (pParam->m_iSize == 8)
+			a.mov(dword_ptr(esp, iDisp + 4), imm(iHigh));
+	}
+	else if (type == SIGCHAR_FLOAT)
+	{
+		a.movss(xmm0, dword_ptr(esp, iDisp));
+		a.mov(eax, imm(iLow));
+		a.movd(xmm1, eax);
+		a.maxss(xmm0, xmm1);
+		a.mov(eax, imm(iMaxLow));
+		a.movd(xmm1, eax);
+		a.minss(xmm0, xmm1);
+		a.movss(dword_ptr(esp, iDisp), xmm0);
+	}
+	else if (type == SIGCHAR_DOUBLE)
+	{
+		a.movsd(xmm0, qword_ptr(esp, iDisp));
+		Write_LoadDouble(a, xmm1, rule.m_ullValue);
+		a.maxsd(xmm0, xmm1);
+		Write_LoadDouble(a, xmm1, rule.m_ullMax);
+		a.minsd(xmm0, xmm1);
+		a.movsd(qword_ptr(esp, iDisp), xmm0);
+	}
+	else if (pParam->m_iSize == 8)
+	{
+		// Compare both halves with cmp and sbb
+		bool bSigned = IsSignedType(type);
+		Label label_min = a.newLabel();
+		Label label_max = a.newLabel();
+
+		a.mov(eax, dword_ptr(esp, iDisp));
+		a.mov(edx, dword_ptr(esp, iDisp + 4));
+		a.cmp(eax, imm(iLow));
+		a.sbb(edx, imm(iHigh));
+		a.j(bSigned ? C_GREATER_EQUAL : C_ABOVE_EQUAL, label_min);
+		a.mov(dword_ptr(esp, iDisp), imm(iLow));
+		a.mov(dword_ptr(esp, iDisp + 4), imm(iHigh));
+		a.bind(label_min);
+
+		a.mov(eax, imm(iMaxLow));
+		a.mov(edx, imm(iMaxHigh));
+		a.cmp(eax, dword_ptr(esp, iDisp));
+		a.sbb(edx, dword_ptr(esp, iDisp + 4));
+		a.j(bSigned ? C_GREATER_EQUAL : C_ABOVE_EQUAL, label_max);
+		a.mov(dword_ptr(esp, iDisp), imm(iMaxLow));
+		a.mov(dword_ptr(esp, iDisp + 4), imm(iMaxHigh));
+		a.bind(label_max);
+	}
+	else
+	{
+		bool bSigned = IsSignedType(type);
+		int iSize = GetValueSize(type);
+		Mem value = iSize == 1 ? byte_ptr(esp, iDisp) : iSize == 2 ? word_ptr(esp, iDisp) : dword_ptr(esp, iDisp);
+		if (iSize == 4)
+			a.mov(eax, value);
+		else if (bSigned)
+			a.movsx(eax, value);
+		else
+			a.movzx(eax, value);
+
+		a.mov(edx, imm(iLow));
+		a.cmp(eax, edx);
+		a.cmov(bSigned ? C_LESS : C_BELOW, eax, edx);
+
+		a.mov(edx, imm(iMaxLow));
+		a.cmp(eax, edx);
+		a.cmov(bSigned ? C_GREATER : C_ABOVE, eax, edx);
+
+		a.mov(value, iSize == 1 ? al : iSize == 2 ? ax : eax);
+	}
+}
+
+void Write_Supersede(Assembler& a, CHook* pHook, unsigned long long ullValue)
+{
+	char type = pHook->m_pRetParam->m_cParam;
+	if (type == SIGCHAR_FLOAT)
+	{
+		a.push(imm((sysint_t) ullValue));
+		a.fld(dword_ptr(esp));
+		a.add(esp, imm(4));
+	}
+	else if (type == SIGCHAR_DOUBLE)
+	{
+		a.push(imm((sysint_t) (ullValue >> 32)));
+		a.push(imm((sysint_t) ullValue));
+		a.fld(qword_ptr(esp));
+		a.add(esp, imm(8));
+	}
+	else if (type != SIGCHAR_VOID)
+	{
+		// 64 bit integers are returned in edx:eax
+		a.mov(eax, imm((sysint_t) ullValue));
+		a.mov(edx, imm((sysint_t) (ullValue >> 32)));
+	}
+
 	a.ret(imm(pHook->GetPopSize()));
+}
+
+void* CreateRules(CHook* pHook)
+{
+	Assembler a;
+
+	// A supersede rule makes all other rules pointless
+	for(std::list<Rule_t>::iterator it=pHook->m_Rules.begin(); it != pHook->m_Rules.end(); it++)
+	{
+		if (it->m_eType == RULE_SUPERSEDE)
+		{
+			Write_Supersede(a, pHook, it->m_ullValue);
+			return a.make();
+		}
+	}
+
+	// eax and edx are free. ecx might contain the this pointer.
+	a.push(ecx);
+	for(std::list<Rule_t>::iterator it=pHook->m_Rules.begin(); it != pHook->m_Rules.end(); it++)
+		Write_Rule(a, pHook, *it);
 
+	a.pop(ecx);
+
+	// Continue with the bridge or the trampoline
+	a.jmp(dword_ptr_abs((void *) &pHook->m_pRulesNext));
 	return a.make();
-}
\ No newline at end of file
+}
+#endif
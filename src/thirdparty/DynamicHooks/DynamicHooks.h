@@ -36,6 +36,13 @@
 // ============================================================================
 #include <list>
 #include <map>
+#include <vector>
+#include <stddef.h>
+
+// Only the System V AMD64 ABI is supported on 64 bit
+#if defined(_M_X64) || (defined(_WIN32) && defined(__x86_64__))
+	#error "DynamicHooks doesn't support the Windows x64 calling convention"
+#endif
 
 namespace DynamicHooks {
 
@@ -72,6 +79,9 @@ enum HookType_t
 	HOOKTYPE_POST
 };
 
+// Number of hook types
+#define HOOKTYPE_COUNT 2
+
 
 // ============================================================================
 // >> Convention_t
@@ -84,18 +94,156 @@ enum Convention_t
 };
 
 
+// ============================================================================
+// >> Registers_t
+// ============================================================================
+// Indexes of the argument registers in Registers_t
+#define ARG_REG_NONE	-1
+#define ARG_REG_RDI		0
+#define ARG_REG_XMM0	6
+
+#ifdef __x86_64__
+/*
+	Argument registers of the System V AMD64 ABI at the time the hooked
+	function was called: rdi, rsi, rdx, rcx, r8, r9, xmm0 - xmm7 (low
+	quadwords) and rax (number of used SSE registers of variadic functions).
+*/
+struct Registers_t
+{
+	unsigned long long m_ullRegisters[14];
+	unsigned long long m_ullRAX;
+};
+#endif
+
+
 // ============================================================================
 // >> Param_t
 // ============================================================================
 struct Param_t
 {
 	char     m_cParam;
+
+	// Offset from the first stack argument
 	int      m_iOffset;
 	int      m_iSize;
+
+	// Index of the argument register or ARG_REG_NONE if the argument has been
+	// passed on the stack
+	int      m_iRegister;
 	Param_t* m_pNext;
 };
 
 
+// ============================================================================
+// >> Rule_t
+// ============================================================================
+enum RuleType_t
+{
+	// Sets an argument to a constant
+	RULE_SET_ARGUMENT,
+
+	// Clamps an argument to a range
+	RULE_CLAMP_ARGUMENT,
+
+	// Returns a constant without calling the original function or any
+	// callback
+	RULE_SUPERSEDE
+};
+
+/*
+	Rules are compiled into the entry of a hook, so they are applied without
+	calling HookHandler. Values have the type of the argument or the return
+	value: integers are sign or zero extended to 64 bits and floats are stored
+	in the lower 32 bits.
+*/
+struct Rule_t
+{
+	RuleType_t         m_eType;
+
+	// Index of the argument. Unused by RULE_SUPERSEDE.
+	int                m_iIndex;
+
+	// Constant or minimum
+	unsigned long long m_ullValue;
+
+	// Maximum of RULE_CLAMP_ARGUMENT
+	unsigned long long m_ullMax;
+};
+
+/*
+	Compiled rules that have been replaced. Other threads might still execute
+	them, so they are freed after a grace period.
+*/
+struct RetiredRules_t
+{
+	void*        m_pCode;
+
+	// Time in milliseconds the rules have been replaced at
+	unsigned int m_uiRetiredAt;
+};
+
+
+// ============================================================================
+// >> HookFrame_t
+// ============================================================================
+class CHook;
+
+/*
+	State of a single call of a hooked function. The bridge pushes a frame
+	when the function is called and the post-hook code pops it again. Every
+	thread has its own stack of frames, so hooked functions can be called by
+	several threads at once and recursively.
+*/
+struct HookFrame_t
+{
+	CHook* m_pHook;
+
+	// Contains the original return address
+	void* m_pRetAddr;
+
+	// Stack pointer at the time the function was called. It points to the
+	// return address.
+	void* m_pESP;
+
+	// Counter register. This will only be set on Windows
+	void* m_pECX;
+
+	// This is the return register buffer (eax:edx, st0, rax or xmm0)
+	unsigned long long m_ullRetReg;
+
+	// True if a pre-hook callback has overridden the call
+	bool m_bOverridden;
+
+	// Can be used by callbacks to pass data from the pre-hook to the
+	// post-hook of the same call. It's NULL when the call starts. The
+	// callback that sets it stores an identifier (e.g. its own address) in
+	// m_pUserDataOwner. Other callbacks must leave it alone.
+	void* m_pUserData;
+	void* m_pUserDataOwner;
+
+#ifdef __x86_64__
+	// Argument registers at the time the function was called
+	Registers_t m_Registers;
+#endif
+};
+
+// Maximum number of nested hooked calls per thread. Deeper calls skip the
+// callbacks and go straight to the trampoline.
+#define MAX_HOOK_FRAMES 64
+
+/*
+	Returns the frame of the innermost hooked function the calling thread is
+	currently executing. Only valid inside a callback.
+*/
+HookFrame_t* GetCurrentFrame();
+
+/*
+	Returns the number of hooked functions the calling thread is currently
+	executing.
+*/
+int GetFrameDepth();
+
+
 // ============================================================================
 // >> CHook
 // ============================================================================
@@ -112,7 +260,7 @@ public:
 	template<class T>
 	T GetReturnValue()
 	{
-		return *(T *) m_pRetReg;
+		return *(T *) &GetCurrentFrame()->m_ullRetReg;
 	}
 	
 	/*
@@ -121,7 +269,7 @@ public:
 	template<class T>
 	void SetReturnValue(T value)
 	{
-		*(T *) m_pRetReg = value;
+		*(T *) &GetCurrentFrame()->m_ullRetReg = value;
 	}
 	
 	/*
@@ -133,13 +281,7 @@ public:
 	template<class T>
 	T GetArgument(int iIndex)
 	{
-#ifdef _WIN32
-		if (m_eConvention == CONV_THISCALL && iIndex == 0)
-			return *(T *) &m_pECX;
-#endif
-
-		unsigned long reg = ((unsigned long) m_pESP) + GetArgument(iIndex)->m_iOffset + 4;
-		return *(T *) reg;
+		return *(T *) GetArgumentAddress(iIndex);
 	}
 
 	/*
@@ -151,22 +293,36 @@ public:
 	template<class T>
 	void SetArgument(int iIndex, T value)
 	{
+		*(T *) GetArgumentAddress(iIndex) = value;
+	}
+
+	/*
+		Returns the address where the argument at the given index is stored.
+		This is either on the stack or in the register buffer.
+	*/
+	void* GetArgumentAddress(int iIndex)
+	{
+		HookFrame_t* pFrame = GetCurrentFrame();
 #ifdef _WIN32
 		if (m_eConvention == CONV_THISCALL && iIndex == 0)
-		{
-			m_pECX = *(void **) &value;
-			return;
-		}
+			return &pFrame->m_pECX;
+#endif
+
+		Param_t* pParam = GetArgument(iIndex);
+#ifdef __x86_64__
+		if (pParam->m_iRegister != ARG_REG_NONE)
+			return &pFrame->m_Registers.m_ullRegisters[pParam->m_iRegister];
 #endif
 
-		unsigned long reg = ((unsigned long) m_pESP) + GetArgument(iIndex)->m_iOffset + 4;
-		*(T *) reg = value;
+		// Skip the return address
+		return (unsigned char *) pFrame->m_pESP + pParam->m_iOffset + sizeof(void *);
 	}
 
 	/*
-		Adds a new callback to the callback list.
+		Adds a new callback to the callback list. If bFront is true, it's
+		called before all other callbacks of the same type.
 	*/
-	void AddCallback(HookType_t eHookType, void* pCallback);
+	void AddCallback(HookType_t eHookType, void* pCallback, bool bFront = false);
 
 	/*
 		Removes an existing callback from the callback list.
@@ -178,6 +334,46 @@ public:
 	*/
 	bool IsCallbackRegistered(HookType_t eHookType, void* pCallback);
 
+	/*
+		Returns true if at least one callback is registered.
+	*/
+	bool HasCallbacks();
+
+	/*
+		Marks the calling thread as a reader of the callback lists, so they
+		won't be freed until EndRead() is called. Returns the current list
+		of the given hook type.
+	*/
+	std::vector<void *>* BeginRead(HookType_t eHookType)
+	{
+		__atomic_add_fetch(&m_iReaders, 1, __ATOMIC_SEQ_CST);
+		return __atomic_load_n(&m_pCallbacks[eHookType], __ATOMIC_SEQ_CST);
+	}
+
+	void EndRead()
+	{
+		__atomic_sub_fetch(&m_iReaders, 1, __ATOMIC_SEQ_CST);
+	}
+
+	/*
+		Adds a rule and compiles all rules of this hook. Argument rules are
+		applied in the order they were added and before the pre-hook
+		callbacks are called. Returns false if the rules couldn't be compiled.
+	*/
+	bool AddRule(const Rule_t& rule);
+
+	/*
+		Removes all rules.
+	*/
+	void ClearRules();
+
+	/*
+		Lets the entry jump to the rules, the bridge or directly to the
+		trampoline, depending on what is registered. The bridge is skipped
+		if there are no callbacks.
+	*/
+	void UpdateEntry();
+
 	/*
 		Returns the size you have to pop off from stack as a callee.
 	*/
@@ -193,20 +389,20 @@ public:
 	*/
 	Param_t* GetArgument(int iIndex);
 
-public:
-	// This is the return register buffer (eax and st0)
-	void* m_pRetReg;
-
-	// Stack pointer register buffer
-	void* m_pESP;
-
-	// Counter register. This will only be set on Windows
-	void* m_pECX;
-
-	// Contains the original return address
-	void* m_pRetAddr;
+private:
+	/*
+		Replaces the compiled rules and frees the retired rules whose grace
+		period has expired.
+	*/
+	void ReplaceRules(void* pRules);
 
+	/*
+		Publishes a new callback list. Must be called with m_iCallbacksLock
+		held.
+	*/
+	void PublishCallbacks(HookType_t eHookType, std::vector<void *>* pCallbacks);
 
+public:
 	// Parameter struct
 	Param_t* m_pParams;
 
@@ -220,9 +416,23 @@ public:
 	// Address of the bridge
 	void* m_pBridge;
 
+	// Address of the code the hooked function jumps to. It jumps to
+	// m_pEntryTarget, which can be replaced atomically.
+	void*          m_pEntry;
+	void* volatile m_pEntryTarget;
+
+	// Address of the compiled rules or NULL. They jump to m_pRulesNext
+	// (either the bridge or the trampoline) when they are done.
+	void*          m_pRules;
+	void* volatile m_pRulesNext;
+
 	// Address of the hooked function
 	void* m_pFunc;
 
+	// Address of the post-hook code. The bridge redirects the return address
+	// of every call to it.
+	void* m_pPostCallback;
+
 
 	// Calling convention of the original function
 	Convention_t  m_eConvention;
@@ -230,9 +440,92 @@ public:
 	// Stringified parameter list
 	char* m_szParams;
 
+#ifdef __x86_64__
+	// Memory block near the hooked function that contains the trampoline,
+	// the bridge and the post-hook code
+	unsigned char* m_pCode;
+	int            m_iCodeSize;
+
+	// Bytes that have been overwritten by the jump to the bridge
+	unsigned char* m_pOriginalBytes;
+	int            m_iOriginalSize;
+#endif
+
 
-	// A map for all callbacks
-	std::map< HookType_t, std::list<void *> > m_Callbacks;
+	// Callbacks of every hook type. Published lists are never modified, so
+	// HookHandler() can iterate them without a lock while other threads add
+	// or remove callbacks. Changes replace the whole list.
+	std::vector<void *>* m_pCallbacks[HOOKTYPE_COUNT];
+
+	// Number of threads that are currently reading m_pCallbacks
+	int m_iReaders;
+
+	// Serializes changes of the callbacks
+	volatile int m_iCallbacksLock;
+
+	// Replaced callback lists that might still be read by other threads.
+	// They are freed by the next change that finds no reader.
+	std::list< std::vector<void *> * > m_RetiredCallbacks;
+
+	// All rules in the order they have been added
+	std::list<Rule_t> m_Rules;
+
+	// Previously compiled rules in the order they have been replaced
+	std::list<RetiredRules_t> m_RetiredRules;
+};
+
+
+// ============================================================================
+// >> CRedirect
+// ============================================================================
+/*
+	Replaces a function with another one by patching its entry with a direct
+	jump. Unlike CHook, there is no bridge and there are no callbacks. The
+	trampoline calls the original function, so the replacement can chain to
+	it.
+
+	The trampoline is created once and kept until the instance is deleted,
+	because other threads might still be executing it after the redirect has
+	been disabled. Enabling the redirect again reuses the trampoline.
+*/
+class CRedirect
+{
+public:
+	CRedirect(void* pFunc);
+	~CRedirect();
+
+	/*
+		Patches the entry of the function with a jump to pTarget.
+	*/
+	void Enable(void* pTarget);
+
+	/*
+		Restores the original bytes of the function.
+	*/
+	void Disable();
+
+	bool IsEnabled() { return m_pTarget != NULL; }
+
+public:
+	// Address of the redirected function
+	void* m_pFunc;
+
+	// Address of the replacement or NULL if the redirect is disabled
+	void* m_pTarget;
+
+	// Calls the original function. NULL if the function couldn't be
+	// redirected (e.g. because an instruction couldn't be relocated).
+	void* m_pTrampoline;
+
+	// Bytes that are overwritten by the jump
+	unsigned char* m_pOriginalBytes;
+	int            m_iOriginalSize;
+
+#ifdef __x86_64__
+	// Memory block near the function that contains the trampoline and an
+	// absolute jump to far replacements
+	unsigned char* m_pCode;
+#endif
 };
 
 
@@ -260,12 +553,33 @@ public:
 	CHook* FindHook(void* pFunc);
 
 	/*
-		Removes all callbacks and restores all functions.
+		Removes all callbacks and restores all functions. Redirected functions
+		are restored as well.
 	*/
 	void UnhookAllFunctions();
 
+	/*
+		Redirects the given function to pTarget and returns the CRedirect
+		instance. Returns NULL if the function is hooked or already redirected
+		or if it couldn't be redirected.
+	*/
+	CRedirect* RedirectFunction(void* pFunc, void* pTarget);
+
+	/*
+		Restores a redirected function. The CRedirect instance is kept, so
+		its trampoline stays valid.
+	*/
+	void RestoreFunction(void* pFunc);
+
+	/*
+		Returns either NULL or the found CRedirect instance. The instance
+		might be disabled.
+	*/
+	CRedirect* FindRedirect(void* pFunc);
+
 public:
 	std::list<CHook *> m_Hooks;
+	std::list<CRedirect *> m_Redirects;
 };
 
 
@@ -65,8 +65,8 @@ void check_thunks(unsigned char *dest, unsigned char *pc)
 #else
 	/* Step write address back 4 to the start of the function address */
 	unsigned char *writeaddr = dest - 4;
-	unsigned char *calloffset = *(unsigned char **)writeaddr;
-	unsigned char *calladdr = (unsigned char *)(dest + (unsigned int)calloffset);
+	int calloffset = *(int *)writeaddr;
+	unsigned char *calladdr = dest + calloffset;
 
 	/* Lookup name of function being called */
 	if ((*calladdr == 0x8B) && (*(calladdr+2) == 0x24) && (*(calladdr+3) == 0xC3))
@@ -375,7 +375,7 @@ int copy_bytes(unsigned char *func, unsigned char* dest, int required_len) {
 //insert a specific JMP instruction at the given location
 void inject_jmp(void* src, void* dest) {
 	*(unsigned char*)src = OP_JMP;
-	*(long*)((unsigned char*)src+1) = (long)((unsigned char*)dest - ((unsigned char*)src + OP_JMP_SIZE));
+	*(int*)((unsigned char*)src+1) = (int)((unsigned char*)dest - ((unsigned char*)src + OP_JMP_SIZE));
 }
 
 //fill a given block with NOPs
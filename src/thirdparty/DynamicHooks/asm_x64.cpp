@@ -0,0 +1,411 @@
+/**
+* =============================================================================
+* DynamicHooks
+* Copyright (C) 2013 Robin Gohmert. All rights reserved.
+* =============================================================================
+*
+* This software is provided 'as-is', without any express or implied warranty.
+* In no event will the authors be held liable for any damages arising from 
+* the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose, 
+* including commercial applications, and to alter it and redistribute it 
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not 
+* claim that you wrote the original software. If you use this software in a 
+* product, an acknowledgment in the product documentation would be 
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*
+* asm.h/cpp from devmaster.net (thanks cybermind) edited by pRED* to handle gcc
+* -fPIC thunks correctly
+*
+* Idea and trampoline code taken from DynDetours (thanks your-name-here).
+*/
+
+// ============================================================================
+// >> INCLUDES
+// ============================================================================
+#include <string.h>
+#include "asm_x64.h"
+
+
+// ============================================================================
+// >> DEFINITIONS
+// ============================================================================
+#define F_MODRM		0x001	// ModRM byte follows
+#define F_IMM8		0x002	// 8 bit immediate
+#define F_IMM16		0x004	// 16 bit immediate
+#define F_IMMZ		0x008	// 16 or 32 bit immediate (depends on the operand size)
+#define F_IMMV		0x010	// 16, 32 or 64 bit immediate (mov r, imm)
+#define F_MOFFS		0x020	// 32 or 64 bit absolute address
+#define F_REL8		0x040	// 8 bit relative branch
+#define F_REL32		0x080	// 32 bit relative branch
+#define F_GROUP3	0x100	// test r/m, imm has an immediate, the other members don't
+#define F_ERROR		0x200	// Invalid in 64 bit mode or not supported
+
+#define IS_INT32(x)	((x) == (long long) (int) (x))
+
+
+// ============================================================================
+// >> HELPER FUNCTIONS
+// ============================================================================
+static int one_byte_flags(unsigned char op)
+{
+	// add, or, adc, sbb, and, sub, xor and cmp
+	if (op < 0x40)
+	{
+		switch (op & 7)
+		{
+			case 0: case 1: case 2: case 3:	return F_MODRM;
+			case 4:	return F_IMM8;
+			case 5:	return F_IMMZ;
+		}
+
+		// Segment prefixes are handled by the caller. The rest is invalid in
+		// 64 bit mode.
+		return F_ERROR;
+	}
+
+	// push and pop (REX prefixes are handled by the caller)
+	if (op < 0x60)
+		return 0;
+
+	if (op >= 0x70 && op <= 0x7F)
+		return F_REL8;
+
+	if (op >= 0x84 && op <= 0x8F)
+		return F_MODRM;
+
+	if (op >= 0x90 && op <= 0x9F)
+		return op == 0x9A ? F_ERROR : 0;
+
+	if (op >= 0xB0 && op <= 0xB7)
+		return F_IMM8;
+
+	if (op >= 0xB8 && op <= 0xBF)
+		return F_IMMV;
+
+	if (op >= 0xD8 && op <= 0xDF)
+		return F_MODRM;
+
+	switch (op)
+	{
+		case 0x63: return F_MODRM;
+		case 0x68: return F_IMMZ;
+		case 0x69: return F_MODRM | F_IMMZ;
+		case 0x6A: return F_IMM8;
+		case 0x6B: return F_MODRM | F_IMM8;
+		case 0x6C: case 0x6D: case 0x6E: case 0x6F: return 0;
+		case 0x80: case 0x83: return F_MODRM | F_IMM8;
+		case 0x81: return F_MODRM | F_IMMZ;
+		case 0xA0: case 0xA1: case 0xA2: case 0xA3: return F_MOFFS;
+		case 0xA4: case 0xA5: case 0xA6: case 0xA7: return 0;
+		case 0xA8: return F_IMM8;
+		case 0xA9: return F_IMMZ;
+		case 0xAA: case 0xAB: case 0xAC: case 0xAD: case 0xAE: case 0xAF: return 0;
+		case 0xC0: case 0xC1: return F_MODRM | F_IMM8;
+		case 0xC2: return F_IMM16;
+		case 0xC3: return 0;
+		case 0xC6: return F_MODRM | F_IMM8;
+		case 0xC7: return F_MODRM | F_IMMZ;
+		case 0xC8: return F_IMM16 | F_IMM8;
+		case 0xC9: return 0;
+		case 0xCA: return F_IMM16;
+		case 0xCB: case 0xCC: return 0;
+		case 0xCD: return F_IMM8;
+		case 0xCF: return 0;
+		case 0xD0: case 0xD1: case 0xD2: case 0xD3: return F_MODRM;
+		case 0xD7: return 0;
+		case 0xE0: case 0xE1: case 0xE2: case 0xE3: return F_REL8;
+		case 0xE4: case 0xE5: case 0xE6: case 0xE7: return F_IMM8;
+		case 0xE8: case 0xE9: return F_REL32;
+		case 0xEB: return F_REL8;
+		case 0xEC: case 0xED: case 0xEE: case 0xEF: return 0;
+		case 0xF1: case 0xF4: case 0xF5: return 0;
+		case 0xF6: case 0xF7: return F_MODRM | F_GROUP3;
+		case 0xF8: case 0xF9: case 0xFA: case 0xFB: case 0xFC: case 0xFD: return 0;
+		case 0xFE: case 0xFF: return F_MODRM;
+	}
+	return F_ERROR;
+}
+
+static int two_byte_flags(unsigned char op)
+{
+	// jcc rel32
+	if (op >= 0x80 && op <= 0x8F)
+		return F_REL32;
+
+	// bswap
+	if (op >= 0xC8 && op <= 0xCF)
+		return 0;
+
+	// wrmsr, rdtsc, rdmsr, rdpmc, sysenter, sysexit, getsec
+	if (op >= 0x30 && op <= 0x37)
+		return 0;
+
+	switch (op)
+	{
+		case 0x05: case 0x06: case 0x07: case 0x08: case 0x09: case 0x0B:
+		case 0x0E: case 0x77: case 0xA0: case 0xA1: case 0xA2: case 0xA8:
+		case 0xA9: case 0xAA:
+			return 0;
+
+		case 0x0F: case 0x70: case 0x71: case 0x72: case 0x73: case 0xA4:
+		case 0xAC: case 0xBA: case 0xC2: case 0xC4: case 0xC5: case 0xC6:
+			return F_MODRM | F_IMM8;
+	}
+	return F_MODRM;
+}
+
+
+// ============================================================================
+// >> FUNCTIONS
+// ============================================================================
+int insn_length_x64(unsigned char* code, int* rel_offset, int* rel_size, int* is_rip)
+{
+	unsigned char* p = code;
+	int opsize16 = 0;
+	int addrsize32 = 0;
+	int rex_w = 0;
+	int flags;
+
+	*rel_offset = -1;
+	*rel_size = 0;
+	*is_rip = 0;
+
+	// Legacy prefixes
+	for (;; p++)
+	{
+		if (p - code > 14)
+			return 0;
+
+		if (*p == 0x66)
+			opsize16 = 1;
+		else if (*p == 0x67)
+			addrsize32 = 1;
+		else if (*p != 0xF0 && *p != 0xF2 && *p != 0xF3 && *p != 0x2E && *p != 0x36 &&
+				*p != 0x3E && *p != 0x26 && *p != 0x64 && *p != 0x65)
+			break;
+	}
+
+	// REX prefix
+	if ((*p & 0xF0) == 0x40)
+	{
+		rex_w = (*p & 0x08) != 0;
+		p++;
+	}
+
+	unsigned char op = *p++;
+	if (op == 0xC4 || op == 0xC5 || op == 0x62)
+	{
+		// VEX or EVEX prefix. The map is 0F for the 2 byte VEX form.
+		int map = op == 0xC5 ? 1 : (p[0] & (op == 0x62 ? 0x03 : 0x1F));
+		p += op == 0xC5 ? 1 : (op == 0xC4 ? 2 : 3);
+		if (map < 1 || map > 3)
+			return 0;
+
+		op = *p++;
+
+		// vzeroupper and vzeroall don't have a ModRM byte
+		if (map == 1 && op == 0x77)
+			return (int) (p - code);
+
+		flags = F_MODRM | (map == 3 ? F_IMM8 : 0);
+	}
+	else if (op == 0x0F)
+	{
+		op = *p++;
+		if (op == 0x38)
+		{
+			p++;
+			flags = F_MODRM;
+		}
+		else if (op == 0x3A)
+		{
+			p++;
+			flags = F_MODRM | F_IMM8;
+		}
+		else
+			flags = two_byte_flags(op);
+	}
+	else
+		flags = one_byte_flags(op);
+
+	if (flags & F_ERROR)
+		return 0;
+
+	if (flags & F_MODRM)
+	{
+		unsigned char modrm = *p++;
+		int mod = modrm >> 6;
+		int rm = modrm & 7;
+
+		// Only test (/0 and /1) has an immediate
+		if ((flags & F_GROUP3) && ((modrm >> 3) & 7) < 2)
+			flags |= op == 0xF6 ? F_IMM8 : F_IMMZ;
+
+		if (mod != 3)
+		{
+			if (rm == 4)
+			{
+				// SIB byte. A base of rbp/r13 without displacement means disp32.
+				unsigned char sib = *p++;
+				if (mod == 0 && (sib & 7) == 5)
+					p += 4;
+			}
+			else if (mod == 0 && rm == 5)
+			{
+				// RIP-relative
+				*is_rip = 1;
+				*rel_offset = (int) (p - code);
+				*rel_size = 4;
+				p += 4;
+			}
+
+			if (mod == 1)
+				p += 1;
+			else if (mod == 2)
+				p += 4;
+		}
+	}
+
+	if (flags & F_IMM8)
+		p += 1;
+
+	if (flags & F_IMM16)
+		p += 2;
+
+	if (flags & F_IMMZ)
+		p += opsize16 ? 2 : 4;
+
+	if (flags & F_IMMV)
+		p += rex_w ? 8 : (opsize16 ? 2 : 4);
+
+	if (flags & F_MOFFS)
+		p += addrsize32 ? 4 : 8;
+
+	if (flags & F_REL8)
+	{
+		*rel_offset = (int) (p - code);
+		*rel_size = 1;
+		p += 1;
+	}
+
+	if (flags & F_REL32)
+	{
+		*rel_offset = (int) (p - code);
+		*rel_size = 4;
+		p += 4;
+	}
+
+	return (int) (p - code);
+}
+
+int copy_bytes_x64(unsigned char* func, unsigned char* dest, int required_len, int* dest_len)
+{
+	int src_len = 0;
+	int out_len = 0;
+
+	while (src_len < required_len)
+	{
+		unsigned char* insn = func + src_len;
+		unsigned char* out = dest ? dest + out_len : NULL;
+		int rel_offset, rel_size, is_rip;
+		int len = insn_length_x64(insn, &rel_offset, &rel_size, &is_rip);
+		if (!len)
+			return -1;
+
+		src_len += len;
+		if (rel_offset == -1)
+		{
+			if (out)
+				memcpy(out, insn, len);
+
+			out_len += len;
+			continue;
+		}
+
+		// Calculate the absolute target of the relative operand
+		long long disp = rel_size == 1 ? (signed char) insn[rel_offset] : *(int *) (insn + rel_offset);
+		unsigned char* target = insn + len + disp;
+
+		// A branch into the overwritten bytes can't be relocated
+		if (!is_rip && target >= func && target < func + required_len)
+			return -1;
+
+		if (rel_size == 1)
+		{
+			// Convert short branches to near branches. Prefixes (branch hints)
+			// are dropped.
+			unsigned char op = insn[rel_offset - 1];
+			int size;
+			if (op == 0xEB)
+				size = 5;
+			else if (op >= 0x70 && op <= 0x7F)
+				size = 6;
+			else
+				// loop, loope, loopne and jrcxz don't have a near form
+				return -1;
+
+			if (out)
+			{
+				long long rel = target - (out + size);
+				if (!IS_INT32(rel))
+					return -1;
+
+				if (size == 5)
+					out[0] = 0xE9;
+				else
+				{
+					out[0] = 0x0F;
+					out[1] = 0x80 | (op & 0x0F);
+				}
+				*(int *) (out + size - 4) = (int) rel;
+			}
+			out_len += size;
+		}
+		else
+		{
+			if (out)
+			{
+				long long rel = target - (out + len);
+				if (!IS_INT32(rel))
+					return -1;
+
+				memcpy(out, insn, len);
+				*(int *) (out + rel_offset) = (int) rel;
+			}
+			out_len += len;
+		}
+	}
+
+	if (dest_len)
+		*dest_len = out_len;
+
+	return src_len;
+}
+
+int inject_jmp_x64(void* src, void* dest)
+{
+	unsigned char* p = (unsigned char *) src;
+	long long rel = (unsigned char *) dest - (p + 5);
+	if (IS_INT32(rel))
+	{
+		p[0] = 0xE9;
+		*(int *) (p + 1) = (int) rel;
+		return 5;
+	}
+
+	// jmp qword ptr [rip+0] followed by the absolute address
+	p[0] = 0xFF;
+	p[1] = 0x25;
+	*(int *) (p + 2) = 0;
+	*(unsigned long long *) (p + 6) = (unsigned long long) dest;
+	return OP_JMP_ABS_SIZE;
+}
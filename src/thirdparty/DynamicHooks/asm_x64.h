@@ -0,0 +1,61 @@
+/**
+* =============================================================================
+* DynamicHooks
+* Copyright (C) 2013 Robin Gohmert. All rights reserved.
+* =============================================================================
+*
+* This software is provided 'as-is', without any express or implied warranty.
+* In no event will the authors be held liable for any damages arising from 
+* the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose, 
+* including commercial applications, and to alter it and redistribute it 
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not 
+* claim that you wrote the original software. If you use this software in a 
+* product, an acknowledgment in the product documentation would be 
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*
+* asm.h/cpp from devmaster.net (thanks cybermind) edited by pRED* to handle gcc
+* -fPIC thunks correctly
+*
+* Idea and trampoline code taken from DynDetours (thanks your-name-here).
+*/
+
+#ifndef __ASM_X64_H__
+#define __ASM_X64_H__
+
+#define OP_JMP_ABS_SIZE		14
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	//returns the length of the x86-64 instruction at code or 0 if it's unknown
+	//rel_offset receives the offset of a relative operand (branch target or
+	//RIP-relative displacement) or -1, rel_size its size (1 or 4 bytes)
+	int insn_length_x64(unsigned char* code, int* rel_offset, int* rel_size, int* is_rip);
+
+	//copies whole instructions from func until at least required_len bytes are
+	//covered and relocates relative branches and RIP-relative operands, so they
+	//work at dest. Short branches are converted to near branches.
+	//returns the number of copied bytes or -1 if an instruction can't be
+	//relocated. dest_len receives the size of the relocated code. If dest is
+	//NULL, only the sizes are calculated.
+	int copy_bytes_x64(unsigned char* func, unsigned char* dest, int required_len, int* dest_len);
+
+	//insert a near JMP if dest is within +-2 GB or an absolute JMP otherwise
+	//returns the number of bytes that have been written
+	int inject_jmp_x64(void* src, void* dest);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__ASM_X64_H__
@@ -37,13 +37,19 @@
 
 #ifdef __linux__
 	#include <sys/mman.h>
+	#include <string.h>
+	#include <time.h>
 	#include <unistd.h>
 	#define PAGE_SIZE 4096
 	#define ALIGN(ar) ((long)ar & ~(PAGE_SIZE-1))
 	#define PAGE_EXECUTE_READWRITE PROT_READ|PROT_WRITE|PROT_EXEC
 #endif
 
+#include <limits.h>
+#include <string.h>
+
 #include "asm.h"
+#include "asm_x64.h"
 #include "utilities.h"
 using namespace DynamicHooks;
 
@@ -78,6 +84,38 @@ int GetTypeSize(char cType)
 }
 
 
+// ============================================================================
+// >> GetValueSize
+// ============================================================================
+int GetValueSize(char cType)
+{
+    switch(cType)
+    {
+        case SIGCHAR_BOOL:
+        case SIGCHAR_CHAR:
+        case SIGCHAR_UCHAR:     return 1;
+        case SIGCHAR_SHORT:
+        case SIGCHAR_USHORT:    return 2;
+    }
+    return GetTypeSize(cType);
+}
+
+
+// ============================================================================
+// >> GetMilliseconds
+// ============================================================================
+unsigned int GetMilliseconds()
+{
+#if defined __linux__
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned int) (now.tv_sec * 1000 + now.tv_nsec / 1000000);
+#elif defined _WIN32
+	return GetTickCount();
+#endif
+}
+
+
 // ============================================================================
 // >> ParseParams
 // ============================================================================
@@ -88,6 +126,12 @@ void ParseParams(Convention_t eConvention, char* szParams, Param_t* pParams, Par
 	char ch;
 	int offset = 0;
 
+#ifdef __x86_64__
+	// Number of used integer and SSE argument registers
+	int general = 0;
+	int sse = 0;
+#endif
+
 #ifdef _WIN32
 		if (eConvention == CONV_THISCALL)
 			offset -= sizeof(void *);
@@ -103,6 +147,28 @@ void ParseParams(Convention_t eConvention, char* szParams, Param_t* pParams, Par
 		param->m_cParam = ch;
 		param->m_iOffset = offset;
 		param->m_iSize = size;
+		param->m_iRegister = ARG_REG_NONE;
+
+#ifdef __x86_64__
+		// The first six integer and the first eight floating point arguments
+		// are passed in registers. All other arguments use 8 byte stack slots.
+		if (ch == SIGCHAR_FLOAT || ch == SIGCHAR_DOUBLE)
+		{
+			if (sse < 8)
+				param->m_iRegister = ARG_REG_XMM0 + sse++;
+		}
+		else if (general < 6)
+			param->m_iRegister = ARG_REG_RDI + general++;
+
+		if (param->m_iRegister != ARG_REG_NONE)
+		{
+			param->m_iOffset = 0;
+			param = param->m_pNext = new Param_t;
+			continue;
+		}
+		size = sizeof(void *);
+#endif
+
 		param = param->m_pNext = new Param_t;
 		offset += size;
 	}
@@ -117,6 +183,7 @@ void ParseParams(Convention_t eConvention, char* szParams, Param_t* pParams, Par
 	pRetParam->m_cParam  = ch;
 	pRetParam->m_iOffset = 0;
 	pRetParam->m_iSize   = GetTypeSize(ch);
+	pRetParam->m_iRegister = ARG_REG_NONE;
 	pRetParam->m_pNext   = NULL;
 }
 
@@ -127,7 +194,8 @@ void ParseParams(Convention_t eConvention, char* szParams, Param_t* pParams, Par
 void SetMemPatchable(void* pAddr, unsigned int size)
 {
 #if defined __linux__
-	mprotect((void *) ALIGN(pAddr), sysconf(_SC_PAGESIZE), PAGE_EXECUTE_READWRITE);
+	// The memory block might cross a page boundary
+	mprotect((void *) ALIGN(pAddr), (long) pAddr + size - ALIGN(pAddr), PAGE_EXECUTE_READWRITE);
 #elif defined _WIN32
 	DWORD old_prot;
 	VirtualProtect(pAddr, size, PAGE_EXECUTE_READWRITE, &old_prot);
@@ -142,4 +210,114 @@ void WriteJMP(unsigned char* src, void* dest)
 {
 	SetMemPatchable(src, 20);
 	inject_jmp((void *)src, dest);
+}
+
+
+// ============================================================================
+// >> BuildJMP
+// ============================================================================
+int BuildJMP(unsigned char* pBuffer, void* src, void* dest)
+{
+	long long rel = (unsigned char *) dest - ((unsigned char *) src + OP_JMP_SIZE);
+#ifdef __x86_64__
+	if (rel < INT_MIN || rel > INT_MAX)
+	{
+		// jmp qword ptr [rip+0] followed by the absolute address
+		pBuffer[0] = 0xFF;
+		pBuffer[1] = 0x25;
+		*(int *) (pBuffer + 2) = 0;
+		*(unsigned long long *) (pBuffer + 6) = (unsigned long long) dest;
+		return OP_JMP_ABS_SIZE;
+	}
+#endif
+
+	pBuffer[0] = OP_JMP;
+	*(int *) (pBuffer + 1) = (int) rel;
+	return OP_JMP_SIZE;
+}
+
+
+// ============================================================================
+// >> PatchCodeAtomic
+// ============================================================================
+void PatchCodeAtomic(void* pAddr, const unsigned char* pBytes, int iSize)
+{
+	SetMemPatchable(pAddr, iSize);
+
+	// jmp $ (EB FE). A single 16 bit store is atomic as long as it doesn't
+	// cross a cache line. Function entries are usually aligned.
+	volatile unsigned short* pHead = (volatile unsigned short *) pAddr;
+	*pHead = 0xFEEB;
+	__sync_synchronize();
+
+	memcpy((unsigned char *) pAddr + 2, pBytes + 2, iSize - 2);
+	__sync_synchronize();
+
+	*pHead = *(const unsigned short *) pBytes;
+	__sync_synchronize();
+}
+
+
+// ============================================================================
+// >> AllocateNear
+// ============================================================================
+void* AllocateNear(void* pTarget, unsigned int size)
+{
+#if defined __linux__
+	// Search for a free region within +-2 GB of the target in steps of 1 MB,
+	// so it can be reached with 32 bit displacements
+	long target = ALIGN(pTarget);
+	const long step = 1 << 20;
+	for (long distance = step; distance < NEAR_DISTANCE; distance += step)
+	{
+		for (int direction = -1; direction <= 1; direction += 2)
+		{
+			if (direction < 0 && distance > target)
+				continue;
+
+			void* hint = (void *) (target + direction * distance);
+			void* pAddr = mmap(hint, size, PAGE_EXECUTE_READWRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (pAddr == MAP_FAILED)
+				continue;
+
+			long long delta = (unsigned char *) pAddr - (unsigned char *) pTarget;
+			if (delta > -NEAR_DISTANCE && delta < NEAR_DISTANCE)
+				return pAddr;
+
+			munmap(pAddr, size);
+		}
+	}
+
+	// Anywhere is better than nothing. The caller has to use absolute jumps.
+	void* pAddr = mmap(NULL, size, PAGE_EXECUTE_READWRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return pAddr == MAP_FAILED ? NULL : pAddr;
+#elif defined _WIN32
+	return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#endif
+}
+
+
+// ============================================================================
+// >> FreeNear
+// ============================================================================
+void FreeNear(void* pAddr, unsigned int size)
+{
+	if (!pAddr)
+		return;
+
+#if defined __linux__
+	munmap(pAddr, size);
+#elif defined _WIN32
+	VirtualFree(pAddr, 0, MEM_RELEASE);
+#endif
+}
+
+
+// ============================================================================
+// >> IsNear
+// ============================================================================
+bool IsNear(void* pAddr, void* pTarget)
+{
+	long long delta = (unsigned char *) pAddr - (unsigned char *) pTarget;
+	return delta > -NEAR_DISTANCE && delta < NEAR_DISTANCE;
 }
\ No newline at end of file
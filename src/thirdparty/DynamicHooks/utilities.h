@@ -42,13 +42,55 @@
 // ============================================================================
 typedef bool (*HookFn)(DynamicHooks::HookType_t, DynamicHooks::CHook*);
 
+// Maximum distance that can be reached with a 32 bit displacement. Leaves
+// some space for the size of the allocated block.
+#define NEAR_DISTANCE 0x7FF00000LL
+
 
 // ============================================================================
 // >> FUNCTIONS
 // ============================================================================
 int  GetTypeSize(char cType);
+
+/*
+	Returns the number of bytes that are defined by a value of the given type.
+	Unlike GetTypeSize() this doesn't include the padding of small integers.
+*/
+int  GetValueSize(char cType);
+
+/*
+	Returns a monotonic time in milliseconds. It wraps around after 49 days.
+*/
+unsigned int GetMilliseconds();
+
 void ParseParams(DynamicHooks::Convention_t eConvention, char* szParams, DynamicHooks::Param_t* pParams, DynamicHooks::Param_t* pRetParam);
 void SetMemPatchable(void* pAddr, unsigned int size);
 void WriteJMP(unsigned char* src, void* dest);
 
+/*
+	Writes a jump to pBuffer that jumps to dest when it's executed at src.
+	Returns the number of written bytes. pBuffer needs room for 14 bytes.
+*/
+int  BuildJMP(unsigned char* pBuffer, void* src, void* dest);
+
+/*
+	Overwrites the first iSize bytes of a function, so a thread that enters
+	the function executes either the old or the new bytes:
+	1. The first two bytes are replaced with a jump to itself.
+	2. The remaining bytes are written.
+	3. The first two bytes are replaced with the new ones.
+	Threads that are executing the overwritten instructions at the same time
+	(behind the entry point) aren't handled. iSize must be at least 2.
+*/
+void PatchCodeAtomic(void* pAddr, const unsigned char* pBytes, int iSize);
+
+/*
+	Allocates executable memory within +-2 GB of the target, so it can be
+	reached with near jumps and RIP-relative operands. If no such block can be
+	found, the block is allocated anywhere.
+*/
+void* AllocateNear(void* pTarget, unsigned int size);
+void  FreeNear(void* pAddr, unsigned int size);
+bool  IsNear(void* pAddr, void* pTarget);
+
 #endif // _UTILITIES_H
\ No newline at end of file
@@ -0,0 +1,340 @@
+'''
+Scripted behaviour checks for parts of binutils that are easy to break and
+hard to notice. They run against the synthetic library of the benchmarks
+(benchmarks/target/bench_target.cpp), which is compiled on the fly. Build
+binutils first (build.sh or build.cmd), then run:
+
+    python tests/checks.py
+    python tests/checks.py recording query_simd
+
+The script exits with status 1 if at least one check failed.
+'''
+
+# =============================================================================
+# >> IMPORTS
+# =============================================================================
+# Python
+import os
+import sys
+import ctypes
+import shutil
+import optparse
+import tempfile
+import traceback
+
+# Make the binutils package and the benchmarks of the repository importable
+ROOT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, ROOT_DIR)
+sys.path.insert(0, os.path.join(ROOT_DIR, 'benchmarks'))
+
+# binutils
+from binutils import *
+
+# Benchmarks
+from bench import BENCH_DIR
+from bench import build_target
+
+
+# =============================================================================
+# >> CLASSES
+# =============================================================================
+class CheckError(Exception):
+    pass
+
+
+# =============================================================================
+# >> FUNCTIONS
+# =============================================================================
+def expect(condition, message, *args):
+    '''
+    Raises a CheckError with the formatted <message> if <condition> is false.
+    '''
+
+    if not condition:
+        raise CheckError(message % args)
+
+
+# =============================================================================
+# >> CHECKS
+# =============================================================================
+def check_recording(binary):
+    '''
+    Recording has to work on a function without any other callback, so
+    start_recording() alone has to route the function through the bridge.
+    '''
+
+    func = binary['bench_record_target'].make_function(Convention.CDECL,
+        'ii)i')
+
+    func.start_recording(16)
+    for x in xrange(3):
+        expect(func(x, 1) == x * 3 + 1, 'Wrong return value while recording.')
+
+    stats = func.recording_stats
+    expect(stats['calls'] == 3, 'Expected 3 recorded calls, got %d.',
+        stats['calls'])
+
+    func.stop_recording()
+    func(5, 1)
+    expect(func.recording_stats['calls'] == 3,
+        'The function was recorded after stop_recording().')
+
+    # Small integers are recorded with their natural width and have to be
+    # replayed from a saved file
+    func = binary['bench_record_small_target'].make_function(
+        Convention.CDECL, 'csi)i')
+
+    # chars are passed as strings of length 1. '\xfd' is -3.
+    calls = (('\xfd', -300, 7), ('d', 32000, -1))
+    func.start_recording(16)
+    for args, result in zip(calls, (-296, 32099)):
+        expect(func(*args) == result, 'Wrong return value while recording.')
+    func.stop_recording()
+
+    fd, path = tempfile.mkstemp(suffix='.rec')
+    os.close(fd)
+    try:
+        expect(func.save_recording(path) == len(calls),
+            'Not all calls were saved.')
+
+        recording = Recording(path)
+        expect(recording.types == 'csi', 'Wrong types: %s.', recording.types)
+
+        replayed = []
+        def callback(args):
+            replayed.append((args[0], args[1], args[2]))
+
+        result = recording.replay(callback)
+        expect(result[2] == 0, '%d errors while replaying.', result[2])
+        expect(tuple(replayed) == calls, 'Replayed %s instead of %s.',
+            replayed, calls)
+    finally:
+        os.remove(path)
+
+def check_layout_size(binary):
+    '''
+    A field that ends behind the declared size of a layout must still be
+    serialized and restored, so the size has to cover it.
+    '''
+
+    layout = Layout(4)
+    layout.add_field('a', 0, 'int')
+    layout.add_field('b', 8, 'int')
+    expect(layout.size == 12, 'Expected a size of 12, got %d.', layout.size)
+
+    ptr = alloc(12)
+    try:
+        ptr.set_int(1, 0)
+        ptr.set_int(2, 8)
+        blob = serialize(ptr, layout)
+
+        ptr.set_int(0, 0)
+        ptr.set_int(0, 8)
+        deserialize_into(ptr, blob, layout)
+        expect((ptr.get_int(0), ptr.get_int(8)) == (1, 2),
+            'Fields were not restored: %s.', (ptr.get_int(0), ptr.get_int(8)))
+    finally:
+        ptr.dealloc()
+
+def check_query_simd(binary):
+    '''
+    Queries compare columns with SSE2, while ArrayView.filter() tests every
+    object with the scalar comparisons. Both have to return the same objects
+    for edge values, counts that aren't a multiple of the vector width and
+    constants that don't fit into the column.
+    '''
+
+    nan = float('nan')
+    inf = float('inf')
+    columns = (
+        ('i', 0, 'int', (-2**31, -1, 0, 1, 8, 10, 2**31 - 1),
+            (-2**31, -1, 0, 8, 2**31 - 1, 2**40)),
+        ('f', 4, 'float', (nan, -inf, -1.5, 0.0, 2.5, inf),
+            (nan, -inf, -1.5, 0.0, 2.5, 0.1)),
+        ('c', 8, 'uchar', (0, 1, 127, 128, 255),
+            (0, 127, 128, 255, 300)),
+        ('s', 10, 'short', (-2**15, -1, 0, 2**15 - 1),
+            (-2**15, -1, 0, 2**15 - 1, 2**16)),
+        ('u', 12, 'uint', (0, 1, 2**31 - 1, 2**31, 2**32 - 1),
+            (0, 2**31 - 1, 2**31, 2**32 - 1, 2**32)),
+    )
+
+    layout = Layout(16)
+    for name, offset, type_name, values, constants in columns:
+        layout.add_field(name, offset, type_name)
+
+    count = 37
+    ptr = alloc(count * 16)
+    try:
+        for index in xrange(count):
+            obj = Pointer(ptr.address + index * 16)
+            for name, offset, type_name, values, constants in columns:
+                value = values[(index + offset) % len(values)]
+                getattr(obj, 'set_' + type_name)(value, offset)
+
+        view = ArrayView(ptr, 16, count, layout=layout)
+        for name, offset, type_name, values, constants in columns:
+            for op in ('==', '!=', '<', '<=', '>', '>='):
+                for constant in constants:
+                    simd = select(view, layout).where((name, op, constant)).addresses()
+                    scalar = view.filter(name, op, constant).addresses
+                    expect(simd == scalar, '%s %s %r: %d objects instead of %d.',
+                        name, op, constant, len(simd), len(scalar))
+
+        # A leading zero doesn't make a constant octal
+        tens = len(view.filter('i', '==', 10).addresses)
+        expect(tens and select(view, layout).where('i == 010').count() == tens,
+            'Constants with a leading zero were not parsed as decimals.')
+    finally:
+        ptr.dealloc()
+
+def check_task_keys(binary):
+    '''
+    Coalescing must only drop tasks whose key is the same object. Keys whose
+    hashes collide are still different tasks.
+    '''
+
+    drain_main_tasks()
+    set_task_coalescing(True)
+    try:
+        executed = []
+        key = 'check_task_keys'
+        run_on_main(executed.append, (1,), key)
+        run_on_main(executed.append, (2,), key)
+
+        # hash(-1) == hash(-2) in CPython
+        run_on_main(executed.append, (3,), -1)
+        run_on_main(executed.append, (4,), -2)
+        drain_main_tasks()
+        expect(executed == [1, 3, 4], 'Executed %s instead of [1, 3, 4].',
+            executed)
+    finally:
+        set_task_coalescing(False)
+
+def check_hash(binary):
+    '''
+    The hand-written XXH3 and XXH64 have to match the reference
+    implementations for every size class of XXH3, including the SSE2 stripes
+    of inputs larger than 240 bytes. The input starts at an odd address.
+    '''
+
+    # (size, xxh3, xxh64) of bytes (i * 7 + 3) & 0xFF
+    answers = (
+        (0, 0x2D06800538D394C2, 0xEF46DB3751D8E999),
+        (1, 0x13E608BC156DEFED, 0x1F25C8D0BC1F4BB6),
+        (3, 0xA9088DDA485B481C, 0x31D2363F52E564C9),
+        (4, 0x6D9253B16C8B1ED3, 0x9BB64B7D66EE9FDA),
+        (8, 0x60539DB630471163, 0xDAB99D95C6F90092),
+        (9, 0xFEFF668361D723A8, 0x170BB6BF975B4C02),
+        (16, 0xB8C859B0F030B585, 0x434850232B787BE2),
+        (17, 0x714A04408E79B80F, 0x1EFA7025F1B97A7A),
+        (128, 0x67425A03650261BF, 0x46FBCFBF0150793F),
+        (129, 0xC664BF3311C6ABC4, 0x3EB5D118151C8303),
+        (240, 0x64556DC6B462A6CF, 0x42562F61EF11B5AE),
+        (241, 0x8BEADD3A8874FE17, 0x07CF94F8EBA111B5),
+        (1024, 0x9B81661C641C72B1, 0xE6816A6E134B7A33),
+        (1025, 0x806C2072ED713576, 0x6385E21250A735CA),
+        (4097, 0xA51EAD018CADB378, 0xDA8D184207B32A00),
+    )
+
+    size = answers[-1][0]
+    ptr = alloc(size + 1)
+    try:
+        data = Pointer(ptr.address + 1)
+        for index in xrange(size):
+            data.set_uchar((index * 7 + 3) & 0xFF, index)
+
+        for size, xxh3, xxh64 in answers:
+            result = data.hash(size, 'xxh3')
+            expect(result == xxh3, 'XXH3 of %d bytes: 0x%016X instead of '
+                '0x%016X.', size, result, xxh3)
+
+            result = data.hash(size, 'xxh64')
+            expect(result == xxh64, 'XXH64 of %d bytes: 0x%016X instead of '
+                '0x%016X.', size, result, xxh64)
+    finally:
+        ptr.dealloc()
+
+def check_integrity_unload(binary):
+    '''
+    Blocks of a module that has been unloaded must be dropped instead of
+    being hashed.
+    '''
+
+    if os.name == 'nt':
+        return
+
+    import _ctypes
+
+    # Load a copy, so the module of the target library stays loaded
+    temp_dir = tempfile.mkdtemp()
+    try:
+        path = os.path.join(temp_dir, 'check_integrity_unload.so')
+        shutil.copy(binary.path, path)
+        library = ctypes.CDLL(path)
+
+        monitor = IntegrityMonitor(256)
+        expect(monitor.add_modules(os.path.basename(path)),
+            'No segments of the copy were added.')
+
+        monitor.step(monitor.blocks)
+        _ctypes.dlclose(library._handle)
+        monitor.step(monitor.blocks)
+        expect(monitor.blocks == 0, '%d blocks of the unloaded module are '
+            'left.', monitor.blocks)
+    finally:
+        shutil.rmtree(temp_dir)
+
+# All checks in the order they are run
+CHECKS = (
+    ('recording', check_recording),
+    ('layout_size', check_layout_size),
+    ('query_simd', check_query_simd),
+    ('task_keys', check_task_keys),
+    ('hash', check_hash),
+    ('integrity_unload', check_integrity_unload),
+)
+
+
+# =============================================================================
+# >> MAIN
+# =============================================================================
+def main():
+    parser = optparse.OptionParser(usage='%prog [options] [check ...]',
+        description='Runs behaviour checks. Checks: %s.'% ', '.join(
+            name for name, check in CHECKS))
+
+    parser.add_option('-b', '--build-dir', default=os.path.join(BENCH_DIR,
+        'build'), help='directory of the target library')
+
+    options, names = parser.parse_args()
+    for name in names:
+        if name not in dict(CHECKS):
+            parser.error('Unknown check: %s'% name)
+
+    print('Building the target library...')
+    binary = find_binary(build_target(options.build_dir), False)
+
+    failures = 0
+    for name, check in CHECKS:
+        if names and name not in names:
+            continue
+
+        try:
+            check(binary)
+        except CheckError, e:
+            failures += 1
+            print('FAIL %s: %s'% (name, e))
+        except Exception:
+            failures += 1
+            print('FAIL %s:'% name)
+            traceback.print_exc()
+        else:
+            print('OK   %s'% name)
+
+    if failures:
+        print('%d check(s) failed.'% failures)
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()